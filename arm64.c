@@ -44,6 +44,9 @@ static int arm64_vtop_2level_64k(ulong, ulong, physaddr_t *, int);
 static int arm64_vtop_3level_64k(ulong, ulong, physaddr_t *, int);
 static int arm64_vtop_3level_4k(ulong, ulong, physaddr_t *, int);
 static int arm64_vtop_4level_4k(ulong, ulong, physaddr_t *, int);
+struct arm64_walk_info;
+static int arm64_walk_table(struct arm64_walk_info *, int, ulonglong, int, ulong, ulong);
+static int arm64_walk_range(struct task_context *, ulong, ulong, walk_range_func, void *);
 static ulong arm64_get_task_pgd(ulong);
 static void arm64_irq_stack_init(void);
 static void arm64_overflow_stack_init(void);
@@ -422,6 +425,7 @@ arm64_init(int when)
 		machdep->flags |= VMEMMAP;
 
 		machdep->uvtop = arm64_uvtop;
+		machdep->walk_range = arm64_walk_range;
 		machdep->is_uvaddr = arm64_is_uvaddr;
 		machdep->eframe_search = arm64_eframe_search;
 		machdep->back_trace = arm64_back_trace_cmd;
@@ -1049,6 +1053,7 @@ arm64_dump_machdep_table(ulong arg)
 		"arm64_vtop_4level_4k" :
 		machdep->flags & VM_L3_64K ?
 		"arm64_vtop_3level_64k" : "arm64_vtop_2level_64k");
+	fprintf(fp, "          walk_range: arm64_walk_range()\n");
 	fprintf(fp, "        get_task_pgd: arm64_get_task_pgd()\n");
 	fprintf(fp, "            dump_irq: generic_dump_irq()\n");
 	fprintf(fp, "     get_stack_frame: arm64_get_stack_frame()\n");
@@ -2095,6 +2100,116 @@ no_page:
 	return FALSE;
 }
 
+/*
+ *  Walk a range of user virtual addresses by reading each page table page
+ *  once.  Only the 4K granule layouts are handled natively, following the
+ *  leaf rules of arm64_vtop_3level_4k() and arm64_vtop_4level_4k(); the
+ *  64K layouts use the page-at-a-time generic walker.
+ */
+#define ARM64_WALK_LEVELS  (4)
+
+struct arm64_walk_info {
+	walk_range_func func;
+	void *data;
+	ulong *table[ARM64_WALK_LEVELS];
+};
+
+static int
+arm64_walk_table(struct arm64_walk_info *wi, int level, ulonglong table,
+		 int memtype, ulong start, ulong end)
+{
+	struct walk_range_entry wre;
+	ulong *entries;
+	ulong vaddr, next, entry, shift, span;
+
+	shift = PAGESHIFT() + (level * 9);
+	span = 1UL << shift;
+	entries = wi->table[level];
+
+	if (!readmem(table, memtype, entries, PAGESIZE(),
+	    level ? "page directory" : "page table", RETURN_ON_ERROR|QUIET))
+		return TRUE;
+
+	for (vaddr = start; vaddr < end; vaddr = next) {
+		next = (vaddr & ~(span - 1)) + span;
+		if ((next > end) || (next < vaddr))
+			next = end;
+
+		entry = entries[(vaddr >> shift) & (PTRS_PER_PTE_L4_4K - 1)];
+		if (!entry)
+			continue;
+
+		if (level == 0) {
+			if (entry & PTE_VALID) {
+				wre.flags = WALK_RANGE_PRESENT;
+				wre.paddr = (PAGEBASE(entry) & PHYS_MASK) + 
+					PAGEOFFSET(vaddr);
+			} else {
+				wre.flags = 0;
+				wre.paddr = entry;
+			}
+		} else if ((level < 3) && 
+		    ((entry & PMD_TYPE_MASK) == PMD_TYPE_SECT)) {
+			wre.flags = WALK_RANGE_PRESENT;
+			wre.paddr = (entry & ~(span - 1) & PHYS_MASK) + 
+				(vaddr & (span - 1));
+		} else {
+			if (!arm64_walk_table(wi, level - 1, 
+			    entry & PHYS_MASK & (s32)machdep->pagemask,
+			    PHYSADDR, vaddr, next))
+				return FALSE;
+			continue;
+		}
+
+		wre.vaddr = vaddr;
+		wre.size = next - vaddr;
+		if (!wi->func(&wre, wi->data))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int
+arm64_walk_range(struct task_context *tc, ulong start, ulong end,
+		 walk_range_func func, void *data)
+{
+	struct arm64_walk_info walk_info, *wi;
+	ulong user_pgd;
+	int i, top, retval;
+
+	switch (machdep->flags & (VM_L2_64K|VM_L3_64K|VM_L3_4K|VM_L4_4K))
+	{
+	case VM_L3_4K:
+		top = 2;
+		break;
+	case VM_L4_4K:
+		top = 3;
+		break;
+	default:
+		return generic_walk_range(tc, start, end, func, data);
+	}
+
+	if (!IS_UVADDR(start, tc))
+		return generic_walk_range(tc, start, end, func, data);
+
+	readmem(tc->mm_struct + OFFSET(mm_struct_pgd), KVADDR,
+		&user_pgd, sizeof(long), "user pgd", FAULT_ON_ERROR);
+
+	wi = &walk_info;
+	wi->func = func;
+	wi->data = data;
+	for (i = 0; i <= top; i++)
+		wi->table[i] = (ulong *)GETBUF(PAGESIZE());
+
+	retval = arm64_walk_table(wi, top, user_pgd, KVADDR, start, end);
+
+	for (i = 0; i <= top; i++)
+		FREEBUF(wi->table[i]);
+
+	return retval;
+}
+
 static ulong 
 arm64_get_task_pgd(ulong task)
 {
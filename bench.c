@@ -0,0 +1,438 @@
+/* bench.c - core analysis suite
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "defs.h"
+
+/*
+ *  Microbenchmarks of the dumpfile, symbol and hashing paths, for use
+ *  with the synthetic dumpfiles built by benchmark/mkvmcore as well as
+ *  real ones.  Each operation is timed individually, and the results
+ *  are displayed as one JSON object per benchmark.  The "replay" benchmark
+ *  re-issues the dumpfile page reads recorded by "set memtrace".
+ */
+struct bench_data {
+	long iterations;
+	long size;
+	ulonglong memsize;
+	ulonglong seed;
+	physaddr_t *pages;
+	long nr_pages;
+	ulonglong *nsecs;
+	char *buf;
+	long errors;
+	long bytes;
+	char *trace;
+	struct memtrace_page *trace_pages;
+	long trace_count;
+	long saved_iterations;
+};
+
+struct bench_entry {
+	char *name;
+	int (*supported)(void);
+	void (*setup)(struct bench_data *);
+	int (*op)(struct bench_data *, long);
+	void (*cleanup)(struct bench_data *);
+};
+
+static ulonglong bench_random(struct bench_data *);
+static int bench_always(void);
+static int bench_diskdump(void);
+static int bench_trace(void);
+static void bench_page_setup(struct bench_data *);
+static int bench_readmem(struct bench_data *, long);
+static int bench_readmem_seq(struct bench_data *, long);
+static int bench_pfn_to_pos(struct bench_data *, long);
+static int bench_cache_page(struct bench_data *, long);
+static void bench_symbol_setup(struct bench_data *);
+static int bench_value_search(struct bench_data *, long);
+static int bench_symbol_search(struct bench_data *, long);
+static void bench_hq_setup(struct bench_data *);
+static int bench_hq_enter(struct bench_data *, long);
+static void bench_hq_cleanup(struct bench_data *);
+static void bench_replay_setup(struct bench_data *);
+static int bench_replay(struct bench_data *, long);
+static void bench_replay_cleanup(struct bench_data *);
+static int compare_ulonglong(const void *, const void *);
+static void bench_run(struct bench_entry *, struct bench_data *);
+
+static struct bench_entry bench_table[] = {
+	{ "readmem", bench_always, bench_page_setup, bench_readmem, NULL },
+	{ "readmem_seq", bench_always, bench_page_setup,
+		bench_readmem_seq, NULL },
+	{ "pfn_to_pos", bench_diskdump, bench_page_setup,
+		bench_pfn_to_pos, NULL },
+	{ "cache_page", bench_diskdump, bench_page_setup,
+		bench_cache_page, NULL },
+	{ "value_search", bench_always, bench_symbol_setup,
+		bench_value_search, NULL },
+	{ "symbol_search", bench_always, bench_symbol_setup,
+		bench_symbol_search, NULL },
+	{ "hq_enter", bench_always, bench_hq_setup, bench_hq_enter,
+		bench_hq_cleanup },
+	{ "replay", bench_trace, bench_replay_setup, bench_replay,
+		bench_replay_cleanup },
+	{ NULL }
+};
+
+#define BENCH_ITERATIONS  (100000)
+#define BENCH_MAX_PAGES   (65536)
+
+static struct bench_data *bench_current;
+
+void
+cmd_bench(void)
+{
+	int c, found;
+	struct bench_data bench_data, *bd;
+	struct bench_entry *be;
+
+	bd = &bench_data;
+	BZERO(bd, sizeof(struct bench_data));
+	bd->iterations = BENCH_ITERATIONS;
+	bd->size = sizeof(ulong);
+	bd->seed = 1;
+	bench_current = bd;
+
+        while ((c = getopt(argcnt, args, "n:b:m:s:r:")) != EOF) {
+                switch(c)
+		{
+		case 'n':
+			bd->iterations = stol(optarg, FAULT_ON_ERROR, NULL);
+			break;
+
+		case 'b':
+			bd->size = stol(optarg, FAULT_ON_ERROR, NULL);
+			break;
+
+		case 'm':
+			bd->memsize = stol(optarg, FAULT_ON_ERROR, NULL);
+			break;
+
+		case 's':
+			bd->seed = stol(optarg, FAULT_ON_ERROR, NULL);
+			break;
+
+		case 'r':
+			bd->trace = optarg;
+			break;
+
+		default:
+			argerrs++;
+			break;
+		}
+	}
+
+	if (argerrs)
+		cmd_usage(pc->curcmd, SYNOPSIS);
+
+	if ((bd->iterations <= 0) || (bd->size <= 0) ||
+	    (bd->size > PAGESIZE()))
+		error(FATAL, "invalid iteration count or read size\n");
+	if (!bd->seed)
+		bd->seed = 1;
+	if (!bd->memsize)
+		bd->memsize = machdep->memsize;
+
+	bd->nsecs = (ulonglong *)GETBUF(sizeof(ulonglong) * bd->iterations);
+	bd->buf = GETBUF(PAGESIZE());
+
+	if (!args[optind]) {
+		for (be = bench_table; be->name; be++) {
+			if (be->supported())
+				bench_run(be, bd);
+		}
+		return;
+	}
+
+	while (args[optind]) {
+		for (be = bench_table, found = FALSE; be->name; be++) {
+			if (!STREQ(args[optind], be->name))
+				continue;
+			found = TRUE;
+			if (be->supported())
+				bench_run(be, bd);
+			else
+				error(INFO, "%s: not supported with this dumpfile\n",
+					be->name);
+		}
+		if (!found)
+			error(INFO, "unknown benchmark: %s\n", args[optind]);
+		optind++;
+	}
+}
+
+/*
+ *  xorshift64*, so that a given seed always generates the same requests.
+ */
+static ulonglong
+bench_random(struct bench_data *bd)
+{
+	bd->seed ^= bd->seed >> 12;
+	bd->seed ^= bd->seed << 25;
+	bd->seed ^= bd->seed >> 27;
+	return bd->seed * 0x2545F4914F6CDD1DULL;
+}
+
+static int
+bench_always(void)
+{
+	return TRUE;
+}
+
+static int
+bench_diskdump(void)
+{
+	return DISKDUMP_DUMPFILE();
+}
+
+static int
+bench_trace(void)
+{
+	return (bench_current->trace != NULL);
+}
+
+/*
+ *  Gather a pool of random readable physical pages, sorted by address
+ *  for the sequential benchmark.  Unless a memory size is given, the
+ *  pages are chosen from below the system's memory size.
+ */
+static void
+bench_page_setup(struct bench_data *bd)
+{
+	ulonglong max_pfn, pfn;
+	long i, want, tries;
+	physaddr_t paddr;
+
+	if (bd->pages)
+		return;
+
+	if (!bd->memsize)
+		error(FATAL, "memory size unknown: use -m <memsize>\n");
+
+	if (!(max_pfn = bd->memsize / PAGESIZE()))
+		error(FATAL, "memory size %llx is smaller than a page\n",
+			bd->memsize);
+	want = MIN(bd->iterations, BENCH_MAX_PAGES);
+	bd->pages = (physaddr_t *)GETBUF(sizeof(physaddr_t) * want);
+
+	for (i = tries = 0; (i < want) && (tries < want * 16); tries++) {
+		pfn = bench_random(bd) % max_pfn;
+		paddr = PTOB(pfn);
+		if (!readmem(paddr, PHYSADDR, bd->buf, sizeof(ulong),
+		    "bench page", RETURN_ON_ERROR|QUIET))
+			continue;
+		bd->pages[i++] = paddr;
+	}
+
+	if (!(bd->nr_pages = i))
+		error(FATAL, "no readable pages found below %llx\n",
+			bd->memsize);
+
+	qsort(bd->pages, bd->nr_pages, sizeof(physaddr_t), compare_ulonglong);
+}
+
+static int
+bench_readmem(struct bench_data *bd, long i)
+{
+	physaddr_t paddr;
+
+	paddr = bd->pages[bench_random(bd) % bd->nr_pages] +
+		(bench_random(bd) % (PAGESIZE() - bd->size + 1));
+	bd->bytes += bd->size;
+
+	return readmem(paddr, PHYSADDR, bd->buf, bd->size, "bench readmem",
+		RETURN_ON_ERROR|QUIET);
+}
+
+static int
+bench_readmem_seq(struct bench_data *bd, long i)
+{
+	bd->bytes += PAGESIZE();
+
+	return readmem(bd->pages[i % bd->nr_pages], PHYSADDR, bd->buf,
+		PAGESIZE(), "bench readmem_seq", RETURN_ON_ERROR|QUIET);
+}
+
+static int
+bench_pfn_to_pos(struct bench_data *bd, long i)
+{
+	return diskdump_bench_page(BTOP(bd->pages[bench_random(bd) %
+		bd->nr_pages]), FALSE);
+}
+
+static int
+bench_cache_page(struct bench_data *bd, long i)
+{
+	bd->bytes += PAGESIZE();
+
+	return diskdump_bench_page(BTOP(bd->pages[bench_random(bd) %
+		bd->nr_pages]), TRUE);
+}
+
+static void
+bench_symbol_setup(struct bench_data *bd)
+{
+	if (!st->symcnt)
+		error(FATAL, "no kernel symbols to search\n");
+}
+
+static int
+bench_value_search(struct bench_data *bd, long i)
+{
+	struct syment *sp;
+	ulong offset;
+
+	sp = st->symtable + (bench_random(bd) % st->symcnt);
+
+	return (value_search(sp->value + (bench_random(bd) % 64),
+		&offset) != NULL);
+}
+
+static int
+bench_symbol_search(struct bench_data *bd, long i)
+{
+	struct syment *sp;
+
+	sp = st->symtable + (bench_random(bd) % st->symcnt);
+
+	return (symbol_search(sp->name) != NULL);
+}
+
+static void
+bench_hq_setup(struct bench_data *bd)
+{
+	if (!hq_open())
+		error(FATAL, "cannot open hash queue\n");
+}
+
+/*
+ *  Pointer-aligned values, about a fifth of which are duplicates.
+ */
+static int
+bench_hq_enter(struct bench_data *bd, long i)
+{
+	ulong value;
+
+	value = (bench_random(bd) % (bd->iterations * 2)) * sizeof(void *);
+	hq_enter(value);
+
+	return TRUE;
+}
+
+static void
+bench_hq_cleanup(struct bench_data *bd)
+{
+	hq_close();
+}
+
+/*
+ *  Replay each of the trace's page reads once, in order.
+ */
+static void
+bench_replay_setup(struct bench_data *bd)
+{
+	if ((bd->trace_count = memtrace_load_pages(bd->trace,
+	    &bd->trace_pages)) < 0)
+		RESTART();
+	if (!bd->trace_count)
+		error(FATAL, "%s: no page reads recorded\n", bd->trace);
+
+	bd->saved_iterations = bd->iterations;
+	if (bd->trace_count > bd->iterations) {
+		FREEBUF(bd->nsecs);
+		bd->nsecs = (ulonglong *)GETBUF(sizeof(ulonglong) *
+			bd->trace_count);
+	}
+	bd->iterations = bd->trace_count;
+}
+
+static int
+bench_replay(struct bench_data *bd, long i)
+{
+	struct memtrace_page *tp;
+
+	tp = &bd->trace_pages[i];
+	bd->bytes += tp->cnt;
+
+	return readmem(tp->paddr, PHYSADDR, bd->buf, tp->cnt,
+		"bench replay", RETURN_ON_ERROR|QUIET);
+}
+
+static void
+bench_replay_cleanup(struct bench_data *bd)
+{
+	free(bd->trace_pages);
+	bd->trace_pages = NULL;
+	bd->iterations = bd->saved_iterations;
+}
+
+static int
+compare_ulonglong(const void *v1, const void *v2)
+{
+	ulonglong n1, n2;
+
+	n1 = *(ulonglong *)v1;
+	n2 = *(ulonglong *)v2;
+
+	return (n1 < n2) ? -1 : (n1 > n2) ? 1 : 0;
+}
+
+#define PERCENTILE(bd, p)  ((bd)->nsecs[((bd)->iterations - 1) * (p) / 1000])
+
+static void
+bench_run(struct bench_entry *be, struct bench_data *bd)
+{
+	struct timespec start, end, begin;
+	ulonglong total;
+	double seconds;
+	long i;
+
+	if (be->setup)
+		be->setup(bd);
+
+	bd->errors = bd->bytes = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < bd->iterations; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (!be->op(bd, i))
+			bd->errors++;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		bd->nsecs[i] = ((end.tv_sec - start.tv_sec) * 1000000000ULL) +
+			end.tv_nsec - start.tv_nsec;
+	}
+	seconds = (end.tv_sec - begin.tv_sec) +
+		(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+	if (be->cleanup)
+		be->cleanup(bd);
+
+	for (i = 0, total = 0; i < bd->iterations; i++)
+		total += bd->nsecs[i];
+	qsort(bd->nsecs, bd->iterations, sizeof(ulonglong), compare_ulonglong);
+
+	fprintf(fp, "{\"benchmark\": \"%s\", \"dumpfile\": \"%s\", "
+		"\"iterations\": %ld, \"errors\": %ld, \"seconds\": %.6f, "
+		"\"ops_per_sec\": %.1f", be->name,
+		pc->dumpfile ? pc->dumpfile : "(live)", bd->iterations,
+		bd->errors, seconds, seconds > 0 ? bd->iterations / seconds : 0);
+	if (bd->bytes)
+		fprintf(fp, ", \"bytes_per_sec\": %.1f",
+			seconds > 0 ? bd->bytes / seconds : 0);
+	fprintf(fp, ", \"latency_nsecs\": {\"min\": %llu, \"mean\": %llu, "
+		"\"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+		"\"max\": %llu}}\n", bd->nsecs[0], total / bd->iterations,
+		PERCENTILE(bd, 500), PERCENTILE(bd, 900), PERCENTILE(bd, 990),
+		PERCENTILE(bd, 999), bd->nsecs[bd->iterations - 1]);
+}
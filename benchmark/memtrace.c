@@ -0,0 +1,676 @@
+/* memtrace.c - crash readmem trace analyzer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  Reads a trace recorded with the crash "set memtrace" command, and
+ *  replays its dumpfile page reads through simulated page caches of
+ *  several sizes and replacement policies, and its virtual address reads
+ *  through a simulated translation cache.  The hit rates show whether a
+ *  larger or differently organized cache would pay off for a workload
+ *  before any dumpfile code is changed.  The readmem requests are also
+ *  totalled by type string and by command.
+ *
+ *  The trace format is described above memtrace_open() in memory.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+
+#define MEMTRACE_MAGIC    "CRSHMTRC"
+#define MEMTRACE_VERSION  (1)
+#define MEMTRACE_STRING   'S'
+#define MEMTRACE_COMMAND  'C'
+#define MEMTRACE_PAGE     'P'
+#define MEMTRACE_READMEM  'R'
+#define MEMTRACE_OTHER    (0xffff)
+
+/*
+ *  These mirror the readmem() memtype values in defs.h.
+ */
+#define KVADDR            (0x1)
+#define UVADDR            (0x2)
+#define PHYSADDR          (0x4)
+#define XENMACHADDR       (0x8)
+
+#define MAX_CACHES        (32)
+#define NO_PADDR          ((uint64_t)-1)
+
+struct page_rec {
+	uint64_t paddr;
+};
+
+struct readmem_rec {
+	uint64_t addr;
+	uint32_t size;
+	uint16_t id;
+	uint8_t memtype;
+	uint8_t result;
+	uint64_t paddr;
+};
+
+struct type_total {
+	char *type;
+	unsigned long calls;
+	unsigned long failures;
+	unsigned long long bytes;
+	unsigned long pages;
+};
+
+struct command_total {
+	char *line;
+	unsigned long calls;
+	unsigned long failures;
+	unsigned long long bytes;
+	unsigned long pages;
+};
+
+/*
+ *  A fully associative cache of page keys with FIFO or LRU replacement,
+ *  or a direct-mapped one.  The FIFO policy is the round-robin
+ *  replacement of the diskdump page cache, and the direct-mapped one
+ *  that of the vmss and sadump caches.
+ */
+#define POLICY_FIFO    (1)
+#define POLICY_LRU     (2)
+#define POLICY_DIRECT  (3)
+
+struct cache_entry {
+	uint64_t key;
+	long hnext;           /* hash chain */
+	long prev, next;      /* replacement order, most recent first */
+};
+
+struct cache {
+	int policy;
+	long size;
+	long used;
+	long head, tail;
+	long *hash;
+	long hash_size;
+	struct cache_entry *entries;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+static struct {
+	char *file;
+	uint32_t pagesize;
+	struct page_rec *pages;
+	long nr_pages, max_pages;
+	struct readmem_rec *reads;
+	long nr_reads, max_reads;
+	struct type_total types[MEMTRACE_OTHER + 1];
+	struct command_total *commands;
+	long nr_commands, max_commands;
+	long sizes[MAX_CACHES];
+	int nr_sizes;
+	int top;
+} mt;
+
+static void usage(void);
+static void *xrealloc(void *, size_t);
+static void truncated(void);
+static void read_trace(void);
+static void add_command(char *);
+static void cache_init(struct cache *, int, long);
+static int cache_access(struct cache *, uint64_t);
+static long cache_hash(struct cache *, uint64_t);
+static void cache_unlink(struct cache *, long);
+static void cache_push(struct cache *, long);
+static void cache_free(struct cache *);
+static double hit_rate(struct cache *);
+static void report_summary(void);
+static void report_page_caches(void);
+static void report_tlb(void);
+static void report_types(void);
+static void report_commands(void);
+static int compare_types(const void *, const void *);
+static int compare_keys(const void *, const void *);
+
+int
+main(int argc, char **argv)
+{
+	char *p, *end;
+	int c;
+
+	mt.top = 20;
+
+	while ((c = getopt(argc, argv, "c:t:h")) != EOF) {
+		switch (c)
+		{
+		case 'c':
+			mt.nr_sizes = 0;
+			for (p = optarg; *p; p = end) {
+				if (mt.nr_sizes == MAX_CACHES)
+					usage();
+				mt.sizes[mt.nr_sizes] = strtol(p, &end, 0);
+				if ((end == p) || (mt.sizes[mt.nr_sizes] <= 0))
+					usage();
+				mt.nr_sizes++;
+				if (*end == ',')
+					end++;
+				else if (*end)
+					usage();
+			}
+			break;
+		case 't':
+			if ((mt.top = atoi(optarg)) < 0)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (optind != argc - 1)
+		usage();
+	mt.file = argv[optind];
+
+	if (!mt.nr_sizes) {
+		mt.sizes[mt.nr_sizes++] = 16;
+		mt.sizes[mt.nr_sizes++] = 64;
+		mt.sizes[mt.nr_sizes++] = 256;
+		mt.sizes[mt.nr_sizes++] = 1024;
+		mt.sizes[mt.nr_sizes++] = 4096;
+	}
+
+	add_command("(before the first command)");
+	read_trace();
+
+	report_summary();
+	report_page_caches();
+	report_tlb();
+	report_types();
+	report_commands();
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: memtrace [-c size[,size]...] [-t top] tracefile\n");
+	exit(1);
+}
+
+static void *
+xrealloc(void *ptr, size_t size)
+{
+	void *new;
+
+	if (!(new = realloc(ptr, size))) {
+		fprintf(stderr, "memtrace: cannot malloc %ld bytes\n",
+			(long)size);
+		exit(1);
+	}
+
+	return new;
+}
+
+static void
+truncated(void)
+{
+	fprintf(stderr, "memtrace: %s: truncated trace file\n", mt.file);
+	exit(1);
+}
+
+static void
+read_trace(void)
+{
+	unsigned char header[16], rec[24];
+	struct readmem_rec *rr;
+	struct type_total *tt;
+	uint16_t id, len;
+	uint32_t version;
+	char *buf;
+	FILE *fp;
+	int tag;
+
+	if (!(fp = fopen(mt.file, "r"))) {
+		fprintf(stderr, "memtrace: %s: %s\n", mt.file, strerror(errno));
+		exit(1);
+	}
+
+	if ((fread(header, sizeof(header), 1, fp) != 1) ||
+	    memcmp(header, MEMTRACE_MAGIC, 8)) {
+		fprintf(stderr, "memtrace: %s: not a memtrace file\n", mt.file);
+		exit(1);
+	}
+	memcpy(&version, header + 8, sizeof(uint32_t));
+	memcpy(&mt.pagesize, header + 12, sizeof(uint32_t));
+	if (version != MEMTRACE_VERSION) {
+		fprintf(stderr, "memtrace: %s: unsupported version: %u\n",
+			mt.file, version);
+		exit(1);
+	}
+	if (!mt.pagesize || (mt.pagesize & (mt.pagesize - 1))) {
+		fprintf(stderr, "memtrace: %s: invalid page size: %u\n",
+			mt.file, mt.pagesize);
+		exit(1);
+	}
+
+	buf = xrealloc(NULL, 65536);
+
+	while ((tag = fgetc(fp)) != EOF) {
+		switch (tag)
+		{
+		case MEMTRACE_STRING:
+			if (fread(rec, 4, 1, fp) != 1)
+				truncated();
+			memcpy(&id, rec, sizeof(uint16_t));
+			memcpy(&len, rec + 2, sizeof(uint16_t));
+			if (len && (fread(buf, len, 1, fp) != 1))
+				truncated();
+			buf[len] = '\0';
+			tt = &mt.types[id];
+			free(tt->type);
+			tt->type = strdup(buf);
+			break;
+
+		case MEMTRACE_COMMAND:
+			if (fread(&len, sizeof(uint16_t), 1, fp) != 1)
+				truncated();
+			if (len && (fread(buf, len, 1, fp) != 1))
+				truncated();
+			buf[len] = '\0';
+			add_command(buf);
+			break;
+
+		case MEMTRACE_PAGE:
+			if (fread(rec, 12, 1, fp) != 1)
+				truncated();
+			if (mt.nr_pages == mt.max_pages) {
+				mt.max_pages = mt.max_pages ?
+					mt.max_pages * 2 : 65536;
+				mt.pages = xrealloc(mt.pages,
+					mt.max_pages * sizeof(struct page_rec));
+			}
+			memcpy(&mt.pages[mt.nr_pages].paddr, rec + 4,
+				sizeof(uint64_t));
+			mt.commands[mt.nr_commands - 1].pages++;
+			mt.nr_pages++;
+			break;
+
+		case MEMTRACE_READMEM:
+			if (fread(rec, 24, 1, fp) != 1)
+				truncated();
+			if (mt.nr_reads == mt.max_reads) {
+				mt.max_reads = mt.max_reads ?
+					mt.max_reads * 2 : 65536;
+				mt.reads = xrealloc(mt.reads,
+					mt.max_reads * sizeof(struct readmem_rec));
+			}
+			rr = &mt.reads[mt.nr_reads];
+			rr->memtype = rec[0];
+			rr->result = rec[1];
+			memcpy(&rr->id, rec + 2, sizeof(uint16_t));
+			memcpy(&rr->size, rec + 4, sizeof(uint32_t));
+			memcpy(&rr->addr, rec + 8, sizeof(uint64_t));
+			memcpy(&rr->paddr, rec + 16, sizeof(uint64_t));
+			mt.commands[mt.nr_commands - 1].calls++;
+			mt.commands[mt.nr_commands - 1].bytes += rr->size;
+			if (!rr->result)
+				mt.commands[mt.nr_commands - 1].failures++;
+			mt.nr_reads++;
+			break;
+
+		default:
+			fprintf(stderr,
+			    "memtrace: %s: invalid record type: %x\n",
+				mt.file, tag);
+			exit(1);
+		}
+	}
+
+	fclose(fp);
+	free(buf);
+}
+
+static void
+add_command(char *line)
+{
+	if (mt.nr_commands == mt.max_commands) {
+		mt.max_commands = mt.max_commands ? mt.max_commands * 2 : 256;
+		mt.commands = xrealloc(mt.commands,
+			mt.max_commands * sizeof(struct command_total));
+	}
+	memset(&mt.commands[mt.nr_commands], 0, sizeof(struct command_total));
+	mt.commands[mt.nr_commands].line = strdup(line);
+	mt.nr_commands++;
+}
+
+static void
+cache_init(struct cache *cp, int policy, long size)
+{
+	long i;
+
+	memset(cp, 0, sizeof(struct cache));
+	cp->policy = policy;
+	cp->size = size;
+	cp->head = cp->tail = -1;
+	cp->entries = xrealloc(NULL, size * sizeof(struct cache_entry));
+
+	if (policy == POLICY_DIRECT) {
+		for (i = 0; i < size; i++)
+			cp->entries[i].key = NO_PADDR;
+		return;
+	}
+
+	for (cp->hash_size = 1; cp->hash_size < size * 2; cp->hash_size <<= 1)
+		;
+	cp->hash = xrealloc(NULL, cp->hash_size * sizeof(long));
+	for (i = 0; i < cp->hash_size; i++)
+		cp->hash[i] = -1;
+}
+
+static long
+cache_hash(struct cache *cp, uint64_t key)
+{
+	return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & (cp->hash_size - 1);
+}
+
+static void
+cache_unlink(struct cache *cp, long i)
+{
+	struct cache_entry *ce = &cp->entries[i];
+
+	if (ce->prev >= 0)
+		cp->entries[ce->prev].next = ce->next;
+	else
+		cp->head = ce->next;
+	if (ce->next >= 0)
+		cp->entries[ce->next].prev = ce->prev;
+	else
+		cp->tail = ce->prev;
+}
+
+static void
+cache_push(struct cache *cp, long i)
+{
+	struct cache_entry *ce = &cp->entries[i];
+
+	ce->prev = -1;
+	ce->next = cp->head;
+	if (cp->head >= 0)
+		cp->entries[cp->head].prev = i;
+	cp->head = i;
+	if (cp->tail < 0)
+		cp->tail = i;
+}
+
+/*
+ *  Look up a key, inserting it on a miss.  Returns 1 on a hit.
+ */
+static int
+cache_access(struct cache *cp, uint64_t key)
+{
+	struct cache_entry *ce;
+	long i, *lp;
+
+	if (cp->policy == POLICY_DIRECT) {
+		ce = &cp->entries[key % cp->size];
+		if (ce->key == key) {
+			cp->hits++;
+			return 1;
+		}
+		ce->key = key;
+		cp->misses++;
+		return 0;
+	}
+
+	for (i = cp->hash[cache_hash(cp, key)]; i >= 0; i = ce->hnext) {
+		ce = &cp->entries[i];
+		if (ce->key == key) {
+			if (cp->policy == POLICY_LRU) {
+				cache_unlink(cp, i);
+				cache_push(cp, i);
+			}
+			cp->hits++;
+			return 1;
+		}
+	}
+
+	cp->misses++;
+
+	/*
+	 *  Evict the oldest entry once the cache is full.
+	 */
+	if (cp->used < cp->size)
+		i = cp->used++;
+	else {
+		i = cp->tail;
+		ce = &cp->entries[i];
+		for (lp = &cp->hash[cache_hash(cp, ce->key)]; *lp != i;
+		     lp = &cp->entries[*lp].hnext)
+			;
+		*lp = ce->hnext;
+		cache_unlink(cp, i);
+	}
+
+	ce = &cp->entries[i];
+	ce->key = key;
+	lp = &cp->hash[cache_hash(cp, key)];
+	ce->hnext = *lp;
+	*lp = i;
+	cache_push(cp, i);
+
+	return 0;
+}
+
+static void
+cache_free(struct cache *cp)
+{
+	free(cp->entries);
+	free(cp->hash);
+}
+
+static double
+hit_rate(struct cache *cp)
+{
+	unsigned long total = cp->hits + cp->misses;
+
+	return total ? 100.0 * cp->hits / total : 0.0;
+}
+
+static void
+report_summary(void)
+{
+	unsigned long failures, distinct;
+	unsigned long long bytes;
+	uint64_t *keys;
+	long i;
+
+	for (i = 0, failures = 0, bytes = 0; i < mt.nr_reads; i++) {
+		bytes += mt.reads[i].size;
+		if (!mt.reads[i].result)
+			failures++;
+	}
+
+	/*
+	 *  Count the distinct pages, which is the number of misses that
+	 *  an unbounded cache would take.
+	 */
+	keys = xrealloc(NULL, (mt.nr_pages + 1) * sizeof(uint64_t));
+	for (i = 0; i < mt.nr_pages; i++)
+		keys[i] = mt.pages[i].paddr / mt.pagesize;
+	qsort(keys, mt.nr_pages, sizeof(uint64_t), compare_keys);
+	for (i = 0, distinct = 0; i < mt.nr_pages; i++)
+		if (!i || (keys[i] != keys[i-1]))
+			distinct++;
+	free(keys);
+
+	printf("      TRACE FILE: %s\n", mt.file);
+	printf("        PAGESIZE: %u\n", mt.pagesize);
+	printf("        COMMANDS: %ld\n", mt.nr_commands - 1);
+	printf("READMEM REQUESTS: %ld (%lu failed)\n", mt.nr_reads, failures);
+	printf("   READMEM BYTES: %llu\n", bytes);
+	printf("      PAGE READS: %ld\n", mt.nr_pages);
+	printf("  DISTINCT PAGES: %lu (best possible hit rate: %.1f%%)\n",
+		distinct, mt.nr_pages ?
+		100.0 * (mt.nr_pages - distinct) / mt.nr_pages : 0.0);
+}
+
+static void
+report_page_caches(void)
+{
+	static int policies[] = { POLICY_FIFO, POLICY_LRU, POLICY_DIRECT };
+	struct cache cache;
+	double rates[3];
+	long i;
+	int s, p;
+
+	printf("\nPAGE CACHE HIT RATES\n");
+	printf("  ENTRIES     FIFO      LRU   DIRECT\n");
+
+	for (s = 0; s < mt.nr_sizes; s++) {
+		for (p = 0; p < 3; p++) {
+			cache_init(&cache, policies[p], mt.sizes[s]);
+			for (i = 0; i < mt.nr_pages; i++)
+				cache_access(&cache,
+					mt.pages[i].paddr / mt.pagesize);
+			rates[p] = hit_rate(&cache);
+			cache_free(&cache);
+		}
+		printf("  %7ld   %5.1f%%   %5.1f%%   %5.1f%%\n", mt.sizes[s],
+			rates[0], rates[1], rates[2]);
+	}
+}
+
+/*
+ *  Each kernel or user virtual page spanned by a request that reached
+ *  the dumpfile is a translation.  User addresses are not qualified by
+ *  their task, since the trace does not record context changes.
+ */
+static void
+report_tlb(void)
+{
+	struct readmem_rec *rr;
+	struct cache cache;
+	uint64_t vpage, last;
+	unsigned long translations;
+	long i;
+	int s;
+
+	for (i = 0, translations = 0; i < mt.nr_reads; i++) {
+		rr = &mt.reads[i];
+		if (((rr->memtype != KVADDR) && (rr->memtype != UVADDR)) ||
+		    (rr->paddr == NO_PADDR) || !rr->size)
+			continue;
+		translations += (rr->addr + rr->size - 1) / mt.pagesize -
+			rr->addr / mt.pagesize + 1;
+	}
+
+	printf("\nTRANSLATION CACHE HIT RATES (%lu translations)\n",
+		translations);
+	printf("  ENTRIES      LRU\n");
+
+	for (s = 0; s < mt.nr_sizes; s++) {
+		cache_init(&cache, POLICY_LRU, mt.sizes[s]);
+		for (i = 0; i < mt.nr_reads; i++) {
+			rr = &mt.reads[i];
+			if (((rr->memtype != KVADDR) &&
+			    (rr->memtype != UVADDR)) ||
+			    (rr->paddr == NO_PADDR) || !rr->size)
+				continue;
+			last = (rr->addr + rr->size - 1) / mt.pagesize;
+			for (vpage = rr->addr / mt.pagesize; vpage <= last;
+			     vpage++)
+				cache_access(&cache, (vpage << 1) |
+					(rr->memtype == UVADDR));
+		}
+		printf("  %7ld   %5.1f%%\n", mt.sizes[s], hit_rate(&cache));
+		cache_free(&cache);
+	}
+}
+
+static int
+compare_types(const void *v1, const void *v2)
+{
+	const struct type_total *t1 = *(const struct type_total **)v1;
+	const struct type_total *t2 = *(const struct type_total **)v2;
+
+	if (t1->calls != t2->calls)
+		return t1->calls < t2->calls ? 1 : -1;
+	return t1->bytes < t2->bytes ? 1 : (t1->bytes > t2->bytes ? -1 : 0);
+}
+
+static int
+compare_keys(const void *v1, const void *v2)
+{
+	uint64_t k1 = *(const uint64_t *)v1;
+	uint64_t k2 = *(const uint64_t *)v2;
+
+	return k1 < k2 ? -1 : (k1 > k2 ? 1 : 0);
+}
+
+static void
+report_types(void)
+{
+	struct type_total *tt, **sorted;
+	struct readmem_rec *rr;
+	long i, n;
+
+	for (i = 0; i < mt.nr_reads; i++) {
+		rr = &mt.reads[i];
+		tt = &mt.types[rr->id];
+		tt->calls++;
+		tt->bytes += rr->size;
+		if (!rr->result)
+			tt->failures++;
+		if (rr->paddr != NO_PADDR)
+			tt->pages++;
+	}
+	if (!mt.types[MEMTRACE_OTHER].type)
+		mt.types[MEMTRACE_OTHER].type = "(other)";
+
+	sorted = xrealloc(NULL, (MEMTRACE_OTHER + 1) *
+		sizeof(struct type_total *));
+	for (i = n = 0; i <= MEMTRACE_OTHER; i++)
+		if (mt.types[i].calls)
+			sorted[n++] = &mt.types[i];
+	qsort(sorted, n, sizeof(struct type_total *), compare_types);
+
+	printf("\nREADMEM TYPES (top %d of %ld)\n", mt.top, n);
+	printf("     CALLS  FAILED         BYTES  DUMPFILE  TYPE\n");
+	for (i = 0; (i < n) && (i < mt.top); i++) {
+		tt = sorted[i];
+		printf("  %8lu  %6lu  %12llu  %8lu  %s\n", tt->calls,
+			tt->failures, tt->bytes, tt->pages,
+			tt->type ? tt->type : "(unknown)");
+	}
+
+	free(sorted);
+}
+
+static void
+report_commands(void)
+{
+	struct command_total *ct;
+	long i;
+
+	printf("\nCOMMANDS\n");
+	printf("     CALLS  FAILED         BYTES  PAGE READS  COMMAND\n");
+	for (i = 0; i < mt.nr_commands; i++) {
+		ct = &mt.commands[i];
+		if (!i && !ct->calls && !ct->pages)
+			continue;
+		printf("  %8lu  %6lu  %12llu  %10lu  %s\n", ct->calls,
+			ct->failures, ct->bytes, ct->pages, ct->line);
+	}
+}
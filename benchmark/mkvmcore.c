@@ -0,0 +1,726 @@
+/* mkvmcore.c - synthetic dumpfile generator for crash benchmarking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ *  Generates kdump-compressed or ELF dumpfiles of a given size, page
+ *  exclusion ratio and PT_LOAD layout, so that the dumpfile access paths
+ *  of crash can be measured without a real (and unshareable) vmcore.
+ *  The page contents are a function of the pfn, and the same seed always
+ *  produces the same dumpfile.
+ *
+ *  The dumpfiles contain no kernel data, only a VMCOREINFO note; they are
+ *  meant to be read by physical address with the crash "bench" command.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <elf.h>
+#include <sys/time.h>
+#include <sys/utsname.h>
+#include <zlib.h>
+#ifdef LZO
+#include <lzo/lzo1x.h>
+#endif
+#ifdef SNAPPY
+#include <snappy-c.h>
+#endif
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+
+#ifndef EM_LOONGARCH
+#define EM_LOONGARCH 258
+#endif
+
+#define KDUMP_SIGNATURE  "KDUMP   "
+#define NEW_UTS_LEN      (64)
+
+/*
+ *  These mirror the compressed kdump layout in diskdump.h.
+ */
+struct new_utsname {
+	char sysname[NEW_UTS_LEN + 1];
+	char nodename[NEW_UTS_LEN + 1];
+	char release[NEW_UTS_LEN + 1];
+	char version[NEW_UTS_LEN + 1];
+	char machine[NEW_UTS_LEN + 1];
+	char domainname[NEW_UTS_LEN + 1];
+};
+
+struct disk_dump_header {
+	char signature[8];
+	int header_version;
+	struct new_utsname utsname;
+	struct timeval timestamp;
+	unsigned int status;
+	int block_size;
+	int sub_hdr_size;
+	unsigned int bitmap_blocks;
+	unsigned int max_mapnr;
+	unsigned int total_ram_blocks;
+	unsigned int device_blocks;
+	unsigned int written_blocks;
+	unsigned int current_cpu;
+	int nr_cpus;
+};
+
+struct kdump_sub_header {
+	unsigned long phys_base;
+	int dump_level;
+	int split;
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+	off_t offset_vmcoreinfo;
+	unsigned long size_vmcoreinfo;
+	off_t offset_note;
+	unsigned long size_note;
+	off_t offset_eraseinfo;
+	unsigned long size_eraseinfo;
+	unsigned long long start_pfn_64;
+	unsigned long long end_pfn_64;
+	unsigned long long max_mapnr_64;
+};
+
+typedef struct page_desc {
+	off_t offset;
+	unsigned int size;
+	unsigned int flags;
+	unsigned long long page_flags;
+} page_desc_t;
+
+#define DUMP_DH_COMPRESSED_ZLIB    0x1
+#define DUMP_DH_COMPRESSED_LZO     0x2
+#define DUMP_DH_COMPRESSED_SNAPPY  0x4
+#define DUMP_DH_COMPRESSED_ZSTD    0x20
+
+#define divideup(x, y)  (((x) + ((y) - 1)) / (y))
+
+struct compression {
+	char *name;
+	unsigned int flag;
+} compressions[] = {
+	{ "none",   0 },
+	{ "zlib",   DUMP_DH_COMPRESSED_ZLIB },
+	{ "lzo",    DUMP_DH_COMPRESSED_LZO },
+	{ "snappy", DUMP_DH_COMPRESSED_SNAPPY },
+	{ "zstd",   DUMP_DH_COMPRESSED_ZSTD },
+	{ NULL,     0 },
+};
+
+static struct {
+	char *outfile;
+	int elf;
+	struct compression *compression;
+	unsigned long long memsize;
+	double exclude;
+	int segments;
+	unsigned long long gap;
+	long pagesize;
+	unsigned long long seed;
+	char *machine;
+	char *release;
+	int fd;
+	unsigned long long max_mapnr;
+	unsigned char *ram;          /* pfn is backed by a PT_LOAD segment */
+	unsigned char *dumpable;     /* pfn was not excluded */
+	unsigned long long ram_pages;
+	unsigned long long dumpable_pages;
+	char *page;
+	char *cpage;
+	size_t cpage_size;
+} mk;
+
+static void usage(void);
+static unsigned long long random64(void);
+static unsigned long long parse_size(char *);
+static int machine_to_elf(char *);
+static void build_layout(void);
+static void fill_page(unsigned long long);
+static unsigned int compress_page(unsigned int *);
+static char *vmcoreinfo(size_t *);
+static void write_at(void *, size_t, off_t);
+static off_t write_kdump(void);
+static off_t write_elf(void);
+
+#define TEST_BIT(map, pfn)  ((map)[(pfn) >> 3] & (1 << ((pfn) & 7)))
+#define SET_BIT(map, pfn)   ((map)[(pfn) >> 3] |= (1 << ((pfn) & 7)))
+
+int
+main(int argc, char **argv)
+{
+	struct compression *cp;
+	struct utsname uts;
+	off_t size;
+	int c, cflag;
+
+	mk.compression = &compressions[1];
+	mk.memsize = 256ULL << 20;
+	mk.exclude = 0.5;
+	mk.segments = 4;
+	mk.gap = 16ULL << 20;
+	mk.pagesize = sysconf(_SC_PAGESIZE);
+	mk.seed = 1;
+	mk.release = "synthetic";
+	cflag = 0;
+	if (uname(&uts) == 0)
+		mk.machine = strdup(uts.machine);
+
+	while ((c = getopt(argc, argv, "f:c:m:x:l:g:p:s:M:r:h")) != EOF) {
+		switch (c)
+		{
+		case 'f':
+			if (!strcmp(optarg, "elf"))
+				mk.elf = 1;
+			else if (!strcmp(optarg, "kdump"))
+				mk.elf = 0;
+			else
+				usage();
+			break;
+		case 'c':
+			for (cp = compressions; cp->name; cp++)
+				if (!strcmp(optarg, cp->name))
+					break;
+			if (!cp->name)
+				usage();
+			mk.compression = cp;
+			cflag = 1;
+			break;
+		case 'm':
+			mk.memsize = parse_size(optarg);
+			break;
+		case 'x':
+			mk.exclude = atof(optarg);
+			if ((mk.exclude < 0.0) || (mk.exclude >= 1.0))
+				usage();
+			break;
+		case 'l':
+			if ((mk.segments = atoi(optarg)) <= 0)
+				usage();
+			break;
+		case 'g':
+			mk.gap = parse_size(optarg);
+			break;
+		case 'p':
+			mk.pagesize = atol(optarg);
+			if ((mk.pagesize < 1024) ||
+			    (mk.pagesize & (mk.pagesize - 1)))
+				usage();
+			break;
+		case 's':
+			mk.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'M':
+			mk.machine = optarg;
+			break;
+		case 'r':
+			mk.release = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if ((optind != argc - 1) || !mk.machine)
+		usage();
+	mk.outfile = argv[optind];
+
+	if (!mk.seed)
+		mk.seed = 1;
+
+	if (mk.elf) {
+		if (cflag && mk.compression->flag)
+			fprintf(stderr, 
+			    "mkvmcore: ELF dumpfiles are not compressed\n");
+		mk.compression = &compressions[0];
+	}
+
+	if ((mk.fd = open(mk.outfile, O_RDWR|O_CREAT|O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "mkvmcore: %s: %s\n", mk.outfile,
+			strerror(errno));
+		exit(1);
+	}
+
+	mk.cpage_size = mk.pagesize * 2 + 1024;
+	if (!(mk.page = malloc(mk.pagesize)) ||
+	    !(mk.cpage = malloc(mk.cpage_size))) {
+		fprintf(stderr, "mkvmcore: cannot malloc page buffers\n");
+		exit(1);
+	}
+
+	build_layout();
+
+	size = mk.elf ? write_elf() : write_kdump();
+
+	if (close(mk.fd) < 0) {
+		fprintf(stderr, "mkvmcore: %s: %s\n", mk.outfile,
+			strerror(errno));
+		exit(1);
+	}
+
+	printf("%s: %s%s%s  machine: %s  pagesize: %ld\n", mk.outfile,
+		mk.elf ? "ELF" : "kdump-compressed",
+		mk.elf ? "" : "/", mk.elf ? "" : mk.compression->name,
+		mk.machine, mk.pagesize);
+	printf("  max_mapnr: %llu  ram pages: %llu  dumpable: %llu "
+		"(%.1f%% excluded)  file size: %lld\n",
+		mk.max_mapnr, mk.ram_pages, mk.dumpable_pages,
+		mk.ram_pages ? 100.0 * (mk.ram_pages - mk.dumpable_pages) /
+		mk.ram_pages : 0.0, (long long)size);
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "usage: mkvmcore [-f kdump|elf] [-c none|zlib|lzo|snappy|zstd] "
+	    "[-m memsize]\n"
+	    "                [-x exclude-ratio] [-l segments] [-g gap] "
+	    "[-p pagesize]\n"
+	    "                [-s seed] [-M machine] [-r release] outfile\n");
+	exit(1);
+}
+
+/*
+ *  xorshift64*, so that a given seed produces the same dumpfile
+ *  everywhere.
+ */
+static unsigned long long
+random64(void)
+{
+	mk.seed ^= mk.seed >> 12;
+	mk.seed ^= mk.seed << 25;
+	mk.seed ^= mk.seed >> 27;
+	return mk.seed * 0x2545F4914F6CDD1DULL;
+}
+
+static unsigned long long
+parse_size(char *s)
+{
+	unsigned long long size;
+	char *end;
+
+	size = strtoull(s, &end, 0);
+	switch (*end)
+	{
+	case 'G': case 'g':
+		size <<= 10;
+		/* fall through */
+	case 'M': case 'm':
+		size <<= 10;
+		/* fall through */
+	case 'K': case 'k':
+		size <<= 10;
+		break;
+	case '\0':
+		break;
+	default:
+		usage();
+	}
+
+	return size;
+}
+
+static int
+machine_to_elf(char *machine)
+{
+	if (!strcmp(machine, "x86_64"))
+		return EM_X86_64;
+	if (!strcmp(machine, "aarch64"))
+		return EM_AARCH64;
+	if (!strncmp(machine, "ppc64", 5))
+		return EM_PPC64;
+	if (!strcmp(machine, "s390x"))
+		return EM_S390;
+	if (!strcmp(machine, "riscv64"))
+		return EM_RISCV;
+	if (!strcmp(machine, "loongarch64"))
+		return EM_LOONGARCH;
+	if (!strcmp(machine, "ia64"))
+		return EM_IA_64;
+
+	fprintf(stderr, "mkvmcore: unsupported machine type: %s\n", machine);
+	exit(1);
+}
+
+/*
+ *  Split the memory into equally-sized PT_LOAD segments separated by
+ *  gaps, and exclude runs of pages until the requested ratio is met.
+ *  The runs are longer for larger dumps, keeping the number of ELF
+ *  segments that an excluded run splits a PT_LOAD into manageable.
+ */
+static void
+build_layout(void)
+{
+	unsigned long long seg_pages, gap_pages, pfn, start, run, i;
+	unsigned long long avg_run, excluded, target;
+	int s;
+
+	seg_pages = divideup(mk.memsize / mk.segments, mk.pagesize);
+	gap_pages = divideup(mk.gap, mk.pagesize);
+	mk.max_mapnr = seg_pages * mk.segments + gap_pages * (mk.segments - 1);
+
+	if (!(mk.ram = calloc(divideup(mk.max_mapnr, 8) + 8, 1)) ||
+	    !(mk.dumpable = calloc(divideup(mk.max_mapnr, 8) + 8, 1))) {
+		fprintf(stderr, "mkvmcore: cannot malloc page bitmaps\n");
+		exit(1);
+	}
+
+	for (s = 0; s < mk.segments; s++) {
+		start = s * (seg_pages + gap_pages);
+		for (pfn = start; pfn < start + seg_pages; pfn++) {
+			SET_BIT(mk.ram, pfn);
+			SET_BIT(mk.dumpable, pfn);
+		}
+	}
+	mk.ram_pages = seg_pages * mk.segments;
+
+	avg_run = mk.ram_pages / 16384;
+	if (avg_run < 128)
+		avg_run = 128;
+
+	target = (unsigned long long)(mk.ram_pages * mk.exclude);
+	for (excluded = 0; excluded < target; ) {
+		pfn = random64() % mk.max_mapnr;
+		run = 1 + random64() % (avg_run * 2);
+		for (i = 0; (i < run) && (pfn + i < mk.max_mapnr) &&
+		    (excluded < target); i++) {
+			if (!TEST_BIT(mk.ram, pfn + i) ||
+			    !TEST_BIT(mk.dumpable, pfn + i))
+				continue;
+			mk.dumpable[(pfn + i) >> 3] &= ~(1 << ((pfn + i) & 7));
+			excluded++;
+		}
+	}
+	mk.dumpable_pages = mk.ram_pages - excluded;
+}
+
+/*
+ *  Roughly a quarter of the pages are zero-filled, and the others carry
+ *  the pfn and word index followed by zeroes, so that they compress
+ *  about as well as real kernel memory.
+ */
+static void
+fill_page(unsigned long long pfn)
+{
+	unsigned long long *words;
+	long i, used;
+
+	memset(mk.page, 0, mk.pagesize);
+	if ((pfn * 0x9E3779B97F4A7C15ULL) >> 62 == 0)
+		return;
+
+	words = (unsigned long long *)mk.page;
+	used = (mk.pagesize / sizeof(*words)) / (1 + (pfn & 3));
+	for (i = 0; i < used; i++)
+		words[i] = (pfn << 16) | i;
+}
+
+/*
+ *  Compress mk.page into mk.cpage, returning the size; the page is
+ *  stored uncompressed if compression does not make it smaller.
+ */
+static unsigned int
+compress_page(unsigned int *flags)
+{
+	size_t len;
+
+	*flags = 0;
+
+	switch (mk.compression->flag)
+	{
+	case DUMP_DH_COMPRESSED_ZLIB: {
+		uLongf zlen = mk.cpage_size;
+
+		if ((compress2((Bytef *)mk.cpage, &zlen, (Bytef *)mk.page,
+		    mk.pagesize, Z_BEST_SPEED) != Z_OK))
+			zlen = mk.pagesize;
+		len = zlen;
+		break;
+	}
+#ifdef LZO
+	case DUMP_DH_COMPRESSED_LZO: {
+		static char wrkmem[LZO1X_1_MEM_COMPRESS];
+		lzo_uint llen = mk.cpage_size;
+
+		if (lzo1x_1_compress((unsigned char *)mk.page, mk.pagesize,
+		    (unsigned char *)mk.cpage, &llen, wrkmem) != LZO_E_OK)
+			llen = mk.pagesize;
+		len = llen;
+		break;
+	}
+#endif
+#ifdef SNAPPY
+	case DUMP_DH_COMPRESSED_SNAPPY:
+		len = mk.cpage_size;
+		if (snappy_compress(mk.page, mk.pagesize, mk.cpage,
+		    &len) != SNAPPY_OK)
+			len = mk.pagesize;
+		break;
+#endif
+#ifdef ZSTD
+	case DUMP_DH_COMPRESSED_ZSTD:
+		len = ZSTD_compress(mk.cpage, mk.cpage_size, mk.page,
+			mk.pagesize, 1);
+		if (ZSTD_isError(len))
+			len = mk.pagesize;
+		break;
+#endif
+	case 0:
+		len = mk.pagesize;
+		break;
+	default:
+		fprintf(stderr, "mkvmcore: %s compression support "
+			"not built in\n", mk.compression->name);
+		exit(1);
+	}
+
+	if (len >= mk.pagesize) {
+		memcpy(mk.cpage, mk.page, mk.pagesize);
+		return mk.pagesize;
+	}
+
+	*flags = mk.compression->flag;
+	return len;
+}
+
+static char *
+vmcoreinfo(size_t *size)
+{
+	static char buf[256];
+
+	*size = snprintf(buf, sizeof(buf), "OSRELEASE=%s\nPAGESIZE=%ld\n",
+		mk.release, mk.pagesize);
+
+	return buf;
+}
+
+static void
+write_at(void *buf, size_t size, off_t offset)
+{
+	if (pwrite(mk.fd, buf, size, offset) != size) {
+		fprintf(stderr, "mkvmcore: %s: write failed: %s\n",
+			mk.outfile, strerror(errno));
+		exit(1);
+	}
+}
+
+/*
+ *  Block 0 is the header, block 1 the kdump sub-header, and block 2
+ *  the VMCOREINFO data.  They are followed by the two memory bitmaps,
+ *  the page descriptors of the dumpable pages, and the page data.
+ */
+static off_t
+write_kdump(void)
+{
+	struct disk_dump_header *header;
+	struct kdump_sub_header *sub;
+	page_desc_t pd;
+	unsigned long long pfn, index, bitmap_bytes;
+	unsigned int bitmap_blocks;
+	off_t desc_offset, data_offset;
+	char *block, *info;
+	size_t info_size;
+	int sub_hdr_size;
+
+	if (!(block = calloc(mk.pagesize, 1))) {
+		fprintf(stderr, "mkvmcore: cannot malloc header block\n");
+		exit(1);
+	}
+
+	sub_hdr_size = 2;
+	bitmap_bytes = divideup(mk.max_mapnr, 8);
+	bitmap_blocks = divideup(bitmap_bytes, mk.pagesize) * 2;
+
+	header = (struct disk_dump_header *)block;
+	memcpy(header->signature, KDUMP_SIGNATURE, sizeof(header->signature));
+	header->header_version = 6;
+	strcpy(header->utsname.sysname, "Linux");
+	strcpy(header->utsname.nodename, "mkvmcore");
+	strncpy(header->utsname.release, mk.release, NEW_UTS_LEN);
+	strcpy(header->utsname.version, "#1");
+	strncpy(header->utsname.machine, mk.machine, NEW_UTS_LEN);
+	gettimeofday(&header->timestamp, NULL);
+	header->status = mk.compression->flag;
+	header->block_size = mk.pagesize;
+	header->sub_hdr_size = sub_hdr_size;
+	header->bitmap_blocks = bitmap_blocks;
+	header->max_mapnr = (unsigned int)mk.max_mapnr;
+	header->total_ram_blocks = (unsigned int)mk.ram_pages;
+	header->device_blocks = (unsigned int)mk.ram_pages;
+	header->written_blocks = (unsigned int)mk.dumpable_pages;
+	header->nr_cpus = 1;
+	write_at(block, mk.pagesize, 0);
+
+	info = vmcoreinfo(&info_size);
+
+	memset(block, 0, mk.pagesize);
+	sub = (struct kdump_sub_header *)block;
+	sub->dump_level = 31;
+	sub->offset_vmcoreinfo = (off_t)mk.pagesize * 2;
+	sub->size_vmcoreinfo = info_size;
+	sub->start_pfn_64 = 0;
+	sub->end_pfn_64 = mk.max_mapnr;
+	sub->max_mapnr_64 = mk.max_mapnr;
+	write_at(block, mk.pagesize, mk.pagesize);
+
+	memset(block, 0, mk.pagesize);
+	memcpy(block, info, info_size);
+	write_at(block, mk.pagesize, (off_t)mk.pagesize * 2);
+
+	/*
+	 *  The first bitmap marks the pages that exist, and the second
+	 *  those that were not excluded.
+	 */
+	write_at(mk.ram, bitmap_bytes,
+		(off_t)mk.pagesize * (1 + sub_hdr_size));
+	write_at(mk.dumpable, bitmap_bytes,
+		(off_t)mk.pagesize * (1 + sub_hdr_size + bitmap_blocks/2));
+
+	desc_offset = (off_t)mk.pagesize * (1 + sub_hdr_size + bitmap_blocks);
+	data_offset = desc_offset + mk.dumpable_pages * sizeof(page_desc_t);
+
+	for (pfn = index = 0; pfn < mk.max_mapnr; pfn++) {
+		if (!TEST_BIT(mk.dumpable, pfn))
+			continue;
+
+		fill_page(pfn);
+		memset(&pd, 0, sizeof(pd));
+		pd.size = compress_page(&pd.flags);
+		pd.offset = data_offset;
+
+		write_at(mk.cpage, pd.size, data_offset);
+		write_at(&pd, sizeof(pd), desc_offset + index * sizeof(pd));
+
+		data_offset += pd.size;
+		index++;
+	}
+
+	free(block);
+
+	return data_offset;
+}
+
+/*
+ *  A PT_NOTE segment containing the VMCOREINFO note, followed by one
+ *  PT_LOAD segment per run of dumpable pages.  As with kdump vmcores,
+ *  p_align is zero and the segments are packed.
+ */
+static off_t
+write_elf(void)
+{
+	Elf64_Ehdr ehdr;
+	Elf64_Phdr *phdrs, *load;
+	Elf64_Nhdr *nhdr;
+	unsigned long long pfn, start;
+	size_t info_size, note_size;
+	char *note, *info;
+	int phnum, i;
+	off_t offset;
+
+	for (pfn = phnum = 0; pfn < mk.max_mapnr; pfn++)
+		if (TEST_BIT(mk.dumpable, pfn) &&
+		    ((pfn == 0) || !TEST_BIT(mk.dumpable, pfn - 1)))
+			phnum++;
+	phnum++;
+
+	if (phnum >= PN_XNUM) {
+		fprintf(stderr, "mkvmcore: too many PT_LOAD segments: %d "
+			"(use fewer segments or a smaller exclude ratio)\n",
+			phnum);
+		exit(1);
+	}
+
+	if (!(phdrs = calloc(phnum, sizeof(Elf64_Phdr)))) {
+		fprintf(stderr, "mkvmcore: cannot malloc program headers\n");
+		exit(1);
+	}
+
+	info = vmcoreinfo(&info_size);
+	note_size = sizeof(Elf64_Nhdr) + 12 + ((info_size + 3) & ~3);
+	if (!(note = calloc(note_size, 1))) {
+		fprintf(stderr, "mkvmcore: cannot malloc note\n");
+		exit(1);
+	}
+	nhdr = (Elf64_Nhdr *)note;
+	nhdr->n_namesz = strlen("VMCOREINFO") + 1;
+	nhdr->n_descsz = info_size;
+	nhdr->n_type = 0;
+	strcpy(note + sizeof(Elf64_Nhdr), "VMCOREINFO");
+	memcpy(note + sizeof(Elf64_Nhdr) + 12, info, info_size);
+
+	memset(&ehdr, 0, sizeof(ehdr));
+	memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+	ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+#else
+	ehdr.e_ident[EI_DATA] = ELFDATA2MSB;
+#endif
+	ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+	ehdr.e_type = ET_CORE;
+	ehdr.e_machine = machine_to_elf(mk.machine);
+	ehdr.e_version = EV_CURRENT;
+	ehdr.e_phoff = sizeof(Elf64_Ehdr);
+	ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+	ehdr.e_phentsize = sizeof(Elf64_Phdr);
+	ehdr.e_phnum = phnum;
+
+	offset = sizeof(Elf64_Ehdr) + phnum * sizeof(Elf64_Phdr);
+
+	phdrs[0].p_type = PT_NOTE;
+	phdrs[0].p_offset = offset;
+	phdrs[0].p_filesz = note_size;
+	phdrs[0].p_memsz = note_size;
+	write_at(note, note_size, offset);
+	offset += note_size;
+
+	for (pfn = 0, i = 1; pfn < mk.max_mapnr; ) {
+		if (!TEST_BIT(mk.dumpable, pfn)) {
+			pfn++;
+			continue;
+		}
+
+		load = &phdrs[i++];
+		load->p_type = PT_LOAD;
+		load->p_flags = PF_R|PF_W|PF_X;
+		load->p_offset = offset;
+		load->p_paddr = pfn * mk.pagesize;
+		load->p_vaddr = load->p_paddr;
+
+		for (start = pfn; (pfn < mk.max_mapnr) &&
+		    TEST_BIT(mk.dumpable, pfn); pfn++) {
+			fill_page(pfn);
+			write_at(mk.page, mk.pagesize, offset);
+			offset += mk.pagesize;
+		}
+
+		load->p_filesz = (pfn - start) * mk.pagesize;
+		load->p_memsz = load->p_filesz;
+	}
+
+	write_at(&ehdr, sizeof(ehdr), 0);
+	write_at(phdrs, phnum * sizeof(Elf64_Phdr), sizeof(Elf64_Ehdr));
+
+	free(phdrs);
+	free(note);
+
+	return offset;
+}
@@ -15,7 +15,10 @@
  * GNU General Public License for more details.
  */
 
+#define _GNU_SOURCE
 #include "defs.h"
+#include <sys/socket.h>
+#include <sys/un.h>
 
 static void restore_sanity(void);
 static void restore_ifile_sanity(void);
@@ -28,6 +31,18 @@ static int allocate_alias(int);
 static int alias_exists(char *);
 static void resolve_aliases(void);
 static int setup_redirect(int);
+static FILE *setup_output_filter(char *);
+static void close_output_filter(void);
+static void server_accept(void);
+static void server_disconnect(void);
+static void server_command_line(void);
+static void server_end_command(void);
+static void server_sigio(int);
+static int exec_input_line(char *);
+static int input_line_is_barrier(char *);
+static int reopen_input_worker_files(int);
+static void kill_input_workers(void *);
+static void exec_input_file_jobs(FILE *);
 int multiple_pipes(char **);
 static int output_command_to_pids(void);
 static void set_my_tty(void);
@@ -61,11 +76,13 @@ process_command_line(void)
 	 *  piled up by the previous command.
 	 */
 	restore_sanity();
+	if (pc->flags2 & SERVER_MODE)
+		server_end_command();
 	fp = stdout;
 	BZERO(pc->command_line, BUFSIZE);
 
-	if (!pc->ifile_in_progress && !(pc->flags &
-	    (TTY|SILENT|CMDLINE_IFILE|RCHOME_IFILE|RCLOCAL_IFILE)))
+	if (!pc->ifile_in_progress && !(pc->flags2 & SERVER_MODE) && 
+	    !(pc->flags & (TTY|SILENT|CMDLINE_IFILE|RCHOME_IFILE|RCLOCAL_IFILE)))
 		fprintf(fp, "%s", pc->prompt);
 	fflush(fp);
 
@@ -116,6 +133,10 @@ process_command_line(void)
 	} else if (pc->flags & CMDLINE_IFILE) {
 		sprintf(pc->command_line, "< %s", pc->input_file);
 		pc->flags |= INIT_IFILE;
+	} else if (pc->flags2 & SERVER_MODE) {
+		server_command_line();
+		strcpy(pc->orig_line, pc->command_line);
+		check_special_handling(pc->command_line);
 	} else if (pc->flags & TTY) {
 		if (!(pc->readline = readline(pc->prompt))) {
 			args[0] = NULL;
@@ -538,6 +559,13 @@ setup_redirect(int origin)
 			if (pc->redirect & REDIRECT_SHELL_COMMAND)
 				return shell_command(p);
 
+			if ((pipe = setup_output_filter(p))) {
+				fp = pc->filter = pipe;
+				strcpy(pc->pipe_command, p);
+				pc->redirect |= REDIRECT_TO_FILTER;
+				return REDIRECT_TO_PIPE;
+			}
+
                         if ((pipe = popen(p, "w")) == NULL) {
                                 error(INFO, "cannot open pipe\n");
 				pc->redirect |= REDIRECT_FAILURE;
@@ -700,214 +728,972 @@ multiple_pipes(char **input)
 		return FALSE;
 }
 
-void
-debug_redirect(char *s)
-{
-	int others;
-	int alive;
+/*
+ *  In-process output filters.
+ *
+ *  Commands piped to a short chain of common text filters, such as
+ *  "struct page ... | grep flags | wc -l", are handled here rather than
+ *  by popen()'ing a shell for each command.  The command's output is
+ *  written to a fully-buffered stream whose lines are passed through
+ *  each filter stage in turn, with the result written to stdout.
+ *  The supported filters are:
+ *
+ *    grep/egrep [-v] [-c] [-i] [-E] [-F] [-e] pattern
+ *    head [-n count | -count]
+ *    tail [-n count | -count]
+ *    wc [-l] [-w] [-c]
+ *    sort [-n] [-r] [-u]
+ *    uniq [-c]
+ *    awk '{print $N[, $M ...]}'
+ *
+ *  Anything else, including any shell metacharacters outside of quoted
+ *  strings, causes the whole pipeline to be passed to the shell.
+ */
+#define FILTER_MAXSTAGES  (8)
+#define FILTER_MAXARGS    (16)
+#define FILTER_MAXFIELDS  (16)
+#define FILTER_NF         (-1)
+
+#define FILTER_GREP   (1)
+#define FILTER_HEAD   (2)
+#define FILTER_TAIL   (3)
+#define FILTER_WC     (4)
+#define FILTER_SORT   (5)
+#define FILTER_UNIQ   (6)
+#define FILTER_AWK    (7)
+
+#define FILTER_INVERT    (0x1)
+#define FILTER_COUNT     (0x2)
+#define FILTER_ICASE     (0x4)
+#define FILTER_EXTENDED  (0x8)
+#define FILTER_FIXED    (0x10)
+#define FILTER_NUMERIC  (0x20)
+#define FILTER_REVERSE  (0x40)
+#define FILTER_UNIQUE   (0x80)
+#define FILTER_LINES   (0x100)
+#define FILTER_WORDS   (0x200)
+#define FILTER_CHARS   (0x400)
+#define FILTER_REGEX   (0x800)
+
+struct filter_stage {
+	int type;
+	ulong flags;
+	char *pattern;
+	regex_t regex;
+	long count;
+	long lines;
+	long words;
+	long chars;
+	int nfields;
+	int fields[FILTER_MAXFIELDS];
+	char **saved;
+	long nsaved;
+	long maxsaved;
+	char *last;
+};
 
-        others = 0;
-        console("%s: (", s);
-        if (pc->redirect & FROM_COMMAND_LINE)
-                console("%sFROM_COMMAND_LINE", others++ ? "|" : "");
-        if (pc->redirect & FROM_INPUT_FILE)
-                console("%sFROM_INPUT_FILE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_NOT_DONE)
-                console("%sREDIRECT_NOT_DONE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_TO_PIPE)
-                console("%sREDIRECT_TO_PIPE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_TO_STDPIPE)
-                console("%sREDIRECT_TO_STDPIPE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_TO_FILE)
-                console("%sREDIRECT_TO_FILE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_FAILURE)
-                console("%sREDIRECT_FAILURE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_SHELL_ESCAPE)
-                console("%sREDIRECT_SHELL_ESCAPE", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_SHELL_COMMAND)
-                console("%sREDIRECT_SHELL_COMMAND", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_PID_KNOWN)
-                console("%sREDIRECT_PID_KNOWN", others++ ? "|" : "");
-        if (pc->redirect & REDIRECT_MULTI_PIPE)
-                console("%sREDIRECT_MULTI_PIPE", others++ ? "|" : "");
-        console(")\n");
+struct output_filter {
+	int nstages;
+	int done;
+	struct filter_stage stage[FILTER_MAXSTAGES];
+	char *line;
+	size_t linelen;
+	size_t linesize;
+	FILE *out;
+	char cmd[BUFSIZE];
+};
 
-	if (pc->pipe_pid || strlen(pc->pipe_command)) {
-		if (pc->pipe_pid && PID_ALIVE(pc->pipe_pid))
-			alive = TRUE;
-		else
-			alive = FALSE;
-        	console("pipe_pid: %d (%s) pipe_command: %s\n", 
-			pc->pipe_pid, 
-			alive ? "alive" : "dead",
-			pc->pipe_command);
-	}
-}
+static struct output_filter *output_filter = NULL;
+static ulong filter_sort_flags;
+
+static int filter_tokenize(char *, char **, int);
+static int filter_parse_count(char *, long *);
+static int filter_parse_stage(struct filter_stage *, int, char **);
+static int filter_parse_awk(struct filter_stage *, char *);
+static void filter_free(struct output_filter *);
+static void filter_emit(struct output_filter *, int, char *, size_t);
+static void filter_line(struct output_filter *, int, char *, size_t);
+static void filter_flush(struct output_filter *, int);
+static int filter_sort_compare(const void *, const void *);
+static ssize_t filter_write(void *, const char *, size_t);
+static int filter_close(void *);
 
 /*
- *  Determine whether the pid receiving the current piped output is still
- *  alive. 
- *
- *  NOTE: This routine returns TRUE by default, and only returns FALSE if
- *        the pipe_pid exists *and* it's known to have died.  Therefore the
- *        caller must be cognizant of pc->pipe_pid or pc->stdpipe_pid.
- */ 
-int
-output_open(void)
+ *  Split a filter command line into its arguments, stripping quotes.
+ *  Stages are separated by a NULL argv entry.  Returns -1 if anything
+ *  that would require the shell's interpretation is found.
+ */
+static int
+filter_tokenize(char *s, char **argv, int max)
 {
-	int waitstatus, waitret;
+	char *d;
+	int argc, quote, intoken;
 
-	if (!(pc->flags & TTY)) 
-		return TRUE;
-
-	switch (pc->redirect & PIPE_OPTIONS)
-	{
-	case (REDIRECT_TO_STDPIPE|FROM_COMMAND_LINE):
-		waitret = waitpid(pc->stdpipe_pid, &waitstatus, WNOHANG);
-		if ((waitret == pc->stdpipe_pid) || (waitret == -1))
-               		return FALSE;
-		break;
+	argc = 0;
+	intoken = FALSE;
+	quote = NULLCHAR;
 
-	case (REDIRECT_TO_PIPE|FROM_INPUT_FILE):
-		if (pc->curcmd_flags & REPEAT)
-			break;
-		/* FALLTHROUGH */
-	case (REDIRECT_TO_PIPE|FROM_COMMAND_LINE):
-		switch (pc->redirect & (REDIRECT_MULTI_PIPE)) 
-		{
-		case REDIRECT_MULTI_PIPE:
-			if (!PID_ALIVE(pc->pipe_pid))
-				return FALSE;
-			break;
+	for (d = s; *s; s++) {
+		if (quote) {
+			if (*s == quote) {
+				quote = NULLCHAR;
+				continue;
+			}
+			if ((quote == '"') && strchr("\\$`", *s))
+				return -1;
+			*d++ = *s;
+			continue;
+		}
 
-		default:
-               		waitret = waitpid(pc->pipe_pid, &waitstatus, WNOHANG);
-                	if (waitret == pc->pipe_pid) 
-                        	return FALSE;
-			if (waitret == -1) {  /* intervening sh */
-				if (!PID_ALIVE(pc->pipe_pid))
-					return FALSE;
+		if ((*s == ' ') || (*s == '\t') || (*s == '|')) {
+			if (intoken) {
+				*d++ = NULLCHAR;
+				intoken = FALSE;
 			}
-			break;
+			if (*s == '|') {
+				if ((argc >= max) || !argc || !argv[argc-1])
+					return -1;
+				argv[argc++] = NULL;
+			}
+			continue;
 		}
-		break;
 
-	default:
-		break;
+		if (strchr("\\$`<>;&()*?[]{}~!#", *s))
+			return -1;
+
+		if (!intoken) {
+			if (argc >= max)
+				return -1;
+			argv[argc++] = d;
+			intoken = TRUE;
+		}
+		if ((*s == '\'') || (*s == '"')) {
+			quote = *s;
+			continue;
+		}
+		*d++ = *s;
 	}
 
-	return TRUE;
+	if (quote)
+		return -1;
+	if (intoken)
+		*d = NULLCHAR;
+
+	return argc;
 }
 
+static int
+filter_parse_count(char *s, long *count)
+{
+	char *end;
+
+	if (!s || !decimal(s, 0))
+		return FALSE;
+
+	errno = 0;
+	*count = strtol(s, &end, 10);
+	if (errno || *end)
+		return FALSE;
+
+	return TRUE;
+}
 
 /*
- *  Determine the pids of the current popen'd shell and output command.
- *  This is all done using /proc; the ps kludge at the bottom of this
- *  routine is legacy, and should only get executed if /proc doesn't exist.
+ *  Only a list of field references is accepted, as in:
+ *  awk '{print $1}' or awk '{ print $2, $NF }'.
  */
 static int
-output_command_to_pids(void)
+filter_parse_awk(struct filter_stage *fs, char *prog)
 {
-	DIR *dirp;
-        struct dirent *dp;
-	FILE *stp;
-        char buf1[BUFSIZE];
-        char buf2[BUFSIZE];
-        char lookfor[BUFSIZE+2];
-        char *pid, *name, *status, *p_pid, *pgrp, *comm;
-	char *arglist[MAXARGS];
-	int argc;
-	FILE *pipe;
-	int retries, shell_has_exited;
+	char *p, *end;
+	long field;
 
-	retries = 0;
-	shell_has_exited = FALSE;
-	pc->pipe_pid = pc->pipe_shell_pid = 0;
-	comm = strrchr(pc->pipe_command, '/');
-	sprintf(lookfor, "(%s)", comm ? ++comm : pc->pipe_command);
-	stall(1000);
-retry:
-        if (is_directory("/proc") && (dirp = opendir("/proc"))) {
-                for (dp = readdir(dirp); dp && !pc->pipe_pid; 
-		     dp = readdir(dirp)) {
-			if (!decimal(dp->d_name, 0))
-				continue;
-                        sprintf(buf1, "/proc/%s/stat", dp->d_name);
-                        if (file_exists(buf1, NULL) && 
-			    (stp = fopen(buf1, "r"))) {
-                                if (fgets(buf2, BUFSIZE, stp)) {
-                                        pid = strtok(buf2, " ");
-                                        name = strtok(NULL, " ");
-                                        status = strtok(NULL, " ");
-                                        p_pid = strtok(NULL, " ");
-                                        pgrp = strtok(NULL, " ");
-				        if (STREQ(name, "(sh)") &&
-					    (atoi(p_pid) == getpid())) { 
-						pc->pipe_shell_pid = atoi(pid);
-						if (STREQ(status, "Z"))
-							shell_has_exited = TRUE;
-					}
-                                        if (STREQ(name, lookfor) &&
-                                            ((atoi(p_pid) == getpid()) ||
-				             (atoi(p_pid) == pc->pipe_shell_pid)
-			                     || (atoi(pgrp) == getpid()))) {
-						pc->pipe_pid = atoi(pid);
-						console(
-                            "FOUND[%d] (%d->%d->%d) %s %s p_pid: %s pgrp: %s\n",
-						    retries, getpid(), 
-						    pc->pipe_shell_pid, 
-						    pc->pipe_pid,
-						    name, status, p_pid, pgrp);
-					}  
-                                }
-				fclose(stp);
-                        }
-                }
-		closedir(dirp);
-        }
+	p = first_nonspace(prog);
+	if (*p++ != '{')
+		return FALSE;
+	p = first_nonspace(p);
+	if (!STRNEQ(p, "print"))
+		return FALSE;
+	p += strlen("print");
+	if ((*p != ' ') && (*p != '\t'))
+		return FALSE;
 
-	if (!pc->pipe_pid && !shell_has_exited && 
-	    ((retries++ < 10) || pc->pipe_shell_pid)) {
-		stall(1000);
-		goto retry;
-	}
+	for (fs->nfields = 0; ; ) {
+		p = first_nonspace(p);
+		if (*p++ != '$')
+			return FALSE;
+		if (STRNEQ(p, "NF")) {
+			field = FILTER_NF;
+			p += strlen("NF");
+		} else {
+			if (!isdigit(*p))
+				return FALSE;
+			field = strtol(p, &end, 10);
+			if (field > INT_MAX)
+				return FALSE;
+			p = end;
+		}
+		if (fs->nfields >= FILTER_MAXFIELDS)
+			return FALSE;
+		fs->fields[fs->nfields++] = (int)field;
 
-	console("getpid: %d pipe_shell_pid: %d pipe_pid: %d\n",
-		getpid(), pc->pipe_shell_pid, pc->pipe_pid);
+		p = first_nonspace(p);
+		if (*p == ',') {
+			p++;
+			continue;
+		}
+		if (*p++ != '}')
+			return FALSE;
+		break;
+	}
 
-	if (pc->pipe_pid)	
-		return pc->pipe_pid;
+	return (*first_nonspace(p) == NULLCHAR);
+}
 
-	sprintf(buf1, "ps -ft %s", pc->my_tty);
-	console("%s: ", buf1);
+static int
+filter_parse_stage(struct filter_stage *fs, int argc, char **argv)
+{
+	char *p;
+	int i, cflags;
+
+	if (STREQ(argv[0], "grep") || STREQ(argv[0], "egrep") ||
+	    STREQ(argv[0], "fgrep")) {
+		fs->type = FILTER_GREP;
+		if (STREQ(argv[0], "egrep"))
+			fs->flags |= FILTER_EXTENDED;
+		if (STREQ(argv[0], "fgrep"))
+			fs->flags |= FILTER_FIXED;
+		for (i = 1; i < argc; i++) {
+			if ((argv[i][0] != '-') || !argv[i][1] || fs->pattern)
+				break;
+			if (STREQ(argv[i], "--")) {
+				i++;
+				break;
+			}
+			for (p = &argv[i][1]; *p; p++) {
+				switch (*p)
+				{
+				case 'v':
+					fs->flags |= FILTER_INVERT;
+					break;
+				case 'c':
+					fs->flags |= FILTER_COUNT;
+					break;
+				case 'i':
+					fs->flags |= FILTER_ICASE;
+					break;
+				case 'E':
+					fs->flags |= FILTER_EXTENDED;
+					break;
+				case 'F':
+					fs->flags |= FILTER_FIXED;
+					break;
+				case 'e':
+					if (p[1] || (i+1 >= argc))
+						return FALSE;
+					fs->pattern = argv[++i];
+					break;
+				default:
+					return FALSE;
+				}
+				if (fs->pattern)
+					break;
+			}
+		}
+		if (!fs->pattern) {
+			if (i != argc-1)
+				return FALSE;
+			fs->pattern = argv[i];
+		} else if (i != argc)
+			return FALSE;
 
-	if ((pipe = popen(buf1, "r")) == NULL) {
-        	error(INFO, "cannot determine output pid\n");
-		return 0;
+		if (!(fs->flags & FILTER_FIXED)) {
+			cflags = REG_NOSUB;
+			if (fs->flags & FILTER_EXTENDED)
+				cflags |= REG_EXTENDED;
+			if (fs->flags & FILTER_ICASE)
+				cflags |= REG_ICASE;
+			if (regcomp(&fs->regex, fs->pattern, cflags))
+				return FALSE;
+			fs->flags |= FILTER_REGEX;
+		}
+		return TRUE;
 	}
 
-	while (fgets(buf1, BUFSIZE, pipe)) {
-		argc = parse_line(buf1, arglist);
-		if ((argc >= 8) && 
-		    STREQ(arglist[7], pc->pipe_command) &&
-		    STRNEQ(pc->my_tty, arglist[5])) {
-			pc->pipe_pid = atoi(arglist[1]);
+	if (STREQ(argv[0], "head") || STREQ(argv[0], "tail")) {
+		fs->type = STREQ(argv[0], "head") ? FILTER_HEAD : FILTER_TAIL;
+		fs->count = 10;
+		switch (argc)
+		{
+		case 1:
+			break;
+		case 2:
+			if (STRNEQ(argv[1], "-n"))
+				p = &argv[1][2];
+			else if (argv[1][0] == '-')
+				p = &argv[1][1];
+			else
+				return FALSE;
+			if (!filter_parse_count(p, &fs->count))
+				return FALSE;
+			break;
+		case 3:
+			if (!STREQ(argv[1], "-n") ||
+			    !filter_parse_count(argv[2], &fs->count))
+				return FALSE;
 			break;
+		default:
+			return FALSE;
 		}
+		return TRUE;
 	}
-	pclose(pipe);
-	console("%d\n", pc->pipe_pid);
 
-	return pc->pipe_pid;
-}
+	if (STREQ(argv[0], "wc")) {
+		fs->type = FILTER_WC;
+		for (i = 1; i < argc; i++) {
+			if ((argv[i][0] != '-') || !argv[i][1])
+				return FALSE;
+			for (p = &argv[i][1]; *p; p++) {
+				switch (*p)
+				{
+				case 'l':
+					fs->flags |= FILTER_LINES;
+					break;
+				case 'w':
+					fs->flags |= FILTER_WORDS;
+					break;
+				case 'c':
+					fs->flags |= FILTER_CHARS;
+					break;
+				default:
+					return FALSE;
+				}
+			}
+		}
+		if (!(fs->flags & (FILTER_LINES|FILTER_WORDS|FILTER_CHARS)))
+			fs->flags |= (FILTER_LINES|FILTER_WORDS|FILTER_CHARS);
+		return TRUE;
+	}
 
-/*
- *  Close straggling, piped-to, output commands.
- */
-void
-close_output(void)
-{
-        if ((pc->flags & TTY) &&
+	if (STREQ(argv[0], "sort")) {
+		fs->type = FILTER_SORT;
+		for (i = 1; i < argc; i++) {
+			if ((argv[i][0] != '-') || !argv[i][1])
+				return FALSE;
+			for (p = &argv[i][1]; *p; p++) {
+				switch (*p)
+				{
+				case 'n':
+					fs->flags |= FILTER_NUMERIC;
+					break;
+				case 'r':
+					fs->flags |= FILTER_REVERSE;
+					break;
+				case 'u':
+					fs->flags |= FILTER_UNIQUE;
+					break;
+				default:
+					return FALSE;
+				}
+			}
+		}
+		return TRUE;
+	}
+
+	if (STREQ(argv[0], "uniq")) {
+		fs->type = FILTER_UNIQ;
+		if (argc == 2 && STREQ(argv[1], "-c"))
+			fs->flags |= FILTER_COUNT;
+		else if (argc != 1)
+			return FALSE;
+		return TRUE;
+	}
+
+	if (STREQ(argv[0], "awk")) {
+		fs->type = FILTER_AWK;
+		return ((argc == 2) && filter_parse_awk(fs, argv[1]));
+	}
+
+	return FALSE;
+}
+
+/*
+ *  Build an output filter for the pipeline command, returning a
+ *  buffered stream to write the command output into, or NULL if
+ *  the pipeline has to be handed off to the shell.
+ */
+static FILE *
+setup_output_filter(char *cmd)
+{
+	struct output_filter *of;
+	cookie_io_functions_t io;
+	char *argv[FILTER_MAXARGS];
+	int i, argc, start;
+	FILE *filter;
+
+	if (!(of = (struct output_filter *)calloc(1, sizeof(*of))))
+		return NULL;
+
+	strncpy(of->cmd, cmd, BUFSIZE-1);
+	if ((argc = filter_tokenize(of->cmd, argv, FILTER_MAXARGS-1)) <= 0)
+		goto bailout;
+	argv[argc++] = NULL;
+
+	for (i = start = 0; i < argc; i++) {
+		if (argv[i])
+			continue;
+		if ((i == start) || (of->nstages == FILTER_MAXSTAGES))
+			goto bailout;
+		if (!filter_parse_stage(&of->stage[of->nstages++],
+		    i - start, &argv[start]))
+			goto bailout;
+		start = i+1;
+	}
+
+	io.read = NULL;
+	io.write = filter_write;
+	io.seek = NULL;
+	io.close = filter_close;
+
+	if (!(filter = fopencookie(of, "w", io)))
+		goto bailout;
+
+	of->out = stdout;
+	output_filter = of;
+
+	return filter;
+
+bailout:
+	filter_free(of);
+	return NULL;
+}
+
+static void
+filter_free(struct output_filter *of)
+{
+	struct filter_stage *fs;
+	long i;
+	int s;
+
+	for (s = 0; s < FILTER_MAXSTAGES; s++) {
+		fs = &of->stage[s];
+		if (fs->flags & FILTER_REGEX)
+			regfree(&fs->regex);
+		for (i = 0; i < fs->maxsaved; i++)
+			free(fs->saved ? fs->saved[i] : NULL);
+		free(fs->saved);
+		free(fs->last);
+	}
+	free(of->line);
+	free(of);
+}
+
+/*
+ *  Pass a line to the next stage, or write it out after the last one.
+ */
+static void
+filter_emit(struct output_filter *of, int s, char *line, size_t len)
+{
+	if (++s < of->nstages) {
+		filter_line(of, s, line, len);
+		return;
+	}
+
+	fwrite(line, 1, len, of->out);
+	fputc('\n', of->out);
+}
+
+static void
+filter_line(struct output_filter *of, int s, char *line, size_t len)
+{
+	struct filter_stage *fs;
+	char buf[BUFSIZE];
+	char *copy, *field[MAXARGS];
+	int i, f, nf, match, words;
+	size_t size;
+	char *p;
+
+	fs = &of->stage[s];
+
+	switch (fs->type)
+	{
+	case FILTER_GREP:
+		if (fs->flags & FILTER_REGEX)
+			match = (regexec(&fs->regex, line, 0, NULL, 0) == 0);
+		else if (fs->flags & FILTER_ICASE)
+			match = (strcasestr(line, fs->pattern) != NULL);
+		else
+			match = (strstr(line, fs->pattern) != NULL);
+		if (fs->flags & FILTER_INVERT)
+			match = !match;
+		if (!match)
+			break;
+		if (fs->flags & FILTER_COUNT)
+			fs->lines++;
+		else
+			filter_emit(of, s, line, len);
+		break;
+
+	case FILTER_HEAD:
+		if (fs->lines < fs->count) {
+			fs->lines++;
+			filter_emit(of, s, line, len);
+		}
+		/*
+		 *  Like a pipe whose reader has exited, let the command
+		 *  know via output_open() that nothing more will be seen.
+		 */
+		if (fs->lines >= fs->count)
+			of->done = TRUE;
+		break;
+
+	case FILTER_TAIL:
+		if (!fs->count)
+			break;
+		if (!fs->saved) {
+			fs->maxsaved = fs->count;
+			if (!(fs->saved = calloc(fs->maxsaved, sizeof(char *))))
+				break;
+		}
+		i = fs->nsaved++ % fs->maxsaved;
+		free(fs->saved[i]);
+		fs->saved[i] = strdup(line);
+		break;
+
+	case FILTER_WC:
+		fs->lines++;
+		fs->chars += len + 1;
+		for (p = line, words = FALSE; *p; p++) {
+			if (isspace(*p))
+				words = FALSE;
+			else if (!words) {
+				words = TRUE;
+				fs->words++;
+			}
+		}
+		break;
+
+	case FILTER_SORT:
+		if (fs->nsaved == fs->maxsaved) {
+			size = fs->maxsaved ? fs->maxsaved * 2 : 1024;
+			if (!(copy = realloc(fs->saved, size * sizeof(char *))))
+				break;
+			fs->saved = (char **)copy;
+			memset(&fs->saved[fs->maxsaved], 0,
+				(size - fs->maxsaved) * sizeof(char *));
+			fs->maxsaved = size;
+		}
+		if ((fs->saved[fs->nsaved] = strdup(line)))
+			fs->nsaved++;
+		break;
+
+	case FILTER_UNIQ:
+		if (fs->last && STREQ(fs->last, line)) {
+			fs->lines++;
+			break;
+		}
+		filter_flush(of, s);
+		fs->last = strdup(line);
+		fs->lines = 1;
+		break;
+
+	case FILTER_AWK:
+		if (!(copy = strdup(line)))
+			break;
+		for (nf = 0, p = strtok(copy, " \t"); p && (nf < MAXARGS);
+		     p = strtok(NULL, " \t"))
+			field[nf++] = p;
+		for (i = 0, buf[0] = NULLCHAR; i < fs->nfields; i++) {
+			if ((f = fs->fields[i]) == FILTER_NF)
+				f = nf;
+			if (i)
+				strncat(buf, " ", BUFSIZE-1-strlen(buf));
+			if (f == 0)
+				strncat(buf, line, BUFSIZE-1-strlen(buf));
+			else if (f <= nf)
+				strncat(buf, field[f-1], BUFSIZE-1-strlen(buf));
+		}
+		free(copy);
+		filter_emit(of, s, buf, strlen(buf));
+		break;
+	}
+}
+
+static int
+filter_sort_compare(const void *a, const void *b)
+{
+	char *s1 = *(char **)a;
+	char *s2 = *(char **)b;
+	double d1, d2;
+	int cmp;
+
+	cmp = 0;
+	if (filter_sort_flags & FILTER_NUMERIC) {
+		d1 = strtod(s1, NULL);
+		d2 = strtod(s2, NULL);
+		cmp = (d1 < d2) ? -1 : (d1 > d2);
+	}
+	/*
+	 *  As with sort(1), numerically-equal lines fall back to a
+	 *  whole-line comparison unless they are being made unique.
+	 */
+	if (!cmp && ((filter_sort_flags & (FILTER_NUMERIC|FILTER_UNIQUE)) !=
+	    (FILTER_NUMERIC|FILTER_UNIQUE)))
+		cmp = strcoll(s1, s2);
+
+	return (filter_sort_flags & FILTER_REVERSE) ? -cmp : cmp;
+}
+
+/*
+ *  Release anything a stage has been holding on to.
+ */
+static void
+filter_flush(struct output_filter *of, int s)
+{
+	struct filter_stage *fs;
+	char buf[BUFSIZE];
+	long i, first;
+
+	fs = &of->stage[s];
+	buf[0] = NULLCHAR;
+
+	switch (fs->type)
+	{
+	case FILTER_GREP:
+		if (fs->flags & FILTER_COUNT) {
+			sprintf(buf, "%ld", fs->lines);
+			filter_emit(of, s, buf, strlen(buf));
+		}
+		break;
+
+	case FILTER_TAIL:
+		first = fs->nsaved > fs->maxsaved ? fs->nsaved - fs->maxsaved : 0;
+		for (i = first; i < fs->nsaved; i++) {
+			if (fs->saved[i % fs->maxsaved])
+				filter_emit(of, s, fs->saved[i % fs->maxsaved],
+					strlen(fs->saved[i % fs->maxsaved]));
+		}
+		break;
+
+	case FILTER_WC:
+		if (count_bits_long(fs->flags & 
+		    (FILTER_LINES|FILTER_WORDS|FILTER_CHARS)) == 1)
+			sprintf(buf, "%ld", fs->flags & FILTER_LINES ? fs->lines :
+				fs->flags & FILTER_WORDS ? fs->words : fs->chars);
+		else {
+			if (fs->flags & FILTER_LINES)
+				sprintf(&buf[strlen(buf)], "%7ld ", fs->lines);
+			if (fs->flags & FILTER_WORDS)
+				sprintf(&buf[strlen(buf)], "%7ld ", fs->words);
+			if (fs->flags & FILTER_CHARS)
+				sprintf(&buf[strlen(buf)], "%7ld ", fs->chars);
+			buf[strlen(buf)-1] = NULLCHAR;
+		}
+		filter_emit(of, s, buf, strlen(buf));
+		break;
+
+	case FILTER_SORT:
+		if (!fs->nsaved)
+			break;
+		filter_sort_flags = fs->flags;
+		qsort(fs->saved, fs->nsaved, sizeof(char *), filter_sort_compare);
+		for (i = 0; i < fs->nsaved; i++) {
+			if ((fs->flags & FILTER_UNIQUE) && i &&
+			    !filter_sort_compare(&fs->saved[i-1], &fs->saved[i]))
+				continue;
+			filter_emit(of, s, fs->saved[i], strlen(fs->saved[i]));
+		}
+		break;
+
+	case FILTER_UNIQ:
+		if (!fs->last)
+			break;
+		if (fs->flags & FILTER_COUNT) {
+			snprintf(buf, BUFSIZE, "%7ld %s", fs->lines, fs->last);
+			filter_emit(of, s, buf, strlen(buf));
+		} else
+			filter_emit(of, s, fs->last, strlen(fs->last));
+		free(fs->last);
+		fs->last = NULL;
+		break;
+	}
+}
+
+static ssize_t
+filter_write(void *cookie, const char *buf, size_t size)
+{
+	struct output_filter *of = (struct output_filter *)cookie;
+	const char *p, *end, *nl;
+	size_t len;
+	char *line;
+
+	for (p = buf, end = buf + size; p < end; p = nl + 1) {
+		if (!(nl = memchr(p, '\n', end - p)))
+			nl = end;
+		len = nl - p;
+		if (of->linelen + len + 1 > of->linesize) {
+			if (!(line = realloc(of->line, of->linelen + len + BUFSIZE)))
+				return -1;
+			of->line = line;
+			of->linesize = of->linelen + len + BUFSIZE;
+		}
+		memcpy(of->line + of->linelen, p, len);
+		of->linelen += len;
+		of->line[of->linelen] = NULLCHAR;
+
+		if (nl == end)
+			break;
+		if (!of->done)
+			filter_line(of, 0, of->line, of->linelen);
+		of->linelen = 0;
+	}
+
+	return size;
+}
+
+static int
+filter_close(void *cookie)
+{
+	struct output_filter *of = (struct output_filter *)cookie;
+	int s;
+
+	if (of->linelen && !of->done)
+		filter_line(of, 0, of->line, of->linelen);
+
+	for (s = 0; s < of->nstages; s++)
+		filter_flush(of, s);
+	fflush(of->out);
+
+	if (output_filter == of)
+		output_filter = NULL;
+	filter_free(of);
+
+	return 0;
+}
+
+static void
+close_output_filter(void)
+{
+	FILE *filter;
+
+	filter = pc->filter;
+	pc->filter = NULL;
+	fclose(filter);
+}
+
+void
+debug_redirect(char *s)
+{
+	int others;
+	int alive;
+
+        others = 0;
+        console("%s: (", s);
+        if (pc->redirect & FROM_COMMAND_LINE)
+                console("%sFROM_COMMAND_LINE", others++ ? "|" : "");
+        if (pc->redirect & FROM_INPUT_FILE)
+                console("%sFROM_INPUT_FILE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_NOT_DONE)
+                console("%sREDIRECT_NOT_DONE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_TO_PIPE)
+                console("%sREDIRECT_TO_PIPE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_TO_STDPIPE)
+                console("%sREDIRECT_TO_STDPIPE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_TO_FILE)
+                console("%sREDIRECT_TO_FILE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_FAILURE)
+                console("%sREDIRECT_FAILURE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_SHELL_ESCAPE)
+                console("%sREDIRECT_SHELL_ESCAPE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_SHELL_COMMAND)
+                console("%sREDIRECT_SHELL_COMMAND", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_PID_KNOWN)
+                console("%sREDIRECT_PID_KNOWN", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_MULTI_PIPE)
+                console("%sREDIRECT_MULTI_PIPE", others++ ? "|" : "");
+        if (pc->redirect & REDIRECT_TO_FILTER)
+                console("%sREDIRECT_TO_FILTER", others++ ? "|" : "");
+        console(")\n");
+
+	if (pc->pipe_pid || strlen(pc->pipe_command)) {
+		if (pc->pipe_pid && PID_ALIVE(pc->pipe_pid))
+			alive = TRUE;
+		else
+			alive = FALSE;
+        	console("pipe_pid: %d (%s) pipe_command: %s\n", 
+			pc->pipe_pid, 
+			alive ? "alive" : "dead",
+			pc->pipe_command);
+	}
+}
+
+/*
+ *  Determine whether the pid receiving the current piped output is still
+ *  alive. 
+ *
+ *  NOTE: This routine returns TRUE by default, and only returns FALSE if
+ *        the pipe_pid exists *and* it's known to have died.  Therefore the
+ *        caller must be cognizant of pc->pipe_pid or pc->stdpipe_pid.
+ */ 
+int
+output_open(void)
+{
+	int waitstatus, waitret;
+
+	if (pc->redirect & REDIRECT_TO_FILTER)
+		return !(output_filter && output_filter->done);
+
+	if (!(pc->flags & TTY)) 
+		return TRUE;
+
+	switch (pc->redirect & PIPE_OPTIONS)
+	{
+	case (REDIRECT_TO_STDPIPE|FROM_COMMAND_LINE):
+		waitret = waitpid(pc->stdpipe_pid, &waitstatus, WNOHANG);
+		if ((waitret == pc->stdpipe_pid) || (waitret == -1))
+               		return FALSE;
+		break;
+
+	case (REDIRECT_TO_PIPE|FROM_INPUT_FILE):
+		if (pc->curcmd_flags & REPEAT)
+			break;
+		/* FALLTHROUGH */
+	case (REDIRECT_TO_PIPE|FROM_COMMAND_LINE):
+		switch (pc->redirect & (REDIRECT_MULTI_PIPE)) 
+		{
+		case REDIRECT_MULTI_PIPE:
+			if (!PID_ALIVE(pc->pipe_pid))
+				return FALSE;
+			break;
+
+		default:
+               		waitret = waitpid(pc->pipe_pid, &waitstatus, WNOHANG);
+                	if (waitret == pc->pipe_pid) 
+                        	return FALSE;
+			if (waitret == -1) {  /* intervening sh */
+				if (!PID_ALIVE(pc->pipe_pid))
+					return FALSE;
+			}
+			break;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return TRUE;
+}
+
+
+/*
+ *  Determine the pids of the current popen'd shell and output command.
+ *  This is all done using /proc; the ps kludge at the bottom of this
+ *  routine is legacy, and should only get executed if /proc doesn't exist.
+ */
+static int
+output_command_to_pids(void)
+{
+	DIR *dirp;
+        struct dirent *dp;
+	FILE *stp;
+        char buf1[BUFSIZE];
+        char buf2[BUFSIZE];
+        char lookfor[BUFSIZE+2];
+        char *pid, *name, *status, *p_pid, *pgrp, *comm;
+	char *arglist[MAXARGS];
+	int argc;
+	FILE *pipe;
+	int retries, shell_has_exited;
+
+	retries = 0;
+	shell_has_exited = FALSE;
+	pc->pipe_pid = pc->pipe_shell_pid = 0;
+	comm = strrchr(pc->pipe_command, '/');
+	sprintf(lookfor, "(%s)", comm ? ++comm : pc->pipe_command);
+	stall(1000);
+retry:
+        if (is_directory("/proc") && (dirp = opendir("/proc"))) {
+                for (dp = readdir(dirp); dp && !pc->pipe_pid; 
+		     dp = readdir(dirp)) {
+			if (!decimal(dp->d_name, 0))
+				continue;
+                        sprintf(buf1, "/proc/%s/stat", dp->d_name);
+                        if (file_exists(buf1, NULL) && 
+			    (stp = fopen(buf1, "r"))) {
+                                if (fgets(buf2, BUFSIZE, stp)) {
+                                        pid = strtok(buf2, " ");
+                                        name = strtok(NULL, " ");
+                                        status = strtok(NULL, " ");
+                                        p_pid = strtok(NULL, " ");
+                                        pgrp = strtok(NULL, " ");
+				        if (STREQ(name, "(sh)") &&
+					    (atoi(p_pid) == getpid())) { 
+						pc->pipe_shell_pid = atoi(pid);
+						if (STREQ(status, "Z"))
+							shell_has_exited = TRUE;
+					}
+                                        if (STREQ(name, lookfor) &&
+                                            ((atoi(p_pid) == getpid()) ||
+				             (atoi(p_pid) == pc->pipe_shell_pid)
+			                     || (atoi(pgrp) == getpid()))) {
+						pc->pipe_pid = atoi(pid);
+						console(
+                            "FOUND[%d] (%d->%d->%d) %s %s p_pid: %s pgrp: %s\n",
+						    retries, getpid(), 
+						    pc->pipe_shell_pid, 
+						    pc->pipe_pid,
+						    name, status, p_pid, pgrp);
+					}  
+                                }
+				fclose(stp);
+                        }
+                }
+		closedir(dirp);
+        }
+
+	if (!pc->pipe_pid && !shell_has_exited && 
+	    ((retries++ < 10) || pc->pipe_shell_pid)) {
+		stall(1000);
+		goto retry;
+	}
+
+	console("getpid: %d pipe_shell_pid: %d pipe_pid: %d\n",
+		getpid(), pc->pipe_shell_pid, pc->pipe_pid);
+
+	if (pc->pipe_pid)	
+		return pc->pipe_pid;
+
+	sprintf(buf1, "ps -ft %s", pc->my_tty);
+	console("%s: ", buf1);
+
+	if ((pipe = popen(buf1, "r")) == NULL) {
+        	error(INFO, "cannot determine output pid\n");
+		return 0;
+	}
+
+	while (fgets(buf1, BUFSIZE, pipe)) {
+		argc = parse_line(buf1, arglist);
+		if ((argc >= 8) && 
+		    STREQ(arglist[7], pc->pipe_command) &&
+		    STRNEQ(pc->my_tty, arglist[5])) {
+			pc->pipe_pid = atoi(arglist[1]);
+			break;
+		}
+	}
+	pclose(pipe);
+	console("%d\n", pc->pipe_pid);
+
+	return pc->pipe_pid;
+}
+
+/*
+ *  Close straggling, piped-to, output commands.
+ */
+void
+close_output(void)
+{
+        if ((pc->flags & TTY) &&
 	    (pc->pipe_pid || strlen(pc->pipe_command)) && 
             output_open()) 
                 kill(pc->pipe_pid, 9);
@@ -945,47 +1731,282 @@ cmdline_init(void)
         	pc->termios_raw.c_cc[VMIN] = (char)1;
         	pc->termios_raw.c_cc[VTIME] = (char)0;
 
-		restore_sanity();
+		restore_sanity();
+
+		pc->flags |= TTY;
+		set_my_tty();
+
+		SIGACTION(SIGINT, restart, &pc->sigaction, NULL);
+		readline_init();
+        }
+        else {
+		if (fd < 0)
+			error(INFO, "/dev/tty: %s\n", strerror(errno));
+		if (!(pc->flags & SILENT))
+			fprintf(fp, "NOTE: stdin: not a tty\n\n");
+                fflush(fp);
+		pc->flags &= ~TTY;
+        }
+
+	SIGACTION(SIGPIPE, SIG_IGN, &pc->sigaction, NULL);
+
+	set_command_prompt(NULL);
+}
+
+
+/*
+ *  Create and stash the original prompt, but allow changes during runtime.
+ */
+void
+set_command_prompt(char *new_prompt)
+{
+	static char *orig_prompt = NULL;
+
+	if (!orig_prompt) {
+		if (!(orig_prompt = (char *)malloc(strlen(pc->program_name)+3)))
+			error(FATAL, "cannot malloc prompt string\n");
+		sprintf(orig_prompt, "%s> ", pc->program_name);
+	}
+
+	if (new_prompt)
+		pc->prompt = new_prompt;
+	else
+		pc->prompt = orig_prompt;
+}
+
+/*
+ *  Server mode: once initialized, the session accepts connections on
+ *  the UNIX domain socket given with --server, and executes each
+ *  newline-terminated command line sent by a client.  While a command
+ *  runs, stdout and stderr are redirected to the client, so output --
+ *  including that of piped-to shell commands -- streams straight back;
+ *  the end of each command's output is marked with a NUL byte.  A ^C
+ *  byte sent by the client, or the client hanging up, interrupts the
+ *  running command just like a SIGINT.  Clients are served one at a
+ *  time, in the order that they connect.
+ */
+#define SERVER_CANCEL  (0x03)
+
+static char server_buf[BUFSIZE];
+static int server_buflen = 0;
+static int server_busy = FALSE;
+static int server_hangup = FALSE;
+static int server_stdout = -1;
+static int server_stderr = -1;
+
+void
+set_server_socket(char *path)
+{
+	pc->server_socket = path;
+	pc->server_fd = pc->client_fd = -1;
+	pc->flags2 |= SERVER_MODE;
+}
+
+void
+server_init(void)
+{
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	struct stat sbuf;
+	mode_t mask;
+	int ret;
+
+	if (strlen(pc->server_socket) >= sizeof(addr.sun_path))
+		error(FATAL, "--server: socket path too long: %s\n",
+			pc->server_socket);
+
+	/*
+	 *  Only replace a stale socket of our own.
+	 */
+	if (lstat(pc->server_socket, &sbuf) == 0) {
+		if (!S_ISSOCK(sbuf.st_mode))
+			error(FATAL, "--server: %s exists and is not a socket\n",
+				pc->server_socket);
+		if (sbuf.st_uid != getuid())
+			error(FATAL, "--server: %s is owned by another user\n",
+				pc->server_socket);
+		if (unlink(pc->server_socket) < 0)
+			error(FATAL, "--server: cannot remove %s: %s\n",
+				pc->server_socket, strerror(errno));
+	}
+
+	BZERO(&addr, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pc->server_socket);
+
+	if ((pc->server_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		error(FATAL, "--server: socket: %s\n", strerror(errno));
+
+	/*
+	 *  The socket is created with owner-only permissions, so that no
+	 *  other user can connect to it between bind() and listen().
+	 */
+	mask = umask(S_IRWXG|S_IRWXO|S_IXUSR);
+	ret = bind(pc->server_fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (ret < 0)
+		error(FATAL, "--server: %s: %s\n", pc->server_socket,
+			strerror(errno));
+	if (listen(pc->server_fd, SOMAXCONN) < 0)
+		error(FATAL, "--server: listen: %s\n", strerror(errno));
+	fcntl(pc->server_fd, F_SETFD, FD_CLOEXEC);
+
+	if (((server_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0)) < 0) ||
+	    ((server_stderr = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0)) < 0))
+		error(FATAL, "--server: cannot save stdout/stderr: %s\n",
+			strerror(errno));
+
+	/*
+	 *  SIGIO is also raised as the socket's send buffer drains,
+	 *  so interrupted system calls must be restarted.
+	 */
+	BZERO(&sa, sizeof(struct sigaction));
+	sa.sa_handler = server_sigio;
+	sa.sa_flags = SA_NOMASK|SA_RESTART;
+	sigaction(SIGIO, &sa, NULL);
+
+	pc->flags &= ~SCROLL;
+
+	if (!(pc->flags & SILENT))
+		fprintf(fp, "%s: listening on %s\n", pc->program_name,
+			pc->server_socket);
+	fflush(fp);
+}
+
+static void
+server_accept(void)
+{
+	int fd;
+
+	while ((fd = accept(pc->server_fd, NULL, NULL)) < 0) {
+		if ((errno != EINTR) && (errno != ECONNABORTED)) {
+			error(INFO, "--server: accept: %s\n", strerror(errno));
+			stall(100000);
+		}
+	}
+
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETOWN, getpid());
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_ASYNC);
+
+	pc->client_fd = fd;
+	server_buflen = 0;
+	server_hangup = FALSE;
+}
+
+static void
+server_disconnect(void)
+{
+	if (pc->client_fd >= 0)
+		close(pc->client_fd);
+	pc->client_fd = -1;
+	server_buflen = 0;
+}
+
+/*
+ *  Read the next command line from the current client, waiting for 
+ *  a new client if there is none, and direct output to it.
+ */
+static void
+server_command_line(void)
+{
+	char *nl, *s, *d;
+	int len;
 
-		pc->flags |= TTY;
-		set_my_tty();
+	while (TRUE) {
+		if (pc->client_fd < 0) {
+			server_accept();
+			continue;
+		}
 
-		SIGACTION(SIGINT, restart, &pc->sigaction, NULL);
-		readline_init();
-        }
-        else {
-		if (fd < 0)
-			error(INFO, "/dev/tty: %s\n", strerror(errno));
-		if (!(pc->flags & SILENT))
-			fprintf(fp, "NOTE: stdin: not a tty\n\n");
-                fflush(fp);
-		pc->flags &= ~TTY;
-        }
+		if ((nl = memchr(server_buf, '\n', server_buflen))) {
+			*nl = NULLCHAR;
+			for (s = server_buf, d = pc->command_line; *s; s++) {
+				if (*s != SERVER_CANCEL)
+					*d++ = *s;
+			}
+			*d = NULLCHAR;
+			len = (nl - server_buf) + 1;
+			server_buflen -= len;
+			memmove(server_buf, nl + 1, server_buflen);
+
+			clean_line(pc->command_line);
+			if (STREQ(pc->command_line, "q") || 
+			    STREQ(pc->command_line, "quit") ||
+			    STREQ(pc->command_line, "exit")) {
+				server_disconnect();
+				continue;
+			}
+			break;
+		}
 
-	SIGACTION(SIGPIPE, SIG_IGN, &pc->sigaction, NULL);
+		if (server_buflen >= (BUFSIZE-1)) {
+			s = "input line exceeds maximum of 1500 bytes\n";
+			len = write(pc->client_fd, s, strlen(s));
+			server_disconnect();
+			continue;
+		}
 
-	set_command_prompt(NULL);
-}
+		len = read(pc->client_fd, &server_buf[server_buflen], 
+			BUFSIZE-1-server_buflen);
+		if ((len < 0) && (errno == EINTR))
+			continue;
+		if (len <= 0) {
+			server_disconnect();
+			continue;
+		}
+		server_buflen += len;
+	}
 
+	fflush(stdout);
+	fflush(stderr);
+	dup2(pc->client_fd, STDOUT_FILENO);
+	dup2(pc->client_fd, STDERR_FILENO);
+	server_busy = TRUE;
+}
 
 /*
- *  Create and stash the original prompt, but allow changes during runtime.
+ *  Terminate the output of the last command, and restore stdout
+ *  and stderr.
  */
-void
-set_command_prompt(char *new_prompt)
+static void
+server_end_command(void)
 {
-	static char *orig_prompt = NULL;
+	if (!server_busy)
+		return;
 
-	if (!orig_prompt) {
-		if (!(orig_prompt = (char *)malloc(strlen(pc->program_name)+3)))
-			error(FATAL, "cannot malloc prompt string\n");
-		sprintf(orig_prompt, "%s> ", pc->program_name);
+	fflush(stdout);
+	fflush(stderr);
+	dup2(server_stdout, STDOUT_FILENO);
+	dup2(server_stderr, STDERR_FILENO);
+	server_busy = FALSE;
+
+	if (server_hangup || (write(pc->client_fd, "", 1) != 1))
+		server_disconnect();
+}
+
+static void
+server_sigio(int sig)
+{
+	int ret, saved_errno;
+	char c;
+
+	if (!server_busy || (pc->client_fd < 0))
+		return;
+
+	saved_errno = errno;
+	ret = recv(pc->client_fd, &c, 1, MSG_PEEK|MSG_DONTWAIT);
+	if ((ret == 0) || ((ret < 0) && (errno != EAGAIN) && 
+	    (errno != EWOULDBLOCK) && (errno != EINTR)))
+		server_hangup = TRUE;
+	else if ((ret == 1) && (c == SERVER_CANCEL))
+		ret = recv(pc->client_fd, &c, 1, MSG_DONTWAIT);
+	else {
+		errno = saved_errno;
+		return;
 	}
 
-	if (new_prompt)
-		pc->prompt = new_prompt;
-	else
-		pc->prompt = orig_prompt;
+	restart(SIGINT);
 }
 
 /*
@@ -1098,6 +2119,8 @@ restore_sanity(void)
         struct extension_table *ext;
 	struct command_table_entry *cp;
 
+	profile_command_end();
+
         if (pc->stdpipe) {
 		close(fileno(pc->stdpipe));
                 pc->stdpipe = NULL;
@@ -1125,6 +2148,8 @@ restore_sanity(void)
 			}
 		pc->pipe_pid = 0;
 	}
+	if (pc->filter)
+		close_output_filter();
 	if (pc->ifile_pipe) {
 		fflush(pc->ifile_pipe);
 		close(fileno(pc->ifile_pipe));
@@ -1174,6 +2199,8 @@ restore_sanity(void)
 	if (pc->tmpfile2)
 		close_tmpfile2();
 
+	profile_report();
+
 	if (pc->cmd_cleanup)
 		pc->cmd_cleanup(pc->cmd_cleanup_arg);
 
@@ -1263,11 +2290,16 @@ restore_ifile_sanity(void)
                 pc->ifile_pipe = NULL;
         }
 
+	if (pc->filter)
+		close_output_filter();
+
         if (pc->ifile_ofile) {
                 fclose(pc->ifile_ofile);
                 pc->ifile_ofile = NULL;
         }
 
+	profile_report();
+
         if (pc->flags & TTY) {
                 if ((fd = open("/dev/tty", O_RDONLY)) < 0) {
                         console("/dev/tty: %s\n", strerror(errno));
@@ -1441,6 +2473,11 @@ exec_input_file(void)
 	if (pc->ifile_offset)
 		fseek(pc->ifile, (long)pc->ifile_offset, SEEK_SET);
 
+	if ((pc->jobs > 1) && !(this & (RCHOME_IFILE|RCLOCAL_IFILE))) {
+		exec_input_file_jobs(incoming_fp);
+		goto done_input;
+	}
+
         while (fgets(buf, BUFSIZE-1, pc->ifile)) {
                 /*
                  *  Restore normal environment.
@@ -1457,40 +2494,8 @@ exec_input_file(void)
 		if (STRNEQ(buf, "#") || STREQ(buf, "\n"))
 			continue;
 
-                check_special_handling(buf);
-                strcpy(pc->command_line, buf);
-                clean_line(pc->command_line);
-                strcpy(pc->orig_line, pc->command_line);
-		strip_linefeeds(pc->orig_line);
-		resolve_aliases();
-
-	        switch (setup_redirect(FROM_INPUT_FILE))
-	        {
-	        case REDIRECT_NOT_DONE:
-	        case REDIRECT_TO_PIPE:
-	        case REDIRECT_TO_FILE:
-	                break;
-	
-		case REDIRECT_SHELL_ESCAPE:
-		case REDIRECT_SHELL_COMMAND:
-			continue;
-
-	        case REDIRECT_FAILURE:
-	                goto done_input;
-	        }
-
-		if (CRASHDEBUG(1))
-			console(buf);
-
-		if (!(argcnt = parse_line(pc->command_line, args)))
-			continue;
-
-                if (!(pc->flags & SILENT)) {
-                        fprintf(fp, "%s%s", pc->prompt, buf);
-                        fflush(fp);
-                }
-
-                exec_command();
+		if (!exec_input_line(buf))
+			goto done_input;
 
 		if (received_SIGINT())
 			goto done_input;
@@ -1507,6 +2512,479 @@ done_input:
 	pc->ifile_in_progress = 0;
 }
 
+/*
+ *  Execute one line read from an input file.  Returns FALSE if the
+ *  remainder of the input file should not be executed.
+ */
+static int
+exec_input_line(char *buf)
+{
+        check_special_handling(buf);
+        strcpy(pc->command_line, buf);
+        clean_line(pc->command_line);
+        strcpy(pc->orig_line, pc->command_line);
+	strip_linefeeds(pc->orig_line);
+	resolve_aliases();
+
+        switch (setup_redirect(FROM_INPUT_FILE))
+        {
+        case REDIRECT_NOT_DONE:
+        case REDIRECT_TO_PIPE:
+        case REDIRECT_TO_FILE:
+                break;
+
+	case REDIRECT_SHELL_ESCAPE:
+	case REDIRECT_SHELL_COMMAND:
+		return TRUE;
+
+        case REDIRECT_FAILURE:
+                return FALSE;
+        }
+
+	if (CRASHDEBUG(1))
+		console(buf);
+
+	if (!(argcnt = parse_line(pc->command_line, args)))
+		return TRUE;
+
+        if (!(pc->flags & SILENT)) {
+                fprintf(fp, "%s%s", pc->prompt, buf);
+                fflush(fp);
+        }
+
+        exec_command();
+
+	return TRUE;
+}
+
+/*
+ *  Parallel input file execution (--jobs).
+ *
+ *  Runs of independent input file lines are shared out among forked
+ *  worker processes, each of which inherits the fully-initialized
+ *  session.  Workers claim lines one at a time from a shared batch
+ *  descriptor, and record where each line's output starts and ends in
+ *  their private output file.  Once all workers have exited, the output
+ *  is copied out in the original line order, so the end result is the
+ *  same as that of a sequential run.
+ *
+ *  Lines that change the state seen by the lines that follow them,
+ *  or whose output is appended to files, are executed by the parent
+ *  in between batches.
+ */
+struct input_line {
+	char *line;
+	long offset;           /* input file offset of the next line */
+};
+
+struct input_batch {
+	int next;              /* next line to be claimed */
+	int count;
+	struct input_batch_line {
+		int worker;
+		off_t start;
+		off_t end;
+	} line[];
+};
+
+static pid_t input_workers[MAX_INPUT_JOBS];
+
+/*
+ *  Lines that must be run by the parent: those that change the session
+ *  state, directly or through an alias, those that assign gdb
+ *  convenience variables, and those whose output is redirected to a
+ *  file.  The redirection check follows setup_redirect(), so that a
+ *  '>' within a string, within parentheses, or in a "->" is ignored.
+ */
+static int
+input_line_is_barrier(char *line)
+{
+	static char *barriers[] = {
+		"set", "alias", "extend", "mod", "gdb", "q", "quit", "exit",
+		NULL
+	};
+	struct alias_data *ad;
+	char **b, *p, *q;
+	char expanded[BUFSIZE];
+	int i, len, expression, string;
+
+	p = first_nonspace(line);
+	if (*p == '<')
+		return TRUE;
+
+	/*
+	 *  Expand an alias as resolve_aliases() will.
+	 */
+	len = strcspn(p, " \t");
+	if (len >= BUFSIZE)
+		return TRUE;
+	strncpy(expanded, p, len);
+	expanded[len] = NULLCHAR;
+
+	if ((ad = is_alias(expanded)) && ad->argcnt) {
+		expanded[0] = NULLCHAR;
+		for (i = 0; i < ad->argcnt; i++) {
+			if ((strlen(expanded) + strlen(ad->args[i]) + 2) >= BUFSIZE)
+				return TRUE;
+			strcat(expanded, ad->args[i]);
+			strcat(expanded, " ");
+		}
+		if ((strlen(expanded) + strlen(p + len)) >= BUFSIZE)
+			return TRUE;
+		strcat(expanded, first_nonspace(p + len));
+		p = expanded;
+	}
+
+	len = strcspn(p, " \t");
+	for (b = barriers; *b; b++) {
+		if ((len == strlen(*b)) && STRNEQ(p, *b))
+			return TRUE;
+	}
+
+	line = p;
+	expression = 0;
+	string = FALSE;
+
+	for ( ; *p; p++) {
+		if (*p == '(')
+			expression++;
+		if (*p == ')')
+			expression--;
+		if ((*p == '"') || (*p == '\''))
+			string = !string;
+
+		if (!(expression || string) && (*p == '>') &&
+		    !((p > line) && (*(p-1) == '-')))
+			return TRUE;
+
+		/*
+		 *  $name = value, but not $name == value.
+		 */
+		if (!string && (*p == '$')) {
+			for (q = p+1; *q && (isalnum((unsigned char)*q) || (*q == '_')); q++)
+				;
+			q = first_nonspace(q);
+			if (((*q == '=') && (*(q+1) != '=')) ||
+			    (*q && strchr("+-*/%&|^", *q) && (*(q+1) == '=')) ||
+			    (STRNEQ(q, "<<=") || STRNEQ(q, ">>=")) ||
+			    STRNEQ(q, "++") || STRNEQ(q, "--"))
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+kill_input_workers(void *arg)
+{
+	int w;
+
+	for (w = 0; w < MAX_INPUT_JOBS; w++) {
+		if (input_workers[w] > 0)
+			kill(input_workers[w], SIGKILL);
+		input_workers[w] = 0;
+	}
+
+	pc->cmd_cleanup = NULL;
+	pc->cmd_cleanup_arg = NULL;
+}
+
+/*
+ *  A forked worker shares the open file descriptions of the parent, and
+ *  so their file offsets, with the other workers.  Since several dumpfile
+ *  backends, and gdb's reads of the debuginfo files, seek and then read,
+ *  each worker reopens every file, device or mapfile that is open for
+ *  reading, at the same offset and under the same descriptor number.
+ *  A worker that cannot do so must not run any lines.
+ */
+static int
+reopen_input_worker_files(int outfd)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat sbuf;
+	int fd, newfd, flags, fdflags, nfds, i;
+	int fds[MAX_INPUT_REOPEN];
+	off_t offset;
+	char path[PATH_MAX];
+
+	if (!(dirp = opendir("/proc/self/fd")))
+		return FALSE;
+
+	for (nfds = 0; (dp = readdir(dirp)); ) {
+		if (!decimal(dp->d_name, 0))
+			continue;
+		fd = atoi(dp->d_name);
+		if ((fd <= STDERR_FILENO) || (fd == outfd) || (fd == dirfd(dirp)))
+			continue;
+		if (nfds == MAX_INPUT_REOPEN) {
+			closedir(dirp);
+			return FALSE;
+		}
+		fds[nfds++] = fd;
+	}
+	closedir(dirp);
+
+	for (i = 0; i < nfds; i++) {
+		fd = fds[i];
+		if ((fstat(fd, &sbuf) < 0) ||
+		    !(S_ISREG(sbuf.st_mode) || S_ISCHR(sbuf.st_mode) ||
+		    S_ISBLK(sbuf.st_mode)))
+			continue;
+		if (((flags = fcntl(fd, F_GETFL)) < 0) ||
+		    ((fdflags = fcntl(fd, F_GETFD)) < 0))
+			return FALSE;
+		if ((flags & O_ACCMODE) == O_WRONLY)
+			continue;
+
+		offset = lseek(fd, 0, SEEK_CUR);
+		snprintf(path, PATH_MAX, "/proc/self/fd/%d", fd);
+		if ((newfd = open(path, flags & (O_ACCMODE|O_NONBLOCK|O_APPEND))) < 0)
+			return FALSE;
+		if (((offset >= 0) && (lseek(newfd, offset, SEEK_SET) != offset)) ||
+		    (dup2(newfd, fd) < 0)) {
+			close(newfd);
+			return FALSE;
+		}
+		close(newfd);
+		fcntl(fd, F_SETFD, fdflags);
+	}
+
+	return TRUE;
+}
+
+static void
+exec_input_worker(struct input_batch *batch, struct input_line *lines, int w)
+{
+	struct input_batch_line *bl;
+	char buf[BUFSIZE];
+	volatile int k;
+
+	pc->cmd_cleanup = NULL;
+	pc->ifile = NULL;
+
+	if (!reopen_input_worker_files(STDOUT_FILENO))
+		_exit(2);
+
+	/*
+	 *  A FATAL error only aborts the line that caused it.
+	 */
+	k = -1;
+	if (setjmp(pc->main_loop_env)) {
+		if (pc->flags & _SIGINT_)
+			_exit(1);
+		restore_sanity();
+		fflush(stdout);
+		if (k >= 0)
+			batch->line[k].end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	}
+
+	while ((k = __sync_fetch_and_add(&batch->next, 1)) < batch->count) {
+		bl = &batch->line[k];
+		bl->worker = w;
+		bl->start = bl->end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+
+		fp = stdout;
+		restore_ifile_sanity();
+        	BZERO(pc->command_line, BUFSIZE);
+        	BZERO(pc->orig_line, BUFSIZE);
+		snprintf(buf, BUFSIZE-1, "%s\n", lines[k].line);
+
+		exec_input_line(buf);
+
+		/*
+		 *  Wait for any piped-to command to finish writing.
+		 */
+		restore_sanity();
+		fflush(stdout);
+		bl->end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	}
+
+	fflush(stdout);
+	_exit(0);
+}
+
+/*
+ *  Run a batch of independent input file lines in up to pc->jobs
+ *  worker processes, and then write their output to ofp in order.
+ */
+static int
+exec_input_batch(FILE *ofp, struct input_line *lines, int count)
+{
+	struct input_batch *batch;
+	struct input_batch_line *bl;
+	FILE *out[MAX_INPUT_JOBS];
+	char buf[BUFSIZE];
+	ssize_t len, size;
+	int w, k, workers, status;
+	off_t off;
+	pid_t pid;
+
+	workers = MIN(pc->jobs, count);
+	size = sizeof(struct input_batch) + 
+		(count * sizeof(struct input_batch_line));
+	if ((batch = mmap(NULL, size, PROT_READ|PROT_WRITE, 
+	    MAP_SHARED|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		error(INFO, "--jobs: cannot mmap batch: %s\n", strerror(errno));
+		return FALSE;
+	}
+	batch->next = 0;
+	batch->count = count;
+	for (k = 0; k < count; k++)
+		batch->line[k].worker = -1;
+
+	fflush(ofp);
+	fflush(stdout);
+	fflush(stderr);
+
+	pc->cmd_cleanup = kill_input_workers;
+	pc->cmd_cleanup_arg = NULL;
+
+	for (w = 0; w < workers; w++) {
+		if (!(out[w] = tmpfile())) {
+			error(INFO, "--jobs: cannot create output file: %s\n",
+				strerror(errno));
+			break;
+		}
+		if ((pid = fork()) < 0) {
+			error(INFO, "--jobs: fork: %s\n", strerror(errno));
+			fclose(out[w]);
+			break;
+		}
+		if (pid == 0) {
+			dup2(fileno(out[w]), STDOUT_FILENO);
+			exec_input_worker(batch, lines, w);
+		}
+		input_workers[w] = pid;
+	}
+	workers = w;
+
+	for (w = 0; w < workers; w++) {
+		while ((waitpid(input_workers[w], &status, 0) < 0) && 
+		    (errno == EINTR))
+			;
+		input_workers[w] = 0;
+	}
+	pc->cmd_cleanup = NULL;
+
+	for (k = 0; k < count; k++) {
+		bl = &batch->line[k];
+		if (bl->worker < 0) {
+			/*
+			 *  No worker could claim it, so run it here.
+			 */
+			fp = ofp;
+			restore_ifile_sanity();
+			BZERO(pc->command_line, BUFSIZE);
+			BZERO(pc->orig_line, BUFSIZE);
+			snprintf(buf, BUFSIZE-1, "%s\n", lines[k].line);
+			exec_input_line(buf);
+			fflush(ofp);
+			continue;
+		}
+		for (off = bl->start; off < bl->end; off += len) {
+			len = MIN(sizeof(buf), bl->end - off);
+			if ((len = pread(fileno(out[bl->worker]), buf, 
+			    len, off)) <= 0)
+				break;
+			fwrite(buf, 1, len, ofp);
+		}
+	}
+	fflush(ofp);
+
+	for (w = 0; w < workers; w++)
+		fclose(out[w]);
+	munmap(batch, size);
+
+	return (workers > 0);
+}
+
+/*
+ *  Read the remainder of the input file, and execute it in batches
+ *  separated by the lines that must be run by this process.
+ */
+static void
+exec_input_file_jobs(FILE *incoming_fp)
+{
+	struct input_line *lines;
+	struct stat sbuf;
+	char buf[BUFSIZE];
+	char *text, *p, *nl;
+	long start, size;
+	int i, j, k, count;
+
+	start = ftell(pc->ifile);
+	if (fstat(fileno(pc->ifile), &sbuf) < 0)
+		error(FATAL, "%s\n", strerror(errno));
+	size = MAX(sbuf.st_size - start, 0);
+
+	/*
+	 *  Each command's restore_sanity() calls free_all_bufs(), so the
+	 *  input text must outlive the GETBUF() arena.
+	 */
+	if (!(text = malloc(size+1)))
+		error(FATAL, "cannot malloc input file buffer\n");
+	size = fread(text, 1, size, pc->ifile);
+	text[size] = NULLCHAR;
+
+	for (p = text, count = 1; (p = strchr(p, '\n')); p++)
+		count++;
+	if (!(lines = (struct input_line *)
+	    malloc(sizeof(struct input_line) * count))) {
+		free(text);
+		error(FATAL, "cannot malloc input line table\n");
+	}
+
+	for (p = text, count = 0; p < (text + size); p = nl + 1) {
+		if (!(nl = strchr(p, '\n')))
+			nl = text + size;
+		*nl = NULLCHAR;
+		if ((*p == '#') || (*p == NULLCHAR))
+			continue;
+		lines[count].line = p;
+		lines[count].offset = start + (nl + 1 - text);
+		count++;
+	}
+
+	for (i = 0; i < count; i = j) {
+		for (j = i; j < count; j++) {
+			if (input_line_is_barrier(lines[j].line))
+				break;
+		}
+
+		if ((j - i) > 1) {
+			pc->ifile_offset = lines[j-1].offset;
+			if (exec_input_batch(incoming_fp, &lines[i], j - i)) {
+				if (received_SIGINT())
+					goto out;
+				continue;
+			}
+		}
+
+		/*
+		 *  Barrier lines, single lines, or a batch that could
+		 *  not be handed to any worker.
+		 */
+		if (j == i)
+			j++;
+
+		for (k = i; k < j; k++) {
+			fp = incoming_fp;
+			restore_ifile_sanity();
+			BZERO(pc->command_line, BUFSIZE);
+			BZERO(pc->orig_line, BUFSIZE);
+			pc->ifile_offset = lines[k].offset;
+			snprintf(buf, BUFSIZE-1, "%s\n", lines[k].line);
+			if (!exec_input_line(buf) || received_SIGINT())
+				goto out;
+		}
+	}
+out:
+	free(lines);
+	free(text);
+}
+
 /*
  *  Prime the alias list with a few built-in's.
  */
@@ -47,6 +47,7 @@
 #include <sys/param.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <execinfo.h> /* backtrace() */
 #include <regex.h>
 #ifdef LZO
@@ -415,10 +416,14 @@ struct number_option {
 #define REDIRECT_SHELL_COMMAND (0x100)
 #define REDIRECT_PID_KNOWN     (0x200)
 #define REDIRECT_MULTI_PIPE    (0x400)
+#define REDIRECT_TO_FILTER     (0x800)
 
 #define PIPE_OPTIONS (FROM_COMMAND_LINE | FROM_INPUT_FILE | REDIRECT_TO_PIPE | \
                       REDIRECT_TO_STDPIPE | REDIRECT_TO_FILE)
 
+#define MAX_INPUT_JOBS (64)      /* --jobs limit */
+#define MAX_INPUT_REOPEN (1024)  /* files reopened by each --jobs worker */
+
 #define DEFAULT_REDHAT_DEBUG_LOCATION  "/usr/lib/debug/lib/modules"
 
 #define MEMORY_DRIVER_MODULE        "crash"
@@ -570,6 +575,9 @@ struct program_context {
 #define MEMSRC_LOCAL         (0x80000ULL)
 #define REDZONE             (0x100000ULL)
 #define VMWARE_VMSS_GUESTDUMP (0x200000ULL)
+#define SERVER_MODE          (0x400000ULL)
+#define MEMTRACE             (0x800000ULL)
+#define MEMTRACING()  (pc->flags2 & MEMTRACE)
 	char *cleanup;
 	char *namelist_orig;
 	char *namelist_debug_orig;
@@ -581,6 +589,12 @@ struct program_context {
 	char *(*read_vmcoreinfo)(const char *);
 	FILE *error_fp;			/* error() message direction */
 	char *error_path;		/* stderr path information */
+	FILE *filter;			/* in-process output filter stream */
+	char *server_socket;		/* --server UNIX socket path */
+	int server_fd;			/* listening server socket */
+	int client_fd;			/* current server client */
+	int jobs;			/* --jobs input file workers */
+	char *memtrace;			/* "set memtrace" trace file */
 };
 
 #define READMEM  pc->readmem
@@ -796,6 +810,22 @@ struct kernel_table {                   /* kernel data */
 	ulonglong flags2;
 	char *source_tree;
 	struct timespec boot_date;
+	struct xen_m2p_map {
+		ulong flags;
+#define M2P_MAP_INIT      (0x1)
+#define M2P_MAP_BUILDING  (0x2)
+#define M2P_MAP_VALID     (0x4)
+		ulong runs;
+		ulong size;
+		ulong pages;
+		ulong lookups;
+		struct xen_m2p_run {
+			ulong mfn;
+			ulong pfn;
+			ulong count;
+			ulong reach;	/* highest mfn+count up to this run */
+		} *run;
+	} m2p_map;
 };
 
 /*
@@ -1011,6 +1041,23 @@ struct vaddr_range {
 #define MAX_KVADDR_RANGES KVADDR_MODULES
 };
 
+/*
+ *  Leaf mapping handed to the machdep->walk_range() callback.  Present
+ *  mappings carry the physical address of vaddr and the number of bytes
+ *  that remain mapped contiguously from it (a 4K page, or the remainder of
+ *  a 2MB/1GB huge page); non-present, non-zero PTEs are passed with the
+ *  raw PTE in paddr, just as uvtop() returns them.
+ */
+struct walk_range_entry {
+	ulong vaddr;
+	ulong size;
+	physaddr_t paddr;
+	ulong flags;
+#define WALK_RANGE_PRESENT (0x1)
+};
+
+typedef int (*walk_range_func)(struct walk_range_entry *, void *);
+
 #define MAX_MACHDEP_ARGS 5  /* for --machdep/-m machine-specific args */
 
 struct machdep_table {
@@ -1083,6 +1130,7 @@ struct machdep_table {
 	int (*is_page_ptr)(ulong, physaddr_t *);
 	int (*get_cpu_reg)(int, int, const char *, int, void *);
 	int (*is_cpu_prstatus_valid)(int cpu);
+	int (*walk_range)(struct task_context *, ulong, ulong, walk_range_func, void *);
 };
 
 /*
@@ -2659,6 +2707,25 @@ struct vm_table {                /* kernel VM-related data */
 		char *name;
 	} *pageflags_data;
 	ulong max_mem_section_nr;
+	struct mem_section_info {       /* sections 0 to max_mem_section_nr */
+		ulong mem_map;          /* decoded */
+		ulong flags;            /* section_mem_map flag bits */
+	} *mem_section_info;
+	struct mem_map_range {          /* PRESENT sections' mem_maps, merged */
+		ulong start;
+		ulong end;
+		ulong pfn;
+	} *mem_map_ranges;
+	long nr_mem_map_ranges;
+	ulong mem_section_info_gen;     /* command generation of a live table */
+	struct vmalloc_area {           /* vmap_area_list or vmlist, sorted */
+		ulong vmap_area;        /* 0 with vmlist */
+		ulong vm_struct;
+		ulong start;
+		ulong end;
+	} *vmalloc_areas;
+	long nr_vmalloc_areas;
+	ulong vmalloc_areas_gen;        /* command generation of a live table */
 	ulong zero_paddr;
 	ulong huge_zero_paddr;
 };
@@ -2757,6 +2824,8 @@ struct tree_data {
 	char **structname;
 	int structname_args;
 	int count;
+	int (*callback_func)(void *, void *);
+	void *callback_data;
 };
 
 #define TREE_ROOT_OFFSET_ENTERED  (VERBOSE << 1)
@@ -2769,6 +2838,9 @@ struct tree_data {
 #define TREE_READ_MEMBER          (VERBOSE << 8)
 #define TREE_LINEAR_ORDER         (VERBOSE << 9)
 #define TREE_STRUCT_VERBOSE       (VERBOSE << 10)
+#define TREE_CALLBACK             (VERBOSE << 11)
+#define TREE_CALLBACK_RETURN      (VERBOSE << 12)
+#define TREE_CALLBACK_STOPPED     (VERBOSE << 13)
 
 #define ALIAS_RUNTIME  (1)
 #define ALIAS_RCLOCAL  (2)
@@ -5327,6 +5399,71 @@ struct task_mem_usage {
 	ulong pgd_addr;
 };
 
+/*
+ *  Per-command profiling ("set profile").  The counters are cumulative;
+ *  each command's report is the difference between their values at
+ *  profile_command_start() and profile_command_end().
+ */
+#define PROFILE_MEMTYPES      (5)   /* KVADDR through FILEADDR */
+#define PROFILE_ZLIB          (0)
+#define PROFILE_LZO           (1)
+#define PROFILE_SNAPPY        (2)
+#define PROFILE_ZSTD          (3)
+#define PROFILE_COMPRESSIONS  (4)
+#define PROFILE_GDB_REQUESTS  (GNU_LOOKUP_STRUCT_CONTENTS+1)  /* 0: other */
+
+struct profile_counters {
+	long readmem_calls[PROFILE_MEMTYPES];
+	long long readmem_bytes[PROFILE_MEMTYPES];
+	long page_reads;
+	long cache_hits;
+	long cache_misses;
+	long kvtop;
+	long decompressed[PROFILE_COMPRESSIONS];
+	long long decompress_nsecs[PROFILE_COMPRESSIONS];
+	long gdb_requests[PROFILE_GDB_REQUESTS];
+	long long gdb_nsecs;
+};
+
+struct profile_data {
+	ulong flags;
+	char *path;
+	FILE *ofp;
+	struct profile_counters count;
+	struct profile_counters start;
+	struct profile_counters delta;
+	struct timespec start_time;
+	struct rusage start_rusage;
+	long long wall_usecs;
+	long long user_usecs;
+	long long sys_usecs;
+	long getbuf_peak;
+	char command[BUFSIZE];
+};
+
+#define PROFILE_ON       (0x1)
+#define PROFILE_FILE     (0x2)
+#define PROFILE_ACTIVE   (0x4)
+#define PROFILE_PENDING  (0x8)
+
+#define PROFILING()       (prof->flags & PROFILE_ACTIVE)
+#define PROFILE_COUNT(X)  { if (PROFILING()) prof->count.X++; }
+
+/*
+ *  readmem() trace records ("set memtrace"), described in memory.c.
+ */
+#define MEMTRACE_MAGIC    "CRSHMTRC"
+#define MEMTRACE_VERSION  (1)
+#define MEMTRACE_STRING   ('S')
+#define MEMTRACE_COMMAND  ('C')
+#define MEMTRACE_PAGE     ('P')
+#define MEMTRACE_READMEM  ('R')
+
+struct memtrace_page {
+	physaddr_t paddr;
+	long cnt;
+};
+
 /*
  *  Global data (global_data.c) 
  */
@@ -5345,6 +5482,7 @@ extern struct vm_table vm_table, *vt;
 extern struct machdep_table *machdep;
 extern struct symbol_table_data symbol_table_data, *st;
 extern struct extension_table *extension_table;
+extern struct profile_data profile_data, *prof;
 
 /*
  *  Generated in build_data.c
@@ -5363,6 +5501,8 @@ void cmd_quit(void);         /* main.c */
 void cmd_mach(void);         /* main.c */
 void cmd_help(void);         /* help.c */
 void cmd_test(void);         /* test.c */
+void cmd_bench(void);        /* bench.c */
+void cmd_export(void);       /* export.c */
 void cmd_ascii(void);        /* tools.c */
 void cmd_sbitmapq(void);     /* sbitmap.c */
 void cmd_bpf(void);          /* bfp.c */
@@ -5487,6 +5627,8 @@ struct alias_data *is_alias(char *);
 void deallocate_alias(char *);
 void cmdline_init(void);
 void set_command_prompt(char *);
+void set_server_socket(char *);
+void server_init(void);
 void exec_input_file(void);
 void process_command_line(void);
 void dump_history(void);
@@ -5611,10 +5753,18 @@ void buf_init(void);
 void sym_buf_init(void);
 void free_all_bufs(void);
 char *getbuf(long);
+char *getbuf_nozero(long);
+void profile_readmem(int, long);
+void profile_decompress(int, struct timespec *);
+void profile_gdb_request(int, struct timespec *);
+void profile_command_start(void);
+void profile_command_end(void);
+void profile_report(void);
 void freebuf(char *);
 char *resizebuf(char *, long, long);
 char *strdupbuf(char *);
 #define GETBUF(X)   getbuf((long)(X))
+#define GETBUF_NOZERO(X) getbuf_nozero((long)(X))
 #define FREEBUF(X)  freebuf((char *)(X))
 #define RESIZEBUF(X,Y,Z) (X) = (typeof(X))resizebuf((char *)(X), (long)(Y), (long)(Z));
 #define STRDUPBUF(X) strdupbuf((char *)(X))
@@ -5706,6 +5856,7 @@ void set_temporary_radix(unsigned int, unsigned int *);
 void restore_current_radix(unsigned int);
 void dump_struct(char *, ulong, unsigned);
 void dump_struct_member(char *, ulong, unsigned);
+void dump_struct_member_list(char *, char **, int, ulong, unsigned);
 void dump_union(char *, ulong, unsigned);
 void store_module_symbols_v1(ulong, int);
 void store_module_symbols_v2(ulong, int);
@@ -5735,6 +5886,8 @@ int is_module_address(ulong, char *);
 ulong lowest_module_address(void);
 ulong highest_module_address(void);
 int load_module_symbols(char *, char *, ulong);
+void start_module_symbol_workers(char **, int);
+void finish_module_symbol_workers(void);
 void delete_load_module(ulong);
 ulong gdb_load_module_callback(ulong, char *);
 char *load_module_filter(char *, int);
@@ -5777,6 +5930,17 @@ struct syment *symbol_complete_match(const char *, struct syment *);
 void mem_init(void);
 void vm_init(void);
 int readmem(ulonglong, int, void *, long, char *, ulong);
+void prefetch_readmem(ulonglong, int, long);
+int memtrace_open(char *);
+void memtrace_close(void);
+void memtrace_command(char *);
+void memtrace_page(physaddr_t, long);
+void memtrace_readmem(ulonglong, int, long, char *, ulonglong, int);
+long memtrace_load_pages(char *, struct memtrace_page **);
+void prefetch_physaddr(physaddr_t *, int);
+void prefetch_willneed(int, off_t, off_t);
+#define PREFETCH_BATCH      (256)
+#define PREFETCH_MAX_PAGES  (4096)
 int writemem(ulonglong, int, void *, long, char *, ulong);
 int generic_verify_paddr(uint64_t);
 int read_dev_mem(int, void *, int, ulong, physaddr_t);
@@ -5791,6 +5955,7 @@ int write_lkcd_dumpfile(int, void *, int, ulong, physaddr_t);
 int write_daemon(int, void *, int, ulong, physaddr_t);
 int kvtop(struct task_context *, ulong, physaddr_t *, int);
 int uvtop(struct task_context *, ulong, physaddr_t *, int);
+int walk_range(struct task_context *, ulong, ulong, walk_range_func, void *);
 void do_vtop(ulong, struct task_context *, ulong);
 void raw_stack_dump(ulong, ulong);
 void raw_data_dump(ulong, long, int);
@@ -5801,6 +5966,7 @@ char *fill_vma_cache(ulong);
 void clear_vma_cache(void);
 void dump_vma_cache(ulong);
 int generic_is_page_ptr(ulong, physaddr_t *);
+int generic_walk_range(struct task_context *, ulong, ulong, walk_range_func, void *);
 int is_page_ptr(ulong, physaddr_t *);
 void dump_vm_table(int);
 int read_string(ulong, char *, int);
@@ -5971,12 +6137,14 @@ extern char *help_pointer[];
 extern char *help_alias[];
 extern char *help_ascii[];
 extern char *help_bpf[];
+extern char *help_bench[];
 extern char *help_bt[];
 extern char *help_btop[];
 extern char *help_dev[];
 extern char *help_dis[];
 extern char *help_eval[];
 extern char *help_exit[];
+extern char *help_export[];
 extern char *help_extend[];
 extern char *help_files[];
 extern char *help_foreach[];
@@ -7301,6 +7469,7 @@ struct machine_specific {
 int is_netdump(char *, ulong);
 uint netdump_page_size(void);
 int read_netdump(int, void *, int, ulong, physaddr_t);
+void netdump_prefetch(physaddr_t *, int);
 int write_netdump(int, void *, int, ulong, physaddr_t);
 int netdump_free_memory(void);
 int netdump_memory_used(void);
@@ -7377,6 +7546,8 @@ int is_ramdump_image(void);
 int is_diskdump(char *);
 uint diskdump_page_size(void);
 int read_diskdump(int, void *, int, ulong, physaddr_t);
+void diskdump_prefetch(physaddr_t *, int);
+int diskdump_bench_page(ulong, int);
 int write_diskdump(int, void *, int, ulong, physaddr_t);
 int diskdump_free_memory(void);
 int diskdump_memory_used(void);
@@ -7453,6 +7624,7 @@ struct zspage_5_17 {
 void check_flattened_format(char *file);
 int is_flattened_format(char *file);
 int read_flattened_format(int fd, off_t offset, void *buf, size_t size);
+void set_flat_rearrange_file(char *);
 void dump_flat_header(FILE *);
 
 /*
@@ -7491,6 +7663,7 @@ int kvmdump_phys_base(unsigned long *);
 void kvmdump_display_regs(int, FILE *);
 void set_kvmhost_type(char *);
 void set_kvm_iohole(char *);
+void set_kvm_cache_size(char *);
 struct kvm_register_set {
 	union {
 		uint32_t cs;
@@ -7512,6 +7685,7 @@ int get_kvm_register_set(int, struct kvm_register_set *);
 int is_sadump(char *);
 uint sadump_page_size(void);
 int read_sadump(int, void *, int, ulong, physaddr_t);
+void sadump_prefetch(physaddr_t *, int);
 int write_sadump(int, void *, int, ulong, physaddr_t);
 int sadump_init(char *, FILE *);
 int sadump_is_diskset(void);
@@ -7625,6 +7799,34 @@ void dump_lockless_record_log(int);
 void cmd_template(void);
 void foreach_test(ulong, ulong);
 
+/*
+ *  export.c
+ */
+struct export_field {
+	char *name;
+	int type;
+};
+
+#define EXPORT_ADDR     (1)
+#define EXPORT_INT      (2)
+#define EXPORT_UINT     (3)
+#define EXPORT_STRING   (4)
+
+int export_active(void);
+void export_schema(char *, struct export_field *, int);
+void export_addr(ulong);
+void export_int(long);
+void export_uint(ulong);
+void export_string(char *, long);
+void export_null(void);
+void export_record(void);
+struct req_entry;
+struct req_entry *fill_member_offsets(char *);                      /* tools.c */
+int export_struct_fields(struct req_entry *, struct export_field *); /* tools.c */
+void export_struct_members(struct req_entry *, ulong);               /* tools.c */
+void export_slab_objects(char *);                                    /* memory.c */
+void export_mem_map(void);                                           /* memory.c */
+
 /*
  *  va_server.c
  */
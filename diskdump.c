@@ -97,6 +97,21 @@ static struct diskdump_data **dd_list = NULL;
 static int num_dd = 0;
 static int num_dumpfiles = 0;
 
+/* Split dumpfiles sorted by start_pfn, built on first use */
+struct split_pfn_range {
+	unsigned long long start_pfn;
+	unsigned long long end_pfn;
+	struct diskdump_data *ddp;
+};
+static struct split_pfn_range *split_table = NULL;
+static int split_entries = 0;
+
+static struct diskdump_data *split_pfn_to_dd(ulong);
+static int compare_split_pfn_range(const void *, const void *);
+
+static struct swap_device_cache *swap_device_cache(ulonglong);
+static char *zram_page_cache_lookup(ulong, ulonglong, int *);
+
 int dumpfile_is_split(void)
 {
 	return KDUMP_SPLIT();
@@ -262,6 +277,10 @@ add_diskdump_data(char* name)
 	dd->flags |= DUMPFILE_SPLIT;
 	dd->filename = name;
 
+	free(split_table);
+	split_table = NULL;
+	split_entries = 0;
+
 	if (CRASHDEBUG(1))
 		fprintf(fp, "%s: start_pfn=%llu, end_pfn=%llu\n", name,
 			dd->sub_header_kdump->start_pfn_64,
@@ -283,6 +302,71 @@ clean_diskdump_data(void)
 	dd_list = NULL;
 	num_dumpfiles = 0;
 	dd = &diskdump_data;
+
+	free(split_table);
+	split_table = NULL;
+	split_entries = 0;
+}
+
+static int
+compare_split_pfn_range(const void *v1, const void *v2)
+{
+	struct split_pfn_range *r1, *r2;
+
+	r1 = (struct split_pfn_range *)v1;
+	r2 = (struct split_pfn_range *)v2;
+
+	return (r1->start_pfn < r2->start_pfn ? -1 :
+		r1->start_pfn == r2->start_pfn ? 0 : 1);
+}
+
+/*
+ *  Find the split dumpfile containing a pfn, checking the current one
+ *  first, and then binary-searching the dumpfiles by start_pfn.
+ */
+static struct diskdump_data *
+split_pfn_to_dd(ulong pfn)
+{
+	struct split_pfn_range *r;
+	int i, lo, hi, mid;
+
+	if ((pfn >= dd->sub_header_kdump->start_pfn_64) &&
+	    (pfn < dd->sub_header_kdump->end_pfn_64))
+		return dd;
+
+	if (!split_table) {
+		if (!(split_table = malloc(num_dumpfiles * 
+		    sizeof(struct split_pfn_range))))
+			error(FATAL, "cannot malloc split dumpfile table\n");
+		for (i = 0; i < num_dumpfiles; i++) {
+			split_table[i].start_pfn = 
+				dd_list[i]->sub_header_kdump->start_pfn_64;
+			split_table[i].end_pfn = 
+				dd_list[i]->sub_header_kdump->end_pfn_64;
+			split_table[i].ddp = dd_list[i];
+		}
+		split_entries = num_dumpfiles;
+		qsort(split_table, split_entries, 
+			sizeof(struct split_pfn_range), compare_split_pfn_range);
+	}
+
+	/* the last dumpfile starting at or below the pfn */
+	lo = 0;
+	hi = split_entries - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (split_table[mid].start_pfn <= pfn)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	if (hi < 0)
+		return NULL;
+
+	r = &split_table[hi];
+
+	return (pfn < r->end_pfn) ? r->ddp : NULL;
 }
 
 static inline int 
@@ -1143,9 +1227,11 @@ page_is_cached(physaddr_t paddr)
 			pgc->pg_hit_count++;
 			dd->curbufptr = pgc->pg_bufptr;
 			dd->cached_reads++;
+			PROFILE_COUNT(cache_hits);
 			return TRUE;
 		}
 	}
+	PROFILE_COUNT(cache_misses);
 	return FALSE;
 }
 
@@ -1191,6 +1277,7 @@ cache_page(physaddr_t paddr)
 	page_desc_t pd;
 	const int block_size = dd->block_size;
 	ulong retlen;
+	struct timespec start;
 #ifdef ZSTD
 	static ZSTD_DCtx *dctx = NULL;
 #endif
@@ -1268,6 +1355,9 @@ cache_page(physaddr_t paddr)
 		}
 	}
 
+	if (PROFILING())
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
 	if (pd.flags & DUMP_DH_COMPRESSED_ZLIB) {
 		retlen = block_size;
 		ret = uncompress((unsigned char *)dd->page_cache_hdr[i].pg_bufptr,
@@ -1361,12 +1451,111 @@ cache_page(physaddr_t paddr)
 		memcpy(dd->page_cache_hdr[i].pg_bufptr,
 		       dd->compressed_page, block_size);
 
+	if (PROFILING()) {
+		if (pd.flags & DUMP_DH_COMPRESSED_ZLIB)
+			profile_decompress(PROFILE_ZLIB, &start);
+		else if (pd.flags & DUMP_DH_COMPRESSED_LZO)
+			profile_decompress(PROFILE_LZO, &start);
+		else if (pd.flags & DUMP_DH_COMPRESSED_SNAPPY)
+			profile_decompress(PROFILE_SNAPPY, &start);
+		else if (pd.flags & DUMP_DH_COMPRESSED_ZSTD)
+			profile_decompress(PROFILE_ZSTD, &start);
+	}
+
 	dd->page_cache_hdr[i].pg_flags |= PAGE_VALID;
 	dd->curbufptr = dd->page_cache_hdr[i].pg_bufptr;
 
 	return TRUE;
 }
 
+/*
+ *  Support for the "bench" command, which times pfn_to_pos() and
+ *  cache_page() in isolation.  Returns FALSE if the pfn is not in
+ *  the dumpfile.
+ */
+int
+diskdump_bench_page(ulong pfn, int cache)
+{
+	struct diskdump_data *ddp;
+	physaddr_t paddr;
+
+	if (KDUMP_SPLIT()) {
+		if (!(ddp = split_pfn_to_dd(pfn)))
+			return FALSE;
+		dd = ddp;
+	}
+
+	if ((pfn >= dd->max_mapnr) || !page_is_dumpable(pfn))
+		return FALSE;
+
+	if (!cache)
+		return (pfn_to_pos(pfn) > 0);
+
+#ifdef ARM
+	paddr = ((physaddr_t)pfn << dd->block_shift) + 
+		machdep->machspec->phys_base;
+#else
+	paddr = (physaddr_t)pfn << dd->block_shift;
+#endif
+	return (cache_page(paddr) == TRUE);
+}
+
+/*
+ *  Advise the kernel of the dumpfile ranges backing a set of pages.  
+ *  The page descriptors are advised and then read first, since they 
+ *  are needed to locate the (compressed) page data.
+ */
+void
+diskdump_prefetch(physaddr_t *paddrs, int count)
+{
+	struct {
+		struct diskdump_data *ddp;
+		off_t offset;
+	} pds[PREFETCH_BATCH];
+	struct diskdump_data *dd_save, *ddp;
+	page_desc_t pd;
+	ulong pfn;
+	int i, n;
+
+	if (XEN_CORE_DUMPFILE())
+		return;
+
+	/*
+	 *  The pages of a split dumpfile are routed to their own pieces,
+	 *  whose reads the kernel then services concurrently.
+	 */
+	dd_save = dd;
+
+	for (i = n = 0; (i < count) && (n < PREFETCH_BATCH); i++) {
+		pfn = paddr_to_pfn(paddrs[i]);
+		if (KDUMP_SPLIT()) {
+			if (!(ddp = split_pfn_to_dd(pfn)))
+				continue;
+			dd = ddp;
+		}
+		if ((pfn >= dd->max_mapnr) || !page_is_ram(pfn) ||
+		    !page_is_dumpable(pfn))
+			continue;
+		pds[n].ddp = dd;
+		pds[n].offset = dd->data_offset
+			+ (off_t)(pfn_to_pos(pfn) - 1)*sizeof(page_desc_t);
+		prefetch_willneed(dd->dfd, pds[n].offset, sizeof(page_desc_t));
+		n++;
+	}
+
+	prefetch_willneed(-1, 0, 0);
+
+	for (i = 0; i < n; i++) {
+		ddp = pds[i].ddp;
+		if (read_pd(ddp->dfd, pds[i].offset, &pd) || 
+		    (pd.offset <= 0) || (pd.size > ddp->block_size))
+			continue;
+		prefetch_willneed(ddp->dfd, pd.offset, pd.size);
+	}
+
+	dd = dd_save;
+}
+
 /*
  *  Read from a diskdump-created dumpfile.
  */
@@ -1394,20 +1583,11 @@ read_diskdump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 
 	if (KDUMP_SPLIT()) {
 		/* Find proper dd */
-		int i;
-		unsigned long long start_pfn;
-		unsigned long long end_pfn;
-
-		for (i=0; i<num_dumpfiles; i++) {
-			start_pfn = dd_list[i]->sub_header_kdump->start_pfn_64;
-			end_pfn = dd_list[i]->sub_header_kdump->end_pfn_64;
-			if ((pfn >= start_pfn) && (pfn < end_pfn))	{
-				dd = dd_list[i];
-				break;
-			}
-		}
+		struct diskdump_data *ddp;
 
-		if (i == num_dumpfiles) {
+		if ((ddp = split_pfn_to_dd(pfn)))
+			dd = ddp;
+		else {
 			if (CRASHDEBUG(8))
 				fprintf(fp, "read_diskdump: SEEK_ERROR: "
 				    "paddr/pfn %llx/%lx beyond last dumpfile\n",
@@ -2251,13 +2431,18 @@ diskdump_memory_dump(FILE *fp)
 {
 	int i;
 
-	if (KDUMP_SPLIT() && (dd_list != NULL))
+	if (KDUMP_SPLIT() && (dd_list != NULL)) {
 		for (i = 0; i < num_dumpfiles; i++) {
 			dd = dd_list[i];
 			__diskdump_memory_dump(fp);
 			fprintf(fp, "\n");
 		}
-	else
+		fprintf(fp, "split_table: %lx\n", (ulong)split_table);
+		for (i = 0; i < split_entries; i++)
+			fprintf(fp, "  [%d] start_pfn: %llx end_pfn: %llx %s\n", i,
+				split_table[i].start_pfn, split_table[i].end_pfn,
+				split_table[i].ddp->filename);
+	} else
 		__diskdump_memory_dump(fp);
 
 	return 0;
@@ -2949,14 +3134,114 @@ lookup_swap_cache(ulonglong pte_val, unsigned char *zram_buf)
 	return NULL;
 }
 
+/*
+ *  The swap device data that readswap() and try_zram_decompress() need
+ *  is looked up once per swap type, and the most recently decompressed
+ *  zram pages are kept, keyed by swap entry, so that reading a swapped-out
+ *  page a word at a time does not decompress it again for every word.
+ *  Both are discarded by each command on a live system.
+ */
+#define SWAP_DEVICES_CACHED  (32)
+#define ZRAM_PAGE_CACHE      (64)
+
+static struct swap_device_cache {
+	ulong gen;
+	int valid;
+	char name[32];
+	ulong private_data;     /* struct zram for zram devices */
+	ulong table;            /* zram->table */
+	ulong mem_pool;         /* zram->mem_pool */
+	char compressor[4][32]; /* by ZRAM_COMP_PRIORITY */
+} swap_devices[SWAP_DEVICES_CACHED];
+
+static struct zram_page_cache {
+	ulong gen;
+	int next;
+	char *buf;
+	struct zram_page {
+		int valid;
+		ulong swp_type;
+		ulonglong swp_offset;
+	} pages[ZRAM_PAGE_CACHE];
+} zram_page_cache = { 0 };
+
+static struct swap_device_cache *
+swap_device_cache(ulonglong pte_val)
+{
+	struct swap_device_cache *sd;
+	ulong type;
+
+	if ((type = __swp_type(pte_val)) >= SWAP_DEVICES_CACHED)
+		return NULL;
+
+	sd = &swap_devices[type];
+	if (ACTIVE() && (sd->gen != pc->cmdgencur))
+		BZERO(sd, sizeof(struct swap_device_cache));
+	sd->gen = pc->cmdgencur;
+
+	return sd;
+}
+
+/*
+ *  Return the zram page cache buffer of a swap entry, or if it is not
+ *  cached, claim the next slot for it and return NULL.  The claimed
+ *  slot becomes valid once the caller has filled it.
+ */
+static char *
+zram_page_cache_lookup(ulong swp_type, ulonglong swp_offset, int *slot)
+{
+	struct zram_page_cache *zc = &zram_page_cache;
+	struct zram_page *zp;
+	int i;
+
+	if (!zc->buf && !(zc->buf = malloc(ZRAM_PAGE_CACHE * PAGESIZE()))) {
+		*slot = -1;
+		return NULL;
+	}
+
+	if (ACTIVE() && (zc->gen != pc->cmdgencur)) {
+		for (i = 0; i < ZRAM_PAGE_CACHE; i++)
+			zc->pages[i].valid = FALSE;
+		zc->gen = pc->cmdgencur;
+	}
+
+	for (i = 0; i < ZRAM_PAGE_CACHE; i++) {
+		zp = &zc->pages[i];
+		if (zp->valid && (zp->swp_type == swp_type) &&
+		    (zp->swp_offset == swp_offset)) {
+			return zc->buf + (i * PAGESIZE());
+		}
+	}
+
+	*slot = zc->next;
+	zc->next = (zc->next + 1) % ZRAM_PAGE_CACHE;
+	zp = &zc->pages[*slot];
+	zp->valid = FALSE;
+	zp->swp_type = swp_type;
+	zp->swp_offset = swp_offset;
+
+	return NULL;
+}
+
 static int get_disk_name_private_data(ulonglong pte_val, ulonglong vaddr,
 				       char *name, ulong *private_data)
 {
 	ulong swap_info, bdev, bd_disk;
+	struct swap_device_cache *sd;
 
 	if (!symbol_exists("swap_info"))
 		return FALSE;
 
+	if ((sd = swap_device_cache(pte_val)) && sd->valid) {
+		if (name) {
+			memcpy(name, sd->name, strlen("zram"));
+			name[strlen("zram")] = NULLCHAR;
+		}
+		if (private_data)
+			*private_data = sd->private_data;
+		return TRUE;
+	}
+
 	swap_info = symbol_value("swap_info");
 
 	swap_info_init();
@@ -2972,6 +3257,23 @@ static int get_disk_name_private_data(ulonglong pte_val, ulonglong vaddr,
 			sizeof(void *), "swap_info_struct_bdev", FAULT_ON_ERROR);
 	readmem(bdev + OFFSET(block_device_bd_disk), KVADDR, &bd_disk,
 			sizeof(void *), "block_device_bd_disk", FAULT_ON_ERROR);
+
+	if (sd) {
+		readmem(bd_disk + OFFSET(gendisk_disk_name), KVADDR, sd->name,
+			strlen("zram"), "gendisk_disk_name", FAULT_ON_ERROR);
+		readmem(bd_disk + OFFSET(gendisk_private_data), KVADDR,
+			&sd->private_data, sizeof(void *),
+			"gendisk_private_data", FAULT_ON_ERROR);
+		sd->valid = TRUE;
+		if (name) {
+			memcpy(name, sd->name, strlen("zram"));
+			name[strlen("zram")] = NULLCHAR;
+		}
+		if (private_data)
+			*private_data = sd->private_data;
+		return TRUE;
+	}
+
 	if (name)
 		readmem(bd_disk + OFFSET(gendisk_disk_name), KVADDR, name,
 			strlen("zram"), "gendisk_disk_name", FAULT_ON_ERROR);
@@ -3012,9 +3314,12 @@ try_zram_decompress(ulonglong pte_val, unsigned char *buf, ulong len, ulonglong
 	ulonglong swp_offset;
 	unsigned char *obj_addr = NULL;
 	unsigned char *zram_buf = NULL;
-	unsigned char *outbuf = NULL;
+	unsigned char *page;
+	struct swap_device_cache *sd;
 	ulong zram, zram_table_entry, sector, index, entry, flags, size,
-		outsize, off;
+		outsize, off, mem_pool;
+	uint32_t prio;
+	int slot;
 
 	if (INVALID_MEMBER(zram_mem_pool)) {
 		zram_init();
@@ -3029,31 +3334,64 @@ try_zram_decompress(ulonglong pte_val, unsigned char *buf, ulong len, ulonglong
 	if (CRASHDEBUG(2))
 		error(WARNING, "this page has swapped to zram\n");
 
-	if (!get_disk_name_private_data(pte_val, vaddr, NULL, &zram))
-		return 0;
-
 	if (THIS_KERNEL_VERSION >= LINUX(2, 6, 0))
 		swp_offset = (ulonglong)__swp_offset(pte_val);
 	else
 		swp_offset = (ulonglong)SWP_OFFSET(pte_val);
 
+	off = PAGEOFFSET(vaddr);
+	if ((page = (unsigned char *)zram_page_cache_lookup(__swp_type(pte_val),
+	    swp_offset, &slot))) {
+		memcpy(buf, page + off, len);
+		return len;
+	}
+
+	if (!get_disk_name_private_data(pte_val, vaddr, NULL, &zram))
+		return 0;
+
+	/*
+	 *  The zram table and pool pointers, and the compressor names,
+	 *  are read once per swap device.
+	 */
+	if ((sd = swap_device_cache(pte_val)) && sd->table) {
+		zram_table_entry = sd->table;
+		mem_pool = sd->mem_pool;
+	} else {
+		readmem(zram, KVADDR, &zram_table_entry,
+			sizeof(void *), "zram_table_entry", FAULT_ON_ERROR);
+		readmem(zram + OFFSET(zram_mem_pool), KVADDR, &mem_pool,
+			sizeof(void *), "zram.mem_pool", FAULT_ON_ERROR);
+		if (sd) {
+			sd->table = zram_table_entry;
+			sd->mem_pool = mem_pool;
+		}
+	}
+
 	sector = swp_offset << (PAGESHIFT() - 9);
 	index = sector >> SECTORS_PER_PAGE_SHIFT;
-	readmem(zram, KVADDR, &zram_table_entry,
-		sizeof(void *), "zram_table_entry", FAULT_ON_ERROR);
 	zram_table_entry += (index * SIZE(zram_table_entry));
 	readmem(zram_table_entry + OFFSET(zram_table_entry_flags), KVADDR, &flags,
 		sizeof(void *), "zram_table_entry.flags", FAULT_ON_ERROR);
-	if (VALID_MEMBER(zram_compressor))
-		readmem(zram + OFFSET(zram_compressor), KVADDR, name, sizeof(name),
-			"zram compressor", FAULT_ON_ERROR);
+
+	prio = VALID_MEMBER(zram_compressor) ? 0 :
+		(flags >> ZRAM_COMP_PRIORITY_BIT1) & ZRAM_COMP_PRIORITY_MASK;
+	if (sd && sd->compressor[prio][0])
+		strcpy(name, sd->compressor[prio]);
 	else {
-		ulong comp_alg_addr;
-		uint32_t prio = (flags >> ZRAM_COMP_PRIORITY_BIT1) & ZRAM_COMP_PRIORITY_MASK;
-		readmem(zram + OFFSET(zram_comp_algs) + sizeof(const char *) * prio, KVADDR,
-			&comp_alg_addr, sizeof(comp_alg_addr), "zram comp_algs", FAULT_ON_ERROR);
-		read_string(comp_alg_addr, name, sizeof(name));
+		if (VALID_MEMBER(zram_compressor))
+			readmem(zram + OFFSET(zram_compressor), KVADDR, name,
+				sizeof(name), "zram compressor", FAULT_ON_ERROR);
+		else {
+			ulong comp_alg_addr;
+			readmem(zram + OFFSET(zram_comp_algs) + sizeof(const char *) * prio, KVADDR,
+				&comp_alg_addr, sizeof(comp_alg_addr), "zram comp_algs", FAULT_ON_ERROR);
+			read_string(comp_alg_addr, name, sizeof(name));
+		}
+		name[sizeof(name)-1] = NULLCHAR;
+		if (sd)
+			strcpy(sd->compressor[prio], name);
 	}
+
 	if (STREQ(name, "lzo")) {
 #ifdef LZO
 		if (!(dd->flags & LZO_SUPPORTED)) {
@@ -3074,12 +3412,18 @@ try_zram_decompress(ulonglong pte_val, unsigned char *buf, ulong len, ulonglong
 		return 0;
 	}
 
+	/*
+	 *  The whole page is decoded into its cache slot, or into a
+	 *  temporary buffer if the cache could not be allocated.
+	 */
+	page = (slot >= 0) ? (unsigned char *)zram_page_cache.buf +
+		(slot * PAGESIZE()) : (unsigned char *)GETBUF(PAGESIZE());
 	zram_buf = (unsigned char *)GETBUF(PAGESIZE());
+
 	/* lookup page from swap cache */
-	off = PAGEOFFSET(vaddr);
 	obj_addr = lookup_swap_cache(pte_val, zram_buf);
 	if (obj_addr != NULL) {
-		memcpy(buf, obj_addr + off, len);
+		memcpy(page, obj_addr, PAGESIZE());
 		goto out;
 	}
 
@@ -3087,12 +3431,8 @@ try_zram_decompress(ulonglong pte_val, unsigned char *buf, ulong len, ulonglong
 		sizeof(void *), "entry of table", FAULT_ON_ERROR);
 	if (!entry || (flags & ZRAM_FLAG_SAME_BIT)) {
 		int count;
-		ulong *same_buf = (ulong *)GETBUF(PAGESIZE());
-		for (count = 0; count < PAGESIZE() / sizeof(ulong); count++) {
-			same_buf[count] = entry;
-		}
-		memcpy(buf, same_buf + off, len);
-		FREEBUF(same_buf);
+		for (count = 0; count < PAGESIZE() / sizeof(ulong); count++)
+			((ulong *)page)[count] = entry;
 		goto out;
 	}
 	size = flags & (ZRAM_FLAG_SHIFT -1);
@@ -3101,32 +3441,32 @@ try_zram_decompress(ulonglong pte_val, unsigned char *buf, ulong len, ulonglong
 		goto out;
 	}
 
-	readmem(zram + OFFSET(zram_mem_pool), KVADDR, &zram,
-		sizeof(void *), "zram.mem_pool", FAULT_ON_ERROR);
-
-	obj_addr = zram_object_addr(zram, entry, zram_buf);
+	obj_addr = zram_object_addr(mem_pool, entry, zram_buf);
 	if (obj_addr == NULL) {
 		len = 0;
 		goto out;
 	}
 
 	if (size == PAGESIZE()) {
-		memcpy(buf, obj_addr + off, len);
+		memcpy(page, obj_addr, PAGESIZE());
 	} else {
-		outbuf = (unsigned char *)GETBUF(PAGESIZE());
 		outsize = PAGESIZE();
-		if (!decompressor(obj_addr, size, outbuf, &outsize, NULL))
-			memcpy(buf, outbuf + off, len);
-		else {
+		if (decompressor(obj_addr, size, page, &outsize, NULL)) {
 			error(WARNING, "zram decompress error\n");
 			len = 0;
 		}
-		FREEBUF(outbuf);
 	}
 
 out:
-	if (len && CRASHDEBUG(2))
-		error(INFO, "%lx: zram decompress success\n", vaddr);
+	if (len) {
+		memcpy(buf, page + off, len);
+		if (slot >= 0)
+			zram_page_cache.pages[slot].valid = TRUE;
+		if (CRASHDEBUG(2))
+			error(INFO, "%lx: zram decompress success\n", vaddr);
+	}
+	if (slot < 0)
+		FREEBUF(page);
 	FREEBUF(zram_buf);
 	return len;
 }
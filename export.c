@@ -0,0 +1,873 @@
+/* export.c - core analysis suite
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "defs.h"
+
+/*
+ *  Machine-readable export of the task table, linked lists, red-black
+ *  trees, xarrays, slab objects and the mem_map.  A walker declares its
+ *  record layout once with export_schema(), and then hands each record's
+ *  fields, in that order, to export_addr(), export_int(), export_uint(),
+ *  export_string() and export_null(), ending it with export_record().
+ *  The fields are converted directly into a large output buffer, and are
+ *  written as JSON Lines, CSV, or blocks of columns in a binary format:
+ *
+ *    "CRASHEXP" version(u32) byteorder(u32: 0x01020304) nfields(u32)
+ *    namelen(u16) schema-name
+ *    nfields x { type(u8) namelen(u16) name }
+ *    blocks of { nrecords(u32) nfields x { bytes(u64) column-data } }
+ *    nrecords(u32): 0
+ *
+ *  Numeric columns hold 8-byte values in the byte order of the host that
+ *  wrote them, and string columns hold a 4-byte length and the bytes of
+ *  each string.
+ */
+
+#define EXPORT_JSONL    (1)
+#define EXPORT_CSV      (2)
+#define EXPORT_BINARY   (3)
+
+#define EXPORT_BUFSIZE      (1024*1024)
+#define EXPORT_BLOCK        (4096)     /* records per binary block */
+#define EXPORT_VERSION      (1)
+#define EXPORT_BYTEORDER    (0x01020304)
+
+struct export_column {
+	char *buf;
+	ulong len;
+	ulong size;
+};
+
+static struct export_data {
+	int format;
+	FILE *ofp;
+	FILE *wfp;              /* -w output file */
+	FILE *saved_fp;
+	char *buf;
+	ulong len;
+	char *name;
+	struct export_field *fields;
+	int nfields;
+	int field;              /* the next field of the current record */
+	struct export_column *columns;
+	ulong block_records;
+	ulonglong records;
+} export_data = { 0 };
+
+static char *export_type_names[] = {
+	NULL, "addr", "int", "uint", "string"
+};
+
+static void export_cleanup(void *);
+static void export_flush(void);
+static void export_write(char *, ulong);
+static void export_column_write(struct export_column *, void *, ulong);
+static void export_block(void);
+static void export_field(int);
+static void export_decimal(ulonglong, int);
+static void export_hex(ulong);
+static void export_json_string(char *, long);
+static void export_csv_string(char *, long);
+static void export_tasks(void);
+static struct req_entry *export_entry_schema(char *, struct export_field *,
+	int, char *);
+static int export_list_entry(void *, void *);
+static void export_list(struct list_data *, char *);
+static void export_rbtree(struct tree_data *, char *);
+static void export_xarray_entry(ulong, ulong, const char *, ulong, void *);
+static void export_xarray(ulong, char *);
+
+void
+cmd_export(void)
+{
+	int c, format;
+	char *outfile, *members;
+	struct list_data list_data, *ld;
+	struct tree_data tree_data, *td;
+	struct datatype_member struct_member, *sm;
+	struct syment *sp;
+	struct export_data *ed;
+	ulonglong records;
+
+	ed = &export_data;
+	format = EXPORT_JSONL;
+	outfile = members = NULL;
+	ld = &list_data;
+	BZERO(ld, sizeof(struct list_data));
+	td = &tree_data;
+	BZERO(td, sizeof(struct tree_data));
+	sm = &struct_member;
+
+	while ((c = getopt(argcnt, args, "f:w:o:s:Hh")) != EOF) {
+		switch(c)
+		{
+		case 'f':
+			if (STREQ(optarg, "jsonl") || STREQ(optarg, "json"))
+				format = EXPORT_JSONL;
+			else if (STREQ(optarg, "csv"))
+				format = EXPORT_CSV;
+			else if (STREQ(optarg, "binary") || STREQ(optarg, "bin"))
+				format = EXPORT_BINARY;
+			else
+				error(FATAL, "invalid export format: %s\n", optarg);
+			break;
+
+		case 'w':
+			outfile = optarg;
+			break;
+
+		case 'o':
+			if (IS_A_NUMBER(optarg))
+				ld->member_offset = stol(optarg, FAULT_ON_ERROR, NULL);
+			else if (arg_to_datatype(optarg, sm, RETURN_ON_ERROR) > 1)
+				ld->member_offset = sm->member_offset;
+			else
+				error(FATAL, "invalid -o argument: %s\n", optarg);
+			break;
+
+		case 's':
+			members = optarg;
+			break;
+
+		case 'H':
+			ld->flags |= LIST_HEAD_FORMAT|LIST_HEAD_POINTER;
+			break;
+
+		case 'h':
+			ld->flags |= LIST_HEAD_FORMAT;
+			break;
+
+		default:
+			argerrs++;
+			break;
+		}
+	}
+
+	if (argerrs || !args[optind])
+		cmd_usage(pc->curcmd, SYNOPSIS);
+
+	if (members && !strchr(members, '.'))
+		error(FATAL, "-s requires struct.member[,member...]: %s\n",
+			members);
+
+	if (outfile && !(ed->wfp = fopen(outfile, "w")))
+		error(FATAL, "cannot open %s: %s\n", outfile, strerror(errno));
+
+	ed->format = format;
+	ed->ofp = ed->wfp ? ed->wfp : fp;
+	ed->buf = GETBUF(EXPORT_BUFSIZE);
+	ed->len = 0;
+	ed->records = 0;
+	ed->fields = NULL;
+	ed->columns = NULL;
+
+	pc->cmd_cleanup = export_cleanup;
+	pc->cmd_cleanup_arg = NULL;
+
+	/*
+	 *  The walkers' own display is discarded while exporting.
+	 */
+	ed->saved_fp = fp;
+	fp = pc->nullfp;
+
+	if (STREQ(args[optind], "tasks"))
+		export_tasks();
+	else if (STREQ(args[optind], "list")) {
+		if (!args[optind+1])
+			cmd_usage(pc->curcmd, SYNOPSIS);
+		if ((sp = symbol_search(args[optind+1])))
+			ld->start = sp->value;
+		else
+			ld->start = htol(args[optind+1], FAULT_ON_ERROR, NULL);
+		export_list(ld, members);
+	} else if (STREQ(args[optind], "rbtree")) {
+		if (!args[optind+1])
+			cmd_usage(pc->curcmd, SYNOPSIS);
+		if ((sp = symbol_search(args[optind+1])))
+			td->start = sp->value;
+		else
+			td->start = htol(args[optind+1], FAULT_ON_ERROR, NULL);
+		td->node_member_offset = ld->member_offset;
+		export_rbtree(td, members);
+	} else if (STREQ(args[optind], "xarray")) {
+		if (!args[optind+1])
+			cmd_usage(pc->curcmd, SYNOPSIS);
+		if ((sp = symbol_search(args[optind+1])))
+			export_xarray(sp->value, members);
+		else
+			export_xarray(htol(args[optind+1], FAULT_ON_ERROR,
+				NULL), members);
+	} else if (STREQ(args[optind], "slab"))
+		export_slab_objects(args[optind+1]);
+	else if (STREQ(args[optind], "pages"))
+		export_mem_map();
+	else
+		error(FATAL, "invalid export type: %s\n", args[optind]);
+
+	if (!ed->fields)
+		error(FATAL, "nothing exported\n");
+
+	if (ed->format == EXPORT_BINARY) {
+		if (ed->block_records)
+			export_block();
+		export_column_write(NULL, "\0\0\0\0", sizeof(uint));
+	}
+
+	export_flush();
+	records = ed->records;
+
+	export_cleanup(NULL);
+	pc->cmd_cleanup = NULL;
+
+	if (outfile)
+		fprintf(fp, "%llu records written to %s\n", records, outfile);
+}
+
+/*
+ *  Also called by restore_sanity() if the export fails.
+ */
+static void
+export_cleanup(void *arg)
+{
+	struct export_data *ed;
+	int i;
+
+	ed = &export_data;
+
+	if (ed->saved_fp)
+		fp = ed->saved_fp;
+
+	if (ed->wfp)
+		fclose(ed->wfp);
+	if (ed->columns) {
+		for (i = 0; i < ed->nfields; i++)
+			free(ed->columns[i].buf);
+		free(ed->columns);
+	}
+
+	BZERO(ed, sizeof(struct export_data));
+}
+
+int
+export_active(void)
+{
+	return (export_data.ofp != NULL);
+}
+
+static void
+export_flush(void)
+{
+	struct export_data *ed = &export_data;
+
+	if (ed->len && (fwrite(ed->buf, 1, ed->len, ed->ofp) != ed->len))
+		error(FATAL, "export write failed: %s\n", strerror(errno));
+	ed->len = 0;
+}
+
+static void
+export_write(char *s, ulong len)
+{
+	struct export_data *ed = &export_data;
+
+	if ((ed->len + len) > EXPORT_BUFSIZE) {
+		export_flush();
+		if (len > EXPORT_BUFSIZE) {
+			if (fwrite(s, 1, len, ed->ofp) != len)
+				error(FATAL, "export write failed: %s\n",
+					strerror(errno));
+			return;
+		}
+	}
+
+	memcpy(ed->buf + ed->len, s, len);
+	ed->len += len;
+}
+
+#define EXPORT_PUTC(C) \
+	do { \
+		if (export_data.len == EXPORT_BUFSIZE) \
+			export_flush(); \
+		export_data.buf[export_data.len++] = (C); \
+	} while (0)
+
+/*
+ *  Append to a binary column, or with a NULL column, to the output.
+ */
+static void
+export_column_write(struct export_column *col, void *data, ulong len)
+{
+	ulong size;
+
+	if (!col) {
+		export_write(data, len);
+		return;
+	}
+
+	if ((col->len + len) > col->size) {
+		for (size = col->size ? col->size : 4096; size < (col->len + len);
+		     size *= 2)
+			;
+		if (!(col->buf = realloc(col->buf, size)))
+			error(FATAL, "cannot realloc export column\n");
+		col->size = size;
+	}
+
+	memcpy(col->buf + col->len, data, len);
+	col->len += len;
+}
+
+static void
+export_block(void)
+{
+	struct export_data *ed = &export_data;
+	uint32_t nrecords;
+	uint64_t bytes;
+	int i;
+
+	nrecords = ed->block_records;
+	export_column_write(NULL, &nrecords, sizeof(nrecords));
+	for (i = 0; i < ed->nfields; i++) {
+		bytes = ed->columns[i].len;
+		export_column_write(NULL, &bytes, sizeof(bytes));
+		export_column_write(NULL, ed->columns[i].buf, bytes);
+		ed->columns[i].len = 0;
+	}
+	ed->block_records = 0;
+}
+
+/*
+ *  Declare the fields of the records that follow, and write the header.
+ */
+void
+export_schema(char *name, struct export_field *fields, int nfields)
+{
+	struct export_data *ed = &export_data;
+	uint32_t u32;
+	uint16_t u16;
+	uint8_t type;
+	int i;
+
+	if (ed->fields)
+		error(FATAL, "export schema already declared\n");
+
+	ed->name = name;
+	ed->fields = fields;
+	ed->nfields = nfields;
+	ed->field = 0;
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		export_write("{\"schema\":", strlen("{\"schema\":"));
+		export_json_string(name, -1);
+		export_write(",\"fields\":[", strlen(",\"fields\":["));
+		for (i = 0; i < nfields; i++) {
+			if (i)
+				EXPORT_PUTC(',');
+			export_write("{\"name\":", strlen("{\"name\":"));
+			export_json_string(fields[i].name, -1);
+			export_write(",\"type\":", strlen(",\"type\":"));
+			export_json_string(export_type_names[fields[i].type], -1);
+			EXPORT_PUTC('}');
+		}
+		export_write("]}\n", 3);
+		break;
+
+	case EXPORT_CSV:
+		for (i = 0; i < nfields; i++) {
+			if (i)
+				EXPORT_PUTC(',');
+			export_csv_string(fields[i].name, -1);
+		}
+		EXPORT_PUTC('\n');
+		break;
+
+	case EXPORT_BINARY:
+		if (!(ed->columns = calloc(nfields, sizeof(struct export_column))))
+			error(FATAL, "cannot malloc export columns\n");
+		export_write("CRASHEXP", 8);
+		u32 = EXPORT_VERSION;
+		export_write((char *)&u32, sizeof(u32));
+		u32 = EXPORT_BYTEORDER;
+		export_write((char *)&u32, sizeof(u32));
+		u32 = nfields;
+		export_write((char *)&u32, sizeof(u32));
+		u16 = strlen(name);
+		export_write((char *)&u16, sizeof(u16));
+		export_write(name, u16);
+		for (i = 0; i < nfields; i++) {
+			type = fields[i].type;
+			export_write((char *)&type, sizeof(type));
+			u16 = strlen(fields[i].name);
+			export_write((char *)&u16, sizeof(u16));
+			export_write(fields[i].name, u16);
+		}
+		break;
+	}
+}
+
+/*
+ *  Start the next field of a record, which must be of the declared type.
+ */
+static void
+export_field(int type)
+{
+	struct export_data *ed = &export_data;
+	struct export_field *f;
+
+	if (!ed->fields || (ed->field >= ed->nfields))
+		error(FATAL, "export: too many fields in record\n");
+
+	f = &ed->fields[ed->field];
+	if (f->type != type)
+		error(FATAL, "export: field \"%s\" is not of type %s\n",
+			f->name, export_type_names[type]);
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		EXPORT_PUTC(ed->field ? ',' : '{');
+		EXPORT_PUTC('"');
+		export_write(f->name, strlen(f->name));
+		EXPORT_PUTC('"');
+		EXPORT_PUTC(':');
+		break;
+
+	case EXPORT_CSV:
+		if (ed->field)
+			EXPORT_PUTC(',');
+		break;
+	}
+
+	ed->field++;
+}
+
+static void
+export_decimal(ulonglong value, int negative)
+{
+	char buf[24], *p;
+
+	p = &buf[sizeof(buf)];
+	do {
+		*--p = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+	if (negative)
+		*--p = '-';
+
+	export_write(p, &buf[sizeof(buf)] - p);
+}
+
+static void
+export_hex(ulong value)
+{
+	char buf[24], *p;
+
+	p = &buf[sizeof(buf)];
+	do {
+		*--p = "0123456789abcdef"[value & 0xf];
+		value >>= 4;
+	} while (value);
+	*--p = 'x';
+	*--p = '0';
+
+	export_write(p, &buf[sizeof(buf)] - p);
+}
+
+static void
+export_json_string(char *s, long len)
+{
+	unsigned char c;
+	long i;
+
+	if (len < 0)
+		len = strlen(s);
+
+	EXPORT_PUTC('"');
+	for (i = 0; i < len; i++) {
+		c = (unsigned char)s[i];
+		if ((c == '"') || (c == '\\')) {
+			EXPORT_PUTC('\\');
+			EXPORT_PUTC(c);
+		} else if ((c < ' ') || (c > '~')) {
+			EXPORT_PUTC('\\');
+			EXPORT_PUTC('u');
+			EXPORT_PUTC('0');
+			EXPORT_PUTC('0');
+			EXPORT_PUTC("0123456789abcdef"[c >> 4]);
+			EXPORT_PUTC("0123456789abcdef"[c & 0xf]);
+		} else
+			EXPORT_PUTC(c);
+	}
+	EXPORT_PUTC('"');
+}
+
+static void
+export_csv_string(char *s, long len)
+{
+	long i;
+
+	if (len < 0)
+		len = strlen(s);
+
+	for (i = 0; i < len; i++) {
+		if (strchr(",\"\r\n", s[i]))
+			break;
+	}
+	if (i == len) {
+		export_write(s, len);
+		return;
+	}
+
+	EXPORT_PUTC('"');
+	for (i = 0; i < len; i++) {
+		if (s[i] == '"')
+			EXPORT_PUTC('"');
+		EXPORT_PUTC(s[i]);
+	}
+	EXPORT_PUTC('"');
+}
+
+/*
+ *  Addresses are displayed as hexadecimal strings in JSON, which has
+ *  no hexadecimal numbers, and in CSV.
+ */
+void
+export_addr(ulong value)
+{
+	struct export_data *ed = &export_data;
+	uint64_t v;
+
+	export_field(EXPORT_ADDR);
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		EXPORT_PUTC('"');
+		export_hex(value);
+		EXPORT_PUTC('"');
+		break;
+	case EXPORT_CSV:
+		export_hex(value);
+		break;
+	case EXPORT_BINARY:
+		v = value;
+		export_column_write(&ed->columns[ed->field-1], &v, sizeof(v));
+		break;
+	}
+}
+
+void
+export_int(long value)
+{
+	struct export_data *ed = &export_data;
+	int64_t v;
+
+	export_field(EXPORT_INT);
+
+	if (ed->format == EXPORT_BINARY) {
+		v = value;
+		export_column_write(&ed->columns[ed->field-1], &v, sizeof(v));
+	} else if (value < 0)
+		export_decimal(-(ulonglong)value, TRUE);
+	else
+		export_decimal(value, FALSE);
+}
+
+void
+export_uint(ulong value)
+{
+	struct export_data *ed = &export_data;
+	uint64_t v;
+
+	export_field(EXPORT_UINT);
+
+	if (ed->format == EXPORT_BINARY) {
+		v = value;
+		export_column_write(&ed->columns[ed->field-1], &v, sizeof(v));
+	} else
+		export_decimal(value, FALSE);
+}
+
+/*
+ *  A field of any type whose value could not be read: null in JSON, an
+ *  empty field in CSV, and 0 or an empty string in the binary format.
+ */
+void
+export_null(void)
+{
+	struct export_data *ed = &export_data;
+	uint64_t v;
+	uint32_t l;
+	int type;
+
+	if (!ed->fields || (ed->field >= ed->nfields))
+		error(FATAL, "export: too many fields in record\n");
+
+	type = ed->fields[ed->field].type;
+	export_field(type);
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		export_write("null", 4);
+		break;
+	case EXPORT_CSV:
+		break;
+	case EXPORT_BINARY:
+		if (type == EXPORT_STRING) {
+			l = 0;
+			export_column_write(&ed->columns[ed->field-1], &l,
+				sizeof(l));
+		} else {
+			v = 0;
+			export_column_write(&ed->columns[ed->field-1], &v,
+				sizeof(v));
+		}
+		break;
+	}
+}
+
+/*
+ *  A negative length means a NUL-terminated string; otherwise the string
+ *  ends at its first NUL or after len bytes.
+ */
+void
+export_string(char *s, long len)
+{
+	struct export_data *ed = &export_data;
+	char *p;
+	uint32_t l;
+
+	export_field(EXPORT_STRING);
+
+	if (!s)
+		s = "";
+	if (len < 0)
+		len = strlen(s);
+	else if ((p = memchr(s, NULLCHAR, len)))
+		len = p - s;
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		export_json_string(s, len);
+		break;
+	case EXPORT_CSV:
+		export_csv_string(s, len);
+		break;
+	case EXPORT_BINARY:
+		l = len;
+		export_column_write(&ed->columns[ed->field-1], &l, sizeof(l));
+		export_column_write(&ed->columns[ed->field-1], s, len);
+		break;
+	}
+}
+
+void
+export_record(void)
+{
+	struct export_data *ed = &export_data;
+
+	if (ed->field != ed->nfields)
+		error(FATAL, "export: record has %d of %d fields\n",
+			ed->field, ed->nfields);
+
+	switch (ed->format)
+	{
+	case EXPORT_JSONL:
+		EXPORT_PUTC('}');
+		EXPORT_PUTC('\n');
+		break;
+	case EXPORT_CSV:
+		EXPORT_PUTC('\n');
+		break;
+	case EXPORT_BINARY:
+		if (++ed->block_records == EXPORT_BLOCK)
+			export_block();
+		break;
+	}
+
+	ed->field = 0;
+	ed->records++;
+}
+
+static struct export_field task_fields[] = {
+	{ "task", EXPORT_ADDR },
+	{ "pid", EXPORT_UINT },
+	{ "ppid", EXPORT_UINT },
+	{ "tgid", EXPORT_UINT },
+	{ "cpu", EXPORT_INT },
+	{ "state", EXPORT_STRING },
+	{ "mm", EXPORT_ADDR },
+	{ "comm", EXPORT_STRING },
+};
+
+static void
+export_tasks(void)
+{
+	struct task_context *tc;
+	char buf[BUFSIZE];
+	ulong i;
+
+	export_schema("tasks", task_fields,
+		sizeof(task_fields)/sizeof(struct export_field));
+
+	tc = FIRST_CONTEXT();
+	for (i = 0; i < RUNNING_TASKS(); i++, tc++) {
+		export_addr(tc->task);
+		export_uint(tc->pid);
+		export_uint(task_to_pid(tc->ptask));
+		export_uint(task_tgid(tc->task));
+		export_int(tc->processor);
+		export_string(task_state_string(tc->task, buf, !VERBOSE), -1);
+		export_addr(tc->mm_struct);
+		export_string(tc->comm, -1);
+		export_record();
+	}
+}
+
+static int
+export_list_entry(void *entry, void *arg)
+{
+	struct req_entry *e = (struct req_entry *)arg;
+
+	export_addr((ulong)entry);
+	if (e)
+		export_struct_members(e, (ulong)entry);
+	export_record();
+
+	return FALSE;
+}
+
+/*
+ *  Declare the schema of a walker whose records are made up of the lead
+ *  fields, followed by the -s members of the structure at each entry, and
+ *  return the members' req_entry, if any.
+ */
+static struct req_entry *
+export_entry_schema(char *name, struct export_field *lead, int nlead,
+	char *members)
+{
+	struct export_field *fields;
+	struct req_entry *e;
+	int nfields;
+
+	e = members ? fill_member_offsets(members) : NULL;
+	nfields = nlead + export_struct_fields(e, NULL);
+	fields = (struct export_field *)
+		GETBUF(sizeof(struct export_field) * nfields);
+	BCOPY(lead, fields, sizeof(struct export_field) * nlead);
+	export_struct_fields(e, &fields[nlead]);
+
+	export_schema(name, fields, nfields);
+
+	return e;
+}
+
+static struct export_field entry_fields[] = {
+	{ "addr", EXPORT_ADDR },
+};
+
+/*
+ *  The list options are those of the list command: -o gives the offset
+ *  of the next pointer or list_head, -h means that the start address is
+ *  that of a structure containing the list_head, and -H that it is the
+ *  address of a LIST_HEAD.
+ */
+static void
+export_list(struct list_data *ld, char *members)
+{
+	struct req_entry *e;
+
+	e = export_entry_schema("list", entry_fields,
+		sizeof(entry_fields)/sizeof(struct export_field), members);
+
+	if (ld->flags & LIST_HEAD_FORMAT) {
+		ld->list_head_offset = ld->member_offset;
+		ld->member_offset = 0;
+		if (ld->flags & LIST_HEAD_POINTER) {
+			ld->end = ld->start;
+			readmem(ld->start, KVADDR, &ld->start, sizeof(void *),
+				"LIST_HEAD contents", FAULT_ON_ERROR);
+			if (ld->start == ld->end)
+				return;
+		} else
+			ld->start += ld->list_head_offset;
+	}
+
+	ld->flags |= LIST_CALLBACK;
+	ld->callback_func = export_list_entry;
+	ld->callback_data = e;
+
+	hq_open();
+	do_list(ld);
+	hq_close();
+}
+
+/*
+ *  The entries of a red-black tree, in order, from the rb_root at
+ *  td->start.  As with the tree command, -o gives the offset of the
+ *  rb_node in the structures containing them.
+ */
+static void
+export_rbtree(struct tree_data *td, char *members)
+{
+	struct req_entry *e;
+
+	e = export_entry_schema("rbtree", entry_fields,
+		sizeof(entry_fields)/sizeof(struct export_field), members);
+
+	td->flags |= TREE_CALLBACK;
+	td->callback_func = export_list_entry;
+	td->callback_data = e;
+
+	hq_open();
+	do_rbtree(td);
+	hq_close();
+}
+
+static struct export_field xarray_fields[] = {
+	{ "index", EXPORT_UINT },
+	{ "entry", EXPORT_ADDR },
+};
+
+static void
+export_xarray_entry(ulong node, ulong slot, const char *path,
+	ulong index, void *private)
+{
+	struct req_entry *e = (struct req_entry *)private;
+
+	export_uint(index);
+	export_addr(slot);
+	if (e)
+		export_struct_members(e, slot);
+	export_record();
+}
+
+/*
+ *  The entries of the xarray at root, with their indexes.
+ */
+static void
+export_xarray(ulong root, char *members)
+{
+	struct xarray_ops ops = {
+		.entry		= export_xarray_entry,
+		.radix		= 16,
+	};
+
+	ops.private = export_entry_schema("xarray", xarray_fields,
+		sizeof(xarray_fields)/sizeof(struct export_field), members);
+
+	do_xarray_traverse(root, TRUE, &ops);
+}
@@ -18,7 +18,7 @@
 #include "defs.h"
 #include <sys/sysmacros.h>
 #include <linux/major.h>
-#include <regex.h>
+#include <fnmatch.h>
 #include <sys/utsname.h>
 
 static void show_mounts(ulong, int, struct task_context *);
@@ -1007,71 +1007,463 @@ is_directory(char *file)
 }
 
 
+/*
+ *  search_directory_tree() builds an index of each directory tree that it
+ *  is asked to search: the pathnames of the tree's entries in traversal
+ *  order, hashed by basename, so that looking up every module object file
+ *  of a kernel walks its module and debuginfo trees once instead of once
+ *  per module and filename suffix.  The modification times of the tree's
+ *  directories are recorded, and an index is revalidated against them at
+ *  most once per command.  If the CRASH_MODULE_INDEX environment variable
+ *  names a directory, the indexes are also saved there, and are reused by
+ *  later sessions for as long as they remain valid.
+ */
+struct dir_index_entry {
+	char *path;
+	char *name;
+	int next;                     /* basename hash chain */
+	int isdir;
+	struct timespec mtime;        /* directories only */
+};
+
+struct dir_index {
+	struct dir_index *next;
+	char *directory;
+	int follow_links;
+	ulong cmdgen;
+	int count;
+	int max;
+	struct dir_index_entry *entries;
+	int *hash;
+	int hash_size;
+};
+
+struct dir_index_ancestor {
+	dev_t dev;
+	ino_t ino;
+	struct dir_index_ancestor *parent;
+};
+
+static struct dir_index *dir_indexes = NULL;
+
+#define DIR_INDEX_VERSION "crash directory index 1"
+
+static ulong
+dir_index_hashval(char *name)
+{
+	ulong hash;
+
+	for (hash = 5381; *name; name++)
+		hash = (hash * 33) ^ (unsigned char)*name;
+
+	return hash;
+}
+
+static void
+dir_index_clear(struct dir_index *di)
+{
+	int i;
+
+	for (i = 0; i < di->count; i++)
+		free(di->entries[i].path);
+	free(di->entries);
+	free(di->hash);
+	di->entries = NULL;
+	di->hash = NULL;
+	di->count = di->max = di->hash_size = 0;
+}
+
+static int
+dir_index_add(struct dir_index *di, char *path, struct stat *sbuf)
+{
+	struct dir_index_entry *entries, *de;
+
+	if (di->count == di->max) {
+		if (!(entries = realloc(di->entries,
+		    (di->max ? di->max * 2 : 1024) *
+		    sizeof(struct dir_index_entry))))
+			return FALSE;
+		di->entries = entries;
+		di->max = di->max ? di->max * 2 : 1024;
+	}
+
+	de = &di->entries[di->count];
+	if (!(de->path = strdup(path)))
+		return FALSE;
+	de->name = strrchr(de->path, '/') ? strrchr(de->path, '/') + 1 :
+		de->path;
+	de->isdir = sbuf ? S_ISDIR(sbuf->st_mode) : FALSE;
+	if (de->isdir)
+		de->mtime = sbuf->st_mtim;
+	di->count++;
+
+	return TRUE;
+}
+
+/*
+ *  Walk a directory, appending its entries to the index and descending
+ *  into its subdirectories.  Symbolic links to directories are followed
+ *  if requested, stopping at any that would loop back to an ancestor.
+ */
+static int
+dir_index_walk(struct dir_index *di, char *path, int len,
+	struct dir_index_ancestor *parent)
+{
+	struct dir_index_ancestor self, *a;
+	struct dirent *dp;
+	struct stat sbuf;
+	DIR *dirp;
+	int dirlen, isdir, ret;
+
+	if (!(dirp = opendir(path)))
+		return TRUE;
+
+	ret = TRUE;
+	while ((dp = readdir(dirp))) {
+		if (STREQ(dp->d_name, ".") || STREQ(dp->d_name, ".."))
+			continue;
+		if ((len + strlen(dp->d_name) + 2) > PATH_MAX)
+			continue;
+
+		dirlen = len + sprintf(path + len, "/%s", dp->d_name);
+
+		switch (dp->d_type)
+		{
+		case DT_DIR:
+			isdir = (lstat(path, &sbuf) == 0);
+			break;
+		case DT_LNK:
+			isdir = di->follow_links && (stat(path, &sbuf) == 0) &&
+				S_ISDIR(sbuf.st_mode);
+			break;
+		case DT_UNKNOWN:
+			isdir = ((di->follow_links ? stat(path, &sbuf) :
+				lstat(path, &sbuf)) == 0) &&
+				S_ISDIR(sbuf.st_mode);
+			break;
+		default:
+			isdir = FALSE;
+			break;
+		}
+
+		if (!dir_index_add(di, path, isdir ? &sbuf : NULL)) {
+			ret = FALSE;
+			break;
+		}
+
+		if (!isdir)
+			continue;
+
+		for (a = parent; a; a = a->parent)
+			if ((a->dev == sbuf.st_dev) && (a->ino == sbuf.st_ino))
+				break;
+		if (a)
+			continue;
+
+		self.dev = sbuf.st_dev;
+		self.ino = sbuf.st_ino;
+		self.parent = parent;
+		if (!(ret = dir_index_walk(di, path, dirlen, &self)))
+			break;
+	}
+
+	path[len] = NULLCHAR;
+	closedir(dirp);
+
+	return ret;
+}
+
+static int
+dir_index_scan(struct dir_index *di)
+{
+	struct dir_index_ancestor top;
+	struct stat sbuf;
+	char *path;
+	int ret;
+
+	if ((stat(di->directory, &sbuf) < 0) || !S_ISDIR(sbuf.st_mode) ||
+	    (strlen(di->directory) >= PATH_MAX))
+		return FALSE;
+
+	path = GETBUF(PATH_MAX);
+	strcpy(path, di->directory);
+
+	top.dev = sbuf.st_dev;
+	top.ino = sbuf.st_ino;
+	top.parent = NULL;
+
+	ret = dir_index_add(di, path, &sbuf) &&
+		dir_index_walk(di, path, strlen(path), &top);
+
+	FREEBUF(path);
+
+	return ret;
+}
+
+static int
+dir_index_build_hash(struct dir_index *di)
+{
+	int i, h;
+
+	for (di->hash_size = 64; di->hash_size < di->count; di->hash_size <<= 1)
+		;
+	if (!(di->hash = malloc(di->hash_size * sizeof(int))))
+		return FALSE;
+	for (i = 0; i < di->hash_size; i++)
+		di->hash[i] = -1;
+
+	/*
+	 *  Insert in reverse so that each chain is in traversal order.
+	 */
+	for (i = di->count - 1; i >= 0; i--) {
+		h = dir_index_hashval(di->entries[i].name) & (di->hash_size-1);
+		di->entries[i].next = di->hash[h];
+		di->hash[h] = i;
+	}
+
+	return TRUE;
+}
+
+static int
+dir_index_valid(struct dir_index *di)
+{
+	struct dir_index_entry *de;
+	struct stat sbuf;
+	int i;
+
+	for (i = 0; i < di->count; i++) {
+		de = &di->entries[i];
+		if (!de->isdir)
+			continue;
+		if ((stat(de->path, &sbuf) < 0) || !S_ISDIR(sbuf.st_mode) ||
+		    (sbuf.st_mtim.tv_sec != de->mtime.tv_sec) ||
+		    (sbuf.st_mtim.tv_nsec != de->mtime.tv_nsec))
+			return FALSE;
+	}
+
+	return di->count > 0;
+}
+
+/*
+ *  The saved index of a directory tree is named after a hash of its
+ *  pathname, and starts with the version, the pathname and the symbolic
+ *  link handling, followed by one line per entry in traversal order:
+ *
+ *    D <mtime seconds> <mtime nanoseconds> <pathname>
+ *    F <pathname>
+ */
+static char *
+dir_index_file(struct dir_index *di, char *buf)
+{
+	char *dir;
+
+	if (!(dir = getenv("CRASH_MODULE_INDEX")) || !is_directory(dir))
+		return NULL;
+
+	sprintf(buf, "%s/%lx%s.index", dir, dir_index_hashval(di->directory),
+		di->follow_links ? "L" : "");
+
+	return buf;
+}
+
+static int
+dir_index_load(struct dir_index *di)
+{
+	char file[PATH_MAX+BUFSIZE];
+	char *buf, *p;
+	struct stat sbuf;
+	FILE *ifp;
+	int ret;
+
+	if (!dir_index_file(di, file) || !(ifp = fopen(file, "r")))
+		return FALSE;
+
+	buf = GETBUF(PATH_MAX+BUFSIZE);
+	ret = FALSE;
+
+	if (!fgets(buf, PATH_MAX+BUFSIZE, ifp) ||
+	    !STREQ(strip_linefeeds(buf), DIR_INDEX_VERSION) ||
+	    !fgets(buf, PATH_MAX+BUFSIZE, ifp) ||
+	    !STREQ(strip_linefeeds(buf), di->directory) ||
+	    !fgets(buf, PATH_MAX+BUFSIZE, ifp) ||
+	    (atoi(buf) != di->follow_links))
+		goto out;
+
+	while (fgets(buf, PATH_MAX+BUFSIZE, ifp)) {
+		strip_linefeeds(buf);
+		if (STRNEQ(buf, "F ")) {
+			if (!dir_index_add(di, buf+2, NULL))
+				goto out;
+		} else if (STRNEQ(buf, "D ")) {
+			BZERO(&sbuf, sizeof(struct stat));
+			sbuf.st_mode = S_IFDIR;
+			sbuf.st_mtim.tv_sec = strtol(buf+2, &p, 10);
+			sbuf.st_mtim.tv_nsec = strtol(p, &p, 10);
+			if (*p++ != ' ')
+				goto out;
+			if (!dir_index_add(di, p, &sbuf))
+				goto out;
+		} else
+			goto out;
+	}
+
+	ret = TRUE;
+out:
+	FREEBUF(buf);
+	fclose(ifp);
+	if (!ret)
+		dir_index_clear(di);
+
+	return ret;
+}
+
+static void
+dir_index_save(struct dir_index *di)
+{
+	char file[PATH_MAX+BUFSIZE], tmpfile[PATH_MAX+BUFSIZE+32];
+	struct dir_index_entry *de;
+	FILE *ofp;
+	int i;
+
+	if (!dir_index_file(di, file))
+		return;
+
+	sprintf(tmpfile, "%s.%d", file, getpid());
+	if (!(ofp = fopen(tmpfile, "w"))) {
+		error(INFO, "%s: %s\n", tmpfile, strerror(errno));
+		return;
+	}
+
+	fprintf(ofp, "%s\n%s\n%d\n", DIR_INDEX_VERSION, di->directory,
+		di->follow_links);
+	for (i = 0; i < di->count; i++) {
+		de = &di->entries[i];
+		if (strchr(de->path, '\n'))
+			continue;
+		if (de->isdir)
+			fprintf(ofp, "D %ld %ld %s\n", (long)de->mtime.tv_sec,
+				(long)de->mtime.tv_nsec, de->path);
+		else
+			fprintf(ofp, "F %s\n", de->path);
+	}
+
+	if ((fclose(ofp) != 0) || (rename(tmpfile, file) < 0)) {
+		error(INFO, "%s: %s\n", file, strerror(errno));
+		unlink(tmpfile);
+	}
+}
+
+/*
+ *  Return the index of a directory tree, building, loading or rebuilding
+ *  it if it has not already been validated during the current command.
+ */
+static struct dir_index *
+get_dir_index(char *directory, int follow_links)
+{
+	struct dir_index *di;
+	char *how;
+
+	for (di = dir_indexes; di; di = di->next) {
+		if ((di->follow_links == follow_links) &&
+		    STREQ(di->directory, directory))
+			break;
+	}
+
+	if (di) {
+		if (di->cmdgen == pc->cmdgencur)
+			return (di->count ? di : NULL);
+		if (dir_index_valid(di)) {
+			di->cmdgen = pc->cmdgencur;
+			return di;
+		}
+		dir_index_clear(di);
+	} else {
+		if (!(di = calloc(1, sizeof(struct dir_index))) ||
+		    !(di->directory = strdup(directory))) {
+			free(di);
+			error(INFO, "cannot malloc directory index\n");
+			return NULL;
+		}
+		di->follow_links = follow_links;
+		di->next = dir_indexes;
+		dir_indexes = di;
+	}
+
+	di->cmdgen = pc->cmdgencur;
+
+	if (dir_index_load(di) && dir_index_valid(di))
+		how = "loaded";
+	else {
+		dir_index_clear(di);
+		if (!dir_index_scan(di)) {
+			if (di->count)
+				error(INFO, "cannot malloc directory index\n");
+			dir_index_clear(di);
+			return NULL;
+		}
+		dir_index_save(di);
+		how = "scanned";
+	}
+
+	if (!dir_index_build_hash(di)) {
+		error(INFO, "cannot malloc directory index\n");
+		dir_index_clear(di);
+		return NULL;
+	}
+
+	if (CRASHDEBUG(1))
+		fprintf(fp, "directory index: %s: %s %d entries\n",
+			directory, how, di->count);
+
+	return di;
+}
+
 /*
  *  Search a directory tree for filename, and if found, return a temporarily
- *  allocated buffer containing the full pathname.   The "done" business is
- *  protection against fgets() prematurely returning NULL before the find
- *  command completes.  (I thought this was impossible until I saw it happen...)
- *  When time permits, rewrite this doing the search by hand.
+ *  allocated buffer containing the full pathname.  As with "find -name",
+ *  the filename may be a shell pattern such as "ext[_-]fs.ko", in which
+ *  case the first entry that matches it in traversal order is returned.
  */
 char *
 search_directory_tree(char *directory, char *file, int follow_links)
 {
-	char command[BUFSIZE];
-	char buf[BUFSIZE];
-	char *retbuf, *start, *end, *module;
-	FILE *pipe;
-	regex_t regex;
-	int regex_used, done;
+	struct dir_index *di;
+	struct dir_index_entry *de;
+	char *retbuf;
+	int i;
 
-	if (!file_exists("/usr/bin/find", NULL) || 
-	    !file_exists("/bin/echo", NULL) ||
-	    !is_directory(directory) ||
-	    (*file == '(')) 
+	if (!is_directory(directory) || (*file == '(') ||
+	    !(di = get_dir_index(directory, follow_links)))
 		return NULL;
 
-	sprintf(command, 
-            "/usr/bin/find %s %s -name %s -print; /bin/echo search done",
-		follow_links ? "-L" : "", directory, file);
-
-        if ((pipe = popen(command, "r")) == NULL) {
-                error(INFO, "%s: %s\n", command, strerror(errno));
-                return NULL;
-        }
-
-	done = FALSE;
-	retbuf = NULL;
-	regex_used = ((start = strstr(file, "[")) && 
-		(end = strstr(file, "]")) && (start < end) &&
-		(regcomp(&regex, file, 0) == 0));
+	de = NULL;
 
-        while (fgets(buf, BUFSIZE-1, pipe) || !done) {
-                if (STREQ(buf, "search done\n")) {
-                        done = TRUE;
-                        break;
-                }
-                if (!retbuf && !regex_used &&
-                    STREQ((char *)basename(strip_linefeeds(buf)), file)) {
-                        retbuf = GETBUF(strlen(buf)+1);
-                        strcpy(retbuf, buf);
-                }
-		if (!retbuf && regex_used) {
-			module = basename(strip_linefeeds(buf));
-			if (regexec(&regex, module, 0, NULL, 0) == 0) {
-				retbuf = GETBUF(strlen(buf)+1);
-				strcpy(retbuf, buf);
+	if (strpbrk(file, "[*?")) {
+		for (i = 0; i < di->count; i++) {
+			if (fnmatch(file, di->entries[i].name, 0) == 0) {
+				de = &di->entries[i];
+				break;
 			}
 		}
-        }
+	} else {
+		i = di->hash[dir_index_hashval(file) & (di->hash_size-1)];
+		for ( ; i >= 0; i = di->entries[i].next) {
+			if (STREQ(di->entries[i].name, file)) {
+				de = &di->entries[i];
+				break;
+			}
+		}
+	}
 
-	if (regex_used)
-		regfree(&regex);
+	if (!de)
+		return NULL;
 
-        pclose(pipe);
+	retbuf = GETBUF(strlen(de->path)+1);
+	strcpy(retbuf, de->path);
 
 	return retbuf;
 }
- 
+
 /*
  *  Determine whether a file exists, and if so, if it's a tty.
  */
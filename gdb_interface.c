@@ -375,6 +375,8 @@ gdb_pass_through(char *cmd, FILE *fptr, ulong flags)
 void 
 gdb_interface(struct gnu_request *req)
 {
+	struct timespec start;
+
 	if (!(pc->flags & GDB_INIT)) 
 		error(FATAL, "gdb_interface: gdb not initialized?\n"); 
 
@@ -405,10 +407,16 @@ gdb_interface(struct gnu_request *req)
 		SIGACTION(SIGPIPE, SIG_IGN, &pc->sigaction, NULL);
 	} 
 
+	if (PROFILING())
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
 	pc->flags |= IN_GDB;
 	gdb_command_funnel(req);
 	pc->flags &= ~IN_GDB;
 
+	if (PROFILING())
+		profile_gdb_request(req->command, &start);
+
 	SIGACTION(SIGINT, restart, &pc->sigaction, NULL);
 	SIGACTION(SIGSEGV, SIG_DFL, &pc->sigaction, NULL);
 
@@ -811,7 +819,8 @@ cmd_gdb(void)
 		} else
 			strcpy(buf, pc->orig_line);
 
-		if (pc->redirect & (REDIRECT_TO_FILE|REDIRECT_TO_PIPE))
+		if (pc->redirect & 
+		    (REDIRECT_TO_FILE|REDIRECT_TO_PIPE|REDIRECT_TO_FILTER))
 			strip_redirection(buf);
 
 		if (!gdb_pass_through(buf, NULL, GNU_RETURN_ON_ERROR))
@@ -55,6 +55,12 @@ struct symbol_table_data *st = &symbol_table_data;
 struct machdep_table machdep_table = { 0 };
 struct machdep_table *machdep = &machdep_table;
 
+/*
+ *  Per-command profiling counters, bumped while "set profile" is on.
+ */
+struct profile_data profile_data = { 0 };
+struct profile_data *prof = &profile_data;
+
 /*
  *  Command functions are entered with the args[] array and argcnt value 
  *  pre-set for issuance to getopt().
@@ -72,6 +78,7 @@ struct command_table_entry linux_command_table[] = {
 	{"*", 	    cmd_pointer, help_pointer, 0},
 	{"alias",   cmd_alias,   help_alias,   0},
         {"ascii",   cmd_ascii,   help_ascii,   0},
+	{"bench",   cmd_bench,   help_bench,   HIDDEN_COMMAND|MINIMAL},
         {"bpf",     cmd_bpf,     help_bpf,     0},
         {"bt",      cmd_bt,      help_bt,      REFRESH_TASK_TABLE},
 	{"btop",    cmd_btop,    help_btop,    0},
@@ -79,6 +86,7 @@ struct command_table_entry linux_command_table[] = {
 	{"dis",     cmd_dis,     help_dis,     MINIMAL},
 	{"eval",    cmd_eval,    help_eval,    MINIMAL},
 	{"exit",    cmd_quit,    help_exit,    MINIMAL},
+	{"export",  cmd_export,  help_export,  REFRESH_TASK_TABLE},
 	{"extend",  cmd_extend,  help_extend,  MINIMAL},
 	{"files",   cmd_files,   help_files,   REFRESH_TASK_TABLE},
 	{"foreach", cmd_foreach, help_foreach, REFRESH_TASK_TABLE},
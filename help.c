@@ -332,8 +332,9 @@ char *program_usage_info[] = {
     "    the two values.",
     "",
     "  --hash count",
-    "    Set the number of internal hash queue heads used for list gathering",
-    "    and verification.  The default count is 32768.",
+    "    Set the initial number of slots in the internal hash table used for",
+    "    list gathering and verification.  The table grows as needed.  The",
+    "    default count is 32768.",
     "",
     "  --kaslr offset | auto",
     "    If x86, x86_64, s390x or loongarch64 kernel was configured with",
@@ -358,6 +359,37 @@ char *program_usage_info[] = {
     "  --kvmio <size>",
     "    override the automatically-calculated KVM guest I/O hole size.",
     "",
+    "  --kvmcache <pages>",
+    "    When examining a KVM guest dumpfile, specify the number of pages",
+    "    held in its page cache.  The value is rounded up to a power of two;",
+    "    the default is 256.",
+    "",
+    "  --rearrange <file>",
+    "    When examining a flattened-format dumpfile created by makedumpfile -F,",
+    "    also write its contents to <file> as a regular dumpfile that can be",
+    "    used directly in later sessions.  A new <file> is only readable and",
+    "    writable by the user.",
+    "",
+    "  --server <socket>",
+    "    After initialization, accept connections on the UNIX domain socket",
+    "    <socket> instead of reading commands from the terminal.  Each",
+    "    newline-terminated command sent by a client is executed and its",
+    "    output, followed by a NUL byte, is written back to the client.",
+    "    Sending a ^C byte while a command is running interrupts it, and",
+    "    \"q\" or \"exit\" closes the connection.  The socket is only",
+    "    accessible by its owner, and an existing socket at the same path is",
+    "    replaced only if it belongs to the user running crash.",
+    "",
+    "  --jobs <count>",
+    "    Execute the commands in input files using up to <count> forked",
+    "    processes (maximum 64).  Their output is displayed in the same order",
+    "    as it would be when executed sequentially.  Commands that change the",
+    "    session state, such as set, alias, extend, mod, gdb, aliases of them,",
+    "    or assignments to $ convenience variables, and commands whose output",
+    "    is redirected to a file, are executed one at a time.  Each process",
+    "    reopens the dumpfile and the other files it reads, so /proc/self/fd",
+    "    must be available.",
+    "",
     "  --offline [show|hide]",
     "    Show or hide command output that is associated with offline cpus,",
     "    overriding any settings in either ./.crashrc or $HOME/.crashrc.",
@@ -388,6 +420,11 @@ char *program_usage_info[] = {
     "    Specifies an alternative directory tree to search for kernel",
     "    module object files.",
     "",
+    "  CRASH_MODULE_INDEX",
+    "    Specifies a directory in which the indexes of the directory trees",
+    "    searched for kernel module object files are saved, so that later",
+    "    sessions need not scan the trees again while they are unchanged.",
+    "",
     "  CRASH_EXTENSIONS",
     "    Specifies a directory containing extension modules that will be",
     "    loaded automatically if the -x command line option is used.",
@@ -1088,6 +1125,78 @@ char *help_exit[] = {
 NULL            
 };
 
+char *help_export[] = {
+"export",
+"export kernel data in a machine-readable format",
+"[-f jsonl|csv|binary] [-w file] [-o offset] [-s struct.member[,member]]\n"
+"         [-H|-h] tasks | list start | rbtree root | xarray root | slab [cache] |\n"
+"         pages",
+"  This command writes one record per task, list, tree or xarray entry, slab",
+"  object or page structure, in a format suited to other tools rather than to",
+"  the screen.",
+"  The records are converted directly into a large output buffer, so that",
+"  exporting every page structure of a large dump is bounded by the reading",
+"  of the dump rather than by formatting.",
+" ",
+"  The first record describes the schema: the name of the export and the",
+"  name and type of each field, one of addr, int, uint or string.",
+" ",
+"    -f jsonl  one JSON object per line, preceded by a schema object of the",
+"              form {\"schema\":name,\"fields\":[{\"name\":...,\"type\":...}]}.",
+"              Addresses are hexadecimal strings.  This is the default.",
+"    -f csv    comma-separated values, preceded by a header line of field",
+"              names.  Fields containing commas or quotes are quoted.",
+"    -f binary a \"CRASHEXP\" header, followed by blocks of up to 4096 records",
+"              stored column by column.  Numbers are 8-byte values in the",
+"              byte order of the host, and strings are a 4-byte length",
+"              followed by their bytes.  A block of 0 records ends the file.",
+"   -w file    write to file instead of the screen.",
+" ",
+"  The data to export:",
+" ",
+"    tasks     each task: task, pid, ppid, tgid, cpu, state, mm and comm.",
+"    list start",
+"              each entry of the linked list at start, a symbol or address,",
+"              which is walked as by the list command, using the -o, -H and",
+"              -h options in the same way.  The entry address is exported as",
+"              \"addr\", followed by the members given with -s, which are",
+"              resolved once for the whole list.  Members that are neither",
+"              strings nor integers are exported as hexadecimal bytes, and",
+"              members that cannot be read as null, which is an empty CSV",
+"              field, and 0 or an empty string in the binary format.",
+"    rbtree root",
+"              each entry of the red-black tree whose rb_root is at root, in",
+"              order.  The -o option gives the offset of the rb_node in the",
+"              structures containing them, as with the tree command, and the",
+"              structure address is exported as \"addr\", followed by the -s",
+"              members.",
+"    xarray root",
+"              each entry of the xarray at root: index and entry, followed by",
+"              the -s members of the structure that the entry points to.",
+"    slab [cache]",
+"              each object of a SLUB cache, or of every cache: cache, name,",
+"              slab, object, allocated, and the cpu whose per-cpu freelist",
+"              holds a free object, or -1.",
+"    pages     each page structure of the mem_map: page, pfn, flags, count,",
+"              mapping and index.",
+"\nEXAMPLES",
+"  Export the task table as CSV:",
+"\n    %s> export -f csv tasks",
+"    task,pid,ppid,tgid,cpu,state,mm,comm",
+"    0xffffffff81a13480,0,0,0,0,RU,0x0,swapper/0",
+"    0xffff88003e0c8000,1,0,1,2,IN,0xffff88003c9d8000,systemd",
+"    ...",
+"\n  Export the mem_map to a file in the binary format:",
+"\n    %s> export -f binary -w pages.bin pages",
+"    2097152 records written to pages.bin",
+"\n  Export the modules list, with two members of each module:",
+"\n    %s> export -o module.list -s module.name,state -H list modules",
+"    {\"schema\":\"list\",\"fields\":[{\"name\":\"addr\",\"type\":\"addr\"},{\"name\":\"name\",\"type\":\"string\"},{\"name\":\"state\",\"type\":\"string\"}]}",
+"    {\"addr\":\"0xffffffffc0a1e000\",\"name\":\"xfs\",\"state\":\"MODULE_STATE_LIVE\"}",
+"    ...",
+NULL
+};
+
 char *help_help[] = { 
 "help",
 "get help",
@@ -1208,6 +1317,24 @@ char *help_set[] = {
 "                               \"filename\": error messages are only sent to the",
 "                                 specified filename; they are not displayed on",
 "                                 the console and are not sent to a pipe or file.",
+"   profile  on | off | filename   profile each subsequent command.",
+"                               \"on\": after each command completes, display",
+"                                 its elapsed, user and system time, readmem()",
+"                                 calls and bytes per memory type, dumpfile",
+"                                 page reads and page cache hits/misses, kvtop()",
+"                                 translations, per-algorithm page decompression",
+"                                 counts and time, gdb requests by type and",
+"                                 time, and the peak number of GETBUF buffers.",
+"                               \"filename\": append the same counters for each",
+"                                 command to the specified file, one JSON",
+"                                 object per line.",
+"  memtrace  filename | off     record each readmem() request, its type string",
+"                               and resulting physical address, and each",
+"                               dumpfile page read, in a binary trace file.",
+"                               The trace may be replayed against the dumpfile",
+"                               with \"bench -r filename replay\", or analyzed",
+"                               with the memtrace utility in the benchmark",
+"                               subdirectory of the %s sources.",
 " ",
 "  Internal variables may be set in four manners:\n",
 "    1. entering the set command in $HOME/.%src.",
@@ -1260,6 +1387,8 @@ char *help_set[] = {
 "           offline: show",
 "           redzone: on",
 "             error: default",
+"           profile: off",
+"          memtrace: off",
 " ",
 "  Show the current context:\n",
 "    %s> set",
@@ -2529,6 +2658,44 @@ char *help_mach[] = {
 NULL               
 };
 
+char *help_bench[] = {
+"bench",
+"microbenchmark the dumpfile, symbol and hashing paths",
+"[-n iterations][-b bytes][-m memsize][-s seed][-r tracefile] [benchmark] ...",
+"  This command times the operations listed below individually, and displays",
+"  the throughput and latency percentiles of each benchmark as one JSON object",
+"  per line.  If no benchmark is specified, all of those supported by the",
+"  dumpfile are run.",
+" ",
+"        readmem  reads of \"bytes\" at random physical addresses.",
+"    readmem_seq  page-sized reads of physical pages in ascending order.",
+"     pfn_to_pos  compressed kdump page descriptor lookups.",
+"     cache_page  compressed kdump page reads and decompression.",
+"   value_search  address-to-symbol lookups near random symbols.",
+"  symbol_search  name-to-symbol lookups of random symbols.",
+"       hq_enter  hash queue insertions of pointer-aligned values.",
+"         replay  the dumpfile page reads recorded in a tracefile, in order.",
+" ",
+"    -n iterations  the number of operations per benchmark (default: 100000).",
+"    -b bytes       the readmem request size (default: the size of a long).",
+"    -m memsize     choose the physical pages below memsize (default: the",
+"                   system's memory size).",
+"    -s seed        the random number seed (default: 1); the same seed always",
+"                   generates the same requests.",
+"    -r tracefile   a readmem trace recorded with \"set memtrace\"; the replay",
+"                   benchmark runs one iteration per page read in the trace.",
+"                   Running it with \"set profile on\" displays the resulting",
+"                   dumpfile cache hits and misses.",
+" ",
+"  Synthetic dumpfiles suitable for these benchmarks may be generated with",
+"  the mkvmcore utility in the benchmark subdirectory of the %s sources.",
+"\nEXAMPLES",
+"    %s> bench -n 10000 -m 0x10000000 readmem hq_enter",
+"    {\"benchmark\": \"readmem\", \"dumpfile\": \"vmcore\", \"iterations\": 10000, \"errors\": 0, \"seconds\": 0.004917, \"ops_per_sec\": 2033761.4, \"bytes_per_sec\": 16270091.3, \"latency_nsecs\": {\"min\": 231, \"mean\": 452, \"p50\": 290, \"p90\": 331, \"p99\": 6204, \"p999\": 13520, \"max\": 41833}}",
+"    {\"benchmark\": \"hq_enter\", \"dumpfile\": \"vmcore\", \"iterations\": 10000, \"errors\": 0, \"seconds\": 0.000931, \"ops_per_sec\": 10741138.6, \"latency_nsecs\": {\"min\": 40, \"mean\": 63, \"p50\": 60, \"p90\": 71, \"p99\": 110, \"p999\": 421, \"max\": 2304}}",
+NULL
+};
+
 char *help_bpf[] = {
 "bpf",
 "extended Berkeley Packet Filter (eBPF)",
@@ -5972,7 +6139,8 @@ char *help__list[] = {
 "               expressing the argument as \"struct.member.member.member...\".",
 "    -S struct  Similar to -s, but instead of parsing gdb output, member values",
 "               are read directly from memory, so the command works much faster",
-"               for 1-, 2-, 4-, and 8-byte members.",
+"               for 1-, 2-, 4-, and 8-byte members, bitfields, enums and",
+"               character arrays.",
 "    -O offset  Only used in conjunction with -h; it specifies the offset of",
 "               head node list_head embedded within a data structure which is",
 "               different than the offset of list_head of other nodes embedded",
@@ -6359,7 +6527,8 @@ char *help_tree[] = {
 "             \"struct.member.member.member...\".",
 "  -S struct  Similar to -s, but instead of parsing gdb output, member values",
 "             are read directly from memory, so the command works much faster", 
-"             for 1-, 2-, 4-, and 8-byte members.",
+"             for 1-, 2-, 4-, and 8-byte members, bitfields, enums and",
+"             character arrays.",
 "         -l  For red-black trees, dump the tree sorted in linear order starting",
 "             with the leftmost node and progressing to the right.  This option",
 "             does not apply to radix trees.",
@@ -8459,6 +8628,10 @@ char *output_info[] = {
 "Command output may be piped to an external command using standard command",
 "line pipe syntax.  For example:\n", 
 "  %s> log | grep eth0\n",
+"Simple pipelines made up of grep, egrep, fgrep, head, tail, wc, sort, uniq",
+"and awk '{print $N}' are filtered by %s itself without starting a shell;",
+"unsupported options, other commands or shell metacharacters cause the",
+"pipeline to be passed to /bin/sh.\n",
 "Command output may be redirected to a file using standard command line syntax.",
 "For example:\n",
 "  %s> foreach bt > bt.all\n",
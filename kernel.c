@@ -70,6 +70,12 @@ static void verify_namelist(void);
 static char *debug_kernel_version(char *);
 static int restore_stack(struct bt_info *);
 static ulong __xen_m2p(ulonglong, ulong);
+static ulong xen_m2p_search(ulonglong, ulong);
+static void xen_m2p_map_init(void);
+static void xen_m2p_map_add(ulong);
+static void xen_m2p_map_free(void);
+static ulong xen_m2p_map_lookup(ulong);
+static int compare_m2p_run(const void *, const void *);
 static ulong __xen_pvops_m2p_l2(ulonglong, ulong);
 static ulong __xen_pvops_m2p_l3(ulonglong, ulong);
 static ulong __xen_pvops_m2p_hyper(ulonglong, ulong);
@@ -4598,6 +4604,7 @@ do_module_cmd(ulong flag, char *modref, ulong address,
 	struct load_module *lm, *lmp;
 	int maxnamelen;
 	int maxsizelen;
+	char **objfiles, **prefetch;
 	char buf1[BUFSIZE];
 	char buf2[BUFSIZE];
 	char buf3[BUFSIZE];
@@ -4704,6 +4711,25 @@ do_module_cmd(ulong flag, char *modref, ulong address,
 		break;
 
 	case LOAD_ALL_MODULE_SYMBOLS:
+		/*
+		 *  Find all of the object files first, so that their symbols
+		 *  can be decoded ahead of the serialized symbol loading.
+		 */
+		objfiles = (char **)GETBUF(sizeof(char *) * kt->mods_installed);
+		prefetch = (char **)GETBUF(sizeof(char *) * kt->mods_installed);
+		for (i = j = 0; i < kt->mods_installed; i++) {
+			lm = &st->load_modules[i];
+			if (STREQ(lm->mod_name, "(unknown module)"))
+				continue;
+			objfiles[i] = find_module_objfile(lm->mod_name,
+				NULL, tree);
+			if (objfiles[i] && !(lm->mod_flags & MOD_LOAD_SYMS) &&
+			    !strlen(lm->mod_namelist))
+				prefetch[j++] = objfiles[i];
+		}
+		if (!REMOTE())
+			start_module_symbol_workers(prefetch, j);
+
 		for (i = j = 0; i < kt->mods_installed; i++) {
 			lm = &st->load_modules[i];
 
@@ -4717,7 +4743,7 @@ do_module_cmd(ulong flag, char *modref, ulong address,
 			modref = lm->mod_name;
 			address = lm->mod_base;
 
-			if ((objfile = find_module_objfile(modref,NULL,tree))) {
+			if ((objfile = objfiles[i])) {
 				if (!is_elf_file(objfile)) {
                         		error(INFO, 
 			                  "%s: not an ELF format object file\n",
@@ -4745,6 +4771,9 @@ do_module_cmd(ulong flag, char *modref, ulong address,
                               "cannot find or load object file for %s module\n",
 					modref);
 		}
+		finish_module_symbol_workers();
+		FREEBUF(prefetch);
+		FREEBUF(objfiles);
 		do_module_cmd(REMOTE_MODULE_SAVE_MSG, 0, 0, 0, tree);
 		break;
 
@@ -6502,6 +6531,22 @@ no_cpu_flags:
 	else
 		fprintf(fp, "\n");
 
+	others = 0;
+	fprintf(fp, "                m2p_map:\n");
+	fprintf(fp, "                  flags: %lx (", kt->m2p_map.flags);
+	if (kt->m2p_map.flags & M2P_MAP_INIT)
+		fprintf(fp, "%sM2P_MAP_INIT", others++ ? "|" : "");
+	if (kt->m2p_map.flags & M2P_MAP_BUILDING)
+		fprintf(fp, "%sM2P_MAP_BUILDING", others++ ? "|" : "");
+	if (kt->m2p_map.flags & M2P_MAP_VALID)
+		fprintf(fp, "%sM2P_MAP_VALID", others++ ? "|" : "");
+	fprintf(fp, ")\n");
+	fprintf(fp, "                    run: %lx\n", (ulong)kt->m2p_map.run);
+	fprintf(fp, "                   runs: %ld\n", kt->m2p_map.runs);
+	fprintf(fp, "                   size: %ld\n", kt->m2p_map.size);
+	fprintf(fp, "                  pages: %ld\n", kt->m2p_map.pages);
+	fprintf(fp, "                lookups: %ld\n", kt->m2p_map.lookups);
+
 	if (!symbol_exists("xen_p2m_addr")) {
 		fprintf(fp, "              pvops_xen:\n");
 		fprintf(fp, "                    p2m_top: %lx\n", kt->pvops_xen.p2m_top);
@@ -10004,11 +10049,18 @@ xen_m2p(ulonglong machine)
 static ulong
 __xen_m2p(ulonglong machine, ulong mfn)
 {
-	ulong c, i, kmfn, mapping, p, pfn;
-	ulong start, end;
+	ulong c, i, kmfn, p, pfn;
 	ulong *mp = (ulong *)kt->m2p_page;
 	int memtype;
 
+	if (!(kt->m2p_map.flags & M2P_MAP_INIT))
+		xen_m2p_map_init();
+	else if (kt->m2p_map.flags & M2P_MAP_BUILDING)
+		xen_m2p_map_free();
+
+	if (kt->m2p_map.flags & M2P_MAP_VALID)
+		return xen_m2p_map_lookup(mfn);
+
 	if (XEN_CORE_DUMPFILE() && symbol_exists("xen_p2m_addr"))
 		memtype = PHYSADDR;
 	else
@@ -10056,6 +10108,21 @@ __xen_m2p(ulonglong machine, ulong mfn)
 		}
 	}
 
+	return xen_m2p_search(machine, mfn);
+}
+
+/*
+ *  Search the p2m tree/array from the beginning for the page containing
+ *  the mfn.  While the m2p map is being built, the search is done for an
+ *  mfn that can never be found, so that every mapping page gets visited.
+ */
+static ulong
+xen_m2p_search(ulonglong machine, ulong mfn)
+{
+	ulong c, i, mapping, p, pfn;
+	ulong start, end;
+	ulong *mp = (ulong *)kt->m2p_page;
+
 	if (PVOPS_XEN()) {
 		/*
 		 *  The machine address was not cached, so search from the
@@ -10096,6 +10163,7 @@ __xen_m2p(ulonglong machine, ulong mfn)
 			}
 	
 			kt->p2m_pages_searched++;
+			xen_m2p_map_add(p);
 	
 			if (search_mapping_page(mfn, &i, &start, &end)) {
 				pfn = p + i;
@@ -10124,6 +10192,180 @@ __xen_m2p(ulonglong machine, ulong mfn)
 	return (XEN_MFN_NOT_FOUND);
 }
 
+/*
+ *  The m2p map is the complete p2m table inverted into runs of 
+ *  contiguous mfns that map to contiguous pfns, sorted by mfn.  It is
+ *  built once, on the first m2p translation of a dumpfile, by walking 
+ *  every p2m mapping page; the runs array is grown as each page is added.
+ *  Each run also records the highest mfn reached by it or any run before
+ *  it, so that a lookup can find every run that overlaps an mfn.
+ *  Live systems keep using the search and cache, since their p2m table
+ *  may change.
+ */
+static void
+xen_m2p_map_init(void)
+{
+	struct xen_m2p_map *m2p;
+	struct xen_m2p_run *run;
+	ulong i;
+
+	m2p = &kt->m2p_map;
+	m2p->flags |= M2P_MAP_INIT;
+
+	if (ACTIVE() || !kt->m2p_page)
+		return;
+
+	m2p->flags |= M2P_MAP_BUILDING;
+	m2p->size = XEN_PFNS_PER_PAGE;
+	if (!(m2p->run = (struct xen_m2p_run *)
+	    malloc(m2p->size * sizeof(struct xen_m2p_run)))) {
+		m2p->flags &= ~M2P_MAP_BUILDING;
+		return;
+	}
+
+	xen_m2p_search(0, XEN_MFN_NOT_FOUND);
+
+	if (!(m2p->flags & M2P_MAP_BUILDING)) 
+		return;
+
+	qsort(m2p->run, m2p->runs, sizeof(struct xen_m2p_run), compare_m2p_run);
+
+	for (i = 0; i < m2p->runs; i++) {
+		run = &m2p->run[i];
+		run->reach = run->mfn + run->count;
+		if (i && (run[-1].reach > run->reach))
+			run->reach = run[-1].reach;
+	}
+
+	m2p->flags &= ~M2P_MAP_BUILDING;
+	m2p->flags |= M2P_MAP_VALID;
+
+	if (CRASHDEBUG(1))
+		error(INFO, "m2p map: %ld pages %ld runs\n", 
+			m2p->pages, m2p->runs);
+}
+
+/*
+ *  Add the mfns of the mapping page in kt->m2p_page, which begins 
+ *  at pfn, to the m2p map that is being built.
+ */
+static void
+xen_m2p_map_add(ulong pfn)
+{
+	struct xen_m2p_map *m2p;
+	struct xen_m2p_run *run, *new;
+	ulong i, kmfn;
+	ulong *mp;
+
+	m2p = &kt->m2p_map;
+	if (!(m2p->flags & M2P_MAP_BUILDING))
+		return;
+
+	mp = (ulong *)kt->m2p_page;
+	m2p->pages++;
+
+	for (i = 0; i < XEN_PFNS_PER_PAGE; i++, pfn++) {
+		if (mp[i] == XEN_MFN_NOT_FOUND)
+			continue;
+
+		kmfn = mp[i] & ~XEN_FOREIGN_FRAME;
+
+		if (m2p->runs) {
+			run = &m2p->run[m2p->runs-1];
+			if ((kmfn == (run->mfn + run->count)) &&
+			    (pfn == (run->pfn + run->count))) {
+				run->count++;
+				continue;
+			}
+		}
+
+		if (m2p->runs == m2p->size) {
+			if (!(new = (struct xen_m2p_run *)realloc(m2p->run, 
+			    m2p->size * 2 * sizeof(struct xen_m2p_run)))) {
+				error(INFO, "cannot realloc m2p map\n");
+				xen_m2p_map_free();
+				return;
+			}
+			m2p->run = new;
+			m2p->size *= 2;
+		}
+
+		run = &m2p->run[m2p->runs++];
+		run->mfn = kmfn;
+		run->pfn = pfn;
+		run->count = 1;
+	}
+}
+
+static void
+xen_m2p_map_free(void)
+{
+	struct xen_m2p_map *m2p;
+
+	m2p = &kt->m2p_map;
+
+	if (m2p->run)
+		free(m2p->run);
+	m2p->run = NULL;
+	m2p->runs = m2p->size = 0;
+	m2p->flags &= ~(M2P_MAP_BUILDING|M2P_MAP_VALID);
+}
+
+static int
+compare_m2p_run(const void *v1, const void *v2)
+{
+	struct xen_m2p_run *r1, *r2;
+
+	r1 = (struct xen_m2p_run *)v1;
+	r2 = (struct xen_m2p_run *)v2;
+
+	if (r1->mfn != r2->mfn)
+		return (r1->mfn < r2->mfn ? -1 : 1);
+
+	return (r1->pfn < r2->pfn ? -1 : r1->pfn == r2->pfn ? 0 : 1);
+}
+
+static ulong
+xen_m2p_map_lookup(ulong mfn)
+{
+	struct xen_m2p_map *m2p;
+	struct xen_m2p_run *run;
+	long lo, hi, mid;
+	ulong pfn;
+
+	m2p = &kt->m2p_map;
+	m2p->lookups++;
+
+	/*
+	 *  Find the last run starting at or below the mfn.
+	 */
+	lo = 0;
+	hi = m2p->runs - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (m2p->run[mid].mfn <= mfn)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	/*
+	 *  Walk back over the runs that may still contain the mfn.  If the
+	 *  mfn is mapped more than once, return its lowest pfn, which is
+	 *  the one that a search of the p2m table finds first.
+	 */
+	for (pfn = XEN_MFN_NOT_FOUND; hi >= 0; hi--) {
+		run = &m2p->run[hi];
+		if (mfn >= run->reach)
+			break;
+		if ((mfn < (run->mfn + run->count)) &&
+		    ((run->pfn + (mfn - run->mfn)) < pfn))
+			pfn = run->pfn + (mfn - run->mfn);
+	}
+
+	return pfn;
+}
+
 static ulong
 __xen_pvops_m2p_l2(ulonglong machine, ulong mfn)
 {
@@ -10149,6 +10391,7 @@ __xen_pvops_m2p_l2(ulonglong machine, ulong mfn)
 		}
 
 		kt->p2m_pages_searched++;
+		xen_m2p_map_add(p);
 
 		if (search_mapping_page(mfn, &i, &start, &end)) {
 			pfn = p + i;
@@ -10206,11 +10449,13 @@ __xen_pvops_m2p_l3(ulonglong machine, ulong mfn)
 				kt->last_mapping_read = mapping;
 			}
 
+			p = i * XEN_P2M_MID_PER_PAGE * XEN_P2M_PER_PAGE;
+			p += j * XEN_P2M_PER_PAGE;
+			xen_m2p_map_add(p);
+
 			if (!search_mapping_page(mfn, &k, &start, &end))
 				continue;
 
-			p = i * XEN_P2M_MID_PER_PAGE * XEN_P2M_PER_PAGE;
-			p += j * XEN_P2M_PER_PAGE;
 			pfn = p + k;
 
 			if (CRASHDEBUG(1))
@@ -10255,6 +10500,7 @@ __xen_pvops_m2p_hyper(ulonglong machine, ulong mfn)
 		}
 
 		kt->p2m_pages_searched++;
+		xen_m2p_map_add(p * XEN_PFNS_PER_PAGE);
 
 		if (search_mapping_page(mfn, &i, &start, &end)) {
 			pfn = p * XEN_PFNS_PER_PAGE + i;
@@ -10381,6 +10627,7 @@ __xen_pvops_m2p_domU(ulonglong machine, ulong mfn)
 			kt->last_mapping_read = mapping;
 		}
 		kt->p2m_pages_searched++;
+		xen_m2p_map_add(p * XEN_PFNS_PER_PAGE);
 
 		if (search_mapping_page(mfn, &i, &start, &end)) {
 			pfn = p * XEN_PFNS_PER_PAGE + i;
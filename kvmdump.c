@@ -30,6 +30,7 @@ static void write_mapfile_registers(void);
 static void write_mapfile_trailer(void);
 static void read_mapfile_trailer(void);
 static void read_mapfile_registers(void);
+static void kvmdump_map_table_init(void);
 
 #define RAM_OFFSET_COMPRESSED (~(off_t)255)
 #define QEMU_COMPRESSED       ((WRITE_ERROR)-1)
@@ -127,12 +128,22 @@ kvmdump_init(char *filename, FILE *fptr)
 		break;
 	}
 
-        if ((cachebuf = calloc(1, KVMDUMP_CACHED_PAGES * page_size)) == NULL)
-                error(FATAL, "%s: cannot malloc KVM page_cache_buf\n");
+	if (!kvm->cached_pages)
+		kvm->cached_pages = KVMDUMP_CACHED_PAGES;
 
-	for (i = 0; i < KVMDUMP_CACHED_PAGES; i++) {
+        if ((cachebuf = calloc(1, kvm->cached_pages * page_size)) == NULL)
+                error(FATAL, "cannot malloc KVM page_cache_buf\n");
+	if ((kvm->page_cache = calloc(kvm->cached_pages, 
+	    sizeof(struct kvm_page_cache_hdr))) == NULL)
+                error(FATAL, "cannot malloc KVM page_cache\n");
+	if ((kvm->page_hash = malloc(kvm->cached_pages * sizeof(int))) == NULL)
+                error(FATAL, "cannot malloc KVM page_hash\n");
+
+	for (i = 0; i < kvm->cached_pages; i++) {
 		kvm->page_cache[i].paddr = CACHE_UNUSED;
 		kvm->page_cache[i].bufptr = cachebuf + (i * page_size);
+		kvm->page_cache[i].next = -1;
+		kvm->page_hash[i] = -1;
 	}
 
 	kvmdump_regs_store(KVMDUMP_REGS_START, NULL);
@@ -153,6 +164,8 @@ kvmdump_init(char *filename, FILE *fptr)
 			break;
 		}
 
+		kvmdump_map_table_init();
+
 		for (cp = pc->cmd_table; cp->name; cp++) {
 			if (STREQ(cp->name, "map")) {
 				cp->flags &= ~HIDDEN_COMMAND;
@@ -269,7 +282,13 @@ kvmdump_memory_dump(FILE *ofp)
         fprintf(ofp, "   map_start_offset: %llx\n", (ulonglong)kvm->mapinfo.map_start_offset);
         fprintf(ofp, "           checksum: %llx\n", (ulonglong)kvm->mapinfo.checksum);
 
+	fprintf(ofp, "        map_table: %lx\n", (ulong)kvm->map_table);
+	fprintf(ofp, "      map_entries: %ld\n", kvm->map_entries);
+	fprintf(ofp, "         map_base: %lx (%s)\n", (ulong)kvm->map_base,
+		kvm->map_base ? "mmap" : kvm->map_table ? "malloc" : "unused");
+	fprintf(ofp, "         map_size: %ld\n", (ulong)kvm->map_size);
 	fprintf(ofp, "        curbufptr: %lx\n", (ulong)kvm->un.curbufptr);
+	fprintf(ofp, "     cached_pages: %d\n", kvm->cached_pages);
 	fprintf(ofp, "      evict_index: %d\n", kvm->evict_index);
 	fprintf(ofp, "         accesses: %ld\n", kvm->accesses);
 	fprintf(ofp, "        hit_count: %ld ", kvm->hit_count);
@@ -285,7 +304,7 @@ kvmdump_memory_dump(FILE *ofp)
 	else
 		fprintf(ofp, "\n");
 
-	for (i = 0; i < KVMDUMP_CACHED_PAGES; i++) {
+	for (i = 0; i < kvm->cached_pages; i++) {
 		if (kvm->page_cache[i].paddr == CACHE_UNUSED)
 			fprintf(ofp, "   %spage_cache[%d]: CACHE_UNUSED\n", 
 				i < 10 ? " " : "", i);
@@ -513,6 +532,33 @@ kvmdump_phys_base(unsigned long *phys_base)
         return FALSE;
 }
 
+/*
+ *  The page cache is hashed on the page frame number; the cached_pages
+ *  entries are recycled in round-robin order, so an entry being evicted
+ *  is first unlinked from its current hash chain.
+ */
+static void
+kvm_page_cache_unhash(int idx)
+{
+	struct kvm_page_cache_hdr *pgc;
+	int *link;
+
+	pgc = &kvm->page_cache[idx];
+	if (pgc->paddr == CACHE_UNUSED)
+		return;
+
+	for (link = &kvm->page_hash[KVM_PAGE_HASH(pgc->paddr)]; *link >= 0; 
+	     link = &kvm->page_cache[*link].next) {
+		if (*link == idx) {
+			*link = pgc->next;
+			break;
+		}
+	}
+
+	pgc->paddr = CACHE_UNUSED;
+	pgc->next = -1;
+}
+
 static int
 cache_page(physaddr_t paddr)
 {
@@ -523,19 +569,20 @@ cache_page(physaddr_t paddr)
 
 	kvm->accesses++;
 
-	for (idx = 0; idx < KVMDUMP_CACHED_PAGES; idx++) {
+	for (idx = kvm->page_hash[KVM_PAGE_HASH(paddr)]; idx >= 0; 
+	     idx = pgc->next) {
 		pgc = &kvm->page_cache[idx];
 
-		if (pgc->paddr == CACHE_UNUSED)
-			continue;
-
 		if (pgc->paddr == paddr) {
 			kvm->hit_count++;
 			kvm->un.curbufptr = pgc->bufptr;
+			PROFILE_COUNT(cache_hits);
 			return idx;
 		}
 	}
 
+	PROFILE_COUNT(cache_misses);
+
 	if ((err = load_mapfile_offset(paddr, &offset)) < 0)
 		return err;
 
@@ -549,18 +596,16 @@ cache_page(physaddr_t paddr)
 	pgc = &kvm->page_cache[idx];
         page_size = memory_page_size();
 
-	if (lseek(kvm->vmfd, offset, SEEK_SET) < 0) {
-		pgc->paddr = CACHE_UNUSED;
-		return SEEK_ERROR;
-	}
-	if (read(kvm->vmfd, pgc->bufptr, page_size) != page_size) {
-		pgc->paddr = CACHE_UNUSED;
+	kvm_page_cache_unhash(idx);
+
+	if (pread(kvm->vmfd, pgc->bufptr, page_size, offset) != page_size)
 		return READ_ERROR;
-	}
 
-	kvm->evict_index = (idx+1) % KVMDUMP_CACHED_PAGES;
+	kvm->evict_index = (idx+1) % kvm->cached_pages;
 
 	pgc->paddr = paddr;
+	pgc->next = kvm->page_hash[KVM_PAGE_HASH(paddr)];
+	kvm->page_hash[KVM_PAGE_HASH(paddr)] = idx;
 	kvm->un.curbufptr = pgc->bufptr;
 
 	return idx;
@@ -635,6 +680,19 @@ load_mapfile_offset(uint64_t physaddr, off_t *entry_ptr)
 		}
 		break;
 	}
+
+	if (kvm->map_table) {
+		if ((kvm_addr/4096) >= kvm->map_entries) {
+			if (CRASHDEBUG(1))
+				error(INFO, "load_mapfile_offset: "
+				    "physical: %llx beyond %s entries\n",
+					(unsigned long long)physaddr, 
+					mapfile_in_use());
+			return READ_ERROR;
+		}
+		*entry_ptr = kvm->map_table[kvm_addr/4096];
+		return 0;
+	}
  
 	if (lseek(kvm->mapfd, mapfile_offset(kvm_addr), SEEK_SET) < 0) {
 		if (CRASHDEBUG(1))
@@ -1049,6 +1107,67 @@ read_mapfile_registers(void)
 	kvm->flags |= REGS_FROM_MAPFILE;
 }
 
+/*
+ *  Once the mapfile is complete, bring its page offset entries into memory
+ *  so that load_mapfile_offset() no longer needs an lseek() and read() on
+ *  the mapfile for every uncached page.  The entries occupy the space
+ *  between the start of the map and the optional register set and trailer
+ *  at its end.  The map is mmap'd if possible, and otherwise read into a 
+ *  malloc'd array; if neither works, the file-based lookup remains in use.
+ */
+static void
+kvmdump_map_table_init(void)
+{
+	off_t start, end, base;
+	uint64_t regs[2];   /* ncpus, magic */
+	size_t pad;
+	char *p;
+
+	if ((end = lseek(kvm->mapfd, 0, SEEK_END)) < 0)
+		return;
+
+	end -= sizeof(struct mapinfo_trailer);
+	if ((pread(kvm->mapfd, regs, sizeof(regs), end - sizeof(regs)) ==
+	    sizeof(regs)) && (regs[1] == REGS_MAGIC) && (regs[0] < NR_CPUS))
+		end -= sizeof(regs) + (regs[0] * sizeof(struct register_set));
+
+	start = mapfile_offset(0);
+	if (end <= start)
+		return;
+
+	kvm->map_entries = (end - start)/sizeof(off_t);
+
+	base = start & ~((off_t)memory_page_size() - 1);
+	pad = start - base;
+	kvm->map_size = pad + (kvm->map_entries * sizeof(off_t));
+
+	p = mmap(NULL, kvm->map_size, PROT_READ, MAP_PRIVATE, kvm->mapfd, base);
+	if (p != MAP_FAILED) {
+		kvm->map_base = p;
+		kvm->map_table = (off_t *)(p + pad);
+		return;
+	}
+
+	kvm->map_size = kvm->map_entries * sizeof(off_t);
+	if ((p = malloc(kvm->map_size)) == NULL)
+		goto bailout;
+
+	if (pread(kvm->mapfd, p, kvm->map_size, start) != kvm->map_size) {
+		free(p);
+		goto bailout;
+	}
+
+	kvm->map_table = (off_t *)p;
+	return;
+
+bailout:
+	if (CRASHDEBUG(1))
+		error(INFO, "%s: cannot load map entries into memory\n", 
+			mapfile_in_use());
+	kvm->map_entries = 0;
+	kvm->map_size = 0;
+}
+
 void
 set_kvmhost_type(char *host)
 {
@@ -1068,6 +1187,26 @@ set_kvmhost_type(char *host)
 		error(INFO, "invalid --kvmhost argument: %s\n", host);
 }
 
+/*
+ *  set_kvm_cache_size() is called from main() with the --kvmcache
+ *  command line argument, the number of pages to hold in the page cache.
+ */
+void
+set_kvm_cache_size(char *optarg)
+{
+	ulong pages;
+
+	if (!decimal(optarg, 0) || !(pages = stol(optarg, QUIET, NULL)) ||
+	    (pages > KVMDUMP_MAX_CACHED_PAGES)) {
+		error(INFO, "invalid --kvmcache argument: %s\n", optarg);
+		return;
+	}
+
+	kvm->cached_pages = 1;
+	while (kvm->cached_pages < pages)
+		kvm->cached_pages <<= 1;
+}
+
 /*
  *  set_kvm_iohole() is called from main() with a command line argument,
  *  or from the x86/x86_64_init functions for assistance in determining
@@ -40,7 +40,8 @@ struct register_set {
 #define MAPFILE_MAGIC (0xfeedbabedeadbeefULL)
 #define CHKSUM_SIZE   (4096)
 
-#define KVMDUMP_CACHED_PAGES 32
+#define KVMDUMP_CACHED_PAGES     256    /* default, see --kvmcache */
+#define KVMDUMP_MAX_CACHED_PAGES (1 << 20)
 
 struct kvmdump_data {
 	ulong flags;
@@ -53,7 +54,15 @@ struct kvmdump_data {
         struct kvm_page_cache_hdr {
                 uint64_t paddr;
                	char *bufptr;
-        } page_cache[KVMDUMP_CACHED_PAGES];
+		int next;             /* page_hash chain */
+        } *page_cache;
+	int *page_hash;
+	int cached_pages;
+	/* in-memory copy of the mapfile offset entries */
+	off_t *map_table;
+	ulong map_entries;
+	void *map_base;
+	size_t map_size;
 	union {
 		char *curbufptr;
 		unsigned char compressed;
@@ -69,6 +78,9 @@ struct kvmdump_data {
 	uint64_t iohole;
 };
 
+#define KVM_PAGE_HASH(paddr) \
+	((int)(((paddr) >> 12) & (kvm->cached_pages - 1)))
+
 #define TMPFILE              (0x2)
 #define MAPFILE              (0x4)
 #define MAPFILE_FOUND        (0x8)
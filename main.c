@@ -63,6 +63,10 @@ static struct option long_options[] = {
 	{"mod", required_argument, 0, 0},
 	{"kvmhost", required_argument, 0, 0},
 	{"kvmio", required_argument, 0, 0},
+	{"kvmcache", required_argument, 0, 0},
+	{"rearrange", required_argument, 0, 0},
+	{"server", required_argument, 0, 0},
+	{"jobs", required_argument, 0, 0},
 	{"no_elf_notes", 0, 0, 0},
 	{"osrelease", required_argument, 0, 0},
 	{"log", required_argument, 0, 0},
@@ -266,6 +270,26 @@ main(int argc, char **argv)
 		        else if (STREQ(long_options[option_index].name, "kvmio"))
 				set_kvm_iohole(optarg);
 
+		        else if (STREQ(long_options[option_index].name, "kvmcache"))
+				set_kvm_cache_size(optarg);
+
+		        else if (STREQ(long_options[option_index].name, "rearrange"))
+				set_flat_rearrange_file(optarg);
+
+		        else if (STREQ(long_options[option_index].name, "server"))
+				set_server_socket(optarg);
+
+		        else if (STREQ(long_options[option_index].name, "jobs")) {
+				if (!decimal(optarg, 0) ||
+				    ((pc->jobs = atoi(optarg)) < 1) ||
+				    (pc->jobs > MAX_INPUT_JOBS)) {
+					error(INFO, 
+					    "invalid --jobs argument: %s\n",
+						optarg);
+					program_usage(SHORT_FORM);
+				}
+			}
+
 		        else if (STREQ(long_options[option_index].name, "osrelease")) {
 				pc->flags2 |= GET_OSRELEASE;
 				get_osrelease(optarg);
@@ -822,6 +846,9 @@ main_loop(void)
 	if (pc->flags & PRELOAD_EXTENSIONS)
 		preload_extensions();
 
+	if (pc->flags2 & SERVER_MODE)
+		server_init();
+
 	/*
 	 *  Return here if a non-recoverable error occurs
 	 *  during command execution.
@@ -854,6 +881,7 @@ exec_command(void)
 {
 	struct command_table_entry *ct;
 	struct args_input_file args_ifile;
+	int profile;
 
         if (args[0] && (args[0][0] == '\\') && args[0][1]) {
 		shift_string_left(args[0], 1);
@@ -887,11 +915,24 @@ reattempt:
                 pc->curcmd = ct->name;
 		pc->cmdgencur++;
 
+		if (MEMTRACING())
+			memtrace_command(pc->orig_line);
+
+		/*
+		 *  Commands such as "repeat" re-enter here; only the
+		 *  outermost command is profiled.
+		 */
+		if ((profile = !PROFILING()))
+			profile_command_start();
+
 		if (is_args_input_file(ct, &args_ifile))
 			exec_args_input_file(ct, &args_ifile);
 		else
 			(*ct->func)();
 
+		if (profile)
+			profile_command_end();
+
                 pc->lastcmd = pc->curcmd;
                 pc->curcmd = pc->program_name;
                 return;
@@ -1135,6 +1176,7 @@ setup_environment(int argc, char **argv)
 	machdep->verify_paddr = generic_verify_paddr;
 	machdep->get_kvaddr_ranges = generic_get_kvaddr_ranges;
 	machdep->is_page_ptr = generic_is_page_ptr;
+	machdep->walk_range = generic_walk_range;
 	pc->redhat_debug_loc = DEFAULT_REDHAT_DEBUG_LOCATION;
 	pc->cmdgencur = 0;
 	pc->cmd_table = linux_command_table;
@@ -1502,6 +1544,8 @@ dump_program_context(void)
 		fprintf(fp, "%sREDZONE", others++ ? "|" : "");
 	if (pc->flags2 & VMWARE_VMSS_GUESTDUMP)
 		fprintf(fp, "%sVMWARE_VMSS_GUESTDUMP", others++ ? "|" : "");
+	if (pc->flags2 & SERVER_MODE)
+		fprintf(fp, "%sSERVER_MODE", others++ ? "|" : "");
 	fprintf(fp, ")\n");
 
 	fprintf(fp, "         namelist: %s\n", pc->namelist);
@@ -1543,6 +1587,7 @@ dump_program_context(void)
 	fprintf(fp, "            ifile: %lx\n", (ulong)pc->ifile);
 	fprintf(fp, "            ofile: %lx\n", (ulong)pc->ofile);
 	fprintf(fp, "       ifile_pipe: %lx\n", (ulong)pc->ifile_pipe);
+	fprintf(fp, "           filter: %lx\n", (ulong)pc->filter);
 	fprintf(fp, "      ifile_ofile: %lx\n", (ulong)pc->ifile_ofile);
 	fprintf(fp, "       args_ifile: %lx\n", (ulong)pc->args_ifile);
 	fprintf(fp, "       input_file: %s\n", pc->input_file);
@@ -1615,6 +1660,9 @@ dump_program_context(void)
 	if (pc->redirect & REDIRECT_MULTI_PIPE)
 		sprintf(&buf[strlen(buf)], 
 			"%sREDIRECT_MULTI_PIPE", others++ ? "|" : "");
+	if (pc->redirect & REDIRECT_TO_FILTER)
+		sprintf(&buf[strlen(buf)], 
+			"%sREDIRECT_TO_FILTER", others++ ? "|" : "");
 	if (pc->redirect)
 		strcat(buf, ")");
 
@@ -1748,6 +1796,18 @@ dump_program_context(void)
 	fprintf(fp, "  read_vmcoreinfo: %lx\n", (ulong)pc->read_vmcoreinfo);
 	fprintf(fp, "         error_fp: %lx\n", (ulong)pc->error_fp);
 	fprintf(fp, "       error_path: %s\n", pc->error_path);
+	fprintf(fp, "    profile flags: %lx (%s%s%s%s)\n", prof->flags,
+		prof->flags & PROFILE_ON ? "PROFILE_ON " : "",
+		prof->flags & PROFILE_FILE ? "PROFILE_FILE " : "",
+		prof->flags & PROFILE_ACTIVE ? "PROFILE_ACTIVE " : "",
+		prof->flags & PROFILE_PENDING ? "PROFILE_PENDING " : "");
+	fprintf(fp, "    server_socket: %s\n",
+		pc->server_socket ? pc->server_socket : "(none)");
+	fprintf(fp, "        server_fd: %d\n", pc->server_fd);
+	fprintf(fp, "        client_fd: %d\n", pc->client_fd);
+	fprintf(fp, "             jobs: %d\n", pc->jobs);
+	fprintf(fp, "         memtrace: %s\n",
+		pc->memtrace ? pc->memtrace : "(none)");
 }
 
 char *
@@ -1850,6 +1910,10 @@ clean_exit(int status)
 		unlink(pc->namelist_debug);
 	if (pc->cleanup && file_exists(pc->cleanup, NULL))
 		unlink(pc->cleanup);
+	if ((pc->flags2 & SERVER_MODE) && (pc->server_fd >= 0))
+		unlink(pc->server_socket);
+	if (MEMTRACING())
+		memtrace_close();
 
 	ramdump_cleanup();
 	exit(status);
@@ -24,6 +24,10 @@
 #include <byteswap.h>
 
 static void flattened_format_get_osrelease(char *);
+static char *flat_index_path(char *, struct stat64 *, int, char *);
+static int load_flat_index(char *, struct stat64 *);
+static void save_flat_index(char *, struct stat64 *);
+static int rearrange_flat_data(int, int, struct makedumpfile_data_header *);
 
 int flattened_format = 0;
 
@@ -37,12 +41,27 @@ struct all_flat_data {
 	unsigned long long	num_array;
 	struct flat_data	*array;
 	size_t			file_size;
+	void			*index_map;	/* mmap'd sidecar index */
+	size_t			index_map_size;
+	char			*index_file;
 };
 
 struct all_flat_data afd;
 
 struct makedumpfile_header fh_save;
 
+static char *rearrange_file = NULL;
+
+/*
+ *  --rearrange <file>: while the flattened dumpfile is being indexed,
+ *  also write its data out to a regular, seekable dumpfile.
+ */
+void
+set_flat_rearrange_file(char *file)
+{
+	rearrange_file = file;
+}
+
 static int
 is_bigendian(void)
 {
@@ -70,20 +89,27 @@ store_flat_data_array(char *file, struct flat_data **fda)
 	ulonglong		pct, last_pct;
 	char			buf[BUFSIZE];
 	ssize_t			bytes_read;
+	int			rfd = -1;
 
 	fd = open(file, O_RDONLY);
 	if (fd < 0) {
 		error(INFO, "unable to open dump file %s\n", file);
 		return -1;
 	}
-	if (lseek(fd, MAX_SIZE_MDF_HEADER, SEEK_SET) < 0) {
-		error(INFO, "%s: seek error (flat format)\n", file);
+	if (rearrange_file && 
+	    (rfd = open(rearrange_file, O_WRONLY|O_CREAT|O_TRUNC, 0600)) < 0) {
+		error(INFO, "unable to create rearranged dump file %s: %s\n",
+			rearrange_file, strerror(errno));
 		close(fd);
 		return -1;
 	}
+	if (lseek(fd, MAX_SIZE_MDF_HEADER, SEEK_SET) < 0) {
+		error(INFO, "%s: seek error (flat format)\n", file);
+		goto bailout;
+	}
 	if (stat64(file, &stat) < 0) {
 		error(INFO, "cannot stat64 %s\n", file);
-                return -1;
+		goto bailout;
 	}
 
 	please_wait("sorting flat format data");
@@ -158,6 +184,16 @@ store_flat_data_array(char *file, struct flat_data **fda)
 			offset_report = fdh.offset;
 		}
 
+		if (rfd >= 0) {
+			/* copy the data, leaving the file at the next header. */
+			if (!rearrange_flat_data(fd, rfd, &fdh)) {
+				error(INFO, "%s: cannot write rearranged data\n", 
+					rearrange_file);
+				break;
+			}
+			continue;
+		}
+
 		/* seek for next makedumpfile_data_header. */
 		if (lseek(fd, fdh.buf_size, SEEK_CUR) < 0) {
 			error(INFO, "%s: seek error (flat format)\n", file);
@@ -167,6 +203,15 @@ store_flat_data_array(char *file, struct flat_data **fda)
 	please_wait_done();
 
 	close(fd);
+	if (rfd >= 0) {
+		if (close(rfd) < 0)
+			result = FALSE;
+		if (result == TRUE)
+			fprintf(fp, "rearranged dump file written to %s\n", 
+				rearrange_file);
+		else
+			unlink(rearrange_file);
+	}
 	if (result == FALSE) {
 		free(ptr);
 		return -1;
@@ -174,6 +219,187 @@ store_flat_data_array(char *file, struct flat_data **fda)
 	*fda = ptr;
 
 	return num_stored;
+
+bailout:
+	close(fd);
+	if (rfd >= 0) {
+		close(rfd);
+		unlink(rearrange_file);
+	}
+	return -1;
+}
+
+/*
+ *  Copy the data following a makedumpfile_data_header to its location
+ *  in the rearranged dumpfile.
+ */
+static int
+rearrange_flat_data(int fd, int rfd, struct makedumpfile_data_header *fdh)
+{
+	static char *buf = NULL;
+	int64_t offset, remain;
+	size_t size;
+
+#define REARRANGE_BUFSIZE (1024*1024)
+
+	if (!buf && !(buf = malloc(REARRANGE_BUFSIZE)))
+		return FALSE;
+
+	for (offset = fdh->offset, remain = fdh->buf_size; remain > 0; ) {
+		size = MIN(remain, REARRANGE_BUFSIZE);
+		if (read(fd, buf, size) != size)
+			return FALSE;
+		if (pwrite(rfd, buf, size, offset) != size)
+			return FALSE;
+		offset += size;
+		remain -= size;
+	}
+
+	return TRUE;
+}
+
+/*
+ *  The sidecar index is kept next to the dumpfile, or if that directory
+ *  is not writable, in $TMPDIR (or /var/tmp) under a name made from the
+ *  dumpfile's device and inode numbers.  Since those directories may be
+ *  shared, load_flat_index() only accepts an index that is owned by the
+ *  user and is not writable by group or others.
+ */
+static char *
+flat_index_path(char *file, struct stat64 *st, int alt, char *buf)
+{
+	char *dir;
+
+	if (!alt) {
+		if ((strlen(file) + strlen(FLAT_INDEX_SUFFIX)) >= PATH_MAX)
+			return NULL;
+		sprintf(buf, "%s%s", file, FLAT_INDEX_SUFFIX);
+	} else {
+		if (!(dir = getenv("TMPDIR")) || !strlen(dir))
+			dir = "/var/tmp";
+		if ((strlen(dir) + 64) >= PATH_MAX)
+			return NULL;
+		sprintf(buf, "%s/crash.%llx.%llx%s", dir, 
+			(ulonglong)st->st_dev, (ulonglong)st->st_ino, 
+			FLAT_INDEX_SUFFIX);
+	}
+
+	return buf;
+}
+
+static int
+load_flat_index(char *file, struct stat64 *st)
+{
+	int alt, fd;
+	char path[PATH_MAX];
+	struct flat_index_header *hdr;
+	struct stat64 istat;
+	size_t size;
+	void *map;
+
+	for (alt = 0; alt < 2; alt++) {
+		if (!flat_index_path(file, st, alt, path))
+			continue;
+		if ((fd = open(path, O_RDONLY)) < 0)
+			continue;
+		if ((fstat64(fd, &istat) < 0) || 
+		    (istat.st_size < sizeof(struct flat_index_header))) {
+			close(fd);
+			continue;
+		}
+		/*
+		 *  Its offsets direct every read of the dumpfile, so only
+		 *  an index that no other user could have written is used.
+		 */
+		if (!S_ISREG(istat.st_mode) || (istat.st_uid != getuid()) ||
+		    (istat.st_mode & (S_IWGRP|S_IWOTH))) {
+			if (CRASHDEBUG(1))
+				error(INFO, "%s: ignoring index not owned by "
+					"user or writable by others\n", path);
+			close(fd);
+			continue;
+		}
+		size = istat.st_size;
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			continue;
+
+		hdr = (struct flat_index_header *)map;
+		if (strncmp(hdr->signature, FLAT_INDEX_SIGNATURE, 
+		    sizeof(hdr->signature)) ||
+		    (hdr->version != FLAT_INDEX_VERSION) ||
+		    (hdr->dev != (int64_t)st->st_dev) ||
+		    (hdr->ino != (int64_t)st->st_ino) ||
+		    (hdr->size != (int64_t)st->st_size) ||
+		    (hdr->mtime != (int64_t)st->st_mtime) ||
+		    (hdr->num_array <= 0) ||
+		    (size != sizeof(struct flat_index_header) + 
+		    (hdr->num_array * sizeof(struct flat_data)))) {
+			if (CRASHDEBUG(1))
+				error(INFO, "%s: stale or invalid index\n", path);
+			munmap(map, size);
+			continue;
+		}
+
+		afd.num_array = hdr->num_array;
+		afd.array = (struct flat_data *)(hdr + 1);
+		afd.index_map = map;
+		afd.index_map_size = size;
+		afd.index_file = strdup(path);
+
+		if (CRASHDEBUG(1))
+			fprintf(fp, "makedumpfile: using index %s\n", path);
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ *  Failure to save the index is not an error; the dumpfile simply 
+ *  gets indexed again the next time.
+ */
+static void
+save_flat_index(char *file, struct stat64 *st)
+{
+	int alt, fd;
+	char path[PATH_MAX], tmp[PATH_MAX+32];
+	struct flat_index_header hdr;
+	size_t size;
+
+	BZERO(&hdr, sizeof(struct flat_index_header));
+	strncpy(hdr.signature, FLAT_INDEX_SIGNATURE, sizeof(hdr.signature));
+	hdr.version = FLAT_INDEX_VERSION;
+	hdr.dev = st->st_dev;
+	hdr.ino = st->st_ino;
+	hdr.size = st->st_size;
+	hdr.mtime = st->st_mtime;
+	hdr.num_array = afd.num_array;
+	size = afd.num_array * sizeof(struct flat_data);
+
+	for (alt = 0; alt < 2; alt++) {
+		if (!flat_index_path(file, st, alt, path))
+			continue;
+		sprintf(tmp, "%s.%d", path, getpid());
+		if ((fd = open(tmp, O_WRONLY|O_CREAT|O_EXCL, 0600)) < 0)
+			continue;
+		if ((write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) ||
+		    (write(fd, afd.array, size) != size) ||
+		    (close(fd) < 0) || (rename(tmp, path) < 0)) {
+			unlink(tmp);
+			continue;
+		}
+
+		afd.index_file = strdup(path);
+		if (CRASHDEBUG(1))
+			fprintf(fp, "makedumpfile: saved index %s\n", path);
+		return;
+	}
+
+	if (CRASHDEBUG(1))
+		error(INFO, "%s: cannot save flat format index\n", file);
 }
 
 static int
@@ -182,6 +408,13 @@ read_all_makedumpfile_data_header(char *file)
 	unsigned long long	num;
 	struct flat_data	*fda = NULL;
 	long long retval;
+	struct stat64 stat;
+	int identity;
+
+	identity = (stat64(file, &stat) == 0) && S_ISREG(stat.st_mode);
+
+	if (identity && !rearrange_file && load_flat_index(file, &stat))
+		return TRUE;
 
 	retval = num = store_flat_data_array(file, &fda);
 	if (retval < 0)
@@ -190,6 +423,9 @@ read_all_makedumpfile_data_header(char *file)
 	afd.num_array = num;
 	afd.array     = fda;
 
+	if (identity)
+		save_flat_index(file, &stat);
+
 	return TRUE;
 }
 
@@ -364,7 +600,11 @@ dump_flat_header(FILE *ofp)
 	fprintf(ofp, "      all_flat_data:\n");
 	fprintf(ofp, "          num_array: %lld\n", (ulonglong)afd.num_array);
 	fprintf(ofp, "              array: %lx\n", (ulong)afd.array);
-	fprintf(ofp, "          file_size: %ld\n\n", (ulong)afd.file_size);
+	fprintf(ofp, "          file_size: %ld\n", (ulong)afd.file_size);
+	fprintf(ofp, "          index_map: %lx\n", (ulong)afd.index_map);
+	fprintf(ofp, "     index_map_size: %ld\n", (ulong)afd.index_map_size);
+	fprintf(ofp, "         index_file: %s\n\n", 
+		afd.index_file ? afd.index_file : "(none)");
 }
 
 static void 
@@ -44,3 +44,22 @@ struct makedumpfile_data_header {
 	int64_t buf_size;
 };
 
+
+/*
+ * crash sidecar index of a flattened dumpfile
+ *   The sorted flat_data array built from a flattened dumpfile is saved
+ *   following this header, which identifies the dumpfile it was built from.
+ */
+#define FLAT_INDEX_SIGNATURE    "crash flatidx"
+#define FLAT_INDEX_VERSION      (1)
+#define FLAT_INDEX_SUFFIX       ".flatidx"
+
+struct flat_index_header {
+	char    signature[16];  /* = "crash flatidx" */
+	int64_t version;
+	int64_t dev;
+	int64_t ino;
+	int64_t size;
+	int64_t mtime;
+	int64_t num_array;
+};
@@ -172,6 +172,7 @@ static int show_page_member_data(char *, ulong, struct meminfo *, char *);
 static void dump_mem_map(struct meminfo *);
 static void dump_mem_map_SPARSEMEM(struct meminfo *);
 static void fill_mem_map_cache(ulong, ulong, char *);
+static ulong prefetch_mem_map(ulong, ulong, ulong);
 static void page_flags_init(void);
 static int page_flags_init_from_pageflag_names(void);
 static int page_flags_init_from_pageflags_enum(void);
@@ -234,7 +235,12 @@ static void gather_slab_cached_count(struct meminfo *);
 static void dump_slab_objects(struct meminfo *);
 static void dump_slab_objects_percpu(struct meminfo *);
 static void dump_vmlist(struct meminfo *);
-static void dump_vmap_area(struct meminfo *);
+static void vmalloc_areas_free(void);
+static int compare_vmalloc_area(const void *, const void *);
+static void vmalloc_areas_init(void);
+static struct vmalloc_area *get_vmalloc_areas(void);
+static long vmalloc_area_search(ulong);
+static void show_vmalloc_area(struct vmalloc_area *);
 static int dump_page_lists(struct meminfo *);
 static void dump_kmeminfo(void);
 static int page_to_phys(ulong, physaddr_t *); 
@@ -257,6 +263,9 @@ static int next_physpage(ulonglong, ulonglong *);
 static int next_vmlist_vaddr(ulong, ulong *);
 static int next_module_vaddr(ulong, ulong *);
 static int next_identity_mapping(ulong, ulong *);
+static int vm_area_page_dump_leaf(struct walk_range_entry *, void *);
+static int vm_area_page_dump_page(ulong, ulong, int, physaddr_t,
+	struct reference *);
 static int vm_area_page_dump(ulong, ulong, ulong, ulong, ulong,
 	struct reference *);
 static void rss_page_types_init(void);
@@ -280,6 +289,12 @@ static ulong nr_blockdev_pages(void);
 static ulong nr_blockdev_pages_v2(void);
 void sparse_mem_init(void);
 void dump_mem_sections(int);
+static int compare_mem_map_range(const void *, const void *);
+static void mem_section_info_free(void);
+static void mem_section_info_init(void);
+static struct mem_section_info *get_mem_section_info(void);
+static int mem_map_range_search(ulong, physaddr_t *);
+static void export_page_range(ulong, ulong, ulong, char *);
 void dump_memory_blocks(int);
 void list_mem_sections(void);
 ulong sparse_decode_mem_map(ulong, ulong);
@@ -2310,7 +2325,7 @@ readmem(ulonglong addr, int memtype, void *buffer, long size,
 	int fd;
 	long cnt, orig_size;
 	physaddr_t paddr;
-	ulonglong pseudo;
+	ulonglong pseudo, orig_addr, trace_paddr;
 	char *bufptr;
 
 	if (CRASHDEBUG(4))
@@ -2318,8 +2333,13 @@ readmem(ulonglong addr, int memtype, void *buffer, long size,
 			addr, memtype_string(memtype, 1), type, size, 
 			error_handle_string(error_handle), (ulong)buffer);
 
+	if (PROFILING())
+		profile_readmem(memtype, size);
+
 	bufptr = (char *)buffer;
+	orig_addr = addr;
 	orig_size = size;
+	trace_paddr = (ulonglong)(-1);
 
 	if (size <= 0) {
 		if (PRINT_ERROR_MESSAGE)
@@ -2433,6 +2453,13 @@ readmem(ulonglong addr, int memtype, void *buffer, long size,
 		else
 			pc->curcmd_flags &= ~MEMTYPE_KVADDR;
 
+		PROFILE_COUNT(page_reads);
+		if (MEMTRACING()) {
+			if (trace_paddr == (ulonglong)(-1))
+				trace_paddr = paddr;
+			memtrace_page(paddr, cnt);
+		}
+
 		switch (READMEM(fd, bufptr, cnt, 
 		    (memtype == PHYSADDR) || (memtype == XENMACHADDR) ? 0 : addr, paddr))
 		{
@@ -2474,9 +2501,16 @@ readmem(ulonglong addr, int memtype, void *buffer, long size,
                 size -= cnt;
         }
 
+	if (MEMTRACING())
+		memtrace_readmem(orig_addr, memtype, orig_size, type,
+			trace_paddr, TRUE);
+
         return TRUE;
 
 readmem_error:
+	if (MEMTRACING())
+		memtrace_readmem(orig_addr, memtype, orig_size, type,
+			trace_paddr, FALSE);
 	
         switch (error_handle)
         {
@@ -2495,6 +2529,427 @@ readmem_error:
 	return FALSE;
 }
 
+/*
+ *  Ask the dumpfile backend to start reading the pages of a range that
+ *  is about to be scanned, so that the disk or network filesystem can
+ *  work on all of them while the scan reads them one at a time.  Only
+ *  the backends that can locate a page's file data cheaply take part;
+ *  the hint is given with posix_fadvise(POSIX_FADV_WILLNEED).  Since
+ *  each page is translated here and read again by the scan, it is only
+ *  worthwhile for the search, mem_map and SLUB slab scans, and not for
+ *  readmem() in general.
+ */
+void
+prefetch_readmem(ulonglong addr, int memtype, long size)
+{
+	physaddr_t paddrs[PREFETCH_BATCH];
+	physaddr_t paddr;
+	ulonglong end;
+	int n, pages;
+
+	if (!DUMPFILE() || REMOTE_DUMPFILE() || FLAT_FORMAT() ||
+	    !(pc->flags & (NETDUMP|KDUMP|DISKDUMP|SADUMP)))
+		return;
+
+	end = addr + size;
+	addr &= ~((ulonglong)PAGESIZE()-1);
+
+	for (n = pages = 0; (addr < end) && (pages < PREFETCH_MAX_PAGES); 
+	     addr += PAGESIZE(), pages++) {
+		if (memtype == KVADDR) {
+			if (!kvtop(CURRENT_CONTEXT(), addr, &paddr, 0))
+				continue;
+		} else
+			paddr = addr;
+
+		paddrs[n++] = paddr;
+		if (n == PREFETCH_BATCH) {
+			prefetch_physaddr(paddrs, n);
+			n = 0;
+		}
+	}
+
+	if (n)
+		prefetch_physaddr(paddrs, n);
+}
+
+/*
+ *  readmem() access tracing, enabled with "set memtrace <file>".  The
+ *  trace file starts with an 8-byte MEMTRACE_MAGIC string, and the 32-bit
+ *  version and page size, followed by variable-length records in host
+ *  byte order, each starting with a one-byte tag:
+ *
+ *    MEMTRACE_STRING   id (u16), length (u16), readmem type string
+ *    MEMTRACE_COMMAND  length (u16), command line
+ *    MEMTRACE_PAGE     count (u32), physical address (u64)
+ *    MEMTRACE_READMEM  memtype (u8), result (u8), type string id (u16),
+ *                      size (u32), address (u64), physical address (u64)
+ *
+ *  A MEMTRACE_PAGE record is written for each backend READMEM() call,
+ *  and the pages of a readmem() request precede its MEMTRACE_READMEM
+ *  record, which carries the physical address of its first page, or -1
+ *  if none was read.  The records of the readmem() calls made by kvtop()
+ *  to translate a request's addresses are interleaved with those pages.
+ *  The type strings are written once, the first time they are seen.
+ *
+ *  The trace is buffered, and only written by the process that opened
+ *  it, so that forked children do not write copies of the buffer.
+ */
+#define MEMTRACE_BUFSIZE   (1024*1024)
+#define MEMTRACE_STRINGS   (4096)     /* type string hash table size */
+#define MEMTRACE_OTHER     (0xffff)   /* type string table overflow id */
+
+static struct memtrace_data {
+	int fd;
+	pid_t pid;
+	unsigned char *buf;
+	long len;
+	int nr_strings;
+	struct memtrace_string {
+		char *type;
+		ulong hash;
+		ushort id;
+	} *strings;
+} memtrace_data = { .fd = -1 };
+
+static void
+memtrace_flush(void)
+{
+	struct memtrace_data *mt = &memtrace_data;
+	unsigned char *p;
+	ssize_t cnt;
+
+	for (p = mt->buf; (getpid() == mt->pid) && (p < mt->buf + mt->len); ) {
+		if ((cnt = write(mt->fd, p, mt->buf + mt->len - p)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		p += cnt;
+	}
+	mt->len = 0;
+}
+
+static void
+memtrace_put(void *rec, long len)
+{
+	struct memtrace_data *mt = &memtrace_data;
+
+	if ((mt->len + len) > MEMTRACE_BUFSIZE)
+		memtrace_flush();
+	memcpy(mt->buf + mt->len, rec, len);
+	mt->len += len;
+}
+
+int
+memtrace_open(char *file)
+{
+	struct memtrace_data *mt = &memtrace_data;
+	unsigned char header[16];
+	uint32_t val;
+	int fd;
+
+	/*
+	 *  Finish any current trace first, since it may be to the same file.
+	 */
+	memtrace_close();
+
+	if ((fd = open(file, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+		error(INFO, "%s: %s\n", file, strerror(errno));
+		return FALSE;
+	}
+
+	if (!(mt->buf = malloc(MEMTRACE_BUFSIZE)) ||
+	    !(mt->strings = calloc(MEMTRACE_STRINGS,
+	    sizeof(struct memtrace_string))) ||
+	    !(pc->memtrace = strdup(file))) {
+		error(INFO, "cannot malloc memtrace buffers\n");
+		close(fd);
+		free(mt->buf);
+		free(mt->strings);
+		mt->buf = NULL;
+		mt->strings = NULL;
+		return FALSE;
+	}
+
+	mt->fd = fd;
+	mt->pid = getpid();
+	mt->len = mt->nr_strings = 0;
+
+	memcpy(header, MEMTRACE_MAGIC, 8);
+	val = MEMTRACE_VERSION;
+	memcpy(header + 8, &val, sizeof(uint32_t));
+	val = PAGESIZE();
+	memcpy(header + 12, &val, sizeof(uint32_t));
+	memtrace_put(header, sizeof(header));
+
+	pc->flags2 |= MEMTRACE;
+
+	return TRUE;
+}
+
+void
+memtrace_close(void)
+{
+	struct memtrace_data *mt = &memtrace_data;
+	int i;
+
+	if (mt->fd < 0)
+		return;
+
+	pc->flags2 &= ~MEMTRACE;
+
+	memtrace_flush();
+	if (getpid() == mt->pid)
+		close(mt->fd);
+	mt->fd = -1;
+
+	for (i = 0; i < MEMTRACE_STRINGS; i++)
+		free(mt->strings[i].type);
+	free(mt->strings);
+	free(mt->buf);
+	mt->strings = NULL;
+	mt->buf = NULL;
+
+	free(pc->memtrace);
+	pc->memtrace = NULL;
+}
+
+/*
+ *  Return the id of a type string, writing a MEMTRACE_STRING record the
+ *  first time that it is seen.  The strings are hashed by content, since
+ *  some callers pass a buffer rather than a string constant.
+ */
+static ushort
+memtrace_string_id(char *type)
+{
+	struct memtrace_data *mt = &memtrace_data;
+	struct memtrace_string *s;
+	unsigned char rec[5];
+	ushort len;
+	ulong hash;
+	char *p;
+	int i;
+
+	if (!type)
+		type = "";
+
+	for (hash = 5381, p = type; *p; p++)
+		hash = (hash * 33) ^ (unsigned char)*p;
+
+	for (i = hash & (MEMTRACE_STRINGS-1); ;
+	     i = (i + 1) & (MEMTRACE_STRINGS-1)) {
+		s = &mt->strings[i];
+		if (!s->type)
+			break;
+		if ((s->hash == hash) && STREQ(s->type, type))
+			return s->id;
+	}
+
+	if ((mt->nr_strings >= (MEMTRACE_STRINGS/2)) ||
+	    !(s->type = strdup(type)))
+		return MEMTRACE_OTHER;
+
+	s->hash = hash;
+	s->id = mt->nr_strings++;
+
+	len = MIN(strlen(type), USHRT_MAX);
+	rec[0] = MEMTRACE_STRING;
+	memcpy(rec + 1, &s->id, sizeof(ushort));
+	memcpy(rec + 3, &len, sizeof(ushort));
+	memtrace_put(rec, sizeof(rec));
+	memtrace_put(type, len);
+
+	return s->id;
+}
+
+void
+memtrace_command(char *line)
+{
+	unsigned char rec[3];
+	ushort len;
+
+	len = strlen(line);
+	if (len && (line[len-1] == '\n'))
+		len--;
+
+	rec[0] = MEMTRACE_COMMAND;
+	memcpy(rec + 1, &len, sizeof(ushort));
+	memtrace_put(rec, sizeof(rec));
+	memtrace_put(line, len);
+}
+
+void
+memtrace_page(physaddr_t paddr, long cnt)
+{
+	unsigned char rec[13];
+	uint32_t count;
+	uint64_t addr;
+
+	count = cnt;
+	addr = paddr;
+	rec[0] = MEMTRACE_PAGE;
+	memcpy(rec + 1, &count, sizeof(uint32_t));
+	memcpy(rec + 5, &addr, sizeof(uint64_t));
+	memtrace_put(rec, sizeof(rec));
+}
+
+void
+memtrace_readmem(ulonglong addr, int memtype, long size, char *type,
+	ulonglong first_paddr, int result)
+{
+	unsigned char rec[25];
+	uint32_t count;
+	uint64_t paddr;
+	ushort id;
+
+	id = memtrace_string_id(type);
+	count = size;
+	paddr = first_paddr;
+
+	rec[0] = MEMTRACE_READMEM;
+	rec[1] = memtype;
+	rec[2] = result;
+	memcpy(rec + 3, &id, sizeof(ushort));
+	memcpy(rec + 5, &count, sizeof(uint32_t));
+	memcpy(rec + 9, &addr, sizeof(uint64_t));
+	memcpy(rec + 17, &paddr, sizeof(uint64_t));
+	memtrace_put(rec, sizeof(rec));
+}
+
+/*
+ *  Read the MEMTRACE_PAGE records of a trace file into an array that the
+ *  caller must free.  Returns the number of records, or -1 on failure.
+ */
+long
+memtrace_load_pages(char *file, struct memtrace_page **pages)
+{
+	FILE *tfp;
+	unsigned char header[16], rec[24];
+	struct memtrace_page *pp, *new;
+	long count, max;
+	uint32_t cnt;
+	uint64_t paddr;
+	ushort len;
+	int tag;
+
+	if (!(tfp = fopen(file, "r"))) {
+		error(INFO, "%s: %s\n", file, strerror(errno));
+		return -1;
+	}
+
+	if ((fread(header, sizeof(header), 1, tfp) != 1) ||
+	    memcmp(header, MEMTRACE_MAGIC, 8)) {
+		error(INFO, "%s: not a memtrace file\n", file);
+		fclose(tfp);
+		return -1;
+	}
+
+	pp = NULL;
+	count = max = 0;
+
+	while ((tag = fgetc(tfp)) != EOF) {
+		switch (tag)
+		{
+		case MEMTRACE_STRING:
+			if (fread(rec, 4, 1, tfp) != 1)
+				goto truncated;
+			memcpy(&len, rec + 2, sizeof(ushort));
+			if (fseek(tfp, len, SEEK_CUR) < 0)
+				goto truncated;
+			break;
+
+		case MEMTRACE_COMMAND:
+			if (fread(&len, sizeof(ushort), 1, tfp) != 1)
+				goto truncated;
+			if (fseek(tfp, len, SEEK_CUR) < 0)
+				goto truncated;
+			break;
+
+		case MEMTRACE_READMEM:
+			if (fread(rec, 24, 1, tfp) != 1)
+				goto truncated;
+			break;
+
+		case MEMTRACE_PAGE:
+			if (fread(rec, 12, 1, tfp) != 1)
+				goto truncated;
+			if (count == max) {
+				max = max ? max * 2 : 4096;
+				if (!(new = realloc(pp,
+				    max * sizeof(struct memtrace_page)))) {
+					error(INFO, "cannot malloc memtrace pages\n");
+					fclose(tfp);
+					free(pp);
+					return -1;
+				}
+				pp = new;
+			}
+			memcpy(&cnt, rec, sizeof(uint32_t));
+			memcpy(&paddr, rec + 4, sizeof(uint64_t));
+			pp[count].paddr = paddr;
+			pp[count].cnt = cnt;
+			count++;
+			break;
+
+		default:
+			error(INFO, "%s: invalid record type: %x\n", file, tag);
+			goto truncated;
+		}
+	}
+
+	fclose(tfp);
+	*pages = pp;
+	return count;
+
+truncated:
+	error(INFO, "%s: truncated memtrace file\n", file);
+	fclose(tfp);
+	free(pp);
+	return -1;
+}
+
+void
+prefetch_physaddr(physaddr_t *paddrs, int count)
+{
+	if (!DUMPFILE() || REMOTE_DUMPFILE() || FLAT_FORMAT() || !count)
+		return;
+
+	if (pc->flags & (NETDUMP|KDUMP))
+		netdump_prefetch(paddrs, count);
+	else if (pc->flags & DISKDUMP)
+		diskdump_prefetch(paddrs, count);
+	else if (pc->flags & SADUMP)
+		sadump_prefetch(paddrs, count);
+
+	prefetch_willneed(-1, 0, 0);
+}
+
+/*
+ *  Collect adjacent file ranges of the same file into a single advice;
+ *  an fd of -1 issues any pending advice.
+ */
+void
+prefetch_willneed(int fd, off_t offset, off_t len)
+{
+	static int pending_fd = -1;
+	static off_t pending_offset, pending_len;
+
+	if ((fd >= 0) && (fd == pending_fd) && 
+	    (offset == (pending_offset + pending_len))) {
+		pending_len += len;
+		return;
+	}
+
+	if ((pending_fd >= 0) && pending_len)
+		posix_fadvise(pending_fd, pending_offset, pending_len, 
+			POSIX_FADV_WILLNEED);
+
+	pending_fd = fd;
+	pending_offset = offset;
+	pending_len = len;
+}
+
 /*
  *  Accept anything...
  */
@@ -3146,6 +3601,8 @@ kvtop(struct task_context *tc, ulong kvaddr, physaddr_t *paddr, int verbose)
 {
 	physaddr_t unused;
 
+	PROFILE_COUNT(kvtop);
+
 	return (machdep->kvtop(tc ? tc : CURRENT_CONTEXT(), kvaddr, 
 		paddr ? paddr : &unused, verbose));
 }
@@ -3166,6 +3623,25 @@ uvtop(struct task_context *tc, ulong vaddr, physaddr_t *paddr, int verbose)
 	return(machdep->uvtop(tc, vaddr, paddr, verbose));
 }
 
+/*
+ *  Walk the user page tables of a task context from start up to end,
+ *  handing each leaf mapping to the callback in ascending address order.
+ *  Unmapped ranges are skipped.  The walk stops early if the callback
+ *  returns FALSE, in which case FALSE is returned to the caller.
+ */
+int
+walk_range(struct task_context *tc, ulong start, ulong end,
+	   walk_range_func func, void *data)
+{
+	if (!tc)
+		error(FATAL, "current context invalid\n");
+
+	if (start >= end)
+		return TRUE;
+
+	return(machdep->walk_range(tc, VIRTPAGEBASE(start), end, func, data));
+}
+
 /*
  *  The vtop command does a verbose translation of a user or kernel virtual
  *  address into it physical address.  The pte translation is shown by
@@ -4250,6 +4726,17 @@ vm_area_dump(ulong task, ulong flag, ulong vaddr, struct reference *ref)
 	return (ulong)NULL;
 }
 
+/*
+ *  State carried across machdep->walk_range() callbacks by
+ *  vm_area_page_dump().
+ */
+struct vm_page_dump_info {
+	ulong vma;
+	ulong next;
+	struct reference *ref;
+	int found;
+};
+
 static int
 vm_area_page_dump(ulong vma, 
 		  ulong task, 
@@ -4258,14 +4745,9 @@ vm_area_page_dump(ulong vma,
 		  ulong mm,
 		  struct reference *ref)
 {
-	physaddr_t paddr;
-	ulong offs;
-	char *p1, *p2;
-	int display;
+	struct vm_page_dump_info vi;
 	char buf1[BUFSIZE];
 	char buf2[BUFSIZE];
-	char buf3[BUFSIZE*2];
-	char buf4[BUFSIZE];
 
 	if (mm == symbol_value("init_mm"))
 		return FALSE;
@@ -4280,11 +4762,102 @@ vm_area_page_dump(ulong vma,
 		start = ref->ref2;
 	}
 
-	while (start < end) {
+	/*
+	 *  Let the page table walker find the mapped pages, and fill in
+	 *  the unmapped gaps between them (and after the last one) here.
+	 */
+	vi.vma = vma;
+	vi.next = start;
+	vi.ref = ref;
+	vi.found = FALSE;
 
-		display = DO_REF_SEARCH(ref) ? FALSE : TRUE;
-	
-		if (VM_REF_CHECK_HEXVAL(ref, start)) {
+	walk_range(task_to_context(task), start, end, 
+		vm_area_page_dump_leaf, &vi);
+
+	if (vi.found)
+		return TRUE;
+
+	for ( ; vi.next < end; vi.next += PAGESIZE()) {
+		if (vm_area_page_dump_page(vma, vi.next, FALSE, 0, ref))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ *  walk_range() callback for vm_area_page_dump().
+ */
+static int
+vm_area_page_dump_leaf(struct walk_range_entry *wre, void *data)
+{
+	struct vm_page_dump_info *vi;
+	ulong vaddr, leaf_end;
+	physaddr_t paddr;
+	int mapped;
+
+	vi = (struct vm_page_dump_info *)data;
+
+	for ( ; vi->next < wre->vaddr; vi->next += PAGESIZE()) {
+		if (vm_area_page_dump_page(vi->vma, vi->next, FALSE, 0, vi->ref))
+			goto found;
+	}
+
+	mapped = wre->flags & WALK_RANGE_PRESENT ? TRUE : FALSE;
+	leaf_end = wre->vaddr + wre->size;
+
+	for (vaddr = wre->vaddr; vaddr < leaf_end; vaddr += PAGESIZE()) {
+		paddr = mapped ? wre->paddr + (vaddr - wre->vaddr) : wre->paddr;
+		if (vm_area_page_dump_page(vi->vma, vaddr, mapped, paddr, vi->ref))
+			goto found;
+	}
+
+	vi->next = leaf_end;
+	return TRUE;
+
+found:
+	vi->found = TRUE;
+	return FALSE;
+}
+
+/*
+ *  Display (or perform a reference search on) a single user page of a vma,
+ *  given the uvtop()-style translation result.  Returns TRUE if a reference
+ *  search matched, recording the page in ref->ref2.
+ */
+static int
+vm_area_page_dump_page(ulong vma, ulong start, int mapped, physaddr_t paddr,
+		       struct reference *ref)
+{
+	ulong offs;
+	char *p1, *p2;
+	int display;
+	char buf1[BUFSIZE];
+	char buf2[BUFSIZE];
+	char buf3[BUFSIZE*2];
+	char buf4[BUFSIZE];
+
+	display = DO_REF_SEARCH(ref) ? FALSE : TRUE;
+
+	if (VM_REF_CHECK_HEXVAL(ref, start)) {
+		if (DO_REF_DISPLAY(ref)) 
+			display = TRUE;
+		else {
+			ref->cmdflags |= VM_REF_PAGE;
+			ref->ref2 = start;
+			return TRUE;
+		}
+	}
+
+	if (mapped) {
+		sprintf(buf3, "%s  %s\n",
+			mkstring(buf1, UVADDR_PRLEN, LJUST|LONG_HEX,
+			MKSTR(start)),
+			mkstring(buf2, MAX(PADDR_PRLEN, 
+			strlen("PHYSICAL")), RJUST|LONGLONG_HEX, 
+			MKSTR(&paddr)));
+
+		if (VM_REF_CHECK_HEXVAL(ref, paddr)) {
 			if (DO_REF_DISPLAY(ref)) 
 				display = TRUE;
 			else {
@@ -4294,16 +4867,17 @@ vm_area_page_dump(ulong vma,
 			}
 		}
 
-                if (uvtop(task_to_context(task), start, &paddr, 0)) {
-			sprintf(buf3, "%s  %s\n",
-				mkstring(buf1, UVADDR_PRLEN, LJUST|LONG_HEX,
-				MKSTR(start)),
-                	        mkstring(buf2, MAX(PADDR_PRLEN, 
-				strlen("PHYSICAL")), RJUST|LONGLONG_HEX, 
-				MKSTR(&paddr)));
+	} else if (paddr && swap_location(paddr, buf1)) {
+
+		sprintf(buf3, "%s  SWAP: %s\n",
+		    mkstring(buf2, UVADDR_PRLEN, LJUST|LONG_HEX,
+			MKSTR(start)), buf1);
 
-			if (VM_REF_CHECK_HEXVAL(ref, paddr)) {
-				if (DO_REF_DISPLAY(ref)) 
+		if (DO_REF_SEARCH(ref)) { 
+			if (VM_REF_CHECK_DECVAL(ref, 
+			    THIS_KERNEL_VERSION >= LINUX(2,6,0) ?
+			    __swp_offset(paddr) : SWP_OFFSET(paddr))) {
+				if (DO_REF_DISPLAY(ref))
 					display = TRUE;
 				else {
 					ref->cmdflags |= VM_REF_PAGE;
@@ -4312,71 +4886,49 @@ vm_area_page_dump(ulong vma,
 				}
 			}
 
-                } else if (paddr && swap_location(paddr, buf1)) {
-
-			sprintf(buf3, "%s  SWAP: %s\n",
-			    mkstring(buf2, UVADDR_PRLEN, LJUST|LONG_HEX,
-                                MKSTR(start)), buf1);
-
-			if (DO_REF_SEARCH(ref)) { 
-				if (VM_REF_CHECK_DECVAL(ref, 
-				    THIS_KERNEL_VERSION >= LINUX(2,6,0) ?
-				    __swp_offset(paddr) : SWP_OFFSET(paddr))) {
-					if (DO_REF_DISPLAY(ref))
-						display = TRUE;
-					else {
-						ref->cmdflags |= VM_REF_PAGE;
-						ref->ref2 = start;
-						return TRUE;
-					}
-				}
-
-				strcpy(buf4, buf3);
-				p1 = strstr(buf4, "SWAP:") + strlen("SWAP: ");
-				p2 = strstr(buf4, "  OFFSET:");
-				*p2 = NULLCHAR;
-				if (VM_REF_CHECK_STRING(ref, p1)) {
-					if (DO_REF_DISPLAY(ref))
-						display = TRUE;
-					else {
-						ref->cmdflags |= VM_REF_PAGE;
-						ref->ref2 = start;
-						return TRUE;
-					}
-				}
-			}
-                } else if (vma_file_offset(vma, start, buf1)) {
-
-                        sprintf(buf3, "%s  FILE: %s\n", 
-			    mkstring(buf2, UVADDR_PRLEN, LJUST|LONG_HEX,
-                                MKSTR(start)), buf1);
-
-			if (DO_REF_SEARCH(ref)) {
-			 	extract_hex(strstr(buf3, "OFFSET:") + 
-					strlen("OFFSET: "), &offs, 0, 0);
-
-				if (VM_REF_CHECK_HEXVAL(ref, offs)) {
-					if (DO_REF_DISPLAY(ref))
-						display = TRUE;
-					else {
-						ref->cmdflags |= VM_REF_PAGE;
-				        	ref->ref2 = start;
-						return TRUE;
-					}
+			strcpy(buf4, buf3);
+			p1 = strstr(buf4, "SWAP:") + strlen("SWAP: ");
+			p2 = strstr(buf4, "  OFFSET:");
+			*p2 = NULLCHAR;
+			if (VM_REF_CHECK_STRING(ref, p1)) {
+				if (DO_REF_DISPLAY(ref))
+					display = TRUE;
+				else {
+					ref->cmdflags |= VM_REF_PAGE;
+					ref->ref2 = start;
+					return TRUE;
 				}
 			}
-                } else {
-                        sprintf(buf3, "%s  (not mapped)\n", 
-			    mkstring(buf1, UVADDR_PRLEN, LJUST|LONG_HEX,
-                                MKSTR(start)));
 		}
+	} else if (vma_file_offset(vma, start, buf1)) {
+
+		sprintf(buf3, "%s  FILE: %s\n", 
+		    mkstring(buf2, UVADDR_PRLEN, LJUST|LONG_HEX,
+			MKSTR(start)), buf1);
 
-		if (display)
-			fprintf(fp, "%s", buf3);
+		if (DO_REF_SEARCH(ref)) {
+			extract_hex(strstr(buf3, "OFFSET:") + 
+				strlen("OFFSET: "), &offs, 0, 0);
 
-		start += PAGESIZE();
+			if (VM_REF_CHECK_HEXVAL(ref, offs)) {
+				if (DO_REF_DISPLAY(ref))
+					display = TRUE;
+				else {
+					ref->cmdflags |= VM_REF_PAGE;
+					ref->ref2 = start;
+					return TRUE;
+				}
+			}
+		}
+	} else {
+		sprintf(buf3, "%s  (not mapped)\n", 
+		    mkstring(buf1, UVADDR_PRLEN, LJUST|LONG_HEX,
+			MKSTR(start)));
 	}
 
+	if (display)
+		fprintf(fp, "%s", buf3);
+
 	return FALSE;
 }
 
@@ -5644,7 +6196,7 @@ dump_mem_map_SPARSEMEM(struct meminfo *mi)
 	ulong i;
 	long total_pages;
 	int others, page_not_mapped, phys_not_mapped, page_mapping;
-	ulong pp, ppend;
+	ulong pp, ppend, mem_map_end, prefetched;
 	physaddr_t phys, physend;
 	ulong tmp, reserved, shared, slabs;
         ulong PG_reserved_flag;
@@ -5795,7 +6347,7 @@ dump_mem_map_SPARSEMEM(struct meminfo *mi)
 		break;
 	}
 
-	page_cache = GETBUF(SIZE(page) * PGMM_CACHED);
+	page_cache = GETBUF_NOZERO(SIZE(page) * PGMM_CACHED);
 	done = FALSE;
 	total_pages = 0;
 
@@ -5855,6 +6407,8 @@ dump_mem_map_SPARSEMEM(struct meminfo *mi)
 		pp = sparse_decode_mem_map(pp, section_nr);
 		phys = (physaddr_t) section_nr * PAGES_PER_SECTION() * PAGESIZE();
 		section_size = PAGES_PER_SECTION();
+		mem_map_end = pp + (section_size * SIZE(page));
+		prefetched = 0;
 
 		for (i = 0; i < section_size; 
 		     i++, pp += SIZE(page), phys += PAGESIZE()) {
@@ -5873,6 +6427,9 @@ dump_mem_map_SPARSEMEM(struct meminfo *mi)
 					continue;
 				}  
 
+				if (!pg_spec && !phys_spec)
+					prefetched = prefetch_mem_map(pp,
+						mem_map_end, prefetched);
 				fill_mem_map_cache(pp, ppend, page_cache);
 			}
 
@@ -6128,7 +6685,7 @@ dump_mem_map(struct meminfo *mi)
 	long i, n;
 	long total_pages;
 	int others, page_not_mapped, phys_not_mapped, page_mapping;
-	ulong pp, ppend;
+	ulong pp, ppend, mem_map_end, prefetched;
 	physaddr_t phys, physend;
 	ulong tmp, reserved, shared, slabs;
         ulong PG_reserved_flag;
@@ -6284,7 +6841,7 @@ dump_mem_map(struct meminfo *mi)
 		break;
 	}
 
-	page_cache = GETBUF(SIZE(page) * PGMM_CACHED);
+	page_cache = GETBUF_NOZERO(SIZE(page) * PGMM_CACHED);
 	done = FALSE;
 	total_pages = 0;
 
@@ -6306,6 +6863,8 @@ dump_mem_map(struct meminfo *mi)
 			node_size = vt->max_mapnr;
 		else
 			node_size = nt->size;
+		mem_map_end = pp + (node_size * SIZE(page));
+		prefetched = 0;
 
 		for (i = 0; i < node_size; 
 		     i++, pp += SIZE(page), phys += PAGESIZE()) {
@@ -6323,6 +6882,9 @@ dump_mem_map(struct meminfo *mi)
 					continue;
 				}  
 
+				if (!pg_spec && !phys_spec)
+					prefetched = prefetch_mem_map(pp,
+						mem_map_end, prefetched);
 				fill_mem_map_cache(pp, ppend, page_cache);
 			}
 
@@ -6626,6 +7188,25 @@ fill_mem_map_cache(ulong pp, ulong ppend, char *page_cache)
         }
 }
 
+/*
+ *  Keep the dumpfile pages of a mem_map scan up to PREFETCH_BATCH pages
+ *  ahead of the page structures being read, stopping at end.  Returns the
+ *  address up to which the mem_map has been prefetched.
+ */
+static ulong
+prefetch_mem_map(ulong pp, ulong end, ulong prefetched)
+{
+	ulong size;
+
+	if ((pp < prefetched) || (pp >= end))
+		return prefetched;
+
+	size = MIN(end - pp, PREFETCH_BATCH * PAGESIZE());
+	prefetch_readmem(pp, KVADDR, size);
+
+	return pp + size;
+}
+
 static void
 dump_hstates()
 {
@@ -8943,277 +9524,315 @@ nr_blockdev_pages_v2(void)
 }
 
 /*
- *  dump_vmlist() displays information from the vmlist.
+ *  The vmap_area_list, or the vmlist on older kernels, is read into
+ *  vt->vmalloc_areas, sorted by address, the first time it is needed,
+ *  and again by each command on a live system.  kmem, search -k and
+ *  the vmalloc address checks then binary search the table instead
+ *  of walking the kernel list for every address.
  */
+static void
+vmalloc_areas_free(void)
+{
+	free(vt->vmalloc_areas);
+	vt->vmalloc_areas = NULL;
+	vt->nr_vmalloc_areas = 0;
+}
+
+static int
+compare_vmalloc_area(const void *v1, const void *v2)
+{
+	const struct vmalloc_area *va1 = v1, *va2 = v2;
+
+	if (va1->start < va2->start)
+		return -1;
+	return (va1->start > va2->start) ? 1 : 0;
+}
 
 static void
-dump_vmlist(struct meminfo *vi)
+vmalloc_areas_init(void)
 {
-	char buf[BUFSIZE];
-	char buf1[BUFSIZE];
-	char buf2[BUFSIZE];
-	ulong vmlist;
-	ulong addr, size, next, pcheck, count, verified; 
-	physaddr_t paddr;
-	int mod_vmlist;
+	int i, cnt, mod_vmlist;
+	long count, max;
+	ulong vmlist, next, flags, addr, size;
+	struct vmalloc_area *va;
+	struct list_data list_data, *ld;
+	char *vmap_area_buf;
 
-	if (vt->flags & USE_VMAP_AREA) {
-		dump_vmap_area(vi);
-		return;
-	}
+#define VM_VM_AREA 0x4   /* mm/vmalloc.c */
 
-	get_symbol_data("vmlist", sizeof(void *), &vmlist);
-	next = vmlist;
-	count = verified = 0;
-	mod_vmlist = kernel_symbol_exists("mod_vmlist");
+	vmalloc_areas_free();
+	count = 0;
 
-	while (next) {
-		if (!(pc->curcmd_flags & HEADER_PRINTED) && (next == vmlist) && 
-		    !(vi->flags & (GET_HIGHEST|GET_PHYS_TO_VMALLOC|
-		      GET_VMLIST_COUNT|GET_VMLIST|VMLIST_VERIFY))) {
-			fprintf(fp, "%s  ", 
-			    mkstring(buf, MAX(strlen("VM_STRUCT"), VADDR_PRLEN),
-			    	CENTER|LJUST, "VM_STRUCT"));
-			fprintf(fp, "%s    SIZE\n",
-			    mkstring(buf, (VADDR_PRLEN * 2) + strlen(" - "),
-				CENTER|LJUST, "ADDRESS RANGE"));
-			pc->curcmd_flags |= HEADER_PRINTED;
+	if (vt->flags & USE_VMAP_AREA) {
+		ld = &list_data;
+		BZERO(ld, sizeof(struct list_data));
+		ld->flags = LIST_HEAD_FORMAT|LIST_HEAD_POINTER|LIST_ALLOCATE;
+		get_symbol_data("vmap_area_list", sizeof(void *), &ld->start);
+		ld->list_head_offset = OFFSET(vmap_area_list);
+		ld->end = symbol_value("vmap_area_list");
+		cnt = do_list(ld);
+		if (cnt < 0) {
+			error(WARNING, "invalid/corrupt vmap_area_list\n");
+			return;
 		}
 
-                readmem(next+OFFSET(vm_struct_addr), KVADDR, 
-			&addr, sizeof(void *),
-                        "vmlist addr", FAULT_ON_ERROR);
-                readmem(next+OFFSET(vm_struct_size), KVADDR, 
-			&size, sizeof(ulong),
-                        "vmlist size", FAULT_ON_ERROR);
+		va = (struct vmalloc_area *)
+			GETBUF(sizeof(struct vmalloc_area) * (cnt+1));
+		vmap_area_buf = GETBUF(SIZE(vmap_area));
 
-		if (vi->flags & (GET_VMLIST_COUNT|GET_VMLIST)) {
-			/*
-			 *  Preceding GET_VMLIST_COUNT set vi->retval.
-			 */
-			if (vi->flags & GET_VMLIST) {
-				if (count < vi->retval) {
-					vi->vmlist[count].addr = addr;
-					vi->vmlist[count].size = size;
-				}
-			}
+		for (i = 0; i < cnt; i++) {
+			readmem(ld->list_ptr[i], KVADDR, vmap_area_buf,
+				SIZE(vmap_area), "vmap_area struct", FAULT_ON_ERROR);
+
+			if (VALID_MEMBER(vmap_area_flags) &&
+			    VALID_MEMBER(vmap_area_purge_list)) {
+				flags = ULONG(vmap_area_buf + OFFSET(vmap_area_flags));
+				if (flags != VM_VM_AREA)
+					continue;
+			} else if (!ULONG(vmap_area_buf + OFFSET(vmap_area_vm)))
+				continue;
+
+			va[count].vmap_area = ld->list_ptr[i];
+			va[count].vm_struct = ULONG(vmap_area_buf +
+				OFFSET(vmap_area_vm));
+			va[count].start = ULONG(vmap_area_buf +
+				OFFSET(vmap_area_va_start));
+			va[count].end = ULONG(vmap_area_buf +
+				OFFSET(vmap_area_va_end));
 			count++;
-			goto next_entry;
 		}
 
-		if (!(vi->flags & ADDRESS_SPECIFIED) || 
-		    ((vi->memtype == KVADDR) &&
-		    ((vi->spec_addr >= addr) && (vi->spec_addr < (addr+size))))) {
-			if (vi->flags & VMLIST_VERIFY) {
-				verified++;
-				break;
-			}	
-			fprintf(fp, "%s%s  %s - %s  %6ld\n",
-				mkstring(buf,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
-				MKSTR(next)), space(MINSPACE-1),
-				mkstring(buf1, VADDR_PRLEN, LONG_HEX|RJUST,
-				MKSTR(addr)),
-				mkstring(buf2, VADDR_PRLEN, LONG_HEX|LJUST,
-				MKSTR(addr+size)),
-				size);
-		}
-
-		if ((vi->flags & ADDRESS_SPECIFIED) && 
-		     (vi->memtype == PHYSADDR)) {
-			for (pcheck = addr; pcheck < (addr+size); 
-			     pcheck += PAGESIZE()) {
-				if (!kvtop(NULL, pcheck, &paddr, 0))
-					continue;
-		    		if ((vi->spec_addr >= paddr) && 
-				    (vi->spec_addr < (paddr+PAGESIZE()))) {
-					if (vi->flags & GET_PHYS_TO_VMALLOC) {
-						vi->retval = pcheck +
-						    PAGEOFFSET(vi->spec_addr);
-						return;
-				        } else
-						fprintf(fp,
-						"%s%s  %s - %s  %6ld\n",
-						mkstring(buf, VADDR_PRLEN,
-						LONG_HEX|CENTER|LJUST,
-						MKSTR(next)), space(MINSPACE-1),
-						mkstring(buf1, VADDR_PRLEN,
-						LONG_HEX|RJUST, MKSTR(addr)),
-						mkstring(buf2, VADDR_PRLEN,
-						LONG_HEX|LJUST,
-						MKSTR(addr+size)), size);
-					break;
-				}
+		FREEBUF(vmap_area_buf);
+		FREEBUF(ld->list_ptr);
+	} else {
+		max = 64;
+		va = (struct vmalloc_area *)
+			GETBUF(sizeof(struct vmalloc_area) * max);
+
+		get_symbol_data("vmlist", sizeof(void *), &vmlist);
+		next = vmlist;
+		mod_vmlist = kernel_symbol_exists("mod_vmlist");
+
+		while (next) {
+			readmem(next+OFFSET(vm_struct_addr), KVADDR,
+				&addr, sizeof(void *),
+				"vmlist addr", FAULT_ON_ERROR);
+			readmem(next+OFFSET(vm_struct_size), KVADDR,
+				&size, sizeof(ulong),
+				"vmlist size", FAULT_ON_ERROR);
+
+			if (count == max) {
+				RESIZEBUF(va, sizeof(struct vmalloc_area) * max,
+					sizeof(struct vmalloc_area) * max * 2);
+				max *= 2;
 			}
+			va[count].vmap_area = 0;
+			va[count].vm_struct = next;
+			va[count].start = addr;
+			va[count].end = addr + size;
+			count++;
 
+			readmem(next+OFFSET(vm_struct_next),
+				KVADDR, &next, sizeof(void *),
+				"vmlist next", FAULT_ON_ERROR);
+
+			if (!next && mod_vmlist) {
+				get_symbol_data("mod_vmlist", sizeof(void *), &next);
+				mod_vmlist = FALSE;
+			}
 		}
-next_entry:
-                readmem(next+OFFSET(vm_struct_next), 
-			KVADDR, &next, sizeof(void *),
-                        "vmlist next", FAULT_ON_ERROR);
-		
-		if (!next && mod_vmlist) {
-			get_symbol_data("mod_vmlist", sizeof(void *), &next);
-			mod_vmlist = FALSE;
-		}
 	}
 
-	if (vi->flags & GET_HIGHEST)
-		vi->retval = addr+size;
+	qsort(va, count, sizeof(struct vmalloc_area), compare_vmalloc_area);
+
+	if (!(vt->vmalloc_areas = (struct vmalloc_area *)
+	    malloc(sizeof(struct vmalloc_area) * (count+1)))) {
+		FREEBUF(va);
+		error(FATAL, "cannot malloc vmalloc area table\n");
+	}
+	BCOPY(va, vt->vmalloc_areas, sizeof(struct vmalloc_area) * count);
+	vt->nr_vmalloc_areas = count;
+	vt->vmalloc_areas_gen = pc->cmdgencur;
+	FREEBUF(va);
+}
+
+static struct vmalloc_area *
+get_vmalloc_areas(void)
+{
+	if (ACTIVE() && vt->vmalloc_areas &&
+	    (vt->vmalloc_areas_gen != pc->cmdgencur))
+		vmalloc_areas_free();
 
-	if (vi->flags & GET_VMLIST_COUNT)
-		vi->retval = count;
+	if (!vt->vmalloc_areas)
+		vmalloc_areas_init();
 
-	if (vi->flags & VMLIST_VERIFY)
-		vi->retval = verified;
+	return vt->vmalloc_areas;
+}
+
+/*
+ *  Return the index of the first vmalloc area that ends above vaddr,
+ *  or vt->nr_vmalloc_areas if there is none.  The areas do not overlap,
+ *  so their end addresses are sorted as well.
+ */
+static long
+vmalloc_area_search(ulong vaddr)
+{
+	long lo, hi, mid;
+
+	lo = 0;
+	hi = vt->nr_vmalloc_areas;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (vt->vmalloc_areas[mid].end > vaddr)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return lo;
 }
 
 static void
-dump_vmap_area(struct meminfo *vi)
+show_vmalloc_area(struct vmalloc_area *va)
 {
-	int i, cnt;
-	ulong start, end, vm_struct, flags, vm;
-	struct list_data list_data, *ld;
-	char *vmap_area_buf; 
-	ulong size, pcheck, count, verified; 
-	physaddr_t paddr;
 	char buf1[BUFSIZE];
 	char buf2[BUFSIZE];
 	char buf3[BUFSIZE];
 	char buf4[BUFSIZE];
 
-#define VM_VM_AREA 0x4   /* mm/vmalloc.c */
+	if (vt->flags & USE_VMAP_AREA)
+		fprintf(fp, "%s%s  %s%s  %s - %s  %7ld\n",
+			mkstring(buf1,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
+			MKSTR(va->vmap_area)), space(MINSPACE-1),
+			mkstring(buf2,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
+			MKSTR(va->vm_struct)), space(MINSPACE-1),
+			mkstring(buf3, VADDR_PRLEN, LONG_HEX|RJUST,
+			MKSTR(va->start)),
+			mkstring(buf4, VADDR_PRLEN, LONG_HEX|LJUST,
+			MKSTR(va->end)),
+			va->end - va->start);
+	else
+		fprintf(fp, "%s%s  %s - %s  %6ld\n",
+			mkstring(buf1,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
+			MKSTR(va->vm_struct)), space(MINSPACE-1),
+			mkstring(buf2, VADDR_PRLEN, LONG_HEX|RJUST,
+			MKSTR(va->start)),
+			mkstring(buf3, VADDR_PRLEN, LONG_HEX|LJUST,
+			MKSTR(va->end)),
+			va->end - va->start);
+}
+
+/*
+ *  dump_vmlist() displays information from the vmap_area_list or vmlist.
+ */
+
+static void
+dump_vmlist(struct meminfo *vi)
+{
+	char buf[BUFSIZE];
+	struct vmalloc_area *va;
+	ulong pcheck;
+	physaddr_t paddr;
+	long i;
+
+	if (!get_vmalloc_areas()) {
+		vi->retval = 0;
+		return;
+	}
+
+	if (vi->flags & GET_VMLIST_COUNT) {
+		vi->retval = vt->nr_vmalloc_areas;
+		return;
+	}
 
-	vmap_area_buf = GETBUF(SIZE(vmap_area));
-	start = count = verified = size = 0;
+	if (vi->flags & GET_VMLIST) {
+		/*
+		 *  Preceding GET_VMLIST_COUNT set vi->retval.
+		 */
+		for (i = 0; (i < vt->nr_vmalloc_areas) && (i < vi->retval); i++) {
+			va = &vt->vmalloc_areas[i];
+			vi->vmlist[i].addr = va->start;
+			vi->vmlist[i].size = va->end - va->start;
+		}
+		return;
+	}
 
-	ld = &list_data;
-	BZERO(ld, sizeof(struct list_data));
-	ld->flags = LIST_HEAD_FORMAT|LIST_HEAD_POINTER|LIST_ALLOCATE;
-	get_symbol_data("vmap_area_list", sizeof(void *), &ld->start);
-	ld->list_head_offset = OFFSET(vmap_area_list);
-	ld->end = symbol_value("vmap_area_list");
-	cnt = do_list(ld);
-	if (cnt < 0) {
-		FREEBUF(vmap_area_buf);
-		error(WARNING, "invalid/corrupt vmap_area_list\n"); 
-		vi->retval = 0;
+	if (vi->flags & GET_HIGHEST) {
+		vi->retval = vt->nr_vmalloc_areas ?
+			vt->vmalloc_areas[vt->nr_vmalloc_areas-1].end : 0;
 		return;
 	}
 
-	for (i = 0; i < cnt; i++) {
-		if (!(pc->curcmd_flags & HEADER_PRINTED) && (i == 0) && 
-		    !(vi->flags & (GET_HIGHEST|GET_PHYS_TO_VMALLOC|
-		      GET_VMLIST_COUNT|GET_VMLIST|VMLIST_VERIFY))) {
-			fprintf(fp, "%s  ", 
-			    mkstring(buf1, MAX(strlen("VMAP_AREA"), VADDR_PRLEN),
+	if (!(pc->curcmd_flags & HEADER_PRINTED) && vt->nr_vmalloc_areas &&
+	    !(vi->flags & (GET_PHYS_TO_VMALLOC|VMLIST_VERIFY))) {
+		if (vt->flags & USE_VMAP_AREA) {
+			fprintf(fp, "%s  ",
+			    mkstring(buf, MAX(strlen("VMAP_AREA"), VADDR_PRLEN),
 			    	CENTER|LJUST, "VMAP_AREA"));
-			fprintf(fp, "%s  ", 
-			    mkstring(buf1, MAX(strlen("VM_STRUCT"), VADDR_PRLEN),
+			fprintf(fp, "%s  ",
+			    mkstring(buf, MAX(strlen("VM_STRUCT"), VADDR_PRLEN),
 			    	CENTER|LJUST, "VM_STRUCT"));
 			fprintf(fp, "%s     SIZE\n",
-			    mkstring(buf1, (VADDR_PRLEN * 2) + strlen(" - "),
+			    mkstring(buf, (VADDR_PRLEN * 2) + strlen(" - "),
 				CENTER|LJUST, "ADDRESS RANGE"));
-			pc->curcmd_flags |= HEADER_PRINTED;
-		}
-
-		readmem(ld->list_ptr[i], KVADDR, vmap_area_buf,
-                        SIZE(vmap_area), "vmap_area struct", FAULT_ON_ERROR); 
-
-		if (VALID_MEMBER(vmap_area_flags) &&
-		    VALID_MEMBER(vmap_area_purge_list)) {
-			flags = ULONG(vmap_area_buf + OFFSET(vmap_area_flags));
-			if (flags != VM_VM_AREA)
-				continue;
 		} else {
-			vm = ULONG(vmap_area_buf + OFFSET(vmap_area_vm));
-			if (!vm)
-				continue;
+			fprintf(fp, "%s  ",
+			    mkstring(buf, MAX(strlen("VM_STRUCT"), VADDR_PRLEN),
+			    	CENTER|LJUST, "VM_STRUCT"));
+			fprintf(fp, "%s    SIZE\n",
+			    mkstring(buf, (VADDR_PRLEN * 2) + strlen(" - "),
+				CENTER|LJUST, "ADDRESS RANGE"));
 		}
-		start = ULONG(vmap_area_buf + OFFSET(vmap_area_va_start));
-		end = ULONG(vmap_area_buf + OFFSET(vmap_area_va_end));
-		vm_struct = ULONG(vmap_area_buf + OFFSET(vmap_area_vm));
+		pc->curcmd_flags |= HEADER_PRINTED;
+	}
 
-		size = end - start;
+	if (!(vi->flags & ADDRESS_SPECIFIED)) {
+		for (i = 0; i < vt->nr_vmalloc_areas; i++)
+			show_vmalloc_area(&vt->vmalloc_areas[i]);
+		return;
+	}
 
-		if (vi->flags & (GET_VMLIST_COUNT|GET_VMLIST)) {
-			/*
-			 *  Preceding GET_VMLIST_COUNT set vi->retval.
-			 */
-			if (vi->flags & GET_VMLIST) {
-				if (count < vi->retval) {
-					vi->vmlist[count].addr = start;
-					vi->vmlist[count].size = size;
-				}
+	if (vi->memtype == KVADDR) {
+		i = vmalloc_area_search(vi->spec_addr);
+		if ((i < vt->nr_vmalloc_areas) &&
+		    (vi->spec_addr >= vt->vmalloc_areas[i].start)) {
+			va = &vt->vmalloc_areas[i];
+			if (vi->flags & VMLIST_VERIFY) {
+				vi->retval = 1;
+				return;
 			}
-			count++;
-			continue;
+			show_vmalloc_area(va);
 		}
+		if (vi->flags & VMLIST_VERIFY)
+			vi->retval = 0;
+		return;
+	}
 
-		if (!(vi->flags & ADDRESS_SPECIFIED) || 
-		    ((vi->memtype == KVADDR) &&
-		    ((vi->spec_addr >= start) && (vi->spec_addr < (start+size))))) {
-			if (vi->flags & VMLIST_VERIFY) {
-				verified++;
+	if (vi->memtype != PHYSADDR)
+		return;
+
+	for (i = 0; i < vt->nr_vmalloc_areas; i++) {
+		va = &vt->vmalloc_areas[i];
+		for (pcheck = va->start; pcheck < va->end;
+		     pcheck += PAGESIZE()) {
+			if (!kvtop(NULL, pcheck, &paddr, 0))
+				continue;
+			if ((vi->spec_addr >= paddr) &&
+			    (vi->spec_addr < (paddr+PAGESIZE()))) {
+				if (vi->flags & GET_PHYS_TO_VMALLOC) {
+					vi->retval = pcheck +
+					    PAGEOFFSET(vi->spec_addr);
+					return;
+				} else
+					show_vmalloc_area(va);
 				break;
-			} 	
-			fprintf(fp, "%s%s  %s%s  %s - %s  %7ld\n",
-				mkstring(buf1,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
-				MKSTR(ld->list_ptr[i])), space(MINSPACE-1),
-				mkstring(buf2,VADDR_PRLEN, LONG_HEX|CENTER|LJUST,
-				MKSTR(vm_struct)), space(MINSPACE-1),
-				mkstring(buf3, VADDR_PRLEN, LONG_HEX|RJUST,
-				MKSTR(start)),
-				mkstring(buf4, VADDR_PRLEN, LONG_HEX|LJUST,
-				MKSTR(start+size)),
-				size);
-		}
-
-		if ((vi->flags & ADDRESS_SPECIFIED) && 
-		     (vi->memtype == PHYSADDR)) {
-			for (pcheck = start; pcheck < (start+size); 
-			     pcheck += PAGESIZE()) {
-				if (!kvtop(NULL, pcheck, &paddr, 0))
-					continue;
-		    		if ((vi->spec_addr >= paddr) && 
-				    (vi->spec_addr < (paddr+PAGESIZE()))) {
-					if (vi->flags & GET_PHYS_TO_VMALLOC) {
-						vi->retval = pcheck +
-						    PAGEOFFSET(vi->spec_addr);
-						FREEBUF(ld->list_ptr);
-						return;
-				        } else
-						fprintf(fp,
-						"%s%s  %s%s  %s - %s  %7ld\n",
-						mkstring(buf1,VADDR_PRLEN, 
-						LONG_HEX|CENTER|LJUST,
-						MKSTR(ld->list_ptr[i])), 
-						space(MINSPACE-1),
-						mkstring(buf2, VADDR_PRLEN,
-						LONG_HEX|CENTER|LJUST,
-						MKSTR(vm_struct)), space(MINSPACE-1),
-						mkstring(buf3, VADDR_PRLEN,
-						LONG_HEX|RJUST, MKSTR(start)),
-						mkstring(buf4, VADDR_PRLEN,
-						LONG_HEX|LJUST,
-						MKSTR(start+size)), size);
-					break;
-				}
 			}
-
 		}
 	}
 
-	FREEBUF(vmap_area_buf);
-	FREEBUF(ld->list_ptr);
-
-	if (vi->flags & GET_HIGHEST)
-		vi->retval = start+size;
-
-	if (vi->flags & GET_VMLIST_COUNT)
-		vi->retval = count;
-
 	if (vi->flags & VMLIST_VERIFY)
-		vi->retval = verified;
+		vi->retval = 0;
 }
 
 
@@ -13764,6 +14383,36 @@ generic_is_page_ptr(ulong addr, physaddr_t *phys)
 	return FALSE;
 }
 
+/*
+ *  Fallback for architectures without a native page table walker:
+ *  translate one page at a time through uvtop().
+ */
+int
+generic_walk_range(struct task_context *tc, ulong start, ulong end,
+		   walk_range_func func, void *data)
+{
+	struct walk_range_entry wre;
+	physaddr_t paddr;
+	ulong vaddr;
+
+	for (vaddr = start; vaddr < end; vaddr += PAGESIZE()) {
+		if (uvtop(tc, vaddr, &paddr, 0))
+			wre.flags = WALK_RANGE_PRESENT;
+		else if (paddr)
+			wre.flags = 0;
+		else
+			continue;
+
+		wre.vaddr = vaddr;
+		wre.size = PAGESIZE();
+		wre.paddr = paddr;
+		if (!func(&wre, data))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 /*
  *  Determine whether an address is a page pointer from the mem_map[] array.
  *  If the caller requests it, return the associated physical address.
@@ -13784,6 +14433,9 @@ is_page_ptr(ulong addr, physaddr_t *phys)
 		return TRUE;
 
 	if (IS_SPARSEMEM()) {
+		if ((n = mem_map_range_search(addr, phys)) >= 0)
+			return n;
+
 		nr_mem_sections = vt->max_mem_section_nr+1;
 	        for (nr = 0; nr < nr_mem_sections ; nr++) {
 	                if ((sec_addr = valid_section_nr(nr))) {
@@ -14105,6 +14757,11 @@ dump_vm_table(int verbose)
 	fprintf(fp, "            mem_sec: %lx\n", (ulong)vt->mem_sec);
 	fprintf(fp, "        mem_section: %lx\n", (ulong)vt->mem_section);
 	fprintf(fp, " max_mem_section_nr: %ld\n", (ulong)vt->max_mem_section_nr);
+	fprintf(fp, "   mem_section_info: %lx\n", (ulong)vt->mem_section_info);
+	fprintf(fp, "     mem_map_ranges: %lx\n", (ulong)vt->mem_map_ranges);
+	fprintf(fp, "  nr_mem_map_ranges: %ld\n", vt->nr_mem_map_ranges);
+	fprintf(fp, "      vmalloc_areas: %lx\n", (ulong)vt->vmalloc_areas);
+	fprintf(fp, "   nr_vmalloc_areas: %ld\n", vt->nr_vmalloc_areas);
 	fprintf(fp, "       ZONE_HIGHMEM: %d\n", vt->ZONE_HIGHMEM);
 	fprintf(fp, "node_online_map_len: %d\n", vt->node_online_map_len);
 	if (vt->node_online_map_len) {
@@ -15355,6 +16012,7 @@ search_virtual(struct searchinfo *si)
 	char *pagebuf;
 	ulong pct, pages_read, pages_checked;
 	time_t begin, finish;
+	ulong prefetched;
 
 	start = si->vaddr_start;
 	end = si->vaddr_end;
@@ -15375,6 +16033,7 @@ search_virtual(struct searchinfo *si)
 	}
 
 	next = start;
+	prefetched = 0;
 
 	for (pp = VIRTPAGEBASE(start); next < end; next = pp) {
 		pages_checked++;
@@ -15414,6 +16073,11 @@ search_virtual(struct searchinfo *si)
 					goto done;
                                 continue;
 			}
+			if ((pp >= prefetched) && (pp < end)) {
+				prefetch_readmem(pp, KVADDR, 
+				    MIN(end - pp, PREFETCH_BATCH * PAGESIZE()));
+				prefetched = pp + (PREFETCH_BATCH * PAGESIZE());
+			}
                         break;
                 }
 
@@ -15485,6 +16149,7 @@ search_physical(struct searchinfo *si)
 	ulong pct, pages_read, pages_checked;
 	time_t begin, finish;
 	ulong page;
+	ulonglong prefetched;
 
 	start_in = si->paddr_start;
 	end_in = si->paddr_end;
@@ -15506,8 +16171,14 @@ search_physical(struct searchinfo *si)
 	}
 
         pnext = start_in;
+	prefetched = 0;
         for (ppp = PHYSPAGEBASE(start_in); pnext < end_in; pnext = ppp) {
 		pages_checked++;
+		if (ppp >= prefetched) {
+			prefetch_readmem(ppp, PHYSADDR, 
+			    MIN(end_in - ppp, PREFETCH_BATCH * PAGESIZE()));
+			prefetched = ppp + (PREFETCH_BATCH * PAGESIZE());
+		}
                 lastpage = (PHYSPAGEBASE(pnext) == PHYSPAGEBASE(end_in));
                 if (LKCD_DUMPFILE())
                         set_lkcd_nohash();
@@ -15565,7 +16236,7 @@ search_physical(struct searchinfo *si)
 }
 
 static bool
-check_vma(ulong vma, ulong vaddr, ulong *vm_next, ulong *nextvaddr)
+check_vma(ulong vma, ulong vaddr, ulong *vm_next, ulong *nextvaddr, ulong *vmend)
 {
 	char *vma_buf;
 	ulong vm_start, vm_end;
@@ -15579,22 +16250,25 @@ check_vma(ulong vma, ulong vaddr, ulong *vm_next, ulong *nextvaddr)
 
 	if (vaddr <= vm_start) {
 		*nextvaddr = vm_start;
+		*vmend = vm_end;
 		return TRUE;
 	}
 
 	if ((vaddr > vm_start) && (vaddr < vm_end)) {
 		*nextvaddr = vaddr;
+		*vmend = vm_end;
 		return TRUE;
 	}
 	return FALSE;
 }
 
 /*
- *  Return the next mapped user virtual address page that comes after 
- *  the passed-in address.
+ *  Return the next user virtual address contained in a vma that comes
+ *  after the passed-in address, along with the end of that vma.
  */
 static int
-next_upage(struct task_context *tc, ulong vaddr, ulong *nextvaddr)
+next_uvma_vaddr(struct task_context *tc, ulong vaddr, ulong *nextvaddr,
+		ulong *vmend)
 {
 	ulong vma, total_vm;
 	ulong vm_next;
@@ -15617,7 +16291,7 @@ next_upage(struct task_context *tc, ulong vaddr, ulong *nextvaddr)
 		do_maple_tree(mm_mt, MAPLE_TREE_GATHER, entry_list);
 		for (i = 0; i < entry_num; i++) {
 			if (!!(vma = (ulong)entry_list[i].value) &&
-			    check_vma(vma, vaddr, NULL, nextvaddr)) {
+			    check_vma(vma, vaddr, NULL, nextvaddr, vmend)) {
 				FREEBUF(entry_list);
 				return TRUE;
 			}
@@ -15629,7 +16303,7 @@ next_upage(struct task_context *tc, ulong vaddr, ulong *nextvaddr)
 		if (!vma)
 			return FALSE;
 		for ( ; vma; vma = vm_next) {
-			if (check_vma(vma, vaddr, &vm_next, nextvaddr))
+			if (check_vma(vma, vaddr, &vm_next, nextvaddr, vmend))
 				return TRUE;
 		}
 	}
@@ -15638,88 +16312,58 @@ next_upage(struct task_context *tc, ulong vaddr, ulong *nextvaddr)
 }
 
 /*
- *  Return the next mapped kernel virtual address in the vmlist
- *  that is equal to or comes after the passed-in address.
- *  Prevent repeated calls to dump_vmlist() by only doing it
- *  one time for dumpfiles, or one time per (active) command.
+ *  walk_range() callback that stops at the first present user page.
  */
 static int
-next_vmlist_vaddr(ulong vaddr, ulong *nextvaddr)
+first_upage(struct walk_range_entry *wre, void *data)
 {
-	int i, retval;
-	ulong cnt;
-	struct meminfo meminfo, *mi;
-	static int count = 0;
-	static struct vmlist *vmlist = NULL;
-	static ulong cmdgencur = BADVAL;
-
-	/*
-	 *  Search the stashed vmlist if possible.
-	 */
-	if (vmlist && ACTIVE()) {
-		if (pc->cmdgencur != cmdgencur) {
-			free(vmlist);
-			vmlist = NULL;
-		}
-	}
+	if (!(wre->flags & WALK_RANGE_PRESENT))
+		return TRUE;
 
-	if (vmlist) {
-		for (i = 0, retval = FALSE; i < count; i++) {
-			if (vaddr <= vmlist[i].addr) {
-				*nextvaddr = vmlist[i].addr;
-				retval = TRUE;
-				break;
-			}
-			if (vaddr < (vmlist[i].addr + vmlist[i].size)) {
-				*nextvaddr = vaddr;
-				retval = TRUE;
-				break;
-			}
-		}
-		return retval;
-	}
+	*((ulong *)data) = wre->vaddr;
+	return FALSE;
+}
 
-	mi = &meminfo;
-	BZERO(mi, sizeof(struct meminfo));
-        mi->flags = GET_VMLIST_COUNT;
-        dump_vmlist(mi);
-	cnt = mi->retval;
+/*
+ *  Return the next mapped user virtual address page that comes after 
+ *  the passed-in address.  Vmas are located first, and the page tables 
+ *  backing each one are then walked to skip its unmapped pages.
+ */
+static int
+next_upage(struct task_context *tc, ulong vaddr, ulong *nextvaddr)
+{
+	ulong start, vm_end;
 
-	if (!cnt)
-		return FALSE;
+	while (next_uvma_vaddr(tc, vaddr, &start, &vm_end)) {
+		if (!walk_range(tc, start, vm_end, first_upage, nextvaddr))
+			return TRUE;
+		vaddr = vm_end - PAGESIZE();
+	}
 
-	mi->vmlist = (struct vmlist *)GETBUF(sizeof(struct vmlist)*cnt);
-        mi->flags = GET_VMLIST;
-        dump_vmlist(mi);
+	return FALSE;
+}
 
-	for (i = 0, retval = FALSE; i < cnt; i++) {
-		if (vaddr <= mi->vmlist[i].addr) {
-			*nextvaddr = mi->vmlist[i].addr;
-			retval = TRUE;
-			break;
-		}
-		if (vaddr < (mi->vmlist[i].addr + mi->vmlist[i].size)) {
-			*nextvaddr = vaddr;
-			retval = TRUE;
-			break;
-		}
-	}
+/*
+ *  Return the next mapped kernel virtual address in the vmlist
+ *  that is equal to or comes after the passed-in address.
+ */
+static int
+next_vmlist_vaddr(ulong vaddr, ulong *nextvaddr)
+{
+	long i;
 
-	if (!vmlist) {
-		vmlist = (struct vmlist *)
-			malloc(sizeof(struct vmlist)*cnt);
+	if (!get_vmalloc_areas())
+		return FALSE;
 
-		if (vmlist) {
-			BCOPY(mi->vmlist, vmlist,
-				sizeof(struct vmlist)*cnt);
-			count = cnt;
-			cmdgencur = pc->cmdgencur;
-		}
-	}
+	if ((i = vmalloc_area_search(vaddr)) == vt->nr_vmalloc_areas)
+		return FALSE;
 
-	FREEBUF(mi->vmlist);
+	if (vaddr < vt->vmalloc_areas[i].start)
+		*nextvaddr = vt->vmalloc_areas[i].start;
+	else
+		*nextvaddr = vaddr;
 
-	return retval;
+	return TRUE;
 }
 
 /*
@@ -17664,8 +18308,20 @@ pfn_to_map(ulong pfn)
 	ulong section, page_offset;
 	ulong section_nr;
 	ulong coded_mem_map, mem_map;
+	struct mem_section_info *msi;
 
 	section_nr = pfn_to_section_nr(pfn);
+
+	if ((section_nr <= vt->max_mem_section_nr) &&
+	    (msi = get_mem_section_info())) {
+		msi += section_nr;
+		if (!(msi->flags & (THIS_KERNEL_VERSION >= LINUX(2,6,24) ?
+		    SECTION_HAS_MEM_MAP : SECTION_MARKED_PRESENT)))
+			return 0;
+		return msi->mem_map +
+			((pfn - section_nr_to_pfn(section_nr)) * SIZE(page));
+	}
+
 	if (!(section = valid_section_nr(section_nr))) 
 		return 0;
 
@@ -17680,6 +18336,247 @@ pfn_to_map(ulong pfn)
 	return 0;
 }
 
+/*
+ *  The sections from 0 to max_mem_section_nr are decoded once into
+ *  vt->mem_section_info, so that pfn_to_map() need not read the
+ *  mem_section structure, and their mem_map ranges are merged and sorted
+ *  into vt->mem_map_ranges, so that is_page_ptr() is a binary search
+ *  instead of a scan of every section.  With a vmemmap, the mem_maps of
+ *  consecutive sections are contiguous, and merge into a handful of
+ *  ranges.  On a live system the table is rebuilt by each command, since
+ *  sections may be hot-added or removed.
+ */
+static int
+compare_mem_map_range(const void *v1, const void *v2)
+{
+	const struct mem_map_range *r1 = v1, *r2 = v2;
+
+	return (r1->start < r2->start) ? -1 : (r1->start > r2->start) ? 1 : 0;
+}
+
+static void
+mem_section_info_free(void)
+{
+	free(vt->mem_section_info);
+	free(vt->mem_map_ranges);
+	vt->mem_section_info = NULL;
+	vt->mem_map_ranges = NULL;
+	vt->nr_mem_map_ranges = 0;
+}
+
+static void
+mem_section_info_init(void)
+{
+	struct mem_section_info *msi;
+	struct mem_map_range *r;
+	ulong nr, count, addr, coded_mem_map;
+	char *mem_section;
+	long i;
+
+	mem_section_info_free();
+
+	count = vt->max_mem_section_nr + 1;
+	if (!(vt->mem_section_info = calloc(count,
+	    sizeof(struct mem_section_info))) ||
+	    !(vt->mem_map_ranges = malloc(count *
+	    sizeof(struct mem_map_range)))) {
+		error(INFO, "cannot malloc mem_section table\n");
+		mem_section_info_free();
+		return;
+	}
+
+	for (nr = 0; nr < count; nr++) {
+		msi = &vt->mem_section_info[nr];
+		if (!(addr = nr_to_section(nr)) ||
+		    !(mem_section = read_mem_section(addr)))
+			continue;
+		coded_mem_map = ULONG(mem_section +
+			OFFSET(mem_section_section_mem_map));
+		if (!(coded_mem_map & SECTION_MARKED_PRESENT))
+			continue;
+
+		msi->flags = coded_mem_map & ~SECTION_MAP_MASK;
+		msi->mem_map = sparse_decode_mem_map(coded_mem_map &
+			SECTION_MAP_MASK, nr);
+
+		r = &vt->mem_map_ranges[vt->nr_mem_map_ranges];
+		if (vt->nr_mem_map_ranges && ((r-1)->end == msi->mem_map) &&
+		    ((r-1)->pfn + ((r-1)->end - (r-1)->start)/SIZE(page) ==
+		    section_nr_to_pfn(nr)))
+			(r-1)->end += PAGES_PER_SECTION() * SIZE(page);
+		else {
+			r->start = msi->mem_map;
+			r->end = msi->mem_map + (PAGES_PER_SECTION() * SIZE(page));
+			r->pfn = section_nr_to_pfn(nr);
+			vt->nr_mem_map_ranges++;
+		}
+	}
+
+	qsort(vt->mem_map_ranges, vt->nr_mem_map_ranges,
+		sizeof(struct mem_map_range), compare_mem_map_range);
+
+	/*
+	 *  The section scan is authoritative if the ranges overlap.
+	 */
+	for (i = 1; i < vt->nr_mem_map_ranges; i++) {
+		if (vt->mem_map_ranges[i].start < vt->mem_map_ranges[i-1].end) {
+			if (CRASHDEBUG(1))
+				error(INFO,
+				    "mem_section table: overlapping mem_maps\n");
+			free(vt->mem_map_ranges);
+			vt->mem_map_ranges = NULL;
+			vt->nr_mem_map_ranges = 0;
+			break;
+		}
+	}
+
+	vt->mem_section_info_gen = pc->cmdgencur;
+
+	if (CRASHDEBUG(1))
+		fprintf(fp, "mem_section table: %ld sections, %ld mem_map ranges\n",
+			count, vt->nr_mem_map_ranges);
+}
+
+static struct mem_section_info *
+get_mem_section_info(void)
+{
+	if (ACTIVE() && vt->mem_section_info &&
+	    (vt->mem_section_info_gen != pc->cmdgencur))
+		mem_section_info_init();
+
+	return vt->mem_section_info;
+}
+
+static int
+mem_map_range_search(ulong addr, physaddr_t *phys)
+{
+	struct mem_map_range *r;
+	long lo, hi, mid;
+
+	if (!get_mem_section_info() || !vt->mem_map_ranges)
+		return -1;
+
+	for (lo = 0, hi = vt->nr_mem_map_ranges - 1; lo <= hi; ) {
+		mid = (lo + hi) / 2;
+		r = &vt->mem_map_ranges[mid];
+		if (addr < r->start)
+			hi = mid - 1;
+		else if (addr >= r->end)
+			lo = mid + 1;
+		else {
+			if ((addr - r->start) % SIZE(page))
+				return FALSE;
+			if (phys)
+				*phys = PTOB(r->pfn +
+				    (addr - r->start) / SIZE(page));
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+ *  Export the page structures of the mem_map, read PGMM_CACHED at a time,
+ *  from the merged SPARSEMEM mem_map ranges if they are available, and
+ *  otherwise from the node table.
+ */
+static struct export_field page_fields[] = {
+	{ "page", EXPORT_ADDR },
+	{ "pfn", EXPORT_UINT },
+	{ "flags", EXPORT_UINT },
+	{ "count", EXPORT_INT },
+	{ "mapping", EXPORT_ADDR },
+	{ "index", EXPORT_UINT },
+};
+
+static void
+export_page_range(ulong mem_map, ulong pfn, ulong pages, char *page_cache)
+{
+	ulong i, cnt, addr, end, prefetched;
+	char *pcache;
+	int mapping, cached;
+
+	mapping = VALID_MEMBER(page_mapping);
+	end = mem_map + (pages * SIZE(page));
+	prefetched = 0;
+
+	while (pages) {
+		cnt = MIN(pages, PGMM_CACHED);
+		if (pages > PGMM_CACHED)
+			prefetched = prefetch_mem_map(mem_map, end, prefetched);
+		cached = readmem(mem_map, KVADDR, page_cache, SIZE(page) * cnt,
+			"page structures", RETURN_ON_ERROR|QUIET);
+
+		/*
+		 *  If the batch cannot be read, read its page structures one
+		 *  at a time, and leave out the ones that cannot be read.
+		 */
+		for (i = 0; i < cnt; i++) {
+			addr = mem_map + (i * SIZE(page));
+			if (cached)
+				pcache = page_cache + (i * SIZE(page));
+			else if (readmem(addr, KVADDR, page_cache, SIZE(page),
+			    "page structure", RETURN_ON_ERROR|QUIET))
+				pcache = page_cache;
+			else
+				continue;
+
+			export_addr(addr);
+			export_uint(pfn + i);
+			export_uint(ULONG(pcache + OFFSET(page_flags)));
+			export_int(INT(pcache + OFFSET(page_count)));
+			export_addr(mapping ?
+				ULONG(pcache + OFFSET(page_mapping)) : 0);
+			export_uint(mapping ?
+				ULONG(pcache + OFFSET(page_index)) : 0);
+			export_record();
+		}
+
+		mem_map += SIZE(page) * cnt;
+		pfn += cnt;
+		pages -= cnt;
+	}
+}
+
+void
+export_mem_map(void)
+{
+	struct mem_map_range *r;
+	struct node_table *nt;
+	char *page_cache;
+	ulong pfn, pp;
+	long i;
+
+	export_schema("pages", page_fields,
+		sizeof(page_fields)/sizeof(struct export_field));
+
+	page_cache = GETBUF_NOZERO(SIZE(page) * PGMM_CACHED);
+
+	if (IS_SPARSEMEM() && get_mem_section_info() && vt->mem_map_ranges) {
+		for (i = 0; i < vt->nr_mem_map_ranges; i++) {
+			r = &vt->mem_map_ranges[i];
+			export_page_range(r->start, r->pfn,
+				(r->end - r->start) / SIZE(page), page_cache);
+		}
+	} else {
+		for (i = 0; i < vt->numnodes; i++) {
+			nt = &vt->node_table[i];
+			pfn = BTOP(nt->start_paddr);
+			if (!IS_SPARSEMEM()) {
+				export_page_range(nt->mem_map, pfn, nt->size,
+					page_cache);
+				continue;
+			}
+			for ( ; pfn < BTOP(nt->start_paddr) + nt->size; pfn++)
+				if ((pp = pfn_to_map(pfn)))
+					export_page_range(pp, pfn, 1, page_cache);
+		}
+	}
+
+	FREEBUF(page_cache);
+}
+
 static void
 fill_mem_section_state(ulong state, char *buf)
 {
@@ -17699,7 +18596,7 @@ fill_mem_section_state(ulong state, char *buf)
 		bufidx += sprintf(buf + bufidx, "%s", "D");
 }
 
-void 
+void
 dump_mem_sections(int initialize)
 {
 	ulong nr, max, addr;
@@ -17720,6 +18617,7 @@ dump_mem_sections(int initialize)
 				max = nr;
 		}
 		vt->max_mem_section_nr = max;
+		mem_section_info_init();
 		return;
 	}
 
@@ -19586,6 +20484,12 @@ do_slab_slub(struct meminfo *si, int verbose)
 
 	fprintf(fp, "  %s", free_inuse_hdr);
 
+	/*
+	 *  The freelist walks below read the free pointers scattered
+	 *  across the slab's objects.
+	 */
+	prefetch_readmem(vaddr, KVADDR, objects * si->size);
+
 #define PAGE_MAPPING_ANON  1
 
 	if (CRASHDEBUG(8)) {
@@ -19650,6 +20554,17 @@ do_slab_slub(struct meminfo *si, int verbose)
 			} 
 		}
 
+		if (export_active()) {
+			export_addr(si->cache);
+			export_string(si->curname, -1);
+			export_addr(si->slab);
+			export_addr(pc->flags2 & REDZONE ? p : p + red_left_pad);
+			export_uint(!is_free);
+			export_int(is_free ? cpu_slab : -1);
+			export_record();
+			continue;
+		}
+
 		fprintf(fp, "  %s%lx%s", 
 			is_free ? " " : "[",
 			pc->flags2 & REDZONE ? p : p + red_left_pad,
@@ -19663,6 +20578,38 @@ do_slab_slub(struct meminfo *si, int verbose)
 	return TRUE;
 }
 
+/*
+ *  Export every object of a SLUB cache, or of all caches, by way of the
+ *  kmem -S object walk in do_slab_slub().
+ */
+static struct export_field slab_object_fields[] = {
+	{ "cache", EXPORT_ADDR },
+	{ "name", EXPORT_STRING },
+	{ "slab", EXPORT_ADDR },
+	{ "object", EXPORT_ADDR },
+	{ "allocated", EXPORT_UINT },
+	{ "cpu", EXPORT_INT },
+};
+
+void
+export_slab_objects(char *cache)
+{
+	struct meminfo meminfo;
+
+	if (vt->flags & KMEM_CACHE_UNAVAIL)
+		error(FATAL, "kmem cache slab subsystem not available\n");
+	if (!(vt->flags & KMALLOC_SLUB))
+		error(FATAL, "slab export requires CONFIG_SLUB\n");
+
+	export_schema("slab", slab_object_fields,
+		sizeof(slab_object_fields)/sizeof(struct export_field));
+
+	BZERO(&meminfo, sizeof(struct meminfo));
+	meminfo.reqname = cache;
+	meminfo.flags = VERBOSE;
+	vt->dump_kmem_cache(&meminfo);
+}
+
 static int
 count_free_objects(struct meminfo *si, ulong freelist)
 {
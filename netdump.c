@@ -862,6 +862,59 @@ read_netdump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
         return cnt;
 }
 
+/*
+ *  Advise the kernel of the dumpfile ranges backing a set of pages, 
+ *  using the same segment lookup as read_netdump().
+ */
+void
+netdump_prefetch(physaddr_t *paddrs, int count)
+{
+	struct pt_load_segment *pls;
+	physaddr_t paddr;
+	off_t offset;
+	int i, j;
+
+	if (XEN_CORE_DUMPFILE())
+		return;
+
+	for (i = 0; i < count; i++) {
+		paddr = paddrs[i];
+
+        	switch (DUMPFILE_FORMAT(nd->flags))
+		{
+		case NETDUMP_ELF32:
+			offset = (off_t)paddr + (off_t)nd->header_size;
+			break;
+
+		case NETDUMP_ELF64:
+		case KDUMP_ELF32:
+		case KDUMP_ELF64:
+			if (nd->num_pt_load_segments == 1) {
+				offset = (off_t)paddr + (off_t)nd->header_size -
+					(off_t)nd->pt_load_segments[0].phys_start;
+				break;
+			}
+
+			for (j = offset = 0; j < nd->num_pt_load_segments; j++) {
+				pls = &nd->pt_load_segments[j];
+				if ((paddr >= pls->phys_start) &&
+				    (paddr < pls->phys_end)) {
+					offset = (off_t)(paddr - pls->phys_start) +
+						pls->file_offset;
+					break;
+				}
+			}
+			break;
+
+		default:
+			return;
+		}
+
+		if (offset > 0)
+			prefetch_willneed(nd->ndfd, offset, PAGESIZE());
+	}
+}
+
 /*
  *  Write to a netdump-created dumpfile.  Note that cmd_wr() does not
  *  allow writes to dumpfiles, so you can't get here from there.
@@ -51,6 +51,13 @@ static int cpu_to_apicid(int cpu, int *apicid);
 static int get_sadump_smram_cpu_state(int cpu, struct sadump_smram_cpu_state *smram);
 static int block_table_init(void);
 static uint64_t pfn_to_block(uint64_t pfn);
+static uint64_t count_dumpable(uint64_t start, uint64_t end);
+static int sadump_cache_init(void);
+static struct sadump_cache_entry *sadump_cache_lookup(uint64_t pfn);
+static void sadump_cache_hash(struct sadump_cache_entry *ce);
+static void sadump_cache_unhash(struct sadump_cache_entry *ce);
+static void sadump_cache_make_mru(struct sadump_cache_entry *ce);
+static int disk_end_init(void);
 static void mask_reserved_fields(struct sadump_smram_cpu_state *smram);
 
 struct sadump_data *
@@ -87,6 +94,11 @@ sadump_cleanup_sadump_data(void)
 	free(sd->dumpable_bitmap);
 	free(sd->page_buf);
 	free(sd->block_table);
+	if (sd->cache) {
+		free(sd->cache[0].page);
+		free(sd->cache);
+	}
+	free(sd->disk_end);
 	if (sd->sd_list[0])
 		free(sd->sd_list[0]);
 	free(sd->sd_list);
@@ -459,6 +471,9 @@ restart:
 		goto err;
 	}
 
+	if (!sadump_cache_init() && CRASHDEBUG(1))
+		error(INFO, "sadump: cannot allocate page cache\n");
+
 	if (!(flags & SADUMP_DISKSET))
 		free(sdh);
 
@@ -624,6 +639,11 @@ open_disk(char *file)
 
 	sd->sd_list_len++;
 
+	if (sd->disk_end) {
+		free(sd->disk_end);
+		sd->disk_end = NULL;
+	}
+
 	if (CRASHDEBUG(1))
 		error(INFO, "sadump: open disk #%d\n", sd->sd_list_len);
 
@@ -736,31 +756,60 @@ page_is_dumpable(uint64_t nr)
 	return is_set_bit(sd->dumpable_bitmap, nr);
 }
 
+/*
+ * Build the table of whole-dump offsets at which each disk of the
+ * diskset ends, once all of the disks have been added.
+ */
 static int
-lookup_diskset(uint64_t whole_offset, int *diskid, uint64_t *disk_offset)
+disk_end_init(void)
 {
-	uint64_t offset = whole_offset;
+	uint64_t used_device_i, ram_size, end;
+	ulong data_offset_i;
 	int i;
 
-	for (i = 0; i < sd->sd_list_len; ++i) {
-		uint64_t used_device_i, ram_size;
-		ulong data_offset_i;
+	sd->disk_end = malloc(sd->sd_list_len * sizeof(uint64_t));
+	if (!sd->disk_end)
+		return FALSE;
 
+	for (i = 0, end = 0; i < sd->sd_list_len; ++i) {
 		used_device_i = sd->sd_list[i]->header->used_device;
 		data_offset_i = sd->sd_list[i]->data_offset;
 
 		ram_size = used_device_i - data_offset_i;
+		end += ram_size;
 
-		if (offset < ram_size)
-			break;
-		offset -= ram_size;
+		sd->disk_end[i] = end;
+	}
+
+	return TRUE;
+}
+
+static int
+lookup_diskset(uint64_t whole_offset, int *diskid, uint64_t *disk_offset)
+{
+	int lo, hi, mid;
+
+	if (!sd->disk_end && !disk_end_init())
+		return FALSE;
+
+	/*
+	 * Find the first disk that ends beyond the offset.
+	 */
+	lo = 0;
+	hi = sd->sd_list_len;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (whole_offset < sd->disk_end[mid])
+			hi = mid;
+		else
+			lo = mid + 1;
 	}
 
-	if (i == sd->sd_list_len)
+	if (lo == sd->sd_list_len)
 		return FALSE;
 
-	*diskid = i;
-	*disk_offset = offset;
+	*diskid = lo;
+	*disk_offset = lo ? whole_offset - sd->disk_end[lo-1] : whole_offset;
 
 	return TRUE;
 }
@@ -771,6 +820,7 @@ int read_sadump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 	uint64_t pfn, whole_offset, perdisk_offset, block;
 	ulong page_offset;
 	int dfd;
+	struct sadump_cache_entry *ce;
 
 	if (sd->flags & SADUMP_KDUMP_BACKUP &&
 	    paddr >= sd->backup_src_start &&
@@ -800,6 +850,18 @@ int read_sadump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 		return cnt;
 	}
 
+	if (sd->cache) {
+		sd->accesses++;
+		if ((ce = sadump_cache_lookup(pfn))) {
+			sd->cache_hits++;
+			PROFILE_COUNT(cache_hits);
+			sadump_cache_make_mru(ce);
+			memcpy(bufptr, ce->page + page_offset, cnt);
+			return cnt;
+		}
+		PROFILE_COUNT(cache_misses);
+	}
+
 	block = pfn_to_block(pfn);
 
 	whole_offset = block * sd->block_size;
@@ -819,6 +881,30 @@ int read_sadump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 
 	}
 
+	if (sd->cache) {
+		/*
+		 * Recycle the least recently used entry.
+		 */
+		ce = sd->cache_lru;
+		if (ce->valid) {
+			sadump_cache_unhash(ce);
+			ce->valid = FALSE;
+		}
+
+		if (pread(dfd, ce->page, sd->block_size, perdisk_offset) != 
+		    sd->block_size)
+			return READ_ERROR;
+
+		ce->pfn = pfn;
+		ce->valid = TRUE;
+		sadump_cache_hash(ce);
+		sadump_cache_make_mru(ce);
+
+		memcpy(bufptr, ce->page + page_offset, cnt);
+
+		return cnt;
+	}
+
 	if (lseek(dfd, perdisk_offset, SEEK_SET) == failed)
 		return SEEK_ERROR;
 
@@ -830,6 +916,44 @@ int read_sadump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 	return cnt;
 }
 
+/*
+ * Advise the kernel of the dump device ranges backing a set of pages
+ * that are not in the page cache.
+ */
+void sadump_prefetch(physaddr_t *paddrs, int count)
+{
+	uint64_t pfn, whole_offset, perdisk_offset;
+	int i, dfd, diskid;
+
+	for (i = 0; i < count; i++) {
+		if (sd->flags & SADUMP_KDUMP_BACKUP &&
+		    paddrs[i] >= sd->backup_src_start &&
+		    paddrs[i] < sd->backup_src_start + sd->backup_src_size)
+			continue;
+
+		pfn = paddr_to_pfn(paddrs[i]);
+		if ((pfn >= sd->max_mapnr) || !page_is_ram(pfn) ||
+		    !page_is_dumpable(pfn))
+			continue;
+		if (sd->cache && sadump_cache_lookup(pfn))
+			continue;
+
+		whole_offset = pfn_to_block(pfn) * sd->block_size;
+
+		if (sd->flags & SADUMP_DISKSET) {
+			if (!lookup_diskset(whole_offset, &diskid, &perdisk_offset))
+				continue;
+			dfd = sd->sd_list[diskid]->dfd;
+			perdisk_offset += sd->sd_list[diskid]->data_offset;
+		} else {
+			dfd = sd->dfd;
+			perdisk_offset = whole_offset + sd->data_offset;
+		}
+
+		prefetch_willneed(dfd, perdisk_offset, sd->block_size);
+	}
+}
+
 int write_sadump(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 {
 	return 0;
@@ -1098,8 +1222,20 @@ int sadump_memory_dump(FILE *fp)
         fprintf(fp, "       block_shift: %d\n", sd->block_shift);
 	fprintf(fp, "          page_buf: %lx\n", (ulong)sd->page_buf);
 	fprintf(fp, "       block_table: %lx\n", (ulong)sd->block_table);
+	fprintf(fp, "             cache: %lx (%d pages)\n", (ulong)sd->cache,
+		sd->cache ? SADUMP_CACHE_PAGES : 0);
+	fprintf(fp, "          accesses: %ld\n", sd->accesses);
+	fprintf(fp, "        cache_hits: %ld ", sd->cache_hits);
+	if (sd->accesses)
+		fprintf(fp, "(%ld%%)\n", sd->cache_hits * 100 / sd->accesses);
+	else
+		fprintf(fp, "\n");
 	fprintf(fp, "       sd_list_len: %d\n", sd->sd_list_len);
 	fprintf(fp, "           sd_list: %lx\n", (ulong)sd->sd_list);
+	fprintf(fp, "          disk_end: %lx\n", (ulong)sd->disk_end);
+	for (i = 0; sd->disk_end && (i < sd->sd_list_len); ++i)
+		fprintf(fp, "       disk_end[%d]: %llx\n", i, 
+			(ulonglong)sd->disk_end[i]);
 	fprintf(fp, "  backup_src_start: %llx\n", sd->backup_src_start);
 	fprintf(fp, "   backup_src_size: %lx\n", sd->backup_src_size);
 	fprintf(fp, "     backup_offset: %llx\n", (ulonglong)sd->backup_src_size);
@@ -1617,13 +1753,10 @@ static int block_table_init(void)
 	}
 
 	for (section = 0; section < max_section; ++section) {
-		if (section > 0)
-			block_table[section] = block_table[section-1];
-		for (pfn = section * SADUMP_PF_SECTION_NUM;
-		     pfn < (section + 1) * SADUMP_PF_SECTION_NUM;
-		     ++pfn)
-			if (page_is_dumpable(pfn))
-				block_table[section]++;
+		pfn = section * SADUMP_PF_SECTION_NUM;
+		block_table[section] = section ? block_table[section-1] : 0;
+		block_table[section] += count_dumpable(pfn, 
+			pfn + SADUMP_PF_SECTION_NUM);
 	}
 
 	sd->block_table = block_table;
@@ -1633,7 +1766,7 @@ static int block_table_init(void)
 
 static uint64_t pfn_to_block(uint64_t pfn)
 {
-	uint64_t block, section, p;
+	uint64_t block, section;
 
 	section = pfn / SADUMP_PF_SECTION_NUM;
 
@@ -1642,13 +1775,122 @@ static uint64_t pfn_to_block(uint64_t pfn)
 	else
 		block = 0;
 
-	for (p = section * SADUMP_PF_SECTION_NUM; p < pfn; ++p)
-		if (page_is_dumpable(p))
-			block++;
+	block += count_dumpable(section * SADUMP_PF_SECTION_NUM, pfn);
 
 	return block;
 }
 
+/*
+ * Count the dumpable pages from start, which must be a multiple of 8,
+ * up to but not including end, a word of the bitmap at a time.  The
+ * bitmap is in most-significant-bit-first order within each byte.
+ */
+static uint64_t
+count_dumpable(uint64_t start, uint64_t end)
+{
+	unsigned char *bitmap = (unsigned char *)sd->dumpable_bitmap;
+	uint64_t count, p, w;
+
+	for (count = 0, p = start; p + 64 <= end; p += 64) {
+		memcpy(&w, bitmap + (p >> 3), sizeof(w));
+		count += hweight64(w);
+	}
+
+	for ( ; p + 8 <= end; p += 8)
+		count += hweight32(bitmap[p >> 3]);
+
+	if (p < end)
+		count += hweight32(bitmap[p >> 3] >> (8 - (end - p)));
+
+	return count;
+}
+
+static int
+sadump_cache_init(void)
+{
+	struct sadump_cache_entry *cache;
+	char *pages;
+	int i;
+
+	cache = calloc(SADUMP_CACHE_PAGES, sizeof(struct sadump_cache_entry));
+	pages = malloc(SADUMP_CACHE_PAGES * sd->block_size);
+	if (!cache || !pages) {
+		free(cache);
+		free(pages);
+		return FALSE;
+	}
+
+	for (i = 0; i < SADUMP_CACHE_PAGES; i++) {
+		cache[i].page = pages + (i * sd->block_size);
+		cache[i].lru_prev = i ? &cache[i-1] : NULL;
+		cache[i].lru_next = (i+1) < SADUMP_CACHE_PAGES ? 
+			&cache[i+1] : NULL;
+	}
+
+	sd->cache = cache;
+	sd->cache_mru = &cache[0];
+	sd->cache_lru = &cache[SADUMP_CACHE_PAGES-1];
+
+	return TRUE;
+}
+
+static struct sadump_cache_entry *
+sadump_cache_lookup(uint64_t pfn)
+{
+	struct sadump_cache_entry *ce;
+
+	for (ce = sd->cache_hash[SADUMP_CACHE_HASH_IDX(pfn)]; ce; 
+	     ce = ce->hash_next) {
+		if (ce->pfn == pfn)
+			return ce;
+	}
+
+	return NULL;
+}
+
+static void
+sadump_cache_hash(struct sadump_cache_entry *ce)
+{
+	struct sadump_cache_entry **head;
+
+	head = &sd->cache_hash[SADUMP_CACHE_HASH_IDX(ce->pfn)];
+	ce->hash_next = *head;
+	*head = ce;
+}
+
+static void
+sadump_cache_unhash(struct sadump_cache_entry *ce)
+{
+	struct sadump_cache_entry **pp;
+
+	for (pp = &sd->cache_hash[SADUMP_CACHE_HASH_IDX(ce->pfn)]; *pp; 
+	     pp = &(*pp)->hash_next) {
+		if (*pp == ce) {
+			*pp = ce->hash_next;
+			break;
+		}
+	}
+	ce->hash_next = NULL;
+}
+
+static void
+sadump_cache_make_mru(struct sadump_cache_entry *ce)
+{
+	if (ce == sd->cache_mru)
+		return;
+
+	ce->lru_prev->lru_next = ce->lru_next;
+	if (ce->lru_next)
+		ce->lru_next->lru_prev = ce->lru_prev;
+	else
+		sd->cache_lru = ce->lru_prev;
+
+	ce->lru_prev = NULL;
+	ce->lru_next = sd->cache_mru;
+	sd->cache_mru->lru_prev = ce;
+	sd->cache_mru = ce;
+}
+
 int sadump_is_zero_excluded(void)
 {
 	return (sd->flags & SADUMP_ZERO_EXCLUDED) ? TRUE : FALSE;
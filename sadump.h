@@ -178,6 +178,22 @@ struct sadump_media_header {
 
 #define SADUMP_PF_SECTION_NUM 4096
 
+/*
+ * Hashed LRU cache of dump blocks read by read_sadump().
+ */
+#define SADUMP_CACHE_PAGES	(128)
+#define SADUMP_CACHE_HASH	(256)	/* power of two */
+#define SADUMP_CACHE_HASH_IDX(pfn) ((pfn) & (SADUMP_CACHE_HASH-1))
+
+struct sadump_cache_entry {
+	uint64_t pfn;
+	char *page;
+	struct sadump_cache_entry *hash_next;
+	struct sadump_cache_entry *lru_prev;
+	struct sadump_cache_entry *lru_next;
+	int valid;
+};
+
 struct sadump_diskset_data {
 	char *filename;
 	int dfd;
@@ -209,8 +225,16 @@ struct sadump_data {
 	char *page_buf;
 	uint64_t *block_table;
 
+	struct sadump_cache_entry *cache;
+	struct sadump_cache_entry *cache_hash[SADUMP_CACHE_HASH];
+	struct sadump_cache_entry *cache_mru;
+	struct sadump_cache_entry *cache_lru;
+	ulong cache_hits;
+	ulong accesses;
+
 	int sd_list_len;
 	struct sadump_diskset_data **sd_list;
+	uint64_t *disk_end;	/* whole-dump offset at which each disk ends */
 
 /* Backup Region, First 640K of System RAM. */
 #define KEXEC_BACKUP_SRC_END	0x0009ffff
@@ -42,14 +42,21 @@ static void symbol_dump(ulong, char *);
 static void check_for_dups(struct load_module *);
 static struct syment *kallsyms_module_symbol(struct load_module *, symbol_info *);
 static int kallsyms_module_function_size(struct syment *, struct load_module *, ulong *);
+struct module_symtab;
+static struct module_symtab *read_module_symtab(bfd *, char *);
+static struct module_symtab *decode_module_objfile(char *);
+static void module_symbol_worker(int);
+static int module_symbol_worker_exited(int);
+static struct module_symtab *module_symbol_worker_table(char *);
+static void kill_module_symbol_workers(void *);
 static void store_load_module_symbols \
-	(bfd *, int, void *, long, uint, ulong, char *);
+	(bfd *, struct module_symtab *, ulong, char *);
 static int load_module_index(struct syment *);
 static void section_header_info(bfd *, asection *, void *);
 static void store_section_data(struct load_module *, bfd *, asection *);
 static void calculate_load_order_v1(struct load_module *, bfd *);
-static void calculate_load_order_v2(struct load_module *, bfd *, int, void *, long, unsigned int);
-static void calculate_load_order_6_4(struct load_module *, bfd *, int, void *, long, unsigned int);
+static void calculate_load_order_v2(struct load_module *, struct module_symtab *);
+static void calculate_load_order_6_4(struct load_module *, struct module_symtab *);
 static void check_insmod_builtin(struct load_module *, int, ulong *);
 static int is_insmod_builtin(struct load_module *, struct syment *);
 struct load_module;
@@ -94,6 +101,36 @@ static int dereference_pointer(ulong, struct datatype_member *, ulong);
 
 #define EV_DWARFEXTRACT  101010101
 
+/*
+ *  A module object file's symbols, sorted by gnu_qsort() and decoded into
+ *  a single block that does not refer back to the BFD, so that it can be
+ *  built by a "mod -S" worker process and passed to the main process.
+ *  The symbol and section names are offsets into the string space that
+ *  follows the symbol array.
+ */
+struct module_syminfo {
+	ulong value;
+	long name;
+	long secname;
+	char type;
+};
+
+struct module_symtab {
+	long symcount;
+	long strsize;
+	struct module_syminfo *syms;
+	char *strings;
+};
+
+#define MODULE_SYMTAB_SIZE(symcount, strsize) \
+	(sizeof(struct module_symtab) + \
+	 ((symcount) * sizeof(struct module_syminfo)) + (strsize))
+#define MODULE_SYMTAB_INIT(tab) \
+	((tab)->syms = (struct module_syminfo *)((tab) + 1), \
+	 (tab)->strings = (char *)((tab)->syms + (tab)->symcount))
+#define MODSYM_NAME(tab, ms)     ((tab)->strings + (ms)->name)
+#define MODSYM_SECNAME(tab, ms)  ((tab)->strings + (ms)->secname)
+
 #define PARSE_FOR_DATA        (1)
 #define PARSE_FOR_DECLARATION (2)
 static void parse_for_member(struct datatype_member *, ulong);
@@ -1081,29 +1118,30 @@ symbol_value_from_proc_kallsyms(char *symname)
 }
 
 /*
- *  Install all static kernel symbol values into the symval_hash.
+ *  Install all static kernel symbol values into the symval_hash.  While
+ *  the chains are built, val_hash_last points to the tail of each one;
+ *  it is then reset to the head, where symval_hash_search() starts.
  */
 static void
 symval_hash_init(void)
 {
 	int index;
-	struct syment *sp, *sph;
+	struct syment *sp;
 
         for (sp = st->symtable; sp < st->symend; sp++) {
 		index = SYMVAL_HASH_INDEX(sp->value);
 
-		if (st->symval_hash[index].val_hash_head == NULL) {
+		if (st->symval_hash[index].val_hash_head == NULL)
 			st->symval_hash[index].val_hash_head = sp;
-			st->symval_hash[index].val_hash_last = sp;
-			continue;
-		}
+		else
+			st->symval_hash[index].val_hash_last->val_hash_next = sp;
 
-		sph = st->symval_hash[index].val_hash_head; 
-		while (sph->val_hash_next)
-			sph = sph->val_hash_next;
-				
-		sph->val_hash_next = sp;
+		st->symval_hash[index].val_hash_last = sp;
 	}
+
+	for (index = 0; index < SYMVAL_HASH; index++)
+		st->symval_hash[index].val_hash_last =
+			st->symval_hash[index].val_hash_head;
 }
 
 /*
@@ -7090,6 +7128,43 @@ dump_struct_member(char *s, ulong addr, unsigned radix)
 }
 
 
+/*
+ *  Like dump_struct_member(), but for several members of the structure
+ *  at addr, which gdb then formats only once.
+ */
+void
+dump_struct_member_list(char *name, char **members, int count, ulong addr,
+	unsigned radix)
+{
+	struct datatype_member datatype_member, *dm;
+        unsigned restore_radix;
+	int i;
+
+	if (!STRUCT_EXISTS(name))
+		error(FATAL, "invalid structure name: %s\n", name);
+
+	restore_radix = 0;
+	dm = &datatype_member;
+	dm->name = name;
+
+	set_temporary_radix(radix, &restore_radix);
+
+        open_tmpfile();
+        print_struct(dm->name, addr);
+
+	for (i = 0; i < count; i++) {
+		dm->member = members[i];
+		if (MEMBER_EXISTS(dm->name, dm->member))
+			parse_for_member(dm, PARSE_FOR_DATA);
+		else
+			parse_for_member_extended(dm, PARSE_FOR_DATA);
+	}
+
+        close_tmpfile();
+
+	restore_current_radix(restore_radix);
+}
+
 /*
  *  Externally available routine to dump a union at an address.
  */
@@ -7755,13 +7830,19 @@ do_datatype_addr(struct datatype_member *dm, ulong addr, int count,
 			} else if ((flags & DEREF_POINTERS) && !dm->member) {
 				print_struct_with_dereference(addr, dm, flags);
                 	} else {
-	                        if (dm->member)
+				/*
+				 *  With a member list, the structure is
+				 *  formatted once for all of its members.
+				 */
+	                        if (dm->member && !i)
 	                                open_tmpfile();
-	
-				if (flags & UNION_REQUEST)
-					print_union(dm->name, addr);
-				else if (flags & STRUCT_REQUEST)
-					print_struct(dm->name, addr);
+
+				if (!dm->member || !i) {
+					if (flags & UNION_REQUEST)
+						print_union(dm->name, addr);
+					else if (flags & STRUCT_REQUEST)
+						print_struct(dm->name, addr);
+				}
 
 				if (dm->member) {
 					if (!((flags & DEREF_POINTERS) &&
@@ -7771,7 +7852,8 @@ do_datatype_addr(struct datatype_member *dm, ulong addr, int count,
 						else
 							parse_for_member(dm, PARSE_FOR_DATA);
 					}
-					close_tmpfile();
+					if ((i+1) >= argc_members)
+						close_tmpfile();
 				}
 
                 	}
@@ -12615,21 +12697,15 @@ calculate_load_order_v1(struct load_module *lm, bfd *bfd)
  * instances.
  */
 static void
-calculate_load_order_v2(struct load_module *lm, bfd *bfd, int dynamic,
-	void *minisyms, long symcount, unsigned int size)
+calculate_load_order_v2(struct load_module *lm, struct module_symtab *tab)
 {
 	struct syment *s1, *s2;
 	ulong sec_start;
-	bfd_byte *from, *fromend;
-	asymbol *store;
-	asymbol *sym;
-	symbol_info syminfo;
+	struct module_syminfo *ms, *msend;
 	char *secname;
 	int i;
 
-	if ((store = bfd_make_empty_symbol(bfd)) == NULL)
-		error(FATAL, "bfd_make_empty_symbol() failed\n");
-
+	msend = tab->syms + tab->symcount;
 	s1 = lm->mod_symtable;
 	s2 = lm->mod_symend;
 	while (s1 < s2) {
@@ -12661,23 +12737,15 @@ calculate_load_order_v2(struct load_module *lm, bfd *bfd, int dynamic,
             }
 
 	    /* Find the symbol in the object file. */
-	    from = (bfd_byte *) minisyms;
-	    fromend = from + symcount * size;
 	    secname = NULL;
-	    for (; from < fromend; from += size) {
-		    if ((sym = bfd_minisymbol_to_symbol(bfd, dynamic, from,
-			    store)) == NULL)
-			    error(FATAL,
-				    "bfd_minisymbol_to_symbol() failed\n");
-
-		    bfd_get_symbol_info(bfd, sym, &syminfo);
+	    for (ms = tab->syms; ms < msend; ms++) {
                     if (CRASHDEBUG(3)) {
                             fprintf(fp,"matching sym %s %lx against bfd %s %lx\n",
-                                s1->name, (long) s1->value, syminfo.name,
-                                (long) syminfo.value);
+                                s1->name, (long) s1->value,
+                                MODSYM_NAME(tab, ms), (long) ms->value);
                     }
-		    if (strcmp(syminfo.name, s1->name) == 0) {
-			    secname = (char *)bfd_section_name(sym->section);
+		    if (strcmp(MODSYM_NAME(tab, ms), s1->name) == 0) {
+			    secname = MODSYM_SECNAME(tab, ms);
 			    break;
 		    }
 
@@ -12710,14 +12778,14 @@ calculate_load_order_v2(struct load_module *lm, bfd *bfd, int dynamic,
 	    }
 
             /* Update the offset information for the section */
-	    sec_start = s1->value - syminfo.value;
+	    sec_start = s1->value - ms->value;
 //	    sec_end = sec_start + lm->mod_section_data[i].size;
 	    lm->mod_section_data[i].offset = sec_start - lm->mod_base;
             lm->mod_section_data[i].flags |= SEC_FOUND;
 
 	    if (CRASHDEBUG(2)) {
 		    fprintf(fp, "update sec offset sym %s @ %lx  val %lx  section %s\n",
-			    s1->name, s1->value, (ulong)syminfo.value, secname);
+			    s1->name, s1->value, ms->value, secname);
 	    }
 
 	    if (strcmp(secname, ".text") == 0)
@@ -12740,21 +12808,15 @@ calculate_load_order_v2(struct load_module *lm, bfd *bfd, int dynamic,
 
 /* Linux 6.4 and later */
 static void
-calculate_load_order_6_4(struct load_module *lm, bfd *bfd, int dynamic,
-	void *minisyms, long symcount, unsigned int size)
+calculate_load_order_6_4(struct load_module *lm, struct module_symtab *tab)
 {
 	struct syment *s1, *s2;
 	ulong sec_start;
-	bfd_byte *from, *fromend;
-	asymbol *store;
-	asymbol *sym;
-	symbol_info syminfo;
+	struct module_syminfo *ms, *msend;
 	char *secname;
 	int i, t;
 
-	if ((store = bfd_make_empty_symbol(bfd)) == NULL)
-		error(FATAL, "bfd_make_empty_symbol() failed\n");
-
+	msend = tab->syms + tab->symcount;
 	for_each_mod_mem_type(t) {
 		s1 = lm->symtable[t];
 		s2 = lm->symend[t];
@@ -12786,21 +12848,15 @@ calculate_load_order_6_4(struct load_module *lm, bfd *bfd, int dynamic,
 			}
 
 			/* Find the symbol in the object file. */
-			from = (bfd_byte *) minisyms;
-			fromend = from + symcount * size;
 			secname = NULL;
-			for (; from < fromend; from += size) {
-				if (!(sym = bfd_minisymbol_to_symbol(bfd, dynamic, from, store)))
-					error(FATAL, "bfd_minisymbol_to_symbol() failed\n");
-
-				bfd_get_symbol_info(bfd, sym, &syminfo);
+			for (ms = tab->syms; ms < msend; ms++) {
 				if (CRASHDEBUG(3)) {
 					fprintf(fp,"matching sym %s %lx against bfd %s %lx\n",
-						s1->name, (long) s1->value, syminfo.name,
-						(long) syminfo.value);
+						s1->name, (long) s1->value,
+						MODSYM_NAME(tab, ms), (long) ms->value);
 				}
-				if (strcmp(syminfo.name, s1->name) == 0) {
-					secname = (char *)bfd_section_name(sym->section);
+				if (strcmp(MODSYM_NAME(tab, ms), s1->name) == 0) {
+					secname = MODSYM_SECNAME(tab, ms);
 					break;
 				}
 
@@ -12831,14 +12887,14 @@ calculate_load_order_6_4(struct load_module *lm, bfd *bfd, int dynamic,
 			}
 
 			/* Update the offset information for the section */
-			sec_start = s1->value - syminfo.value;
+			sec_start = s1->value - ms->value;
 			/* keep the address instead of offset */
 			lm->mod_section_data[i].addr = sec_start;
 			lm->mod_section_data[i].flags |= SEC_FOUND;
 
 			if (CRASHDEBUG(2))
 				fprintf(fp, "update sec offset sym %s @ %lx  val %lx  section %s\n",
-					s1->name, s1->value, (ulong)syminfo.value, secname);
+					s1->name, s1->value, ms->value, secname);
 
 			if (strcmp(secname, ".text") == 0)
 				lm->mod_text_start = sec_start;
@@ -12936,6 +12992,452 @@ compare_prios(const void *v1, const void *v2)
 
 
 
+/*
+ *  Read a module object file's symbols, sort them as gnu_qsort() does,
+ *  and decode them into a module_symtab block.
+ */
+static struct module_symtab *
+read_module_symtab(bfd *bfd, char *namelist)
+{
+	struct module_symtab *tab;
+	struct module_syminfo *ms;
+	symbol_info syminfo;
+	asymbol *sort_x, *sort_y, *sym;
+	asection *section;
+	bfd_byte *from;
+	void *minisyms;
+	unsigned int size;
+	long i, symcount, strsize, secname, len;
+	char *name;
+
+	symcount = bfd_read_minisymbols(bfd, FALSE, &minisyms, &size);
+	if (symcount < 0)
+		error(FATAL, "cannot access symbol table data: %s\n",
+			namelist);
+	else if (symcount == 0)
+		error(FATAL, "no symbols in object file: %s\n", namelist);
+
+        if (CRASHDEBUG(2)) {
+                fprintf(fp, "%ld symbols found in obj file %s\n", symcount,
+                    namelist);
+        }
+        sort_x = bfd_make_empty_symbol(bfd);
+        sort_y = bfd_make_empty_symbol(bfd);
+        if (sort_x == NULL || sort_y == NULL)
+		error(FATAL, "bfd_make_empty_symbol() failed\n");
+
+	gnu_qsort(bfd, minisyms, symcount, size, sort_x, sort_y);
+
+	/*
+	 *  The first pass sizes the string space, and the second one fills
+	 *  in the table.  A section name is stored once for each run of
+	 *  symbols from the same section.
+	 */
+	tab = NULL;
+	do {
+		strsize = secname = 0;
+		section = NULL;
+		ms = tab ? tab->syms : NULL;
+
+		for (i = 0, from = minisyms; i < symcount; i++, from += size) {
+			if (!(sym = bfd_minisymbol_to_symbol(bfd, FALSE,
+			    from, sort_x)))
+				error(FATAL,
+				    "bfd_minisymbol_to_symbol() failed\n");
+
+			bfd_get_symbol_info(bfd, sym, &syminfo);
+
+			if (sym->section != section) {
+				section = sym->section;
+				name = (char *)bfd_section_name(section);
+				len = strlen(name) + 1;
+				if (tab)
+					BCOPY(name, tab->strings + strsize, len);
+				secname = strsize;
+				strsize += len;
+			}
+
+			len = strlen(syminfo.name) + 1;
+			if (tab) {
+				BCOPY(syminfo.name, tab->strings + strsize, len);
+				ms->value = syminfo.value;
+				ms->name = strsize;
+				ms->secname = secname;
+				ms->type = syminfo.type;
+				ms++;
+			}
+			strsize += len;
+		}
+
+		if (tab)
+			break;
+
+		if (!(tab = (struct module_symtab *)
+		    malloc(MODULE_SYMTAB_SIZE(symcount, strsize))))
+			error(FATAL, "module symbol table malloc: %s\n",
+				strerror(errno));
+		tab->symcount = symcount;
+		tab->strsize = strsize;
+		MODULE_SYMTAB_INIT(tab);
+	} while (TRUE);
+
+	free(minisyms);
+
+	return tab;
+}
+
+/*
+ *  When "mod -S" loads all modules, a few forked workers read, sort and
+ *  decode the modules' object file symbols ahead of the main process,
+ *  which still has to install them and hand each object file to gdb one
+ *  module at a time.  Each worker appends its decoded tables to its own
+ *  temporary file, and reports where each one is in a slot array that is
+ *  shared with the main process.  When the main process gets to a module
+ *  that no worker has claimed, or whose worker failed, it reads the
+ *  symbols itself.
+ */
+#define MODULE_SYMBOL_WORKERS  (4)
+#define MODULE_SYMBOL_BUFSIZE  (1024*1024)
+
+#define MODSYM_FREE    (0)
+#define MODSYM_BUSY    (1)   /* claimed by a worker */
+#define MODSYM_DONE    (2)   /* decoded by a worker */
+#define MODSYM_FAILED  (3)
+#define MODSYM_LOCAL   (4)   /* claimed by the main process */
+
+struct module_symbol_slot {
+	volatile int state;
+	int worker;
+	off_t offset;
+	long size;
+};
+
+static struct module_symbol_workers {
+	int count;
+	char **objfiles;
+	struct module_symbol_slot *slots;
+	pid_t pid[MODULE_SYMBOL_WORKERS];
+	FILE *tmpfile[MODULE_SYMBOL_WORKERS];
+} module_symbol_workers = { 0 };
+
+/*
+ *  Open a module object file and return its decoded symbols.
+ */
+static struct module_symtab *
+decode_module_objfile(char *namelist)
+{
+	struct module_symtab *tab;
+	char **matching;
+	bfd *mbfd;
+
+	if (!(mbfd = bfd_openr(namelist, NULL)))
+		error(FATAL, "cannot open object file: %s\n", namelist);
+
+	if (!bfd_check_format_matches(mbfd, bfd_object, &matching) ||
+	    !(bfd_get_file_flags(mbfd) & HAS_SYMS))
+		error(FATAL, "no symbols in object file: %s\n", namelist);
+
+	tab = read_module_symtab(mbfd, namelist);
+
+	bfd_close(mbfd);
+
+	return tab;
+}
+
+/*
+ *  The body of a worker process.  A FATAL error while decoding an object
+ *  file lands back here, and the main process reads that one itself.
+ */
+static void
+module_symbol_worker(int w)
+{
+	struct module_symbol_workers *mw;
+	struct module_symbol_slot *slot;
+	struct module_symtab *tab;
+	volatile off_t offset;
+	ssize_t cnt;
+	long size, done;
+	int i, fd, tfd;
+	char *buf;
+
+	mw = &module_symbol_workers;
+
+	/*
+	 *  The workers must not touch the session or its output.
+	 */
+	signal(SIGINT, SIG_DFL);
+	signal(SIGPIPE, SIG_DFL);
+	fd = fileno(pc->nullfp);
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+	fp = pc->error_fp = pc->nullfp;
+	pc->stdpipe = NULL;
+	pc->flags &= ~IN_FOREACH;
+
+	tfd = fileno(mw->tmpfile[w]);
+	buf = malloc(MODULE_SYMBOL_BUFSIZE);
+	offset = 0;
+
+	for (i = 0; i < mw->count; i++) {
+		slot = &mw->slots[i];
+		if (!__sync_bool_compare_and_swap(&slot->state,
+		    MODSYM_FREE, MODSYM_BUSY))
+			continue;
+		slot->worker = w;
+
+		if (setjmp(pc->main_loop_env)) {
+			slot->state = MODSYM_FAILED;
+			continue;
+		}
+
+		tab = decode_module_objfile(mw->objfiles[i]);
+
+		size = MODULE_SYMTAB_SIZE(tab->symcount, tab->strsize);
+		for (done = 0; done < size; done += cnt) {
+			if ((cnt = pwrite(tfd, (char *)tab + done,
+			    size - done, offset + done)) <= 0)
+				break;
+		}
+		free(tab);
+
+		if (done < size) {
+			slot->state = MODSYM_FAILED;
+			continue;
+		}
+
+		slot->offset = offset;
+		slot->size = size;
+		__sync_synchronize();
+		slot->state = MODSYM_DONE;
+		offset += size;
+
+		/*
+		 *  gdb reads the rest of the object file next, so bring it
+		 *  into the page cache as well.
+		 */
+		if (buf && ((fd = open(mw->objfiles[i], O_RDONLY)) >= 0)) {
+			while (read(fd, buf, MODULE_SYMBOL_BUFSIZE) > 0)
+				;
+			close(fd);
+		}
+	}
+
+	_exit(0);
+}
+
+/*
+ *  Start the workers for the object files of a "mod -S" command.
+ */
+void
+start_module_symbol_workers(char **objfiles, int count)
+{
+	struct module_symbol_workers *mw;
+	int i, w, workers;
+	pid_t pid;
+
+	mw = &module_symbol_workers;
+
+	if ((count < 2) || mw->count)
+		return;
+	if ((kt->flags & KMOD_V2) && (st->flags & USE_OLD_ADD_SYM))
+		return;
+
+	if ((mw->slots = mmap(NULL, sizeof(struct module_symbol_slot) * count,
+	    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+		mw->slots = NULL;
+		return;
+	}
+	BZERO(mw->slots, sizeof(struct module_symbol_slot) * count);
+	mw->count = count;
+
+	/*
+	 *  The caller frees its object file names as it goes.
+	 */
+	if (!(mw->objfiles = (char **)calloc(count, sizeof(char *))))
+		goto bailout;
+	for (i = 0; i < count; i++) {
+		if (!(mw->objfiles[i] = strdup(objfiles[i])))
+			goto bailout;
+	}
+
+	workers = MIN(MODULE_SYMBOL_WORKERS, count);
+	for (w = 0; w < workers; w++) {
+		if (!(mw->tmpfile[w] = tmpfile()))
+			break;
+	}
+	if (!w)
+		goto bailout;
+	workers = w;
+
+	fflush(fp);
+	fflush(stdout);
+	fflush(stderr);
+
+	pc->cmd_cleanup = kill_module_symbol_workers;
+	pc->cmd_cleanup_arg = NULL;
+
+	for (w = 0; w < workers; w++) {
+		if ((pid = fork()) < 0) {
+			if (CRASHDEBUG(1))
+				error(INFO, "module symbol worker: fork: %s\n",
+					strerror(errno));
+			break;
+		}
+		if (!pid)
+			module_symbol_worker(w);
+		mw->pid[w] = pid;
+	}
+
+	return;
+
+bailout:
+	kill_module_symbol_workers(NULL);
+}
+
+/*
+ *  Check whether a worker has gone away, reaping it if so.
+ */
+static int
+module_symbol_worker_exited(int w)
+{
+	struct module_symbol_workers *mw;
+	int status;
+
+	mw = &module_symbol_workers;
+
+	if (mw->pid[w] <= 0)
+		return TRUE;
+	if (waitpid(mw->pid[w], &status, WNOHANG) == 0)
+		return FALSE;
+	mw->pid[w] = 0;
+
+	return TRUE;
+}
+
+/*
+ *  Return the decoded symbols of a module object file from the workers,
+ *  waiting for the one that is decoding it if necessary.  NULL is returned
+ *  if the caller has to read the object file itself.
+ */
+static struct module_symtab *
+module_symbol_worker_table(char *namelist)
+{
+	struct module_symbol_workers *mw;
+	struct module_symbol_slot *slot;
+	struct module_symtab *tab;
+	int i, w;
+
+	mw = &module_symbol_workers;
+
+	for (i = 0, slot = NULL; i < mw->count; i++) {
+		if ((mw->slots[i].state != MODSYM_LOCAL) &&
+		    STREQ(mw->objfiles[i], namelist)) {
+			slot = &mw->slots[i];
+			break;
+		}
+	}
+	if (!slot)
+		return NULL;
+
+	if (__sync_bool_compare_and_swap(&slot->state, MODSYM_FREE,
+	    MODSYM_LOCAL))
+		return NULL;
+
+	while (slot->state == MODSYM_BUSY) {
+		if (module_symbol_worker_exited(slot->worker))
+			break;
+		usleep(1000);
+	}
+	__sync_synchronize();
+
+	if (slot->state != MODSYM_DONE) {
+		slot->state = MODSYM_LOCAL;
+		return NULL;
+	}
+	slot->state = MODSYM_LOCAL;
+	w = slot->worker;
+
+	if (!(tab = (struct module_symtab *)malloc(slot->size)))
+		return NULL;
+
+	if ((pread(fileno(mw->tmpfile[w]), tab, slot->size, slot->offset)
+	    != slot->size) ||
+	    (MODULE_SYMTAB_SIZE(tab->symcount, tab->strsize) != slot->size)) {
+		free(tab);
+		return NULL;
+	}
+	MODULE_SYMTAB_INIT(tab);
+
+	if (CRASHDEBUG(2))
+		fprintf(fp, "%ld symbols decoded by worker %d from %s\n",
+			tab->symcount, w, namelist);
+
+	return tab;
+}
+
+/*
+ *  Error and interrupt cleanup: the results are no longer wanted.
+ */
+static void
+kill_module_symbol_workers(void *arg)
+{
+	struct module_symbol_workers *mw;
+	int w;
+
+	mw = &module_symbol_workers;
+
+	for (w = 0; w < MODULE_SYMBOL_WORKERS; w++) {
+		if (mw->pid[w] > 0)
+			kill(mw->pid[w], SIGKILL);
+	}
+
+	finish_module_symbol_workers();
+}
+
+/*
+ *  Wait for the workers to finish, and release their resources.
+ */
+void
+finish_module_symbol_workers(void)
+{
+	struct module_symbol_workers *mw;
+	int i, w, status;
+
+	mw = &module_symbol_workers;
+
+	for (w = 0; w < MODULE_SYMBOL_WORKERS; w++) {
+		if (mw->pid[w] > 0) {
+			while ((waitpid(mw->pid[w], &status, 0) < 0) &&
+			    (errno == EINTR))
+				;
+		}
+		mw->pid[w] = 0;
+		if (mw->tmpfile[w]) {
+			fclose(mw->tmpfile[w]);
+			mw->tmpfile[w] = NULL;
+		}
+	}
+
+	if (mw->objfiles) {
+		for (i = 0; i < mw->count; i++)
+			free(mw->objfiles[i]);
+		free(mw->objfiles);
+		mw->objfiles = NULL;
+	}
+
+	if (mw->slots) {
+		munmap(mw->slots, sizeof(struct module_symbol_slot) *
+			mw->count);
+		mw->slots = NULL;
+	}
+	mw->count = 0;
+
+	if (pc->cmd_cleanup == kill_module_symbol_workers) {
+		pc->cmd_cleanup = NULL;
+		pc->cmd_cleanup_arg = NULL;
+	}
+}
+
 /*
  *  This routine scours a module object file namelist for global text and
  *  data symbols, sorting and storing them in a static table for quick 
@@ -12950,13 +13452,9 @@ load_module_symbols(char *modref, char *namelist, ulong base_addr)
 {
 	static bfd *mbfd;
 	char **matching;
-  	long symcount;
-  	void *minisyms;
-  	unsigned int size;
 	int result;
 	struct load_module *lm;
-	asymbol *sort_x;
-	asymbol *sort_y;
+	struct module_symtab *tab;
 
 	if (!is_module_name(modref, NULL, &lm))
 		error(FATAL, "%s: not a loaded module name\n", modref);
@@ -13000,28 +13498,12 @@ load_module_symbols(char *modref, char *namelist, ulong base_addr)
 	if (!(bfd_get_file_flags(mbfd) & HAS_SYMS))
 		error(FATAL, "no symbols in object file: %s\n", namelist);
 
-	symcount = bfd_read_minisymbols(mbfd, FALSE, &minisyms, &size);
-	if (symcount < 0)
-		error(FATAL, "cannot access symbol table data: %s\n",
-			namelist);
-	else if (symcount == 0)
-		error(FATAL, "no symbols in object file: %s\n", namelist);
+	if (!(tab = module_symbol_worker_table(namelist)))
+		tab = read_module_symtab(mbfd, namelist);
 
-        if (CRASHDEBUG(2)) {
-                fprintf(fp, "%ld symbols found in obj file %s\n", symcount,
-                    namelist);
-        }
-        sort_x = bfd_make_empty_symbol(mbfd);
-        sort_y = bfd_make_empty_symbol(mbfd);
-        if (sort_x == NULL || sort_y == NULL)
-		error(FATAL, "bfd_make_empty_symbol() failed\n");
-
-	gnu_qsort(mbfd, minisyms, symcount, size, sort_x, sort_y);
+	store_load_module_symbols(mbfd, tab, base_addr, namelist);
 
-	store_load_module_symbols(mbfd, FALSE, minisyms, symcount, 
-		size, base_addr, namelist); 
-
-	free(minisyms);
+	free(tab);
 
 	bfd_close(mbfd);
 
@@ -13465,13 +13947,11 @@ kallsyms_module_symbol(struct load_module *lm, symbol_info *syminfo)
  *  with all the text and data symbols found in the load module object file.
  */
 static void
-store_load_module_symbols(bfd *bfd, int dynamic, void *minisyms, 
-	long symcount, unsigned int size, ulong base_addr, char *namelist)
+store_load_module_symbols(bfd *bfd, struct module_symtab *tab,
+	ulong base_addr, char *namelist)
 {
 	int i, t;
-  	asymbol *store;
-        asymbol *sym;
-  	bfd_byte *from, *fromend;
+	struct module_syminfo *ms, *msend;
         symbol_info syminfo;
 	struct syment *sp, *spx;
 	struct load_module *lm;
@@ -13481,9 +13961,6 @@ store_load_module_symbols(bfd *bfd, int dynamic, void *minisyms,
 	long symalloc;
 	int found = FALSE;
 
-        if ((store = bfd_make_empty_symbol(bfd)) == NULL)
-                error(FATAL, "bfd_make_empty_symbol() failed\n");
-
 	st->current = lm = NULL;
 
 	/*
@@ -13496,7 +13973,7 @@ store_load_module_symbols(bfd *bfd, int dynamic, void *minisyms,
 		lm = &st->load_modules[i];
 
                	if (lm->mod_base == base_addr) {
-			symalloc = symcount + lm->mod_ext_symcnt;
+			symalloc = tab->symcount + lm->mod_ext_symcnt;
 			if (lm->mod_load_symtable && 
 			   (lm->mod_symalloc < symalloc)) {
 				free(lm->mod_load_symtable);
@@ -13558,24 +14035,21 @@ store_load_module_symbols(bfd *bfd, int dynamic, void *minisyms,
         bfd_map_over_sections(bfd, section_header_info, MODULE_SECTIONS);
 
 	if (MODULE_MEMORY())
-		calculate_load_order_6_4(lm, bfd, dynamic, minisyms, symcount, size);
+		calculate_load_order_6_4(lm, tab);
 	else if (kt->flags & KMOD_V1)
 		calculate_load_order_v1(lm, bfd);
 	else
-		calculate_load_order_v2(lm, bfd, dynamic, minisyms,
-			symcount, size);
+		calculate_load_order_v2(lm, tab);
 
-        from = (bfd_byte *) minisyms;
-        fromend = from + symcount * size;
-        for (; from < fromend; from += size)
+	msend = tab->syms + tab->symcount;
+	for (ms = tab->syms; ms < msend; ms++)
         {
-                if ((sym = bfd_minisymbol_to_symbol(bfd, dynamic, from, store))
-                    == NULL)
-                        error(FATAL, "bfd_minisymbol_to_symbol() failed\n");
+		BZERO(&syminfo, sizeof(symbol_info));
+		syminfo.name = MODSYM_NAME(tab, ms);
+		syminfo.value = ms->value;
+		syminfo.type = ms->type;
 
-                bfd_get_symbol_info(bfd, sym, &syminfo);
-
-		secname = (char *)bfd_section_name(sym->section);
+		secname = MODSYM_SECNAME(tab, ms);
                 found = 0;
 
                 if (kt->flags & KMOD_V1) {
@@ -14202,53 +14676,22 @@ ascii_long(ulong word)
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA. */
 
-static bfd *gnu_sort_bfd;
-static asymbol *gnu_sort_x;
-static asymbol *gnu_sort_y;
-
 #define valueof(x) ((x)->section->vma + (x)->value)
 
-static int
-non_numeric_forward(const void *P_x, const void *P_y)
-{
-  	asymbol *x, *y;
-  	const char *xn, *yn;
-
-  	x = bfd_minisymbol_to_symbol(gnu_sort_bfd, FALSE, P_x, gnu_sort_x);
-  	y = bfd_minisymbol_to_symbol(gnu_sort_bfd, FALSE, P_y, gnu_sort_y);
-  	if (x == NULL || y == NULL)
-		error(FATAL, "bfd_minisymbol_to_symbol failed\n");
-
-  	xn = bfd_asymbol_name(x);
-  	yn = bfd_asymbol_name(y);
-
-  	return ((xn == NULL) ? ((yn == NULL) ? 0 : -1) :
-          	((yn == NULL) ? 1 : strcmp (xn, yn)));
-}
-
-static int
-numeric_forward(const void *P_x, const void *P_y)
+/*
+ *  Note the values of the vmlinux symbols that are needed before the
+ *  symbol table has been stored.
+ */
+static void
+gnu_sort_note_symbol(asymbol *x)
 {
-  	asymbol *x, *y;
-  	asection *xs, *ys;
-
-  	x = bfd_minisymbol_to_symbol(gnu_sort_bfd, FALSE, P_x, gnu_sort_x);
-  	y = bfd_minisymbol_to_symbol(gnu_sort_bfd, FALSE, P_y, gnu_sort_y);
-  	if (x == NULL || y == NULL)
-		error(FATAL, "bfd_minisymbol_to_symbol failed\n");
+	if ((st->_stext_vmlinux == UNINITIALIZED) && STREQ(x->name, "_stext"))
+		st->_stext_vmlinux = valueof(x);
 
-	if (st->_stext_vmlinux == UNINITIALIZED) {
-		if (STREQ(x->name, "_stext"))
-			st->_stext_vmlinux = valueof(x);
-		else if (STREQ(y->name, "_stext"))
-			st->_stext_vmlinux = valueof(y);
-	}
-	if (kt->flags2 & KASLR_CHECK) {
-		if (STREQ(x->name, "module_load_offset") || 
-		    STREQ(y->name, "module_load_offset")) {
-			kt->flags2 &= ~KASLR_CHECK;
-			kt->flags2 |= (RELOC_AUTO|KASLR);
-		}
+	if ((kt->flags2 & KASLR_CHECK) &&
+	    STREQ(x->name, "module_load_offset")) {
+		kt->flags2 &= ~KASLR_CHECK;
+		kt->flags2 |= (RELOC_AUTO|KASLR);
 	}
 
 	if (SADUMP_DUMPFILE() || QEMU_MEM_DUMP_NO_VMCOREINFO() || VMSS_DUMPFILE()) {
@@ -14256,51 +14699,86 @@ numeric_forward(const void *P_x, const void *P_y)
 		if (STREQ(x->name, "divide_error") ||
 		    STREQ(x->name, "asm_exc_divide_error"))
 			st->divide_error_vmlinux = valueof(x);
-		else if (STREQ(y->name, "divide_error") ||
-			 STREQ(y->name, "asm_exc_divide_error"))
-			st->divide_error_vmlinux = valueof(y);
-
-		if (STREQ(x->name, "idt_table"))
+		else if (STREQ(x->name, "idt_table"))
 			st->idt_table_vmlinux = valueof(x);
-		else if (STREQ(y->name, "idt_table"))
-			st->idt_table_vmlinux = valueof(y);
-
-		if (STREQ(x->name, "kaiser_init"))
+		else if (STREQ(x->name, "kaiser_init"))
 			st->kaiser_init_vmlinux = valueof(x);
-		else if (STREQ(y->name, "kaiser_init"))
-			st->kaiser_init_vmlinux = valueof(y);
-
-		if (STREQ(x->name, "linux_banner"))
+		else if (STREQ(x->name, "linux_banner"))
 			st->linux_banner_vmlinux = valueof(x);
-		else if (STREQ(y->name, "linux_banner"))
-			st->linux_banner_vmlinux = valueof(y);
-
-		if (STREQ(x->name, "pti_init"))
+		else if (STREQ(x->name, "pti_init"))
 			st->pti_init_vmlinux = valueof(x);
-		else if (STREQ(y->name, "pti_init"))
-			st->pti_init_vmlinux = valueof(y);
-
-		if (STREQ(x->name, "saved_command_line"))
+		else if (STREQ(x->name, "saved_command_line"))
 			st->saved_command_line_vmlinux = valueof(x);
-		else if (STREQ(y->name, "saved_command_line"))
-			st->saved_command_line_vmlinux = valueof(y);
 	}
+}
 
-	xs = bfd_asymbol_section(x);
-	ys = bfd_asymbol_section(y);
+/*
+ *  Each minisymbol is converted to an asymbol once, and its sort key
+ *  saved, rather than converting both minisymbols on every comparison.
+ */
+struct gnu_sort_key {
+	bfd_vma value;
+	const char *name;
+	bfd_byte *minisym;
+};
 
-  	if (bfd_is_und_section(xs)) {
-      		if (!bfd_is_und_section(ys))
-        		return -1;
-    	}
-  	else if (bfd_is_und_section (ys))
-    		return 1;
-  	else if (valueof (x) != valueof (y))
-    		return valueof (x) < valueof (y) ? -1 : 1;
+static int
+gnu_sort_name_forward(const void *P_x, const void *P_y)
+{
+	const char *xn = ((const struct gnu_sort_key *)P_x)->name;
+	const char *yn = ((const struct gnu_sort_key *)P_y)->name;
+
+  	return ((xn == NULL) ? ((yn == NULL) ? 0 : -1) :
+          	((yn == NULL) ? 1 : strcmp (xn, yn)));
+}
+
+/*
+ *  Stable LSD radix sort of the keys by value, one byte per pass,
+ *  skipping the bytes that all of the values share.  The result is
+ *  left in keys.
+ */
+static void
+gnu_radix_sort(struct gnu_sort_key *keys, struct gnu_sort_key *tmp, long count)
+{
+	struct gnu_sort_key *from, *to, *swap;
+	long i, counts[256], pos;
+	int shift, d;
 
-  	return non_numeric_forward(P_x, P_y);
+	if (count <= 1)
+		return;
+
+	from = keys;
+	to = tmp;
+
+	for (shift = 0; shift < (sizeof(bfd_vma) * 8); shift += 8) {
+		BZERO(counts, sizeof(counts));
+		for (i = 0; i < count; i++)
+			counts[(from[i].value >> shift) & 0xff]++;
+		if (counts[(from[0].value >> shift) & 0xff] == count)
+			continue;
+
+		for (d = 0, pos = 0; d < 256; d++) {
+			i = counts[d];
+			counts[d] = pos;
+			pos += i;
+		}
+		for (i = 0; i < count; i++)
+			to[counts[(from[i].value >> shift) & 0xff]++] = from[i];
+
+		swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != keys)
+		BCOPY(from, keys, count * sizeof(struct gnu_sort_key));
 }
 
+/*
+ *  Sort the minisymbols as the GNU nm -n comparator does: undefined
+ *  symbols first, ordered by name, followed by the others ordered by
+ *  value, and then by name.
+ */
 static void
 gnu_qsort(bfd *bfd, 
 	  void *minisyms, 
@@ -14309,11 +14787,68 @@ gnu_qsort(bfd *bfd,
 	  asymbol *x,
 	  asymbol *y)
 {
-	gnu_sort_bfd = bfd;
-	gnu_sort_x = x;
-	gnu_sort_y = y;
-	
-        qsort(minisyms, symcount, size, numeric_forward);
+	struct gnu_sort_key *keys, *tmp;
+	bfd_byte *from, *sorted;
+	asymbol *sym;
+	long i, j, und;
+
+	if (symcount <= 0)
+		return;
+
+	keys = (struct gnu_sort_key *)malloc(symcount *
+		sizeof(struct gnu_sort_key));
+	tmp = (struct gnu_sort_key *)malloc(symcount *
+		sizeof(struct gnu_sort_key));
+	sorted = (bfd_byte *)malloc(symcount * size);
+	if (!keys || !tmp || !sorted)
+		error(FATAL, "symbol sort space malloc: %s\n",
+			strerror(errno));
+
+	/*
+	 *  Undefined symbols go at the front of keys, and the others at
+	 *  the front of tmp.
+	 */
+	from = (bfd_byte *)minisyms;
+	for (i = und = j = 0; i < symcount; i++, from += size) {
+		if (!(sym = bfd_minisymbol_to_symbol(bfd, FALSE, from, x)))
+			error(FATAL, "bfd_minisymbol_to_symbol failed\n");
+
+		gnu_sort_note_symbol(sym);
+
+		if (bfd_is_und_section(bfd_asymbol_section(sym))) {
+			keys[und].value = 0;
+			keys[und].name = bfd_asymbol_name(sym);
+			keys[und].minisym = from;
+			und++;
+		} else {
+			tmp[j].value = valueof(sym);
+			tmp[j].name = bfd_asymbol_name(sym);
+			tmp[j].minisym = from;
+			j++;
+		}
+	}
+
+	qsort(keys, und, sizeof(struct gnu_sort_key), gnu_sort_name_forward);
+
+	BCOPY(tmp, &keys[und], j * sizeof(struct gnu_sort_key));
+	gnu_radix_sort(&keys[und], tmp, j);
+
+	for (i = und; i < symcount; i = j) {
+		for (j = i + 1; (j < symcount) &&
+		     (keys[j].value == keys[i].value); j++)
+			;
+		if ((j - i) > 1)
+			qsort(&keys[i], j - i, sizeof(struct gnu_sort_key),
+				gnu_sort_name_forward);
+	}
+
+	for (i = 0; i < symcount; i++)
+		BCOPY(keys[i].minisym, sorted + (i * size), size);
+	BCOPY(sorted, minisyms, symcount * size);
+
+	free(keys);
+	free(tmp);
+	free(sorted);
 }
 
 /*
@@ -14701,8 +15236,10 @@ fill_struct_member_data(struct struct_member_data *smd)
 
 	open_tmpfile2();
 
-	if (!gdb_pass_through(buf, pc->tmpfile2, GNU_RETURN_ON_ERROR))
+	if (!gdb_pass_through(buf, pc->tmpfile2, GNU_RETURN_ON_ERROR)) {
+		close_tmpfile2();
 		return FALSE;
+	}
 
 	rewind(pc->tmpfile2);
 	if (fgets(buf, BUFSIZE, pc->tmpfile2)) {
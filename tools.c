@@ -24,10 +24,11 @@
 #endif
 
 static void print_number(struct number_option *, int, int);
-static long alloc_hq_entry(void);
-struct hq_entry;
-static void dealloc_hq_entry(struct hq_entry *);
+struct hash_table;
+static int hq_resize(struct hash_table *, ulong);
+static long hq_lookup(struct hash_table *, ulong, long *);
 static void show_options(void);
+static int set_profile(char *);
 static void dump_struct_members(struct list_data *, int, ulong);
 static void rbtree_iteration(ulong, struct tree_data *, char *);
 void dump_struct_members_for_tree(struct tree_data *, int, ulong);
@@ -37,9 +38,22 @@ struct req_entry {
 	int *is_str, *is_ptr;
 	ulong *width, *offset;
 	int count;
+	int *type, *is_unsigned;
+	long *bitpos, *bitsize;
+	struct req_enum {
+		int count;
+		char **name;
+		long *value;
+	} **enums;
+	ulong start, size;	/* span of the members read locally */
+	char *buf;
 };
 
-static void print_value(struct req_entry *, unsigned int, ulong, unsigned int);
+static void print_value(struct req_entry *, unsigned int, ulong, unsigned int,
+	char *);
+static struct req_enum *fill_member_enum(char *, char *);
+static ulonglong req_bitfield_value(struct req_entry *, unsigned int, ulonglong);
+static int req_export_type(struct req_entry *, unsigned int);
 struct req_entry *fill_member_offsets(char *);
 void dump_struct_members_fast(struct req_entry *, int, ulong);
 
@@ -2547,6 +2561,35 @@ cmd_set(void)
                         }
                         return;
 
+		} else if (STREQ(args[optind], "memtrace")) {
+			if (args[optind+1]) {
+				optind++;
+				if (STREQ(args[optind], "off"))
+					memtrace_close();
+				else if (!memtrace_open(args[optind]))
+					return;
+			}
+
+			if (runtime) {
+				fprintf(fp, "memtrace: %s\n",
+					pc->memtrace ? pc->memtrace : "off");
+			}
+			return;
+
+		} else if (STREQ(args[optind], "profile")) {
+			if (args[optind+1]) {
+				optind++;
+				if (!set_profile(args[optind]))
+					return;
+			}
+
+			if (runtime) {
+				fprintf(fp, "profile: %s\n",
+					prof->path ? prof->path :
+					prof->flags & PROFILE_ON ? "on" : "off");
+			}
+			return;
+
 		} else if (XEN_HYPER_MODE()) {
 			error(FATAL, "invalid argument for the Xen hypervisor\n");
 		} else if (pc->flags & MINIMAL_MODE) {
@@ -2655,6 +2698,9 @@ show_options(void)
 	fprintf(fp, "       offline: %s\n", pc->flags2 & OFFLINE_HIDE ? "hide" : "show");
 	fprintf(fp, "       redzone: %s\n", pc->flags2 & REDZONE ? "on" : "off");
 	fprintf(fp, "         error: %s\n", pc->error_path);
+	fprintf(fp, "       profile: %s\n", prof->path ? prof->path :
+		prof->flags & PROFILE_ON ? "on" : "off");
+	fprintf(fp, "      memtrace: %s\n", pc->memtrace ? pc->memtrace : "off");
 }
 
 
@@ -3644,10 +3690,16 @@ next_arg:
 		FREEBUF(ld->structname);
 }
 
+/*
+ *  Display the members described by a req_entry for the structure at p.
+ *  The members that are formatted here are read with a single readmem()
+ *  of the span they cover; anything else is handed to gdb.
+ */
 void
 dump_struct_members_fast(struct req_entry *e, int radix, ulong p)
 {
 	unsigned int i;
+	char *data;
 	char b[BUFSIZE];
 
 	if (!(e && IS_KVADDR(p)))
@@ -3656,9 +3708,14 @@ dump_struct_members_fast(struct req_entry *e, int radix, ulong p)
 	if (!radix)
 		radix = *gdb_output_radix;
 
+	data = NULL;
+	if (e->size && readmem(p + e->start, KVADDR, e->buf, e->size,
+	    "structure members", RETURN_ON_ERROR|QUIET))
+		data = e->buf;
+
 	for (i = 0; i < e->count; i++) {
 		if (0 < e->width[i] && (e->width[i] <= 8 || e->is_str[i])) {
-			print_value(e, i, p, e->is_ptr[i] ? 16 : radix);
+			print_value(e, i, p, e->is_ptr[i] ? 16 : radix, data);
 		} else if (e->width[i] == 0 || e->width[i] > 8) {
 			snprintf(b, BUFSIZE, "%s.%s", e->name, e->member[i]);
 			dump_struct_member(b, p, radix);
@@ -3666,12 +3723,20 @@ dump_struct_members_fast(struct req_entry *e, int radix, ulong p)
 	}
 }
 
+/*
+ *  Resolve each member of a "struct.member1,member2,..." argument once,
+ *  so that every structure displayed with it can be formatted locally:
+ *  the offset, size, type and bitfield position of each member come from
+ *  gdb's printm command, which accepts nested "a.b.c" and "a[n]" members.
+ */
 struct req_entry *
 fill_member_offsets(char *arg)
 {
 	int j;
 	char *p, m;
 	struct req_entry *e;
+	struct struct_member_data smd;
+	ulong start, end;
 	char buf[BUFSIZE];
 
 	if (!(arg && *arg))
@@ -3699,74 +3764,402 @@ fill_member_offsets(char *arg)
 	e->is_str = (int *)GETBUF(e->count * sizeof(int));
 	e->member = (char **)GETBUF(e->count * sizeof(char *));
 	e->offset = (ulong *)GETBUF(e->count * sizeof(ulong));
+	e->type = (int *)GETBUF(e->count * sizeof(int));
+	e->is_unsigned = (int *)GETBUF(e->count * sizeof(int));
+	e->bitpos = (long *)GETBUF(e->count * sizeof(long));
+	e->bitsize = (long *)GETBUF(e->count * sizeof(long));
+	e->enums = (struct req_enum **)GETBUF(e->count * sizeof(void *));
 
 	replace_string(p, ",", ' ');
 	parse_line(p, e->member);
 
+	start = ~0UL;
+	end = 0;
+
 	for (j = 0; j < e->count; j++) {
-		e->offset[j] = MEMBER_OFFSET(e->name, e->member[j]);
-		if (e->offset[j] == INVALID_OFFSET)
-			e->offset[j] = ANON_MEMBER_OFFSET(e->name, e->member[j]);
-		if (e->offset[j] == INVALID_OFFSET)
-			error(FATAL, "Can't get offset of '%s.%s'\n",
-				e->name, e->member[j]);
-
-		e->is_ptr[j] = MEMBER_TYPE(e->name, e->member[j]) == TYPE_CODE_PTR;
+		smd.structure = e->name;
+		smd.member = e->member[j];
+
+		if (fill_struct_member_data(&smd)) {
+			e->offset[j] = smd.offset;
+			e->width[j] = smd.length;
+			e->type[j] = smd.type;
+			e->is_unsigned[j] = smd.unsigned_type;
+			e->bitpos[j] = smd.bitpos;
+			e->bitsize[j] = smd.bitsize;
+		} else {
+			e->offset[j] = MEMBER_OFFSET(e->name, e->member[j]);
+			if (e->offset[j] == INVALID_OFFSET)
+				e->offset[j] = ANON_MEMBER_OFFSET(e->name, e->member[j]);
+			if (e->offset[j] == INVALID_OFFSET)
+				error(FATAL, "Can't get offset of '%s.%s'\n",
+					e->name, e->member[j]);
+
+			e->type[j] = MEMBER_TYPE(e->name, e->member[j]);
+			e->is_unsigned[j] = TRUE;
+
+			/* Dirty hack for obtaining size of particular field */
+			snprintf(buf, BUFSIZE, "%s + 1", e->member[j]);
+			e->width[j] = ANON_MEMBER_OFFSET(e->name, buf) - e->offset[j];
+		}
+
+		e->is_ptr[j] = (e->type[j] == TYPE_CODE_PTR);
 		e->is_str[j] = is_string(e->name, e->member[j]);
+		if (e->type[j] == TYPE_CODE_ENUM)
+			e->enums[j] = fill_member_enum(e->name, e->member[j]);
 
-		/* Dirty hack for obtaining size of particular field */
-		snprintf(buf, BUFSIZE, "%s + 1", e->member[j]);
-		e->width[j] = ANON_MEMBER_OFFSET(e->name, buf) - e->offset[j];
+		if ((e->width[j] == 0) || ((e->width[j] > 8) && !e->is_str[j]))
+			continue;
+		if (e->offset[j] < start)
+			start = e->offset[j];
+		if ((e->offset[j] + e->width[j]) > end)
+			end = e->offset[j] + e->width[j];
+	}
+
+	if (end > start) {
+		e->start = start;
+		e->size = end - start;
+		e->buf = GETBUF(e->size);
 	}
 
 	return e;
 }
 
+/*
+ *  Gather the enumerators of an enum member from its gdb ptype output:
+ *
+ *    type = enum pid_type {PIDTYPE_PID, PIDTYPE_TGID, ..., PIDTYPE_MAX}
+ */
+static struct req_enum *
+fill_member_enum(char *name, char *member)
+{
+	struct req_enum *re;
+	char *ptype, *p1, *p2, *tok;
+	long size, value;
+	int cnt;
+	char buf[BUFSIZE];
+
+	snprintf(buf, BUFSIZE, "ptype ((struct %s *)0x0).%s", name, member);
+
+	open_tmpfile2();
+	if (!gdb_pass_through(buf, pc->tmpfile2, GNU_RETURN_ON_ERROR)) {
+		close_tmpfile2();
+		return NULL;
+	}
+	fseek(pc->tmpfile2, 0, SEEK_END);
+	size = ftell(pc->tmpfile2);
+	rewind(pc->tmpfile2);
+	ptype = GETBUF(size+1);
+	if (fread(ptype, 1, size, pc->tmpfile2) != size) {
+		close_tmpfile2();
+		FREEBUF(ptype);
+		return NULL;
+	}
+	close_tmpfile2();
+
+	if (!(p1 = strstr(ptype, "enum ")) || !(p1 = strchr(p1, '{')) ||
+	    !(p2 = strchr(p1, '}'))) {
+		FREEBUF(ptype);
+		return NULL;
+	}
+	*p2 = NULLCHAR;
+	p1++;
+
+	re = (struct req_enum *)GETBUF(sizeof(struct req_enum));
+	cnt = count_chars(p1, ',') + 1;
+	re->name = (char **)GETBUF(cnt * sizeof(char *));
+	re->value = (long *)GETBUF(cnt * sizeof(long));
+
+	for (value = 0, tok = strtok(p1, ","); tok; tok = strtok(NULL, ",")) {
+		tok = strip_beginning_whitespace(tok);
+		if ((p2 = strstr(tok, " = "))) {
+			*p2 = NULLCHAR;
+			value = strtol(p2 + 3, NULL, 0);
+		}
+		strip_ending_whitespace(tok);
+		if (!strlen(tok) || (re->count == cnt))
+			continue;
+		re->name[re->count] = tok;
+		re->value[re->count++] = value++;
+	}
+
+	return re;
+}
+
+/*
+ *  Extract a bitfield from the integer that contains it.
+ */
+static ulonglong
+req_bitfield_value(struct req_entry *e, unsigned int i, ulonglong value)
+{
+	int bits, pos, size;
+
+	pos = e->bitpos[i];
+	size = e->bitsize[i];
+	bits = e->width[i] * 8;
+
+	if (!size || (size >= 64) || ((pos + size) > bits))
+		return value;
+
+	if (__BYTE_ORDER == __BIG_ENDIAN)
+		pos = bits - pos - size;
+
+	return (value >> pos) & ((1ULL << size) - 1);
+}
+
 static void
-print_value(struct req_entry *e, unsigned int i, ulong addr, unsigned int radix)
+print_value(struct req_entry *e, unsigned int i, ulong addr, unsigned int radix,
+	char *data)
 {
 	union { uint64_t v64; uint32_t v32;
 		uint16_t v16; uint8_t v8;
 	} v;
 	char buf[BUFSIZE];
 	struct syment *sym;
+	struct req_enum *re;
+	ulonglong value;
+	long long svalue;
+	int j, len, scalar;
 
 	addr += e->offset[i];
+	v.v64 = 0;
 
 	/* Read up to 8 bytes, counters, pointers, etc. */
-	if (e->width[i] <= 8 && !readmem(addr, KVADDR, &v, e->width[i],
-	    "structure value", RETURN_ON_ERROR | QUIET)) {
-		error(INFO, "cannot access member: %s at %lx\n", e->member[i], addr);
-		return;
+	if (e->width[i] <= 8) {
+		if (data)
+			BCOPY(data + (e->offset[i] - e->start), &v, e->width[i]);
+		else if (!readmem(addr, KVADDR, &v, e->width[i],
+		    "structure value", RETURN_ON_ERROR | QUIET)) {
+			error(INFO, "cannot access member: %s at %lx\n",
+				e->member[i], addr);
+			return;
+		}
+	}
+
+	scalar = TRUE;
+	switch (e->width[i])
+	{
+	case 1: value = v.v8; break;
+	case 2: value = v.v16; break;
+	case 4: value = v.v32; break;
+	case 8: value = v.v64; break;
+	default: value = 0; scalar = FALSE; break;
+	}
+
+	if (e->bitsize[i])
+		value = req_bitfield_value(e, i, value);
+
+	if ((re = e->enums[i])) {
+		for (j = 0; j < re->count; j++) {
+			if (re->value[j] == (long)value) {
+				fprintf(fp, "  %s = %s\n", e->member[i],
+					re->name[j]);
+				return;
+			}
+		}
 	}
-	snprintf(buf, BUFSIZE, "  %%s = %s%%%s%s",
-		 (radix == 16 ? "0x" : ""),
-		 (e->width[i] == 8 ? "l" : ""),
-		 (radix == 16 ? "x" : "u" )
-		);
 
-	switch (e->width[i]) {
-		case 1: fprintf(fp, buf, e->member[i], v.v8); break;
-		case 2: fprintf(fp, buf, e->member[i], v.v16); break;
-		case 4: fprintf(fp, buf, e->member[i], v.v32); break;
-		case 8: fprintf(fp, buf, e->member[i], v.v64); break;
+	if ((e->type[i] == TYPE_CODE_BOOL) && (value <= 1)) {
+		fprintf(fp, "  %s = %s\n", e->member[i],
+			value ? "true" : "false");
+		return;
 	}
 
+	if (scalar && (radix == 10) && !e->is_unsigned[i] && !e->is_ptr[i]) {
+		len = e->bitsize[i] ? e->bitsize[i] : e->width[i] * 8;
+		svalue = (len < 64) && (value & (1ULL << (len - 1))) ?
+			(long long)(value | (~0ULL << len)) : (long long)value;
+		fprintf(fp, "  %s = %lld", e->member[i], svalue);
+	} else if (scalar)
+		fprintf(fp, radix == 16 ? "  %s = 0x%llx" : "  %s = %llu",
+			e->member[i], value);
 
 	if (e->is_str[i]) {
 		if (e->is_ptr[i]) {
 			read_string(v.v64, buf, BUFSIZE);
 			fprintf(fp, "  \"%s\"", buf);
 		} else {
-			read_string(addr, buf, e->width[i]);
+			len = MIN(e->width[i], BUFSIZE-1);
+			if (data) {
+				BCOPY(data + (e->offset[i] - e->start), buf, len);
+				buf[len] = NULLCHAR;
+			} else
+				read_string(addr, buf, len);
 			fprintf(fp, "  %s = \"%s\"", e->member[i], buf);
 		}
-	} else if ((sym = value_search(v.v64, 0)) && is_symbol_text(sym))
+	} else if (!e->bitsize[i] && (sym = value_search(v.v64, 0)) &&
+	    is_symbol_text(sym))
 		fprintf(fp, " <%s>", sym->name);
 
 	fprintf(fp, "\n");
 }
 
+/*
+ *  The export type of a req_entry member: strings and enumerators are
+ *  exported as text, integers and pointers as numbers, and members that
+ *  are neither, such as arrays and embedded structures, as a string of
+ *  their bytes in hexadecimal.
+ */
+static int
+req_export_type(struct req_entry *e, unsigned int i)
+{
+	if (e->is_str[i] || e->enums[i])
+		return EXPORT_STRING;
+
+	switch (e->width[i])
+	{
+	case 1:
+	case 2:
+	case 4:
+	case 8:
+		if (e->is_ptr[i])
+			return EXPORT_ADDR;
+		if (!e->is_unsigned[i] && (e->type[i] != TYPE_CODE_BOOL))
+			return EXPORT_INT;
+		return EXPORT_UINT;
+	}
+
+	return EXPORT_STRING;
+}
+
+/*
+ *  Fill in the export fields of the members of a req_entry, if fields
+ *  is non-NULL, and return their number.
+ */
+int
+export_struct_fields(struct req_entry *e, struct export_field *fields)
+{
+	unsigned int i;
+
+	if (!e)
+		return 0;
+
+	if (fields) {
+		for (i = 0; i < e->count; i++) {
+			fields[i].name = e->member[i];
+			fields[i].type = req_export_type(e, i);
+		}
+	}
+
+	return e->count;
+}
+
+/*
+ *  Export the members of a req_entry for the structure at p, from a
+ *  single read of the span they cover, as in dump_struct_members_fast().
+ *  A member that cannot be read is exported as null.
+ */
+void
+export_struct_members(struct req_entry *e, ulong p)
+{
+	unsigned int i, j;
+	char *data, *bytes, *s;
+	union { uint64_t v64; uint32_t v32;
+		uint16_t v16; uint8_t v8;
+	} v;
+	ulonglong value;
+	struct req_enum *re;
+	int len, in_span;
+	char buf[BUFSIZE];
+
+	data = NULL;
+	if (e->size && readmem(p + e->start, KVADDR, e->buf, e->size,
+	    "structure members", RETURN_ON_ERROR|QUIET))
+		data = e->buf;
+
+	for (i = 0; i < e->count; i++) {
+		/*
+		 *  Wide members other than strings are not in the span.
+		 */
+		in_span = data && (e->offset[i] >= e->start) &&
+			((e->offset[i] + e->width[i]) <= (e->start + e->size));
+
+		v.v64 = 0;
+		if (e->width[i] <= 8) {
+			if (in_span)
+				BCOPY(data + (e->offset[i] - e->start), &v,
+					e->width[i]);
+			else if (!readmem(p + e->offset[i], KVADDR, &v,
+			    e->width[i], "structure value",
+			    RETURN_ON_ERROR|QUIET)) {
+				export_null();
+				continue;
+			}
+		}
+
+		switch (e->width[i])
+		{
+		case 1: value = v.v8; break;
+		case 2: value = v.v16; break;
+		case 4: value = v.v32; break;
+		default: value = v.v64; break;
+		}
+		if (e->bitsize[i])
+			value = req_bitfield_value(e, i, value);
+
+		switch (req_export_type(e, i))
+		{
+		case EXPORT_ADDR:
+			export_addr(value);
+			continue;
+
+		case EXPORT_UINT:
+			export_uint(value);
+			continue;
+
+		case EXPORT_INT:
+			len = e->bitsize[i] ? e->bitsize[i] : e->width[i] * 8;
+			if ((len < 64) && (value & (1ULL << (len - 1))))
+				value |= ~0ULL << len;
+			export_int((long)value);
+			continue;
+		}
+
+		if (e->is_str[i]) {
+			BZERO(buf, BUFSIZE);
+			if (e->is_ptr[i])
+				read_string(v.v64, buf, BUFSIZE-1);
+			else if (in_span)
+				BCOPY(data + (e->offset[i] - e->start), buf,
+					MIN(e->width[i], BUFSIZE-1));
+			else
+				read_string(p + e->offset[i], buf,
+					MIN(e->width[i], BUFSIZE-1));
+			export_string(buf, -1);
+		} else if ((re = e->enums[i])) {
+			for (j = 0; j < re->count; j++)
+				if (re->value[j] == (long)value)
+					break;
+			if (j < re->count)
+				export_string(re->name[j], -1);
+			else {
+				sprintf(buf, "%lld", (long long)value);
+				export_string(buf, -1);
+			}
+		} else {
+			if (in_span)
+				bytes = data + (e->offset[i] - e->start);
+			else {
+				bytes = GETBUF(e->width[i]);
+				if (!readmem(p + e->offset[i], KVADDR, bytes,
+				    e->width[i], "structure member",
+				    RETURN_ON_ERROR|QUIET)) {
+					FREEBUF(bytes);
+					export_null();
+					continue;
+				}
+			}
+			s = GETBUF((e->width[i] * 2) + 1);
+			for (j = 0; j < e->width[i]; j++)
+				sprintf(&s[j*2], "%02x", (unsigned char)bytes[j]);
+			export_string(s, e->width[i] * 2);
+			FREEBUF(s);
+			if (!in_span)
+				FREEBUF(bytes);
+		}
+	}
+}
+
 /*
  *  Does the work for cmd_list() and any other function that requires the
  *  contents of a linked list.  See cmd_list description above for details.
@@ -4260,7 +4653,7 @@ do_list_no_hash(struct list_data *ld)
 }
 
 /*
- *  Issue a dump_struct_member() call for one or more structure
+ *  Issue a dump_struct_member_list() call for one or more structure
  *  members.  Multiple members are passed in a comma-separated
  *  list using the the format:  
  *
@@ -4269,9 +4662,9 @@ do_list_no_hash(struct list_data *ld)
 void
 dump_struct_members(struct list_data *ld, int idx, ulong next)
 {
-	int i, argc;
-	char *p1, *p2;
-	char *structname, *members;
+	int argc;
+	char *p1;
+	char *structname;
 	char *arglist[MAXARGS];
 	unsigned int radix;
 
@@ -4283,25 +4676,18 @@ dump_struct_members(struct list_data *ld, int idx, ulong next)
 		radix = 0;
 
 	structname = GETBUF(strlen(ld->structname[idx])+1);
-	members = GETBUF(strlen(ld->structname[idx])+1);
 
 	strcpy(structname, ld->structname[idx]);
-	p1 = strstr(structname, ".") + 1;
+	p1 = strstr(structname, ".");
+	*p1++ = NULLCHAR;
 
-	p2 = strstr(ld->structname[idx], ".") + 1;
-	strcpy(members, p2);
-	replace_string(members, ",", ' ');
-	argc = parse_line(members, arglist);
+	replace_string(p1, ",", ' ');
+	argc = parse_line(p1, arglist);
 
-	for (i = 0; i < argc; i++) {
-		*p1 = NULLCHAR;
-		strcat(structname, arglist[i]);
- 		dump_struct_member(structname, 
-			next - ld->list_head_offset - ld->struct_list_offset, radix);
-	}
+	dump_struct_member_list(structname, arglist, argc,
+		next - ld->list_head_offset - ld->struct_list_offset, radix);
 
 	FREEBUF(structname);
-	FREEBUF(members);
 }
 
 #define RADIXTREE_REQUEST (0x1)
@@ -5005,6 +5391,7 @@ do_rbtree(struct tree_data *td)
 		readmem(td->start + OFFSET(rb_root_rb_node), KVADDR,
 			&start, sizeof(void *), "rb_root rb_node", FAULT_ON_ERROR);
 
+	td->flags &= ~TREE_CALLBACK_STOPPED;
 	rbtree_iteration(start, td, pos);
 
 	return td->count;
@@ -5019,7 +5406,7 @@ rbtree_iteration(ulong node_p, struct tree_data *td, char *pos)
 	char new_pos[BUFSIZE];
 	static struct req_entry **e;
 
-	if (!node_p)
+	if (!node_p || (td->flags & TREE_CALLBACK_STOPPED))
 		return;
 
 	if (!td->count && td->structname_args) {
@@ -5050,8 +5437,18 @@ rbtree_iteration(ulong node_p, struct tree_data *td, char *pos)
 					node_p, new_p);
 	}
 
+	if (td->flags & TREE_CALLBACK_STOPPED)
+		return;
+
 	struct_p = node_p - td->node_member_offset;
 
+	if ((td->flags & TREE_CALLBACK) &&
+	    td->callback_func((void *)struct_p, td->callback_data) &&
+	    (td->flags & TREE_CALLBACK_RETURN)) {
+		td->flags |= TREE_CALLBACK_STOPPED;
+		return;
+	}
+
 	if (td->flags & VERBOSE)
 		fprintf(fp, "%lx\n", struct_p);
 	
@@ -5110,10 +5507,10 @@ rbtree_iteration(ulong node_p, struct tree_data *td, char *pos)
 void
 dump_struct_members_for_tree(struct tree_data *td, int idx, ulong struct_p)
 {
-	int i, argc;
+	int argc;
 	uint print_radix;
 	char *p1;
-	char *structname, *members;
+	char *structname;
 	char *arglist[MAXARGS];
 
 	if (td->flags & TREE_STRUCT_RADIX_10)
@@ -5124,23 +5521,17 @@ dump_struct_members_for_tree(struct tree_data *td, int idx, ulong struct_p)
 		print_radix = 0;
 
 	structname = GETBUF(strlen(td->structname[idx])+1);
-	members = GETBUF(strlen(td->structname[idx])+1);
 
 	strcpy(structname, td->structname[idx]);
-	p1 = strstr(structname, ".") + 1;
+	p1 = strstr(structname, ".");
+	*p1++ = NULLCHAR;
 
-	strcpy(members, p1);
-	replace_string(members, ",", ' ');
-	argc = parse_line(members, arglist);
+	replace_string(p1, ",", ' ');
+	argc = parse_line(p1, arglist);
 
-	for (i = 0; i <argc; i++) {
-		*p1 = NULLCHAR;
-		strcat(structname, arglist[i]);
-		dump_struct_member(structname, struct_p, print_radix);
-	}
+	dump_struct_member_list(structname, arglist, argc, struct_p, print_radix);
 
 	FREEBUF(structname);
-	FREEBUF(members);
 }
 
 /*
@@ -5166,34 +5557,40 @@ dump_struct_members_for_tree(struct tree_data *td, int idx, ulong struct_p)
 #define HASH_QUEUE_OPEN       (0x4)
 #define HASH_QUEUE_CLOSED     (0x8)
 
+/*
+ *  The values are kept in the order entered, and an open-addressed
+ *  (linear probing) table of power-of-two size indexes them.  A slot
+ *  is in use only if its gen matches the table's, so that hq_open()
+ *  need not clear the table.  The table doubles when it becomes
+ *  three-quarters full; pc->nr_hash_queues is its initial size.
+ */
 #define HQ_ENTRY_CHUNK   (1024)
 #define NR_HASH_QUEUES_DEFAULT   (32768UL)
-#define HQ_SHIFT         (machdep->pageshift)
-#define HQ_INDEX(X)      (((X) >> HQ_SHIFT) % pc->nr_hash_queues)
-
-struct hq_entry {
-        int next;
-	int order;
-        ulong value;
-};
+#define HQ_HASH(X, BITS) \
+	((ulong)(((ulonglong)(X) * 0x9e3779b97f4a7c15ULL) >> (64 - (BITS))))
 
-struct hq_head {
-	int next;
-	int qcnt;
+struct hq_slot {
+	uint gen;
+	int order;          /* 1-based index into values[] */
 };
 
 struct hash_table {
 	ulong flags;
-	struct hq_head *queue_heads;
-	struct hq_entry *memptr;
+	struct hq_slot *slots;
+	ulong nr_slots;
+	int bits;
+	uint gen;
+	ulong *values;
 	long count;
 	long index;
 	int reallocs;
+	int resizes;
 } hash_table = { 0 };
 
 /*
- *  For starters, allocate a hash table containing HQ_ENTRY_CHUNK entries.
- *  If necessary during runtime, it will be increased in size.
+ *  For starters, allocate room for HQ_ENTRY_CHUNK values and a table of
+ *  pc->nr_hash_queues slots.  If necessary during runtime, both will be
+ *  increased in size.
  */
 void
 hq_init(void)
@@ -5205,8 +5602,7 @@ hq_init(void)
 	if (pc->nr_hash_queues == 0)
 		pc->nr_hash_queues = NR_HASH_QUEUES_DEFAULT;
 
-        if ((ht->queue_heads = (struct hq_head *)malloc(pc->nr_hash_queues *
-	    sizeof(struct hq_head))) == NULL) {
+	if (!hq_resize(ht, pc->nr_hash_queues)) {
 		error(INFO, "cannot malloc memory for hash queue heads: %s\n",
 			strerror(errno));
 		ht->flags = HASH_QUEUE_NONE;
@@ -5214,68 +5610,81 @@ hq_init(void)
 		return;
 	}
 
-        if ((ht->memptr = (struct hq_entry *)malloc(HQ_ENTRY_CHUNK * 
-	    sizeof(struct hq_entry))) == NULL) {
+        if ((ht->values = (ulong *)malloc(HQ_ENTRY_CHUNK *
+	    sizeof(ulong))) == NULL) {
 		error(INFO, "cannot malloc memory for hash queues: %s\n",
 			strerror(errno));
 		ht->flags = HASH_QUEUE_NONE;
 		pc->flags &= ~HASH;
 		return;
 	}
-        
-	BZERO(ht->memptr, HQ_ENTRY_CHUNK * sizeof(struct hq_entry));
+
 	ht->count = HQ_ENTRY_CHUNK;
 	ht->index = 0;
 }
 
 /*
- *  Get a free hash queue entry.  If there's no more available, realloc()
- *  a new chunk of memory with another HQ_ENTRY_CHUNK entries stuck on the end.
+ *  Replace the slot table with one of at least nr_slots slots (rounded
+ *  up to a power of two), and re-enter the values of the current session.
  */
-static long
-alloc_hq_entry(void)
+static int
+hq_resize(struct hash_table *ht, ulong nr_slots)
 {
-	struct hash_table *ht;
-	struct hq_entry *new, *end_of_old;
+	struct hq_slot *slots;
+	ulong size, i;
+	long v;
+	int bits;
 
-	ht = &hash_table;
+	for (bits = 1, size = 2; (size < nr_slots) && (bits < 31); bits++)
+		size <<= 1;
 
-	if (++ht->index == ht->count) {
-                if (!(new = (void *)realloc((void *)ht->memptr,
-		    (ht->count+HQ_ENTRY_CHUNK) * sizeof(struct hq_entry)))) {
-			error(INFO, 
-			    "cannot realloc memory for hash queues: %s\n",
-				strerror(errno));
-			ht->flags |= HASH_QUEUE_FULL;
-			return(-1);
-		}
-		ht->reallocs++;
-		ht->memptr = new;
-		end_of_old = ht->memptr + ht->count;
-		BZERO(end_of_old, HQ_ENTRY_CHUNK * sizeof(struct hq_entry));
-		ht->count += HQ_ENTRY_CHUNK;
+	if (!(slots = (struct hq_slot *)calloc(size, sizeof(struct hq_slot))))
+		return FALSE;
+
+	if (ht->slots) {
+		free(ht->slots);
+		ht->resizes++;
 	}
+	ht->slots = slots;
+	ht->nr_slots = size;
+	ht->bits = bits;
+	ht->gen = 1;
 
-	return(ht->index);
+	for (v = 0; v < ht->index; v++) {
+		i = HQ_HASH(ht->values[v], bits);
+		while (slots[i].gen == ht->gen)
+			i = (i + 1) & (size - 1);
+		slots[i].gen = ht->gen;
+		slots[i].order = v + 1;
+	}
+
+	return TRUE;
 }
 
 /*
- *  Restore the hash queue to its state before the duplicate entry 
- *  was attempted.
- */ 
-static void
-dealloc_hq_entry(struct hq_entry *entry)
+ *  Return the slot holding value, or -1 after setting *slotp to the slot
+ *  where it would be entered.
+ */
+static long
+hq_lookup(struct hash_table *ht, ulong value, long *slotp)
 {
-        struct hash_table *ht;
-        long hqi;
+	struct hq_slot *slot;
+	ulong i;
 
-        ht = &hash_table;
-	hqi = HQ_INDEX(entry->value);
+	i = HQ_HASH(value, ht->bits);
 
-	ht->index--;
+	while (TRUE) {
+		slot = &ht->slots[i];
+		if (slot->gen != ht->gen)
+			break;
+		if (ht->values[slot->order - 1] == value)
+			return i;
+		i = (i + 1) & (ht->nr_slots - 1);
+	}
 
-	BZERO(entry, sizeof(struct hq_entry));
-	ht->queue_heads[hqi].qcnt--;
+	if (slotp)
+		*slotp = i;
+	return -1;
 }
 
 /*
@@ -5294,8 +5703,10 @@ hq_open(void)
 		return FALSE;
 
 	ht->flags &= ~(HASH_QUEUE_FULL|HASH_QUEUE_CLOSED);
-	BZERO(ht->queue_heads, sizeof(struct hq_head) * pc->nr_hash_queues);
-	BZERO(ht->memptr, ht->count * sizeof(struct hq_entry));
+	if (++ht->gen == 0) {
+		BZERO(ht->slots, sizeof(struct hq_slot) * ht->nr_slots);
+		ht->gen = 1;
+	}
 	ht->index = 0;
 
 	ht->flags |= HASH_QUEUE_OPEN;
@@ -5349,22 +5760,17 @@ hq_close(void)
 	return(ht->index);
 }
 
-char *corrupt_hq = "corrupt hash queue entry: value: %lx next: %d order: %d\n";
-
 /*
- *  For a given value, allocate a hash queue entry and hash it into the 
- *  open hash table.  If a duplicate entry is found, return FALSE; for all 
- *  other possibilities return TRUE.  Note that it's up to the user to deal 
- *  with failure.
+ *  For a given value, enter it into the open hash table.  If a duplicate
+ *  entry is found, return FALSE; for all other possibilities return TRUE.
+ *  Note that it's up to the user to deal with failure.
  */
 int
 hq_enter(ulong value)
 {
 	struct hash_table *ht;
-	struct hq_entry *entry;
-	struct hq_entry *list_entry;
-	long hqi;
-	long index;
+	ulong *new;
+	long slot;
 
 	if (!(pc->flags & HASH))
 		return TRUE;
@@ -5377,55 +5783,34 @@ hq_enter(ulong value)
 	if (!(ht->flags & HASH_QUEUE_OPEN))
 		return TRUE;
 
-	if ((index = alloc_hq_entry()) < 0) 
-		return TRUE;
-
-	entry = ht->memptr + index;
-	if (entry->next || entry->value || entry->order) {
-		error(INFO, corrupt_hq,
-			entry->value, entry->next, entry->order);
-		ht->flags |= HASH_QUEUE_NONE;
-		return TRUE;
-	}
-
-	entry->next = 0;
-	entry->value = value;
-	entry->order = index;
-
-	hqi = HQ_INDEX(value);
-
-	if (ht->queue_heads[hqi].next == 0) {
-		ht->queue_heads[hqi].next = index;
-		ht->queue_heads[hqi].qcnt = 1;
-		return TRUE;
-	} else
-		ht->queue_heads[hqi].qcnt++;
-
-	list_entry = ht->memptr + ht->queue_heads[hqi].next;
-
-	while (TRUE) {
-	        if (list_entry->value == entry->value) {
-			dealloc_hq_entry(entry);
-                	return FALSE;
-		}
+	if (hq_lookup(ht, value, &slot) >= 0)
+		return FALSE;
 
-		if (list_entry->next >= ht->count) {
-			error(INFO, corrupt_hq,
-			    	list_entry->value, 
-				list_entry->next,
-				list_entry->order);
-			ht->flags |= HASH_QUEUE_NONE;
+	if (ht->index == ht->count) {
+                if (!(new = (ulong *)realloc((void *)ht->values,
+		    ht->count * 2 * sizeof(ulong)))) {
+			error(INFO,
+			    "cannot realloc memory for hash queues: %s\n",
+				strerror(errno));
+			ht->flags |= HASH_QUEUE_FULL;
 			return TRUE;
 		}
+		ht->reallocs++;
+		ht->values = new;
+		ht->count *= 2;
+	}
 
-		if (list_entry->next == 0)
-			break;
+	ht->values[ht->index++] = value;
+	ht->slots[slot].gen = ht->gen;
+	ht->slots[slot].order = ht->index;
 
-        	list_entry = ht->memptr + list_entry->next;
+	if (((ht->index * 4) > (ht->nr_slots * 3)) &&
+	    !hq_resize(ht, ht->nr_slots * 2)) {
+		error(INFO, "cannot realloc memory for hash queues: %s\n",
+			strerror(errno));
+		ht->flags |= HASH_QUEUE_FULL;
 	}
 
-	list_entry->next = index;
-
 	return TRUE;
 }
 
@@ -5435,13 +5820,10 @@ hq_enter(ulong value)
 void
 dump_hash_table(int verbose)
 {
-	int i;
+	long i, slots_in_use, probe, max_probe, total_probes;
 	struct hash_table *ht;
-	struct hq_entry *list_entry;
-	long elements;
-	long queues_in_use;
+	struct hq_slot *slot;
 	int others;
-	uint minq, maxq; 
 
 	ht = &hash_table;
 	others = 0;
@@ -5456,130 +5838,93 @@ dump_hash_table(int verbose)
         if (ht->flags & HASH_QUEUE_FULL)
                 fprintf(fp, "%sHASH_QUEUE_FULL", others++ ? "|" : "");
 	fprintf(fp, ")\n");
-	fprintf(fp, "  queue_heads[%ld]: %lx\n", pc->nr_hash_queues, 
-		(ulong)ht->queue_heads);
-	fprintf(fp, "             memptr: %lx\n", (ulong)ht->memptr);
+	fprintf(fp, "      slots[%ld]: %lx", ht->nr_slots, (ulong)ht->slots);
+	if (ht->resizes)
+		fprintf(fp, "  (%d resizes)", ht->resizes);
+	fprintf(fp, "\n");
+	fprintf(fp, "                gen: %u\n", ht->gen);
+	fprintf(fp, "             values: %lx\n", (ulong)ht->values);
 	fprintf(fp, "              count: %ld  ", ht->count);
 	if (ht->reallocs)
 		fprintf(fp, "  (%d reallocs)", ht->reallocs);
 	fprintf(fp, "\n");
 	fprintf(fp, "              index: %ld\n", ht->index);
 
-	queues_in_use = 0;
-	minq = ~(0);
-	maxq = 0;
+	if (ht->flags & HASH_QUEUE_NONE)
+		return;
 
-	for (i = 0; i < pc->nr_hash_queues; i++) {
-               	if (ht->queue_heads[i].next == 0) {
-			minq = 0;
-                       	continue;
+	slots_in_use = max_probe = total_probes = 0;
+	for (i = 0; i < ht->nr_slots; i++) {
+		slot = &ht->slots[i];
+		if (slot->gen != ht->gen)
+			continue;
+		if ((slot->order < 1) || (slot->order > ht->index)) {
+			error(INFO, "corrupt hash queue slot: %ld order: %d\n",
+				i, slot->order);
+			ht->flags |= HASH_QUEUE_NONE;
+			return;
 		}
-
-		if (ht->queue_heads[i].qcnt < minq)
-			minq = ht->queue_heads[i].qcnt;
-		if (ht->queue_heads[i].qcnt > maxq)
-			maxq = ht->queue_heads[i].qcnt;
-
-               	queues_in_use++;
-	}
-
-	elements = 0;
-	list_entry = ht->memptr;
-        for (i = 0; i < ht->count; i++, list_entry++) {
-	         if (!list_entry->order) {
-	                if (list_entry->value || list_entry->next)
-				goto corrupt_list_entry;
-	                continue;
-	         }
-	
-	         if (list_entry->next >= ht->count)
-	                        goto corrupt_list_entry;
-
-	         ++elements;
-       	}
-
-	if (elements != ht->index)
-        	fprintf(fp, "     elements found: %ld (expected %ld)\n", 
-			elements, ht->index);
-        fprintf(fp, "      queues in use: %ld of %ld\n", queues_in_use, 
-		pc->nr_hash_queues);
-	fprintf(fp, " queue length range: %d to %d\n", minq, maxq);
+		probe = (i - HQ_HASH(ht->values[slot->order-1], ht->bits)) &
+			(ht->nr_slots - 1);
+		total_probes += probe;
+		if (probe > max_probe)
+			max_probe = probe;
+		slots_in_use++;
+	}
+
+	if (slots_in_use != ht->index)
+        	fprintf(fp, "     elements found: %ld (expected %ld)\n",
+			slots_in_use, ht->index);
+        fprintf(fp, "       slots in use: %ld of %ld\n", slots_in_use,
+		ht->nr_slots);
+	fprintf(fp, "   probe length avg: %ld.%02ld  max: %ld\n",
+		slots_in_use ? total_probes / slots_in_use : 0,
+		slots_in_use ? ((total_probes * 100) / slots_in_use) % 100 : 0,
+		max_probe);
 
 	if (verbose) {
-		if (!elements) {
+		if (!ht->index) {
         		fprintf(fp, "            entries: (none)\n");
 			return;
 		}
 
         	fprintf(fp, "            entries: ");
 
-        	list_entry = ht->memptr;
-	        for (i = 0; i < ht->count; i++, list_entry++) {
-	                 if (list_entry->order)
-	                        fprintf(fp, "%s%lx (%d)\n", 
-					list_entry->order == 1 ?
-					"" : "                     ",
-	                                list_entry->value, list_entry->order);
-	        }
+	        for (i = 0; i < ht->index; i++)
+			fprintf(fp, "%s%lx (%ld)\n", i == 0 ?
+				"" : "                     ",
+	                        ht->values[i], i+1);
 	}
-	return;
-
-corrupt_list_entry:
-
-        error(INFO, corrupt_hq,
-        	list_entry->value, list_entry->next, list_entry->order);
-        ht->flags |= HASH_QUEUE_NONE;
 }
 
 /*
  *  Retrieve the count of, and optionally stuff a pre-allocated array with,
  *  the current hash table entries.  The entries will be sorted according
- *  to the order in which they were entered, so from this point on, no
- *  further hq_enter() operations on this list will be allowed.  However, 
- *  multiple calls to retrieve_list are allowed because the second and 
- *  subsequent ones will go directly to where the non-zero (valid) entries 
- *  start in the potentially very large list_entry memory chunk.
+ *  to the order in which they were entered.
  */
 int
 retrieve_list(ulong array[], int count)
 {
-        int i; 
         struct hash_table *ht;
-        struct hq_entry *list_entry;
         int elements;
 
 	if (!(pc->flags & HASH))
-		error(FATAL, 
+		error(FATAL,
 		    "cannot perform this command with hash turned off\n");
 
         ht = &hash_table;
 
-	list_entry = ht->memptr;
-	for (i = elements = 0; i < ht->count; i++, list_entry++) {
-		if (!list_entry->order) {
-			if (list_entry->value || list_entry->next)
-				goto corrupt_list_entry;
-			continue;
-		}
+	if (ht->flags & HASH_QUEUE_NONE)
+		return(-1);
 
-                if (list_entry->next >= ht->count) 
-			goto corrupt_list_entry;
+	elements = ht->index;
+	if ((count > 0) && (count < elements))
+		elements = count;
 
-		if (array) 
-			array[elements] = list_entry->value; 
-
-                if (++elements == count)
-                       	break;
-	}
+	if (array)
+		BCOPY(ht->values, array, sizeof(ulong) * elements);
 
 	return elements;
-
-corrupt_list_entry:
-
-        error(INFO, corrupt_hq,
-               list_entry->value, list_entry->next, list_entry->order);
-        ht->flags |= HASH_QUEUE_NONE;
-        return(-1);
 }
 
 /*
@@ -5590,8 +5935,6 @@ int
 hq_entry_exists(ulong value)
 {
 	struct hash_table *ht;
-	struct hq_entry *list_entry;
-	long hqi;
 
 	if (!(pc->flags & HASH))
 		return FALSE;
@@ -5604,29 +5947,7 @@ hq_entry_exists(ulong value)
 	if (!(ht->flags & HASH_QUEUE_OPEN))
 		return FALSE;
 
-	hqi = HQ_INDEX(value);
-	list_entry = ht->memptr + ht->queue_heads[hqi].next;
-
-	while (TRUE) {
-		if (list_entry->value == value)
-			return TRUE;
-
-		if (list_entry->next >= ht->count) {
-			error(INFO, corrupt_hq,
-				list_entry->value, 
-				list_entry->next,
- 				list_entry->order);
-			ht->flags |= HASH_QUEUE_NONE;
-			return FALSE;
-		}
-
-		if (list_entry->next == 0)
-			break;
-
-		list_entry = ht->memptr + list_entry->next;
-	}
-
-	return FALSE;
+	return (hq_lookup(ht, value, NULL) >= 0);
 }
 
 /*
@@ -5665,64 +5986,73 @@ ll_power(long long base, long long exp)
  *  to GETBUF(size).  They can explicitly freed by FREEBUF(address), but
  *  they are all freed by free_all_bufs() which is called in a number of
  *  places, most not
+ *
+ *  The buffers are carved out of a per-command arena: a list of large
+ *  malloc'd chunks, each with a bump pointer.  A buffer is rounded up to
+ *  a power-of-two size class from 32 bytes to 32K, and is preceded by a
+ *  header that records its class, so that a FREEBUF'd buffer is pushed
+ *  onto the free list of its class and reused by the next GETBUF of that
+ *  class.  Requests larger than 32K are malloc'd individually, and are
+ *  kept on a list so that they can be freed with the arena.
+ *
+ *  free_all_bufs() releases everything at once by resetting the bump
+ *  pointer to the first chunk and emptying the free lists; the first
+ *  BUF_ARENA_KEEP chunks are retained for the next command.  Since
+ *  restore_sanity() calls it, this also covers commands that end with
+ *  an error() or RESTART().
+ *
+ *  GETBUF() zeroes the buffer; GETBUF_NOZERO() may be used for buffers
+ *  that are entirely overwritten before they are read.
  */
 
-#define NUMBER_1K_BUFS  (10)
-#define NUMBER_2K_BUFS  (10)
-#define NUMBER_4K_BUFS   (5)
-#define NUMBER_8K_BUFS   (5)
-#define NUMBER_32K_BUFS  (1)
-
-#define SHARED_1K_BUF_FULL   (0x003ff)
-#define SHARED_2K_BUF_FULL   (0x003ff)
-#define SHARED_4K_BUF_FULL   (0x0001f)
-#define SHARED_8K_BUF_FULL   (0x0001f)
-#define SHARED_32K_BUF_FULL  (0x00001)
-
-#define SHARED_1K_BUF_AVAIL(X) \
-  (NUMBER_1K_BUFS && !(((X) & SHARED_1K_BUF_FULL) == SHARED_1K_BUF_FULL))
-#define SHARED_2K_BUF_AVAIL(X) \
-  (NUMBER_2K_BUFS && !(((X) & SHARED_2K_BUF_FULL) == SHARED_2K_BUF_FULL))
-#define SHARED_4K_BUF_AVAIL(X) \
-  (NUMBER_4K_BUFS && !(((X) & SHARED_4K_BUF_FULL) == SHARED_4K_BUF_FULL))
-#define SHARED_8K_BUF_AVAIL(X) \
-  (NUMBER_8K_BUFS && !(((X) & SHARED_8K_BUF_FULL) == SHARED_8K_BUF_FULL))
-#define SHARED_32K_BUF_AVAIL(X) \
-  (NUMBER_32K_BUFS && !(((X) & SHARED_32K_BUF_FULL) == SHARED_32K_BUF_FULL))
-
-#define B1K  (0)
-#define B2K  (1)
-#define B4K  (2)
-#define B8K  (3)
-#define B32K (4)
-
-#define SHARED_BUF_SIZES  (B32K+1)
-#define MAX_MALLOC_BUFS   (2000)
-#define MAX_CACHE_SIZE    (KILOBYTES(32))
+#define BUF_CLASSES       (11)                /* 32 bytes to 32K */
+#define BUF_CLASS_MIN     (32)
+#define BUF_CLASS_SIZE(C) ((long)BUF_CLASS_MIN << (C))
+#define BUF_CLASS(S)      ((S) <= BUF_CLASS_MIN ? 0 : \
+	(int)(BITS_PER_LONG - 1 - __builtin_clzl((ulong)(S) - 1)) - 4)
+#define MAX_CACHE_SIZE    (BUF_CLASS_SIZE(BUF_CLASSES-1))
+#define BUF_CHUNK_SIZE    (KILOBYTES(256))
+#define BUF_ARENA_KEEP    (4)                 /* chunks kept between commands */
+
+#define BUF_MAGIC         (0x47455442)        /* "GETB" */
+#define BUF_FREE_MAGIC    (0x46524545)        /* "FREE" */
+#define BUF_LARGE         (-1)
+
+struct buf_header {
+	uint magic;
+	int class;                   /* or BUF_LARGE */
+	ulong gen;                   /* free_all_bufs() generation */
+	long size;                   /* requested size */
+	struct buf_header *next;     /* free list, or large buffer list */
+	struct buf_header *prev;     /* large buffer list */
+};
+
+#define BUF_HDRSIZE       (roundup(sizeof(struct buf_header), 16))
+#define BUF_TO_HDR(B)     ((struct buf_header *)((char *)(B) - BUF_HDRSIZE))
+#define HDR_TO_BUF(H)     ((char *)(H) + BUF_HDRSIZE)
+
+struct buf_chunk {
+	struct buf_chunk *next;
+	char *free;                  /* bump pointer */
+	char *end;
+};
+
+#define BUF_CHUNK_HDRSIZE (roundup(sizeof(struct buf_chunk), 16))
+#define CHUNK_DATA(C)     ((char *)(C) + BUF_CHUNK_HDRSIZE)
 
 struct shared_bufs {
-	char buf_1K[NUMBER_1K_BUFS][1024];
-	char buf_2K[NUMBER_2K_BUFS][2048];
-	char buf_4K[NUMBER_4K_BUFS][4096];
-	char buf_8K[NUMBER_8K_BUFS][8192];
-	char buf_32K[NUMBER_32K_BUFS][32768];
-	long buf_1K_used;
-	long buf_2K_used;
-	long buf_4K_used;
-	long buf_8K_used;
-	long buf_32K_used;
-        long buf_1K_maxuse;
-        long buf_2K_maxuse;
-        long buf_4K_maxuse;
-        long buf_8K_maxuse;
-        long buf_32K_maxuse;
-        long buf_1K_ovf;
-        long buf_2K_ovf;
-        long buf_4K_ovf;
-        long buf_8K_ovf;
-        long buf_32K_ovf;
-	int buf_inuse[SHARED_BUF_SIZES];
-	char *malloc_bp[MAX_MALLOC_BUFS];
+	struct buf_chunk *chunks;
+	struct buf_chunk *current;
+	struct buf_header *free_list[BUF_CLASSES];
+	struct buf_header *large;
+	long nr_chunks;
+	long arena_bytes;            /* carved from the chunks this command */
+	long max_arena_bytes;
+	long class_reqs[BUF_CLASSES];
+	long class_reuse[BUF_CLASSES];
+	long large_reqs;
+	long nozero_reqs;
+	ulong resets;                /* the current generation */
 	long smallest;
 	long largest;
 	long embedded;
@@ -5733,6 +6063,10 @@ struct shared_bufs {
 	ulong reqs;
 } shared_bufs;
 
+static char *getbuf_common(long, int, ulong);
+static struct buf_chunk *buf_chunk_alloc(long);
+static struct buf_header *buf_lookup(char *);
+
 void
 buf_init(void)
 {
@@ -5745,20 +6079,32 @@ buf_init(void)
 	bp->total = 0.0;
 
 #ifdef VALGRIND
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_1K, sizeof(bp->buf_1K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_2K, sizeof(bp->buf_2K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_4K, sizeof(bp->buf_4K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_8K, sizeof(bp->buf_8K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_32K, sizeof(bp->buf_32K));
-
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_1K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_2K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_4K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_8K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_32K, 0, 1);
+	VALGRIND_CREATE_MEMPOOL(bp, 0, 0);
 #endif
 }
 
+static struct buf_chunk *
+buf_chunk_alloc(long size)
+{
+	struct buf_chunk *chunk;
+	long chunksize;
+
+	chunksize = MAX(size + BUF_CHUNK_HDRSIZE, BUF_CHUNK_SIZE);
+
+	if (!(chunk = (struct buf_chunk *)malloc(chunksize)))
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->free = CHUNK_DATA(chunk);
+	chunk->end = (char *)chunk + chunksize;
+	shared_bufs.nr_chunks++;
+
+#ifdef VALGRIND
+	VALGRIND_MAKE_MEM_NOACCESS(chunk->free, chunk->end - chunk->free);
+#endif
+	return chunk;
+}
+
 /*
  *  Free up all buffers used by the last command.
  */
@@ -5766,126 +6112,128 @@ void free_all_bufs(void)
 {
 	int i;
 	struct shared_bufs *bp;
+	struct buf_chunk *chunk, *next;
+	struct buf_header *hp;
 
 	bp = &shared_bufs;
 	bp->embedded = 0;
 
-        for (i = 0; i < SHARED_BUF_SIZES; i++)
-                bp->buf_inuse[i] = 0;
-
-	for (i = 0; i < MAX_MALLOC_BUFS; i++) {
-		if (bp->malloc_bp[i]) {
-			free(bp->malloc_bp[i]);
-			bp->malloc_bp[i] = NULL;
-			bp->frees++;
-		}
+	while ((hp = bp->large)) {
+		bp->large = hp->next;
+		hp->magic = BUF_FREE_MAGIC;
+		free(hp);
+		bp->frees++;
 	}
 
 	if (bp->mallocs != bp->frees)
 		error(WARNING, "malloc/free mismatch (%ld/%ld)\n",
 			bp->mallocs, bp->frees);
 
+	for (i = 0; i < BUF_CLASSES; i++)
+		bp->free_list[i] = NULL;
+
+	for (i = 0, chunk = bp->chunks; chunk; chunk = next, i++) {
+		next = chunk->next;
+		if (i == (BUF_ARENA_KEEP-1))
+			chunk->next = NULL;
+		if (i >= BUF_ARENA_KEEP) {
+			free(chunk);
+			bp->nr_chunks--;
+			continue;
+		}
+		chunk->free = CHUNK_DATA(chunk);
 #ifdef VALGRIND
-	VALGRIND_DESTROY_MEMPOOL(&bp->buf_1K);
-	VALGRIND_DESTROY_MEMPOOL(&bp->buf_2K);
-	VALGRIND_DESTROY_MEMPOOL(&bp->buf_4K);
-	VALGRIND_DESTROY_MEMPOOL(&bp->buf_8K);
-	VALGRIND_DESTROY_MEMPOOL(&bp->buf_32K);
-
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_1K, sizeof(bp->buf_1K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_2K, sizeof(bp->buf_2K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_4K, sizeof(bp->buf_4K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_8K, sizeof(bp->buf_8K));
-	VALGRIND_MAKE_MEM_NOACCESS(&bp->buf_32K, sizeof(bp->buf_32K));
-
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_1K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_2K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_4K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_8K, 0, 1);
-	VALGRIND_CREATE_MEMPOOL(&bp->buf_32K, 0, 1);
+		VALGRIND_MAKE_MEM_NOACCESS(chunk->free, chunk->end - chunk->free);
+#endif
+	}
+
+	bp->current = bp->chunks;
+	bp->arena_bytes = 0;
+	bp->resets++;
+
+#ifdef VALGRIND
+	VALGRIND_DESTROY_MEMPOOL(bp);
+	VALGRIND_CREATE_MEMPOOL(bp, 0, 0);
 #endif
 }
 
 /*
- *  Free a specific buffer that may have been returned by malloc().
- *  If the address is one of the static buffers, look for it and
- *  clear its inuse bit.
+ *  Find the header of a buffer by its address, among the arena chunks and
+ *  the large buffers that are currently allocated, without touching the
+ *  memory of a buffer that has already been released, such as a large
+ *  buffer freed by free_all_bufs().
  */
-void 
-freebuf(char *addr)
+static struct buf_header *
+buf_lookup(char *addr)
 {
-        int i;
-        struct shared_bufs *bp;
+	struct shared_bufs *bp;
+	struct buf_header *hp;
+	struct buf_chunk *chunk;
 
-        bp = &shared_bufs;
-	bp->embedded--;
+	bp = &shared_bufs;
 
-        if (CRASHDEBUG(8)) {
-		INDENT(bp->embedded*2);
-                fprintf(fp, "FREEBUF(%ld)\n", bp->embedded);
-        }
+	if (!addr)
+		return NULL;
 
-	for (i = 0; i < NUMBER_1K_BUFS; i++) {
-		if (addr == (char *)&bp->buf_1K[i]) {
-			bp->buf_inuse[B1K] &= ~(1 << i);
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_FREE(&bp->buf_1K, addr);
-#endif
-			return;
+	for (chunk = bp->chunks; chunk; chunk = chunk->next) {
+		if ((addr >= (CHUNK_DATA(chunk) + BUF_HDRSIZE)) &&
+		    (addr < chunk->free)) {
+			hp = BUF_TO_HDR(addr);
+			return (hp->class == BUF_LARGE ? NULL : hp);
 		}
 	}
 
-	for (i = 0; i < NUMBER_2K_BUFS; i++) {
-		if (addr == (char *)&bp->buf_2K[i]) {
-			bp->buf_inuse[B2K] &= ~(1 << i);
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_FREE(&bp->buf_2K, addr);
-#endif
-			return;
-		}
+	for (hp = bp->large; hp; hp = hp->next) {
+		if (HDR_TO_BUF(hp) == addr)
+			return hp;
 	}
 
-	for (i = 0; i < NUMBER_4K_BUFS; i++) {
-		if (addr == (char *)&bp->buf_4K[i]) {
-			bp->buf_inuse[B4K] &= ~(1 << i);
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_FREE(&bp->buf_4K, addr);
-#endif
-			return;
-		}
+	return NULL;
+}
+
+/*
+ *  Free a specific buffer, putting an arena buffer on the free list of
+ *  its size class, and handing a large buffer back to free().
+ */
+void 
+freebuf(char *addr)
+{
+	struct shared_bufs *bp;
+	struct buf_header *hp;
+
+	bp = &shared_bufs;
+	bp->embedded--;
+
+	if (CRASHDEBUG(8)) {
+		INDENT(bp->embedded*2);
+		fprintf(fp, "FREEBUF(%ld)\n", bp->embedded);
 	}
 
-	for (i = 0; i < NUMBER_8K_BUFS; i++) {
-		if (addr == (char *)&bp->buf_8K[i]) {
-			bp->buf_inuse[B8K] &= ~(1 << i);
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_FREE(&bp->buf_8K, addr);
-#endif
-			return;
-		}
+	hp = buf_lookup(addr);
+
+	if (!hp || (hp->magic != BUF_MAGIC) || (hp->gen != bp->resets))
+		error(FATAL,
+		    "freeing an unknown buffer -- shared buffer inconsistency!\n");
+
+	hp->magic = BUF_FREE_MAGIC;
+
+	if (hp->class == BUF_LARGE) {
+		if (hp->prev)
+			hp->prev->next = hp->next;
+		else
+			bp->large = hp->next;
+		if (hp->next)
+			hp->next->prev = hp->prev;
+		free(hp);
+		bp->frees++;
+		return;
 	}
 
-        for (i = 0; i < NUMBER_32K_BUFS; i++) {
-                if (addr == (char *)&bp->buf_32K[i]) {
-                        bp->buf_inuse[B32K] &= ~(1 << i);
+	hp->next = bp->free_list[hp->class];
+	bp->free_list[hp->class] = hp;
 #ifdef VALGRIND
-			VALGRIND_MEMPOOL_FREE(&bp->buf_32K, addr);
+	VALGRIND_MEMPOOL_FREE(bp, addr);
 #endif
-                        return;
-                }
-        }
-
-        for (i = 0; i < MAX_MALLOC_BUFS; i++) {
-                if (bp->malloc_bp[i] == addr) {
-                        free(bp->malloc_bp[i]);
-                        bp->malloc_bp[i] = NULL;
-                        bp->frees++;
-                        return;
-                }
-        }
-
-	error(FATAL, 
-	    "freeing an unknown buffer -- shared buffer inconsistency!\n");
 }
 
 /* DEBUG */
@@ -5919,41 +6267,36 @@ dump_shared_bufs(void)
 {
         int i;
         struct shared_bufs *bp;
+	struct buf_chunk *chunk;
+	struct buf_header *hp;
+	long cnt;
 
         bp = &shared_bufs;
 
-        fprintf(fp, "   buf_1K_used: %ld\n", bp->buf_1K_used);
-        fprintf(fp, "   buf_2K_used: %ld\n", bp->buf_2K_used);
-        fprintf(fp, "   buf_4K_used: %ld\n", bp->buf_4K_used);
-        fprintf(fp, "   buf_8K_used: %ld\n", bp->buf_8K_used);
-        fprintf(fp, "  buf_32K_used: %ld\n", bp->buf_32K_used);
-
-        fprintf(fp, "    buf_1K_ovf: %ld\n", bp->buf_1K_ovf);
-        fprintf(fp, "    buf_2K_ovf: %ld\n", bp->buf_2K_ovf);
-        fprintf(fp, "    buf_4K_ovf: %ld\n", bp->buf_4K_ovf);
-        fprintf(fp, "    buf_8K_ovf: %ld\n", bp->buf_8K_ovf);
-        fprintf(fp, "   buf_32K_ovf: %ld\n", bp->buf_32K_ovf);
-
-        fprintf(fp, " buf_1K_maxuse: %2ld of %d\n", bp->buf_1K_maxuse, 
-		NUMBER_1K_BUFS);
-        fprintf(fp, " buf_2K_maxuse: %2ld of %d\n", bp->buf_2K_maxuse, 
-		NUMBER_2K_BUFS);
-        fprintf(fp, " buf_4K_maxuse: %2ld of %d\n", bp->buf_4K_maxuse, 
-		NUMBER_4K_BUFS);
-        fprintf(fp, " buf_8K_maxuse: %2ld of %d\n", bp->buf_8K_maxuse, 
-		NUMBER_8K_BUFS);
-        fprintf(fp, "buf_32K_maxuse: %2ld of %d\n", bp->buf_32K_maxuse, 
-		NUMBER_32K_BUFS);
-
-	fprintf(fp, "  buf_inuse[%d]: ", SHARED_BUF_SIZES);
-	for (i = 0; i < SHARED_BUF_SIZES; i++)
-		fprintf(fp, "[%lx]", (ulong)bp->buf_inuse[i]);
-	fprintf(fp, "\n");
+	fprintf(fp, "        chunks: %ld (%ld kept, %ldK each)\n",
+		bp->nr_chunks, (long)BUF_ARENA_KEEP, (long)BUF_CHUNK_SIZE/1024);
+	for (chunk = bp->chunks; chunk; chunk = chunk->next)
+		fprintf(fp, "  %lx: %ld of %ld bytes used%s\n", (ulong)chunk,
+			(long)(chunk->free - CHUNK_DATA(chunk)),
+			(long)(chunk->end - CHUNK_DATA(chunk)),
+			chunk == bp->current ? " (current)" : "");
+	fprintf(fp, "   arena_bytes: %ld\n", bp->arena_bytes);
+	fprintf(fp, "max_arena_bytes: %ld\n", bp->max_arena_bytes);
+	fprintf(fp, "        resets: %lu\n", bp->resets);
+
+	fprintf(fp, "         class     reqs    reused  free\n");
+	for (i = 0; i < BUF_CLASSES; i++) {
+		for (cnt = 0, hp = bp->free_list[i]; hp; hp = hp->next)
+			cnt++;
+		fprintf(fp, "  %12ld %8ld  %8ld  %4ld\n", BUF_CLASS_SIZE(i),
+			bp->class_reqs[i], bp->class_reuse[i], cnt);
+	}
 
-        for (i = 0; i < MAX_MALLOC_BUFS; i++) 
-		if (bp->malloc_bp[i])
-			fprintf(fp, "  malloc_bp[%d]: %lx\n", 
-				i, (ulong)bp->malloc_bp[i]);
+	fprintf(fp, "    large_reqs: %ld\n", bp->large_reqs);
+	for (hp = bp->large; hp; hp = hp->next)
+		fprintf(fp, "  large: %lx (%ld bytes)\n",
+			(ulong)HDR_TO_BUF(hp), hp->size);
+	fprintf(fp, "   nozero_reqs: %ld\n", bp->nozero_reqs);
 
 	if (bp->smallest == 0x7fffffff)
         	fprintf(fp, "      smallest: 0\n");
@@ -5966,41 +6309,45 @@ dump_shared_bufs(void)
 	fprintf(fp, "       mallocs: %ld\n", bp->mallocs);
 	fprintf(fp, "         frees: %ld\n", bp->frees);
 	fprintf(fp, "    reqs/total: %ld/%.0f\n", bp->reqs, bp->total);
-	fprintf(fp, "  average size: %.0f\n", bp->total/bp->reqs);
+	fprintf(fp, "  average size: %.0f\n", bp->reqs ? bp->total/bp->reqs : 0);
 }
 
-/*
- *  Try to get one of the static buffers first.  If not available, fall
- *  through and get it from malloc(), keeping trace of the returned address.
- */
-
-#define SHARED_BUFSIZE(size) \
-                ((size <= 1024) ? 1024 >> 7 : \
-                    ((size <= 2048) ? 2048 >> 7 : \
-                        ((size <= 4096) ? 4096 >> 7 : \
-                            ((size <= 8192) ? 8192 >> 7 : \
-                                ((size <= 32768) ? 32768 >> 7 : -1)))))
-
 char *
 getbuf(long reqsize)
 {
-	int i;
-	int index;
-	int bdx;
-	int mask;
+	return getbuf_common(reqsize, TRUE,
+		(ulong)__builtin_return_address(0));
+}
+
+char *
+getbuf_nozero(long reqsize)
+{
+	return getbuf_common(reqsize, FALSE,
+		(ulong)__builtin_return_address(0));
+}
+
+/*
+ *  Take a buffer from the free list of its size class, or else from the
+ *  current chunk of the arena, moving on to the next chunk, or adding
+ *  one, when it is full.
+ */
+static char *
+getbuf_common(long reqsize, int zero, ulong retaddr)
+{
+	int class;
+	long size;
 	struct shared_bufs *bp;
+	struct buf_header *hp;
+	struct buf_chunk *chunk;
 	char *bufp;
 
 	if (!reqsize) { 
-                ulong retaddr = (ulong)__builtin_return_address(0);
                 error(FATAL, "zero-size memory allocation! (called from %lx)\n",
                         retaddr);
         }
 
 	bp = &shared_bufs;
 
-	index = SHARED_BUFSIZE(reqsize);
-
 	if (CRASHDEBUG(7) && (reqsize > MAX_CACHE_SIZE))
 		error(NOTE, "GETBUF request > MAX_CACHE_SIZE: %ld\n", 
 			reqsize);
@@ -6013,6 +6360,8 @@ getbuf(long reqsize)
 	bp->embedded++;
 	if (bp->embedded > bp->max_embedded)
 		bp->max_embedded = bp->embedded;
+	if (PROFILING() && (bp->embedded > prof->getbuf_peak))
+		prof->getbuf_peak = bp->embedded;
 
 	if (reqsize < bp->smallest)
 		bp->smallest = reqsize;
@@ -6021,115 +6370,380 @@ getbuf(long reqsize)
 
 	bp->total += reqsize;
 	bp->reqs++;
+	if (!zero)
+		bp->nozero_reqs++;
 
-	switch (index)
-	{
-	case -1:
-		break;
+	if (reqsize > MAX_CACHE_SIZE) {
+		if (!(hp = (struct buf_header *)malloc(BUF_HDRSIZE + reqsize)))
+			goto nomem;
+		bp->mallocs++;
+		bp->large_reqs++;
+		hp->class = BUF_LARGE;
+		hp->prev = NULL;
+		if ((hp->next = bp->large))
+			hp->next->prev = hp;
+		bp->large = hp;
+		goto done;
+	}
 
-	case 8:
-                if (SHARED_1K_BUF_AVAIL(bp->buf_inuse[B1K])) {
-                        mask = ~(bp->buf_inuse[B1K]);
-                        bdx = ffs(mask) - 1;
-                        bufp = bp->buf_1K[bdx];
-                        bp->buf_1K_used++;
-                        bp->buf_inuse[B1K] |= (1 << bdx);
-			bp->buf_1K_maxuse = MAX(bp->buf_1K_maxuse, 
-				count_bits_int(bp->buf_inuse[B1K]));
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_ALLOC(&bp->buf_1K, bufp, 1024);
-#endif
-                        BZERO(bufp, 1024);
-                        return(bufp);
-                }
-		bp->buf_1K_ovf++;  /* FALLTHROUGH */
-
-	case 16:
-                if (SHARED_2K_BUF_AVAIL(bp->buf_inuse[B2K])) {
-                        mask = ~(bp->buf_inuse[B2K]);
-                        bdx = ffs(mask) - 1;
-                        bufp = bp->buf_2K[bdx];
-                        bp->buf_2K_used++;
-                        bp->buf_inuse[B2K] |= (1 << bdx);
-                        bp->buf_2K_maxuse = MAX(bp->buf_2K_maxuse,
-                                count_bits_int(bp->buf_inuse[B2K]));
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_ALLOC(&bp->buf_2K, bufp, 2048);
-#endif
-                        BZERO(bufp, 2048);
-                        return(bufp);
-                }
-		bp->buf_2K_ovf++;  /* FALLTHROUGH */
-
-	case 32:
-                if (SHARED_4K_BUF_AVAIL(bp->buf_inuse[B4K])) {
-                        mask = ~(bp->buf_inuse[B4K]);
-                        bdx = ffs(mask) - 1;
-                        bufp = bp->buf_4K[bdx];
-                        bp->buf_4K_used++;
-                        bp->buf_inuse[B4K] |= (1 << bdx);
-                        bp->buf_4K_maxuse = MAX(bp->buf_4K_maxuse,
-                                count_bits_int(bp->buf_inuse[B4K]));
-#ifdef VALGRIND
-			VALGRIND_MEMPOOL_ALLOC(&bp->buf_4K, bufp, 4096);
-#endif
-                        BZERO(bufp, 4096);
-                        return(bufp);
-                }
-		bp->buf_4K_ovf++;  /* FALLTHROUGH */
-
-        case 64:
-                if (SHARED_8K_BUF_AVAIL(bp->buf_inuse[B8K])) {
-                        mask = ~(bp->buf_inuse[B8K]);
-                        bdx = ffs(mask) - 1;
-                        bufp = bp->buf_8K[bdx];
-                        bp->buf_8K_used++;
-                        bp->buf_inuse[B8K] |= (1 << bdx);
-                        bp->buf_8K_maxuse = MAX(bp->buf_8K_maxuse,
-                                count_bits_int(bp->buf_inuse[B8K]));
+	class = BUF_CLASS(reqsize);
+	bp->class_reqs[class]++;
+
+	if ((hp = bp->free_list[class])) {
+		bp->free_list[class] = hp->next;
+		bp->class_reuse[class]++;
+		goto done;
+	}
+
+	size = BUF_HDRSIZE + BUF_CLASS_SIZE(class);
+
+	for (chunk = bp->current; chunk; chunk = chunk->next) {
+		if ((chunk->end - chunk->free) >= size)
+			break;
+	}
+
+	if (!chunk) {
+		if (!(chunk = buf_chunk_alloc(size)))
+			goto nomem;
+		if (bp->current) {
+			chunk->next = bp->current->next;
+			bp->current->next = chunk;
+		} else
+			bp->chunks = chunk;
+	}
+
+	bp->current = chunk;
+	hp = (struct buf_header *)chunk->free;
 #ifdef VALGRIND
-			VALGRIND_MEMPOOL_ALLOC(&bp->buf_8K, bufp, 8192);
+	VALGRIND_MAKE_MEM_UNDEFINED(hp, BUF_HDRSIZE);
 #endif
-                        BZERO(bufp, 8192);
-                        return(bufp);
-                }
-		bp->buf_8K_ovf++;  /* FALLTHROUGH */
-
-	case 256:
-               if (SHARED_32K_BUF_AVAIL(bp->buf_inuse[B32K])) {
-                        mask = ~(bp->buf_inuse[B32K]);
-                        bdx = ffs(mask) - 1;
-                        bufp = bp->buf_32K[bdx];
-                        bp->buf_32K_used++;
-                        bp->buf_inuse[B32K] |= (1 << bdx);
-                        bp->buf_32K_maxuse = MAX(bp->buf_32K_maxuse,
-                                count_bits_int(bp->buf_inuse[B32K]));
+	chunk->free += size;
+	hp->class = class;
+
+	bp->arena_bytes += size;
+	if (bp->arena_bytes > bp->max_arena_bytes)
+		bp->max_arena_bytes = bp->arena_bytes;
+
+done:
+	hp->magic = BUF_MAGIC;
+	hp->gen = bp->resets;
+	hp->size = reqsize;
+	bufp = HDR_TO_BUF(hp);
+
 #ifdef VALGRIND
-			VALGRIND_MEMPOOL_ALLOC(&bp->buf_32K, bufp, 32768);
+	if (hp->class != BUF_LARGE)
+		VALGRIND_MEMPOOL_ALLOC(bp, bufp, reqsize);
 #endif
-                        BZERO(bufp, 32768);
-                        return(bufp);
-                }
-                bp->buf_32K_ovf++;
-		break;
+	if (zero)
+		BZERO(bufp, reqsize);
+
+	return bufp;
+
+nomem:
+	dump_shared_bufs();
+	
+	return ((char *)(long)
+		error(FATAL, "cannot allocate any more memory!\n"));
+}
+
+/*
+ *  Per-command profiling, enabled with "set profile on" or "set profile
+ *  <file>".  The cumulative counters in prof->count are bumped by
+ *  readmem(), the dumpfile page caches and decompressors, kvtop(),
+ *  gdb_interface() and GETBUF(); the share of each command is the
+ *  difference between their values when it starts and when it ends.
+ *  The report is displayed once the command's output has been closed,
+ *  or with "set profile <file>", appended to the file as a JSON line.
+ */
+static char *profile_memtypes[PROFILE_MEMTYPES] = {
+	"KVADDR", "UVADDR", "PHYSADDR", "XENMACHADDR", "FILEADDR"
+};
+
+static char *profile_compressions[PROFILE_COMPRESSIONS] = {
+	"zlib", "lzo", "snappy", "zstd"
+};
+
+static int
+set_profile(char *arg)
+{
+	FILE *ofp;
+	char *path;
+
+	if (STREQ(arg, "on") || STREQ(arg, "off")) {
+		ofp = NULL;
+		path = NULL;
+	} else {
+		if (!(ofp = fopen(arg, "a"))) {
+			error(INFO, "%s: %s\n", arg, strerror(errno));
+			return FALSE;
+		}
+		if (!(path = strdup(arg))) {
+			fclose(ofp);
+			error(INFO, "cannot malloc profile path\n");
+			return FALSE;
+		}
+	}
+
+	if (prof->ofp)
+		fclose(prof->ofp);
+	free(prof->path);
+	prof->ofp = ofp;
+	prof->path = path;
+
+	prof->flags &= PROFILE_ACTIVE;
+	if (!STREQ(arg, "off"))
+		prof->flags |= PROFILE_ON | (ofp ? PROFILE_FILE : 0);
+
+	return TRUE;
+}
+
+static ulonglong
+profile_nsecs(struct timespec *start, struct timespec *end)
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000000ULL) +
+		end->tv_nsec - start->tv_nsec;
+}
+
+static ulonglong
+profile_rusage_usecs(struct timeval *start, struct timeval *end)
+{
+	return ((end->tv_sec - start->tv_sec) * 1000000ULL) +
+		end->tv_usec - start->tv_usec;
+}
+
+void
+profile_readmem(int memtype, long size)
+{
+	int i;
+
+	if ((i = ffs(memtype) - 1) >= PROFILE_MEMTYPES)
+		return;
+
+	prof->count.readmem_calls[i]++;
+	prof->count.readmem_bytes[i] += size;
+}
+
+void
+profile_decompress(int type, struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	prof->count.decompressed[type]++;
+	prof->count.decompress_nsecs[type] += profile_nsecs(start, &now);
+}
+
+void
+profile_gdb_request(int command, struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((command < 0) || (command >= PROFILE_GDB_REQUESTS))
+		command = 0;
+	prof->count.gdb_requests[command]++;
+	prof->count.gdb_nsecs += profile_nsecs(start, &now);
+}
+
+void
+profile_command_start(void)
+{
+	if (!(prof->flags & PROFILE_ON) || (prof->flags & PROFILE_ACTIVE))
+		return;
+
+	prof->flags |= PROFILE_ACTIVE;
+	prof->flags &= ~PROFILE_PENDING;
+	snprintf(prof->command, sizeof(prof->command), "%s", pc->orig_line);
+	strip_linefeeds(prof->command);
+	prof->start = prof->count;
+	prof->getbuf_peak = shared_bufs.embedded;
+	clock_gettime(CLOCK_MONOTONIC, &prof->start_time);
+	getrusage(RUSAGE_SELF, &prof->start_rusage);
+}
+
+/*
+ *  Calculate the command's share of the counters; the report is
+ *  left pending until profile_report() is called.
+ */
+void
+profile_command_end(void)
+{
+	struct profile_counters *c, *s, *d;
+	struct timespec now;
+	struct rusage rusage;
+	int i;
+
+	if (!(prof->flags & PROFILE_ACTIVE))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	getrusage(RUSAGE_SELF, &rusage);
+
+	c = &prof->count;
+	s = &prof->start;
+	d = &prof->delta;
+
+	for (i = 0; i < PROFILE_MEMTYPES; i++) {
+		d->readmem_calls[i] = c->readmem_calls[i] - s->readmem_calls[i];
+		d->readmem_bytes[i] = c->readmem_bytes[i] - s->readmem_bytes[i];
 	}
+	d->page_reads = c->page_reads - s->page_reads;
+	d->cache_hits = c->cache_hits - s->cache_hits;
+	d->cache_misses = c->cache_misses - s->cache_misses;
+	d->kvtop = c->kvtop - s->kvtop;
+	for (i = 0; i < PROFILE_COMPRESSIONS; i++) {
+		d->decompressed[i] = c->decompressed[i] - s->decompressed[i];
+		d->decompress_nsecs[i] = 
+			c->decompress_nsecs[i] - s->decompress_nsecs[i];
+	}
+	for (i = 0; i < PROFILE_GDB_REQUESTS; i++)
+		d->gdb_requests[i] = c->gdb_requests[i] - s->gdb_requests[i];
+	d->gdb_nsecs = c->gdb_nsecs - s->gdb_nsecs;
+
+	prof->wall_usecs = profile_nsecs(&prof->start_time, &now) / 1000;
+	prof->user_usecs = profile_rusage_usecs(&prof->start_rusage.ru_utime,
+		&rusage.ru_utime);
+	prof->sys_usecs = profile_rusage_usecs(&prof->start_rusage.ru_stime,
+		&rusage.ru_stime);
 
-	for (i = 0; i < MAX_MALLOC_BUFS; i++) {
-		if (bp->malloc_bp[i])
+	prof->flags &= ~PROFILE_ACTIVE;
+	prof->flags |= PROFILE_PENDING;
+}
+
+static void
+profile_json_string(FILE *ofp, char *s)
+{
+	fputc('"', ofp);
+	for ( ; *s; s++) {
+		if ((*s == '"') || (*s == '\\'))
+			fprintf(ofp, "\\%c", *s);
+		else if ((unsigned char)*s < ' ')
+			fprintf(ofp, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, ofp);
+	}
+	fputc('"', ofp);
+}
+
+static void
+profile_report_json(FILE *ofp)
+{
+	struct profile_counters *d;
+	char buf[BUFSIZE];
+	int i, others;
+
+	d = &prof->delta;
+
+	fprintf(ofp, "{\"command\": ");
+	profile_json_string(ofp, prof->command);
+	fprintf(ofp, ", \"wall_usecs\": %lld, \"user_usecs\": %lld, "
+		"\"sys_usecs\": %lld", prof->wall_usecs, prof->user_usecs,
+		prof->sys_usecs);
+
+	fprintf(ofp, ", \"readmem\": {");
+	for (i = 0; i < PROFILE_MEMTYPES; i++)
+		fprintf(ofp, "%s\"%s\": {\"calls\": %ld, \"bytes\": %lld}", 
+			i ? ", " : "", profile_memtypes[i], 
+			d->readmem_calls[i], d->readmem_bytes[i]);
+	fprintf(ofp, "}");
+
+	fprintf(ofp, ", \"page_reads\": %ld, \"cache_hits\": %ld, "
+		"\"cache_misses\": %ld, \"kvtop\": %ld", d->page_reads, 
+		d->cache_hits, d->cache_misses, d->kvtop);
+
+	fprintf(ofp, ", \"decompress\": {");
+	for (i = 0; i < PROFILE_COMPRESSIONS; i++)
+		fprintf(ofp, "%s\"%s\": {\"pages\": %ld, \"usecs\": %lld}",
+			i ? ", " : "", profile_compressions[i],
+			d->decompressed[i], d->decompress_nsecs[i] / 1000);
+	fprintf(ofp, "}");
+
+	fprintf(ofp, ", \"gdb_requests\": {");
+	for (i = others = 0; i < PROFILE_GDB_REQUESTS; i++) {
+		if (!d->gdb_requests[i])
 			continue;
+		fprintf(ofp, "%s\"%s\": %ld", others++ ? ", " : "",
+			i ? gdb_command_string(i, buf, FALSE) : "other",
+			d->gdb_requests[i]);
+	}
+	fprintf(ofp, "}, \"gdb_usecs\": %lld", d->gdb_nsecs / 1000);
 
-		if ((bp->malloc_bp[i] = (char *)calloc(reqsize, 1))) {
-			bp->mallocs++;
-			return(bp->malloc_bp[i]);
-		}
+	fprintf(ofp, ", \"getbuf_peak\": %ld}\n", prof->getbuf_peak);
+	fflush(ofp);
+}
 
-		break;
+static void
+profile_report_text(FILE *ofp)
+{
+	struct profile_counters *d;
+	char buf[BUFSIZE];
+	int i, others;
+
+	d = &prof->delta;
+
+	fprintf(ofp, "PROFILE: %s\n", prof->command);
+	fprintf(ofp, "        wall: %lld.%06llds  user: %lld.%06llds  "
+		"sys: %lld.%06llds\n",
+		prof->wall_usecs / 1000000, prof->wall_usecs % 1000000,
+		prof->user_usecs / 1000000, prof->user_usecs % 1000000,
+		prof->sys_usecs / 1000000, prof->sys_usecs % 1000000);
+
+	fprintf(ofp, "     readmem:");
+	for (i = others = 0; i < PROFILE_MEMTYPES; i++) {
+		if (!d->readmem_calls[i])
+			continue;
+		fprintf(ofp, " %s: %ld (%lld bytes)", profile_memtypes[i],
+			d->readmem_calls[i], d->readmem_bytes[i]);
+		others++;
 	}
+	fprintf(ofp, "%s\n", others ? "" : " (none)");
 
-	dump_shared_bufs();
-	
-	return ((char *)(long)
-		error(FATAL, "cannot allocate any more memory!\n"));
+	fprintf(ofp, "  page reads: %ld  cache hits: %ld  cache misses: %ld"
+		"  kvtop: %ld\n", d->page_reads, d->cache_hits, 
+		d->cache_misses, d->kvtop);
+
+	for (i = others = 0; i < PROFILE_COMPRESSIONS; i++) {
+		if (!d->decompressed[i])
+			continue;
+		if (!others++)
+			fprintf(ofp, "  decompress:");
+		fprintf(ofp, " %s: %ld (%lld usecs)", profile_compressions[i],
+			d->decompressed[i], d->decompress_nsecs[i] / 1000);
+	}
+	if (others)
+		fprintf(ofp, "\n");
+
+	for (i = others = 0; i < PROFILE_GDB_REQUESTS; i++) {
+		if (!d->gdb_requests[i])
+			continue;
+		if (!others++)
+			fprintf(ofp, "         gdb:");
+		fprintf(ofp, " %s: %ld", 
+			i ? gdb_command_string(i, buf, FALSE) : "other",
+			d->gdb_requests[i]);
+	}
+	if (others)
+		fprintf(ofp, " (%lld usecs)\n", d->gdb_nsecs / 1000);
+
+	fprintf(ofp, " GETBUF peak: %ld\n", prof->getbuf_peak);
+	fflush(ofp);
+}
+
+/*
+ *  Called after the output of the last command has been closed.
+ */
+void
+profile_report(void)
+{
+	if (!(prof->flags & PROFILE_PENDING))
+		return;
+
+	prof->flags &= ~PROFILE_PENDING;
+
+	if (prof->flags & PROFILE_FILE)
+		profile_report_json(prof->ofp);
+	else
+		profile_report_text(stdout);
 }
 
 /*
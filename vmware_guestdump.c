@@ -266,6 +266,7 @@ vmware_guestdump_init(char *filename, FILE *ofp)
 	}
 	fseek(vmss.dfp, 0L, SEEK_SET);
 	fprintf(ofp, LOGPRX"vmem file: %s\n\n", vmem_filename);
+	vmware_vmss_mem_init();
 
 	if (CRASHDEBUG(1)) {
                 vmware_guestdump_memory_dump(ofp);
@@ -315,6 +316,8 @@ vmware_guestdump_memory_dump(FILE *ofp)
 		fprintf(ofp, "0x%016llx]\n", (ulonglong)vmss.memsize + (holes_sum << VMW_PAGE_SHIFT));
 	}
 
+	vmware_vmss_mem_dump(ofp);
+
 	return TRUE;
 }
 
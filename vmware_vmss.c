@@ -479,6 +479,7 @@ vmware_vmss_init(char *filename, FILE *ofp)
 	}
 
 	vmss.dfp = fp;
+	vmware_vmss_mem_init();
 
 exit:
 	if (grps)
@@ -495,43 +496,186 @@ uint vmware_vmss_page_size(void)
 	return VMW_PAGE_SIZE;
 }
 
-int
-read_vmware_vmss(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
+/*
+ * Set up access to the guest memory once the memory regions and the
+ * file containing the memory are known: turn the regions into a table
+ * of the holes that precede each of them, and either mmap the memory
+ * or allocate a small page cache in front of pread().
+ */
+void
+vmware_vmss_mem_init(void)
 {
-	uint64_t pos = paddr;
+	uint64_t total, offset;
+	uint32_t hole;
+	long pagesize;
+	char *pages;
+	struct stat st;
+	int i;
 
-	if (vmss.regionscount > 0) {
-		/* Memory is divided into regions and there are holes between them. */
-		uint32_t ppn = (uint32_t) (pos >> VMW_PAGE_SHIFT);
-	        int i;
+	vmss.dfd = fileno(vmss.dfp);
+
+	/* Memory is divided into regions and there are holes between them. */
+	for (i = 0, total = 0; i < vmss.regionscount; i++) {
+		hole = vmss.regions[i].startppn - vmss.regions[i].startpagenum;
+		if (!hole)
+			continue;
+		if (vmss.nholes && 
+		    (vmss.regions[i].startppn <= vmss.hole_ppn[vmss.nholes-1])) {
+			/* not in ascending order; search the regions instead */
+			vmss.nholes = 0;
+			break;
+		}
+		total += hole;
+		vmss.hole_ppn[vmss.nholes] = vmss.regions[i].startppn;
+		vmss.hole_pages[vmss.nholes++] = total;
+	}
 
-		for (i = 0; i < vmss.regionscount; i++) {
-			uint32_t hole;
+	/*
+	 * Only map memory that is entirely within the file, since an
+	 * access beyond the end of a truncated file would raise SIGBUS
+	 * instead of failing the read.
+	 */
+	pagesize = sysconf(_SC_PAGESIZE);
+	offset = vmss.memoffset & ~((uint64_t)pagesize - 1);
+	if ((sizeof(void *) == 8) && vmss.memsize &&
+	    (fstat(vmss.dfd, &st) == 0) &&
+	    ((vmss.memoffset + vmss.memsize) <= (uint64_t)st.st_size)) {
+		vmss.mem_map_size = vmss.memsize + (vmss.memoffset - offset);
+		vmss.mem_map = mmap(NULL, vmss.mem_map_size, PROT_READ, 
+			MAP_SHARED, vmss.dfd, offset);
+		if (vmss.mem_map != MAP_FAILED) {
+			vmss.mem_map_offset = offset;
+			return;
+		}
+		vmss.mem_map = NULL;
+		vmss.mem_map_size = 0;
+	}
 
+	vmss.page_cache = calloc(VMSS_CACHED_PAGES, sizeof(struct vmss_page_cache));
+	pages = malloc(VMSS_CACHED_PAGES * VMW_PAGE_SIZE);
+	if (!vmss.page_cache || !pages) {
+		free(vmss.page_cache);
+		free(pages);
+		vmss.page_cache = NULL;
+		return;
+	}
+
+	for (i = 0; i < VMSS_CACHED_PAGES; i++) {
+		vmss.page_cache[i].pos = (uint64_t)-1;
+		vmss.page_cache[i].page = pages + (i * VMW_PAGE_SIZE);
+	}
+}
+
+static uint64_t
+vmss_hole_adjust(uint64_t ppn)
+{
+	int lo, hi, mid;
+	uint64_t holes;
+	uint32_t hole;
+	int i;
+
+	if (!vmss.nholes) {
+		for (i = 0, holes = 0; i < vmss.regionscount; i++) {
 			if (ppn < vmss.regions[i].startppn)
 				break;
-
-			/* skip holes. */
 			hole = vmss.regions[i].startppn - vmss.regions[i].startpagenum;
-			pos -= (uint64_t)hole << VMW_PAGE_SHIFT;
+			holes += hole;
 		}
+		return holes;
+	}
+
+	/* find the last hole ending at or below the ppn */
+	lo = 0;
+	hi = vmss.nholes - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (vmss.hole_ppn[mid] <= ppn)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return (hi < 0) ? 0 : vmss.hole_pages[hi];
+}
+
+int
+read_vmware_vmss(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
+{
+	uint64_t pos = paddr;
+	uint64_t page;
+	struct vmss_page_cache *pcache;
+
+	if (vmss.regionscount > 0) {
+		uint32_t ppn = (uint32_t) (pos >> VMW_PAGE_SHIFT);
+
+		/* skip holes. */
+		pos -= vmss_hole_adjust(ppn) << VMW_PAGE_SHIFT;
 	}
 
 	if (pos + cnt > vmss.memsize) {
 		error(INFO, LOGPRX"Read beyond the end of file! paddr=%#lx cnt=%d\n",
 		      paddr, cnt);
+		if (vmss.mem_map)
+			return READ_ERROR;
+	}
+
+	vmss.accesses++;
+
+	if (vmss.mem_map) {
+		memcpy(bufptr, vmss.mem_map + 
+		    (vmss.memoffset - vmss.mem_map_offset) + pos, cnt);
+		return cnt;
 	}
 
 	pos += vmss.memoffset;
-        if (fseek(vmss.dfp, pos, SEEK_SET) != 0)
-		return SEEK_ERROR;
 
-	if (fread(bufptr, 1, cnt, vmss.dfp) != cnt)
+	page = pos & ~((uint64_t)VMW_PAGE_SIZE - 1);
+	if (vmss.page_cache && 
+	    ((pos + cnt) <= (page + VMW_PAGE_SIZE))) {
+		pcache = &vmss.page_cache[(page >> VMW_PAGE_SHIFT) & 
+			(VMSS_CACHED_PAGES - 1)];
+		if (pcache->pos == page) {
+			vmss.cache_hits++;
+			PROFILE_COUNT(cache_hits);
+		} else {
+			PROFILE_COUNT(cache_misses);
+			pcache->pos = (uint64_t)-1;
+			if (pread(vmss.dfd, pcache->page, VMW_PAGE_SIZE, page) != 
+			    VMW_PAGE_SIZE)
+				goto uncached;
+			pcache->pos = page;
+		}
+		memcpy(bufptr, pcache->page + (pos - page), cnt);
+		return cnt;
+	}
+
+uncached:
+	if (pread(vmss.dfd, bufptr, cnt, pos) != cnt)
 		return READ_ERROR;
 
 	return cnt;
 }
 
+void
+vmware_vmss_mem_dump(FILE *ofp)
+{
+	int i;
+
+	fprintf(ofp, "    Memory access:\n");
+	fprintf(ofp, "        dfd: %d\n", vmss.dfd);
+	fprintf(ofp, "        holes: %d\n", vmss.nholes);
+	for (i = 0; i < vmss.nholes; i++)
+		fprintf(ofp, "            [%d] below ppn %x: %llx pages\n", i,
+			vmss.hole_ppn[i], (ulonglong)vmss.hole_pages[i]);
+	fprintf(ofp, "        mem_map: %lx size: %lx offset: %llx\n",
+		(ulong)vmss.mem_map, (ulong)vmss.mem_map_size, 
+		(ulonglong)vmss.mem_map_offset);
+	fprintf(ofp, "        page_cache: %lx (%d pages)\n", 
+		(ulong)vmss.page_cache, vmss.page_cache ? VMSS_CACHED_PAGES : 0);
+	fprintf(ofp, "        accesses: %ld cache_hits: %ld\n", 
+		vmss.accesses, vmss.cache_hits);
+}
+
 int
 write_vmware_vmss(int fd, void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 {
@@ -819,6 +963,8 @@ exit:
 	if (grps)
 		free(grps);
 
+	vmware_vmss_mem_dump(ofp);
+
 	return result;
 }
 
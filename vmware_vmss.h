@@ -162,9 +162,25 @@ struct vmssdata {
 	uint32_t	*vcpu_regs;
 	uint64_t	num_vcpus;
 	vmssregs64	**regs64;
+	/* guest memory access, set up by vmware_vmss_mem_init() */
+	int		dfd;
+	uint32_t	nholes;
+	uint32_t	hole_ppn[MAX_REGIONS];
+	uint64_t	hole_pages[MAX_REGIONS];  /* total below hole_ppn */
+	char		*mem_map;
+	size_t		mem_map_size;
+	uint64_t	mem_map_offset;
+	struct vmss_page_cache {
+		uint64_t	pos;
+		char		*page;
+	}		*page_cache;
+	ulong		accesses;
+	ulong		cache_hits;
 };
 typedef struct vmssdata vmssdata;
 
+#define VMSS_CACHED_PAGES (64)	/* power of two */
+
 /* VMware only supports X86/X86_64 virtual machines. */
 #define VMW_PAGE_SIZE (4096)
 #define VMW_PAGE_SHIFT (12)
@@ -173,6 +189,9 @@ typedef struct vmssdata vmssdata;
 
 extern vmssdata vmss;
 
+void vmware_vmss_mem_init(void);
+void vmware_vmss_mem_dump(FILE *);
+
 #define DEBUG_PARSE_PRINT(x)		\
 do {					\
 	if (CRASHDEBUG(1)) {		\
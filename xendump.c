@@ -51,6 +51,13 @@ static void xc_core_dump_Elf64_Shdr(Elf64_Off offset, int);
 static char *xc_core_strtab(uint32_t, char *);
 static void xc_core_dump_elfnote(off_t, size_t, int);
 static void xc_core_elf_pfn_init(void);
+static int compare_frame_map(const void *, const void *);
+static void xc_core_frame_index_build(struct xc_core_frame_index *, 
+	struct xc_core_frame_map *, ulong, char *);
+static ulong xc_core_frame_index_lookup(struct xc_core_frame_index *, ulong);
+static void xc_core_frame_index_dump(struct xc_core_frame_index *, char *, FILE *);
+static void xc_core_mfn_index_init(void);
+static void xc_core_pfn_index_init(void);
 
 #define ELFSTORE 1
 #define ELFREAD  0
@@ -169,6 +176,34 @@ xc_core_read(void *bufptr, int cnt, ulong addr, physaddr_t paddr)
 
         pfn = (ulong)BTOP(paddr);
 
+	if (FRAME_INDEX_VALID(&xd->xc_core.pfn_index)) {
+		xd->accesses++;
+		if (pfn == xd->last_pfn) {
+			xd->redundant++;
+			PROFILE_COUNT(cache_hits);
+			BCOPY(xd->page + PAGEOFFSET(paddr), bufptr, cnt);
+			return cnt;
+		}
+
+		PROFILE_COUNT(cache_misses);
+
+		if ((page_index = xc_core_frame_index_lookup
+		    (&xd->xc_core.pfn_index, pfn)) == PFN_NOT_FOUND)
+			return READ_ERROR;
+
+		offset = xd->xc_core.header.xch_pages_offset +
+			((off_t)(page_index) * (off_t)xd->page_size);
+
+		xd->last_pfn = ~(0UL);
+		if (pread(xd->xfd, xd->page, xd->page_size, offset) != 
+		    xd->page_size)
+			return READ_ERROR;
+		xd->last_pfn = pfn;
+
+		BCOPY(xd->page + PAGEOFFSET(paddr), bufptr, cnt);
+		return cnt;
+	}
+
         if ((offset = poc_get(pfn, &redundant))) {
                 if (!redundant) {
                         if (lseek(xd->xfd, offset, SEEK_SET) == -1)
@@ -930,6 +965,8 @@ xendump_memory_dump(FILE *fp)
 		fprintf(fp, "%sXC_SAVE_IA64", others++ ? "|" : "");
 	if (xd->flags & XC_CORE_64BIT_HOST)
 		fprintf(fp, "%sXC_CORE_64BIT_HOST", others++ ? "|" : "");
+	if (xd->flags & XC_CORE_MFN_INDEX)
+		fprintf(fp, "%sXC_CORE_MFN_INDEX", others++ ? "|" : "");
 	fprintf(fp, ")\n");
 	fprintf(fp, "          xfd: %d\n", xd->xfd);
 	fprintf(fp, "    page_size: %d\n", xd->page_size);
@@ -1050,6 +1087,9 @@ xendump_memory_dump(FILE *fp)
 		(ulonglong)xd->xc_core.header.xch_pages_offset,
 		(ulonglong)xd->xc_core.header.xch_pages_offset);
 
+	xc_core_frame_index_dump(&xd->xc_core.mfn_index, "mfn_index", fp);
+	xc_core_frame_index_dump(&xd->xc_core.pfn_index, "pfn_index", fp);
+
 	fprintf(fp, "                elf_class: %s\n", xd->xc_core.elf_class == ELFCLASS64 ? "ELFCLASS64" :
 		xd->xc_core.elf_class == ELFCLASS32 ? "ELFCLASS32" : "n/a");
 	fprintf(fp, "        elf_strtab_offset: %lld (0x%llx)\n", 
@@ -1265,6 +1305,8 @@ xc_core_create_pfn_tables(void)
 
 	xd->flags &= ~(XC_CORE_P2M_CREATE|XC_CORE_PFN_CREATE);
 
+	xc_core_pfn_index_init();
+
 	if (CRASHDEBUG(1))
 		xendump_memory_dump(xd->ofp);
 }
@@ -1282,6 +1324,32 @@ xc_core_mfn_to_page(ulong mfn, char *pgbuf)
 	size_t size;
 	uint nr_pages;
 
+	if (!(xd->flags & XC_CORE_MFN_INDEX))
+		xc_core_mfn_index_init();
+
+	if (pgbuf == xd->page)
+		xd->last_pfn = ~(0UL);
+
+	if (FRAME_INDEX_VALID(&xd->xc_core.mfn_index)) {
+		if ((idx = xc_core_frame_index_lookup(&xd->xc_core.mfn_index, 
+		    mfn)) == MFN_NOT_FOUND) {
+                	error(INFO, "cannot find mfn %ld (0x%lx) in page index\n",
+				mfn, mfn);
+			return NULL;
+		}
+
+		offset = xd->xc_core.header.xch_pages_offset +
+			((off_t)(idx) * (off_t)xd->page_size);
+
+		if (pread(xd->xfd, pgbuf, xd->page_size, offset) != 
+		    xd->page_size) {
+                	error(INFO, "cannot read mfn-specified page\n");
+			return NULL;
+		}
+
+		return pgbuf;
+	}
+
 	if (xd->flags & XC_CORE_ELF)
 		return xc_core_elf_mfn_to_page(mfn, pgbuf);
 
@@ -1431,6 +1499,12 @@ xc_core_mfn_to_page_index(ulong mfn)
 	uint nr_pages;
 	size_t size;
 
+	if (!(xd->flags & XC_CORE_MFN_INDEX))
+		xc_core_mfn_index_init();
+
+	if (FRAME_INDEX_VALID(&xd->xc_core.mfn_index))
+		return (int)xc_core_frame_index_lookup(&xd->xc_core.mfn_index, mfn);
+
 	if (xd->flags & XC_CORE_ELF)
 		return xc_core_elf_mfn_to_page_index(mfn);
 
@@ -1651,6 +1725,9 @@ xc_core_pfn_to_page_index(ulong pfn)
 	ulong *up, mfn;
 	off_t offset;
 
+	if (FRAME_INDEX_VALID(&xd->xc_core.pfn_index))
+		return xc_core_frame_index_lookup(&xd->xc_core.pfn_index, pfn);
+
 	/*
 	 *  This function does not apply when there's no p2m
 	 *  mapping and/or if this is an ELF format dumpfile.
@@ -2869,6 +2946,309 @@ xc_core_elf_pfn_init(void)
 	}
 }
 
+static int
+compare_frame_map(const void *v1, const void *v2)
+{
+	struct xc_core_frame_map *m1, *m2;
+
+	m1 = (struct xc_core_frame_map *)v1;
+	m2 = (struct xc_core_frame_map *)v2;
+
+	if (m1->frame != m2->frame)
+		return (m1->frame < m2->frame ? -1 : 1);
+
+	return (m1->index < m2->index ? -1 : m1->index == m2->index ? 0 : 1);
+}
+
+/*
+ *  Turn an array of frame/page-index pairs into a frame index, taking 
+ *  ownership of the array.  If a frame appears more than once, its lowest 
+ *  page index is used, just as a sequential search of the page index would
+ *  find it.
+ */
+static void
+xc_core_frame_index_build(struct xc_core_frame_index *fi, 
+			  struct xc_core_frame_map *map, ulong count, char *name)
+{
+	ulong i, j;
+
+	BZERO(fi, sizeof(struct xc_core_frame_index));
+
+	if (!count) {
+		free(map);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (map[i].frame > fi->max_frame)
+			fi->max_frame = map[i].frame;
+	}
+
+	/*
+	 *  Use a direct table if at least half of its entries are used.
+	 */
+	if ((fi->max_frame/2) < count) {
+		if ((fi->direct = (ulong *)malloc((fi->max_frame+1) * 
+		    sizeof(ulong)))) {
+			memset(fi->direct, 0xff, (fi->max_frame+1) * sizeof(ulong));
+			for (i = count; i > 0; i--)
+				fi->direct[map[i-1].frame] = map[i-1].index;
+			fi->frames = count;
+			free(map);
+			return;
+		}
+	}
+
+	qsort(map, count, sizeof(struct xc_core_frame_map), compare_frame_map);
+
+	for (i = j = 0; i < count; i++) {
+		if (j && (map[i].frame == map[j-1].frame))
+			continue;
+		map[j++] = map[i];
+	}
+
+	fi->frames = j;
+	fi->sorted = map;
+
+	if (CRASHDEBUG(1))
+		fprintf(xd->ofp, "%s: %ld sorted entries\n", name, fi->frames);
+}
+
+static ulong
+xc_core_frame_index_lookup(struct xc_core_frame_index *fi, ulong frame)
+{
+	long lo, hi, mid;
+
+	if (frame > fi->max_frame)
+		return PFN_NOT_FOUND;
+
+	if (fi->direct)
+		return fi->direct[frame];
+
+	lo = 0;
+	hi = fi->frames - 1;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (fi->sorted[mid].frame == frame)
+			return fi->sorted[mid].index;
+		if (fi->sorted[mid].frame < frame)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return PFN_NOT_FOUND;
+}
+
+static void
+xc_core_frame_index_dump(struct xc_core_frame_index *fi, char *name, FILE *ofp)
+{
+	fprintf(ofp, "%25s: ", name);
+	if (fi->direct)
+		fprintf(ofp, "direct: %lx frames: %ld max_frame: %lx\n",
+			(ulong)fi->direct, fi->frames, fi->max_frame);
+	else if (fi->sorted)
+		fprintf(ofp, "sorted: %lx frames: %ld max_frame: %lx\n",
+			(ulong)fi->sorted, fi->frames, fi->max_frame);
+	else
+		fprintf(ofp, "(unused)\n");
+}
+
+/*
+ *  Read the complete page index once, and create the mfn-to-page-index
+ *  map from it.  ELF dumpfiles without a .xen_p2m section contain no mfns.
+ */
+static void
+xc_core_mfn_index_init(void)
+{
+	struct xc_core_frame_map *map;
+	struct xen_dumpcore_p2m p2m_batch[MAX_BATCH_SIZE];
+	ulong tmp[MAX_BATCH_SIZE];
+	ulong b, i, n, cnt, nr_entries;
+	off_t offset;
+	size_t size;
+
+	xd->flags |= XC_CORE_MFN_INDEX;
+
+	if ((xd->flags & (XC_CORE_ELF|XC_CORE_NO_P2M)) == 
+	    (XC_CORE_ELF|XC_CORE_NO_P2M))
+		return;
+
+	nr_entries = xd->xc_core.header.xch_nr_pages;
+	if (!(xd->flags & XC_CORE_ELF) && (xd->flags & XC_CORE_64BIT_HOST))
+		nr_entries *= 2;
+
+	if (!(map = (struct xc_core_frame_map *)
+	    malloc(nr_entries * sizeof(struct xc_core_frame_map)))) {
+		error(INFO, "cannot malloc xc_core mfn index\n");
+		return;
+	}
+
+	offset = xd->xc_core.header.xch_index_offset;
+
+	for (b = cnt = 0; b < nr_entries; b += n, offset += size) {
+		n = MIN(MAX_BATCH_SIZE, nr_entries - b);
+
+		if (xd->flags & XC_CORE_ELF) {
+			size = n * sizeof(struct xen_dumpcore_p2m);
+			if (pread(xd->xfd, p2m_batch, size, offset) != size)
+				goto bailout;
+			for (i = 0; i < n; i++) {
+				map[cnt].frame = (ulong)p2m_batch[i].gmfn;
+				map[cnt++].index = b+i;
+			}
+		} else {
+			size = n * sizeof(ulong);
+			if (pread(xd->xfd, tmp, size, offset) != size)
+				goto bailout;
+			for (i = 0; i < n; i++) {
+				if (tmp[i] == INVALID_MFN)
+					continue;
+				map[cnt].frame = tmp[i];
+				map[cnt++].index = b+i;
+			}
+		}
+	}
+
+	xc_core_frame_index_build(&xd->xc_core.mfn_index, map, cnt, "mfn_index");
+	return;
+
+bailout:
+	error(INFO, "cannot read index page %ld\n", b);
+	free(map);
+}
+
+/*
+ *  Create the pfn-to-page-index map, which depending upon the dumpfile
+ *  format comes from the page index itself, or from the p2m frames
+ *  combined with the mfn index.
+ */
+static void
+xc_core_pfn_index_init(void)
+{
+	struct xc_core_frame_map *map;
+	struct xen_dumpcore_p2m p2m_batch[MAX_BATCH_SIZE];
+	uint64_t pfn_batch[MAX_BATCH_SIZE];
+	char raw[MAX_BATCH_SIZE * sizeof(ulonglong)];
+	ulong b, i, n, cnt, nr_entries, idx, mfn_idx;
+	ulong *up;
+	off_t offset;
+	size_t size, esize;
+	char *pgbuf;
+
+	if (xd->flags & XC_CORE_ELF)
+		nr_entries = xd->xc_core.header.xch_nr_pages;
+	else if (xd->flags & XC_CORE_NO_P2M)
+		nr_entries = xd->xc_core.header.xch_nr_pages;
+	else {
+		if (!(xd->flags & XC_CORE_MFN_INDEX))
+			xc_core_mfn_index_init();
+		if (!FRAME_INDEX_VALID(&xd->xc_core.mfn_index))
+			return;
+		nr_entries = xd->xc_core.p2m_frames * PFNS_PER_PAGE;
+	}
+
+	if (!nr_entries)
+		return;
+
+	if (!(map = (struct xc_core_frame_map *)
+	    malloc(nr_entries * sizeof(struct xc_core_frame_map)))) {
+		error(INFO, "cannot malloc xc_core pfn index\n");
+		return;
+	}
+
+	offset = xd->xc_core.header.xch_index_offset;
+	cnt = 0;
+
+	switch (xd->flags & (XC_CORE_NO_P2M|XC_CORE_ELF))
+	{
+	case (XC_CORE_NO_P2M|XC_CORE_ELF):
+		for (b = 0; b < nr_entries; b += n, offset += size) {
+			n = MIN(MAX_BATCH_SIZE, nr_entries - b);
+			size = n * sizeof(uint64_t);
+			if (pread(xd->xfd, pfn_batch, size, offset) != size)
+				goto bailout;
+			for (i = 0; i < n; i++) {
+				map[cnt].frame = (ulong)pfn_batch[i];
+				map[cnt++].index = b+i;
+			}
+		}
+		break;
+
+	case XC_CORE_ELF:
+		for (b = 0; b < nr_entries; b += n, offset += size) {
+			n = MIN(MAX_BATCH_SIZE, nr_entries - b);
+			size = n * sizeof(struct xen_dumpcore_p2m);
+			if (pread(xd->xfd, p2m_batch, size, offset) != size)
+				goto bailout;
+			for (i = 0; i < n; i++) {
+				map[cnt].frame = (ulong)p2m_batch[i].pfn;
+				map[cnt++].index = b+i;
+			}
+		}
+		break;
+
+	case XC_CORE_NO_P2M:
+		/*
+		 *  The page index is indexed by pfn, with INVALID_MFN
+		 *  markers for the pfns that are not present.
+		 */
+		esize = (xd->flags & XC_CORE_64BIT_HOST) ? 
+			sizeof(ulonglong) : sizeof(ulong);
+		for (b = 0; b < nr_entries; b += n, offset += size) {
+			n = MIN(MAX_BATCH_SIZE, nr_entries - b);
+			size = n * esize;
+			if (pread(xd->xfd, raw, size, offset) != size)
+				goto bailout;
+			for (i = 0; i < n; i++) {
+				if (*((ulong *)(raw + (i * esize))) == INVALID_MFN)
+					continue;
+				map[cnt].frame = b+i;
+				map[cnt++].index = b+i;
+			}
+		}
+		break;
+
+	default:
+		/*
+		 *  Translate each pfn through its p2m frame to an mfn, 
+		 *  and then through the mfn index.
+		 */
+		if (!(pgbuf = (char *)malloc(xd->page_size)))
+			goto bailout;
+
+		for (idx = b = 0; idx < xd->xc_core.p2m_frames; idx++) {
+			offset = xd->xc_core.header.xch_pages_offset +
+				((off_t)xd->xc_core.p2m_frame_index_list[idx] *
+				(off_t)xd->page_size);
+			b = idx * PFNS_PER_PAGE;
+			if (pread(xd->xfd, pgbuf, xd->page_size, offset) != 
+			    xd->page_size) {
+				free(pgbuf);
+				goto bailout;
+			}
+			up = (ulong *)pgbuf;
+			for (i = 0; i < PFNS_PER_PAGE; i++) {
+				if ((mfn_idx = xc_core_frame_index_lookup
+				    (&xd->xc_core.mfn_index, up[i])) == 
+				    PFN_NOT_FOUND)
+					continue;
+				map[cnt].frame = b+i;
+				map[cnt++].index = mfn_idx;
+			}
+		}
+		free(pgbuf);
+		break;
+	}
+
+	xc_core_frame_index_build(&xd->xc_core.pfn_index, map, cnt, "pfn_index");
+	return;
+
+bailout:
+	error(INFO, "cannot read page index entries for pfn index\n");
+	free(map);
+}
+
 struct xendump_data *
 get_xendump_data(void)
 {
@@ -60,6 +60,25 @@ struct elf_index_pfn {
 };
 #define INDEX_PFN_COUNT (128)
 
+/*
+ *  Complete frame-to-page-index maps of an xc_core dumpfile, built once
+ *  from its page index.  Dense frame ranges use a direct table indexed
+ *  by frame number; sparse ones a frame-sorted array that is searched.
+ */
+struct xc_core_frame_map {
+	ulong frame;
+	ulong index;
+};
+
+struct xc_core_frame_index {
+	ulong frames;
+	ulong max_frame;
+	ulong *direct;
+	struct xc_core_frame_map *sorted;
+};
+
+#define FRAME_INDEX_VALID(fi) ((fi)->direct || (fi)->sorted)
+
 struct last_batch {
 	ulong index;
 	ulong start;
@@ -92,6 +111,8 @@ struct xendump_data {
 		off_t ia64_mapped_regs_offset;
 		struct elf_index_pfn elf_index_pfn[INDEX_PFN_COUNT];
 		struct last_batch last_batch;
+		struct xc_core_frame_index mfn_index;
+		struct xc_core_frame_index pfn_index;
 		Elf32_Ehdr *elf32;
 		Elf64_Ehdr *elf64;
 	} xc_core;
@@ -124,6 +145,7 @@ struct xendump_data {
 #define XC_SAVE_IA64       (XENDUMP_LOCAL << 6)
 #define XC_CORE_64BIT_HOST (XENDUMP_LOCAL << 7)
 #define XC_CORE_ELF        (XENDUMP_LOCAL << 8)
+#define XC_CORE_MFN_INDEX  (XENDUMP_LOCAL << 9)
 
 #define MACHINE_BYTE_ORDER()  \
         (machine_type("X86") || \